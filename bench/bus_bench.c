@@ -0,0 +1,432 @@
+// Bus throughput and latency harness.
+//
+// Forks N producers and M consumers against a bus created with
+// bus_init_with_options(). Children attach with bus_attach() on the SysV
+// backend and bus_attach_inherited() otherwise. Producers publish a
+// weighted mix of message types, and consumers record publish-to-read
+// latency from the bus's send_time_ns stamp in log-linear histograms.
+// Reports delivered msgs/sec and p50/p99/p999.
+//
+// Usage: bus_bench [options]
+//   --seconds S        run time per configuration (default 2)
+//   --producers N      producer processes (default 1)
+//   --consumers M      consumer processes (default 1)
+//   --mode queue|rings delivery mode (default: bus_init's)
+//   --backend sysv|shm_open|memfd
+//   --huge             ask for huge pages
+//   --mix SPEC         weights, e.g. position=8,command=1,status=1
+//   --rate R           messages/sec per producer, 0 = as fast as possible
+//   --batch B          publish with bus_publish_batch in groups of B
+//   --latest TYPES     subscribe to these types with BUS_QOS_LATEST,
+//                      e.g. position,status
+//   --all              run every mode and backend combination
+//   --overflow         instead, check BUS_OVERFLOW_PRIORITY eviction on a
+//                      full lane against expected drop counts
+
+#include "bus.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_PRODUCERS 8
+#define MAX_CONSUMERS MAX_COMPONENTS
+#define MAX_BATCH 64
+#define SCHEDULE_LENGTH 64
+#define READ_BATCH 16
+
+// Results shared with the children. Each process writes only its own
+// entries, and only after the run, so they do not perturb the measurement.
+typedef struct {
+    _Alignas(64) volatile int stop;
+    _Alignas(64) uint64_t published[MAX_PRODUCERS];
+    uint64_t rejected[MAX_PRODUCERS];
+    _Alignas(64) uint64_t delivered[MAX_CONSUMERS];
+    LatencyHistogram latency[MAX_CONSUMERS];
+} BenchShared;
+
+typedef struct {
+    double seconds;
+    int producers;
+    int consumers;
+    BusOptions bus;
+    unsigned weights[MSG_NUM_TYPES];
+    unsigned latest[MSG_NUM_TYPES];     // Nonzero: conflated subscription
+    double rate;
+    int batch;
+} BenchConfig;
+
+static const char* const BACKEND_NAMES[] = {
+    [BUS_BACKEND_SYSV] = "sysv",
+    [BUS_BACKEND_SHM_OPEN] = "shm_open",
+    [BUS_BACKEND_MEMFD] = "memfd"
+};
+
+static void fill_message(Message* msg, MessageType type, int producer) {
+    memset(msg, 0, sizeof(*msg));
+    msg->header.type = type;
+    msg->header.sender = (ComponentId)(producer % MAX_COMPONENTS);
+    msg->header.receiver = COMPONENT_FLIGHT_CONTROLLER;
+    msg->header.message_size = MESSAGE_PAYLOAD_SIZES[type];
+}
+
+// Interleave the types by weight so every batch sees the configured mix
+static int build_schedule(const BenchConfig* config, MessageType schedule[SCHEDULE_LENGTH]) {
+    unsigned total = 0;
+    for (int t = 0; t < MSG_NUM_TYPES; t++) total += config->weights[t];
+    if (total == 0) return 0;
+
+    double credit[MSG_NUM_TYPES] = {0};
+    for (int i = 0; i < SCHEDULE_LENGTH; i++) {
+        int best = -1;
+        for (int t = 0; t < MSG_NUM_TYPES; t++) {
+            credit[t] += (double)config->weights[t] / total;
+            if (config->weights[t] && (best < 0 || credit[t] > credit[best])) best = t;
+        }
+        credit[best] -= 1.0;
+        schedule[i] = (MessageType)best;
+    }
+    return SCHEDULE_LENGTH;
+}
+
+static void run_producer(Bus* bus, const BenchConfig* config, BenchShared* shared, int id) {
+    MessageType schedule[SCHEDULE_LENGTH];
+    build_schedule(config, schedule);
+
+    Message batch[MAX_BATCH];
+    uint64_t published = 0, rejected = 0;
+    uint64_t interval = config->rate > 0 ? (uint64_t)(1e9 / config->rate) : 0;
+    uint64_t next_send = monotonic_ns();
+    int cursor = id;  // Offset producers so their mixes interleave
+
+    while (!shared->stop) {
+        if (interval) {
+            uint64_t now = monotonic_ns();
+            if (now < next_send) {
+                sched_yield();
+                continue;
+            }
+            next_send += interval * (uint64_t)config->batch;
+        }
+
+        for (int i = 0; i < config->batch; i++) {
+            fill_message(&batch[i], schedule[cursor++ % SCHEDULE_LENGTH], id);
+        }
+
+        if (config->batch == 1) {
+            if (bus_publish(bus, &batch[0]) == SUCCESS) {
+                published++;
+            } else {
+                rejected++;
+                sched_yield();  // Full, let consumers run
+            }
+        } else if (bus_publish_batch(bus, batch, config->batch) == SUCCESS) {
+            published += (uint64_t)config->batch;
+        } else {
+            // Part of the batch may have gone through; count it as rejected
+            rejected += (uint64_t)config->batch;
+            sched_yield();
+        }
+    }
+
+    shared->published[id] = published;
+    shared->rejected[id] = rejected;
+}
+
+static void run_consumer(Bus* bus, BenchShared* shared, int id) {
+    // Consumers use their own heap histogram and merge it out once
+    LatencyHistogram* latency = calloc(1, sizeof(LatencyHistogram));
+    Message messages[READ_BATCH];
+    uint64_t delivered = 0;
+
+    while (!shared->stop && latency) {
+        int count = bus_read_batch(bus, (ComponentId)id, messages, READ_BATCH);
+        if (count == 0) {
+            sched_yield();
+            continue;
+        }
+
+        uint64_t now = monotonic_ns();
+        for (int i = 0; i < count; i++) {
+            uint64_t sent = messages[i].header.send_time_ns;
+            latency_histogram_add(latency, now > sent ? now - sent : 0);
+        }
+        delivered += (uint64_t)count;
+    }
+
+    shared->delivered[id] = delivered;
+    if (latency) {
+        latency_histogram_merge(&shared->latency[id], latency);
+        free(latency);
+    }
+}
+
+static void run_child(Bus* bus, int shm_id, const BenchConfig* config,
+                      BenchShared* shared, int index) {
+    Bus* child_bus = config->bus.backend == BUS_BACKEND_SYSV ? bus_attach(shm_id)
+                                                             : bus_attach_inherited(bus);
+    if (!child_bus) _exit(EXIT_FAILURE);
+
+    if (index < config->consumers) {
+        run_consumer(child_bus, shared, index);
+    } else {
+        run_producer(child_bus, config, shared, index - config->consumers);
+    }
+
+    bus_detach(child_bus);
+    _exit(EXIT_SUCCESS);
+}
+
+static int run_config(const BenchConfig* config) {
+    BenchShared* shared = mmap(NULL, sizeof(BenchShared), PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memset(shared, 0, sizeof(*shared));
+
+    Bus* bus = bus_init_with_options(&config->bus);
+    if (!bus) {
+        munmap(shared, sizeof(BenchShared));
+        return -1;
+    }
+
+    // Every consumer takes the whole mix: fan-out in ring mode, shared
+    // work in queue mode
+    for (int c = 0; c < config->consumers; c++) {
+        for (int t = 0; t < MSG_NUM_TYPES; t++) {
+            if (!config->weights[t]) continue;
+            bus_subscribe_qos(bus, (ComponentId)c, (MessageType)t,
+                              config->latest[t] ? BUS_QOS_LATEST : BUS_QOS_QUEUED);
+        }
+    }
+
+    int shm_id = bus_get_shm_id(bus);
+    int children = config->consumers + config->producers;
+    pid_t pids[MAX_CONSUMERS + MAX_PRODUCERS];
+
+    // Consumers first so producers never start against an idle bus
+    for (int i = 0; i < children; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            run_child(bus, shm_id, config, shared, i);
+        }
+        if (pids[i] < 0) {
+            perror("fork");
+            shared->stop = 1;
+            children = i;
+            break;
+        }
+    }
+
+    uint64_t start = monotonic_ns();
+    usleep((useconds_t)(config->seconds * 1e6));
+    shared->stop = 1;
+    for (int i = 0; i < children; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    double elapsed = (double)(monotonic_ns() - start) / 1e9;
+
+    uint64_t published = 0, rejected = 0, delivered = 0;
+    static LatencyHistogram latency;
+    memset(&latency, 0, sizeof(latency));
+    for (int p = 0; p < config->producers; p++) {
+        published += shared->published[p];
+        rejected += shared->rejected[p];
+    }
+    for (int c = 0; c < config->consumers; c++) {
+        delivered += shared->delivered[c];
+        latency_histogram_merge(&latency, &shared->latency[c]);
+    }
+
+    printf("%-5s %-8s %4s %2d %2d %12.0f %12.0f %10.0f %9llu %9llu %9llu\n",
+           config->bus.mode == BUS_MODE_RINGS ? "rings" : "queue",
+           BACKEND_NAMES[config->bus.backend], config->bus.huge_pages ? "yes" : "no",
+           config->producers, config->consumers,
+           published / elapsed, delivered / elapsed, rejected / elapsed,
+           (unsigned long long)latency_histogram_percentile(&latency, 50.0),
+           (unsigned long long)latency_histogram_percentile(&latency, 99.0),
+           (unsigned long long)latency_histogram_percentile(&latency, 99.9));
+    fflush(stdout);
+
+    bus_cleanup(bus);
+    munmap(shared, sizeof(BenchShared));
+    return 0;
+}
+
+static bool parse_mix(const char* spec, unsigned weights[MSG_NUM_TYPES]) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+    memset(weights, 0, sizeof(unsigned) * MSG_NUM_TYPES);
+
+    for (char* item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        char* eq = strchr(item, '=');
+        unsigned weight = eq ? (unsigned)atoi(eq + 1) : 1;
+        if (eq) *eq = '\0';
+
+        int type = -1;
+        for (int t = 0; t < MSG_NUM_TYPES; t++) {
+            if (strcmp(item, MESSAGE_TYPE_NAMES[t]) == 0) type = t;
+        }
+        if (type < 0) {
+            fprintf(stderr, "Unknown message type '%s' in mix\n", item);
+            return false;
+        }
+        weights[type] = weight;
+    }
+    return true;
+}
+
+static Message overflow_message(MessageType type) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = type;
+    msg.header.sender = COMPONENT_FLIGHT_CONTROLLER;
+    msg.header.receiver = COMPONENT_AUTOPILOT;
+    msg.header.message_size = MESSAGE_PAYLOAD_SIZES[type];
+    return msg;
+}
+
+// Fill the normal lane with one head_type message and state requests
+// behind it, none of them read, then publish a status that outranks the
+// requests. Returns false if the outcome or drop counts differ.
+static bool check_overflow(const char* name, MessageType head_type, bool expect_published,
+                           uint64_t expect_requests_dropped) {
+    BusOptions options = bus_default_options();
+    options.mode = BUS_MODE_QUEUE;
+    Bus* bus = bus_init_with_options(&options);
+    if (!bus) return false;
+
+    BusTopicPolicy low = { .overflow = BUS_OVERFLOW_PRIORITY, .priority = 0 };
+    BusTopicPolicy high = { .overflow = BUS_OVERFLOW_PRIORITY, .priority = 1 };
+    bus_set_topic_policy(bus, MSG_STATE_REQUEST, &low);
+    bus_set_topic_policy(bus, MSG_SYSTEM_STATUS, &high);
+    bus_subscribe(bus, COMPONENT_AUTOPILOT, MSG_STATE_REQUEST);
+    bus_subscribe(bus, COMPONENT_AUTOPILOT, MSG_SYSTEM_STATUS);
+
+    Message head = overflow_message(head_type);
+    Message request = overflow_message(MSG_STATE_REQUEST);
+    Message status = overflow_message(MSG_SYSTEM_STATUS);
+    bool filled = bus_publish(bus, &head) == SUCCESS;
+    for (int i = 1; i < MAX_BUS_MESSAGES; i++) {
+        filled &= bus_publish(bus, &request) == SUCCESS;
+    }
+
+    bool published = bus_publish(bus, &status) == SUCCESS;
+    BusStats requests, statuses;
+    bus_get_topic_stats(bus, MSG_STATE_REQUEST, &requests);
+    bus_get_topic_stats(bus, MSG_SYSTEM_STATUS, &statuses);
+    bus_cleanup(bus);
+
+    uint64_t expect_statuses_dropped = expect_published ? 0 : 1;
+    bool ok = filled && published == expect_published &&
+              requests.dropped == expect_requests_dropped &&
+              statuses.dropped == expect_statuses_dropped;
+    printf("%-22s %-9s requests dropped %llu (want %llu), statuses dropped %llu (want %llu)  %s\n",
+           name, published ? "accepted" : "rejected",
+           (unsigned long long)requests.dropped, (unsigned long long)expect_requests_dropped,
+           (unsigned long long)statuses.dropped, (unsigned long long)expect_statuses_dropped,
+           ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--seconds S] [--producers N] [--consumers M] [--mode queue|rings]\n"
+            "          [--backend sysv|shm_open|memfd] [--huge] [--mix type=weight,...]\n"
+            "          [--rate msgs_per_sec] [--batch B] [--latest type,...] [--all] [--overflow]\n"
+            "Mix types: position state_request state_response command status\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config = {
+        .seconds = 2.0,
+        .producers = 1,
+        .consumers = 1,
+        .bus = bus_default_options(),
+        .weights = { [MSG_POSITION_UPDATE] = 8, [MSG_AUTOPILOT_COMMAND] = 1,
+                     [MSG_SYSTEM_STATUS] = 1 },
+        .rate = 0,
+        .batch = 1
+    };
+    bool all = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--all") == 0) {
+            all = true;
+        } else if (strcmp(arg, "--overflow") == 0) {
+            // A lower-priority head is evicted; one of equal priority
+            // blocks the publish without touching anything behind it
+            bool ok = check_overflow("lower-priority head", MSG_STATE_REQUEST, true, 1);
+            ok &= check_overflow("equal-priority head", MSG_SYSTEM_STATUS, false, 0);
+            return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else if (strcmp(arg, "--huge") == 0) {
+            config.bus.huge_pages = true;
+        } else if (!value) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else if (strcmp(arg, "--seconds") == 0) {
+            config.seconds = atof(value); i++;
+        } else if (strcmp(arg, "--producers") == 0) {
+            config.producers = atoi(value); i++;
+        } else if (strcmp(arg, "--consumers") == 0) {
+            config.consumers = atoi(value); i++;
+        } else if (strcmp(arg, "--rate") == 0) {
+            config.rate = atof(value); i++;
+        } else if (strcmp(arg, "--batch") == 0) {
+            config.batch = atoi(value); i++;
+        } else if (strcmp(arg, "--mode") == 0) {
+            config.bus.mode = strcmp(value, "rings") == 0 ? BUS_MODE_RINGS : BUS_MODE_QUEUE; i++;
+        } else if (strcmp(arg, "--backend") == 0) {
+            if (strcmp(value, "sysv") == 0) config.bus.backend = BUS_BACKEND_SYSV;
+            else if (strcmp(value, "memfd") == 0) config.bus.backend = BUS_BACKEND_MEMFD;
+            else config.bus.backend = BUS_BACKEND_SHM_OPEN;
+            i++;
+        } else if (strcmp(arg, "--mix") == 0) {
+            if (!parse_mix(value, config.weights)) return EXIT_FAILURE;
+            i++;
+        } else if (strcmp(arg, "--latest") == 0) {
+            if (!parse_mix(value, config.latest)) return EXIT_FAILURE;
+            i++;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    MessageType schedule[SCHEDULE_LENGTH];
+    if (config.producers < 1 || config.producers > MAX_PRODUCERS ||
+        config.consumers < 1 || config.consumers > MAX_CONSUMERS ||
+        config.batch < 1 || config.batch > MAX_BATCH || config.seconds <= 0 ||
+        !build_schedule(&config, schedule)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-5s %-8s %4s %2s %2s %12s %12s %10s %9s %9s %9s\n",
+           "mode", "backend", "huge", "P", "C", "publish/s", "deliver/s", "reject/s",
+           "p50 ns", "p99 ns", "p999 ns");
+
+    if (!all) {
+        return run_config(&config) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int failures = 0;
+    for (int mode = BUS_MODE_QUEUE; mode <= BUS_MODE_RINGS; mode++) {
+        for (int backend = BUS_BACKEND_SYSV; backend <= BUS_BACKEND_MEMFD; backend++) {
+            config.bus.mode = (BusMode)mode;
+            config.bus.backend = (BusBackend)backend;
+            if (run_config(&config) != 0) failures++;
+        }
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
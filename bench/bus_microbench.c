@@ -0,0 +1,170 @@
+// Cross-process message rate through the shared queue.
+//
+// Forks producers that publish position updates as fast as the queue
+// accepts them, one consumer that drains them, and optional idle pollers
+// that poll bus_read_message() for a type nobody publishes (the way
+// components poll between sensor updates). Idle processes yield, so the
+// numbers stay meaningful with fewer cores than processes. Reports
+// delivered messages per second and the cost of an empty poll.
+//
+// Usage: bus_microbench [seconds] [producers] [pollers] [queue|rings]
+
+#include "bus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_PRODUCERS 4
+#define MAX_POLLERS 3
+
+// Counters shared with the children (separate lines so they are not the
+// contention being measured)
+typedef struct {
+    _Alignas(64) volatile int stop;
+    _Alignas(64) unsigned long published[MAX_PRODUCERS];
+    _Alignas(64) unsigned long delivered;
+    _Alignas(64) unsigned long polls[MAX_POLLERS];
+} BenchCounters;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run_producer(Bus* bus, BenchCounters* counters, int id) {
+    Message msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.type = MSG_POSITION_UPDATE;
+    msg.header.sender = COMPONENT_GPS;
+    msg.header.receiver = COMPONENT_INS;
+    msg.header.message_size = sizeof(PositionUpdateMsg);
+
+    unsigned long published = 0;
+    while (!counters->stop) {
+        msg.payload.position_update.position.latitude = (double)published;
+        if (bus_publish(bus, &msg) == SUCCESS) {
+            published++;
+        } else {
+            sched_yield();  // Queue full, let the consumer run
+        }
+    }
+    counters->published[id] = published;
+}
+
+static void run_consumer(Bus* bus, BenchCounters* counters) {
+    Message msg;
+    unsigned long delivered = 0;
+    while (!counters->stop) {
+        if (bus_read_message(bus, COMPONENT_INS, &msg)) {
+            delivered++;
+        } else {
+            sched_yield();
+        }
+    }
+    counters->delivered = delivered;
+}
+
+static void run_poller(Bus* bus, BenchCounters* counters, int id) {
+    Message msg;
+    unsigned long polls = 0;
+    while (!counters->stop) {
+        bus_read_message(bus, COMPONENT_AUTOPILOT, &msg);
+        polls++;
+        sched_yield();
+    }
+    counters->polls[id] = polls;
+}
+
+// Nanoseconds per bus_read_message() on an empty queue, single process
+static double empty_poll_ns(Bus* bus) {
+    Message msg;
+    const int iterations = 2000000;
+    double start = now_s();
+    for (int i = 0; i < iterations; i++) {
+        bus_read_message(bus, COMPONENT_AUTOPILOT, &msg);
+    }
+    return (now_s() - start) * 1e9 / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    int producers = argc > 2 ? atoi(argv[2]) : 1;
+    int pollers = argc > 3 ? atoi(argv[3]) : 0;
+    BusMode mode = argc > 4 && strcmp(argv[4], "rings") == 0 ? BUS_MODE_RINGS : BUS_MODE_QUEUE;
+
+    if (producers < 1 || producers > MAX_PRODUCERS || pollers < 0 || pollers > MAX_POLLERS) {
+        fprintf(stderr, "Usage: %s [seconds] [1-%d producers] [0-%d pollers] [queue|rings]\n",
+                argv[0], MAX_PRODUCERS, MAX_POLLERS);
+        return EXIT_FAILURE;
+    }
+
+    BenchCounters* counters = mmap(NULL, sizeof(BenchCounters), PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counters == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    memset(counters, 0, sizeof(*counters));
+
+    Bus* bus = bus_init_mode(mode);
+    if (!bus) return EXIT_FAILURE;
+    bus_subscribe(bus, COMPONENT_INS, MSG_POSITION_UPDATE);
+    bus_subscribe(bus, COMPONENT_AUTOPILOT, MSG_STATE_RESPONSE);
+
+    double poll_ns = empty_poll_ns(bus);
+
+    int children = 1 + producers + pollers;
+    pid_t pids[1 + MAX_PRODUCERS + MAX_POLLERS];
+    for (int i = 0; i < children; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            Bus* child_bus = bus_attach_inherited(bus);
+            if (i == 0) {
+                run_consumer(child_bus, counters);
+            } else if (i <= producers) {
+                run_producer(child_bus, counters, i - 1);
+            } else {
+                run_poller(child_bus, counters, i - 1 - producers);
+            }
+            bus_detach(child_bus);
+            _exit(EXIT_SUCCESS);
+        }
+        if (pids[i] < 0) {
+            perror("fork");
+            counters->stop = 1;
+            children = i;
+            break;
+        }
+    }
+
+    double start = now_s();
+    usleep((useconds_t)(seconds * 1e6));
+    counters->stop = 1;
+    for (int i = 0; i < children; i++) {
+        waitpid(pids[i], NULL, 0);
+    }
+    double elapsed = now_s() - start;
+
+    unsigned long published = 0, polls = 0;
+    for (int i = 0; i < producers; i++) published += counters->published[i];
+    for (int i = 0; i < pollers; i++) polls += counters->polls[i];
+
+    printf("mode %s, %d producer(s), %d poller(s), %.1f s\n",
+           mode == BUS_MODE_RINGS ? "rings" : "queue", producers, pollers, elapsed);
+    printf("  delivered   %12.0f msg/s\n", counters->delivered / elapsed);
+    printf("  published   %12.0f msg/s\n", published / elapsed);
+    if (pollers > 0) {
+        printf("  idle polls  %12.0f /s\n", polls / elapsed);
+    }
+    printf("  empty poll  %12.1f ns\n", poll_ns);
+
+    bus_cleanup(bus);
+    munmap(counters, sizeof(BenchCounters));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+// INS model throughput: lanes stepped together versus one at a time.
+//
+// Runs the sensor simulation and dead reckoning of ins_batch.h for a
+// number of aircraft, first as one batch with all lanes side by side, then
+// as separate one-lane batches the way each INS component steps its own.
+// Reports nanoseconds per lane-step for both.
+//
+// Usage: ins_bench [lanes] [steps]
+
+#include "ins_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_LANES 1024
+#define DEFAULT_STEPS 1000
+#define STEP_DT 0.01               // 100 Hz, as in ins_main()
+#define STEPS_PER_SENSOR_UPDATE 10 // New flight state every 10 steps
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Climb-out over SFO with headings spread across the lanes
+static void seed_lane(INSBatch* batch, size_t lane, size_t index) {
+    FlightState flight = {0};
+    flight.heading = (double)(index * 7 % 360);
+    flight.speed = 250.0;
+    flight.vertical_speed = 1500.0;
+    ins_batch_set_flight(batch, lane, &flight);
+
+    INSState state = {0};
+    state.position.latitude = 37.6188;
+    state.position.longitude = -122.3750;
+    state.position.altitude = 1000.0;
+    ins_batch_set_state(batch, lane, &state);
+}
+
+static void run(INSBatch* batch, int steps) {
+    for (int done = 0; done < steps; done += STEPS_PER_SENSOR_UPDATE) {
+        ins_batch_simulate_sensors(batch);
+        ins_batch_integrate(batch, STEP_DT, STEPS_PER_SENSOR_UPDATE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t lanes = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LANES;
+    int steps = argc > 2 ? atoi(argv[2]) : DEFAULT_STEPS;
+    if (lanes == 0 || steps <= 0) {
+        fprintf(stderr, "Usage: %s [lanes] [steps]\n", argv[0]);
+        return 1;
+    }
+
+    INSBatch* batch = ins_batch_create(lanes, 1);
+    INSBatch** singles = calloc(lanes, sizeof(INSBatch*));
+    if (!batch || !singles) {
+        fprintf(stderr, "Failed to allocate %zu lanes\n", lanes);
+        return 1;
+    }
+    for (size_t i = 0; i < lanes; i++) {
+        seed_lane(batch, i, i);
+        singles[i] = ins_batch_create(1, 1 + i);
+        if (!singles[i]) {
+            fprintf(stderr, "Failed to allocate lane %zu\n", i);
+            return 1;
+        }
+        seed_lane(singles[i], 0, i);
+    }
+
+    double start = now_s();
+    run(batch, steps);
+    double batched = now_s() - start;
+
+    start = now_s();
+    for (size_t i = 0; i < lanes; i++) {
+        run(singles[i], steps);
+    }
+    double single = now_s() - start;
+
+    double lane_steps = (double)lanes * steps;
+    printf("%-24s %12s %14s\n", "mode", "seconds", "ns/lane-step");
+    printf("%-24s %12.3f %14.1f\n", "batched", batched, batched / lane_steps * 1e9);
+    printf("%-24s %12.3f %14.1f\n", "one lane at a time", single, single / lane_steps * 1e9);
+
+    INSState state;
+    ins_batch_get_state(batch, 0, &state);
+    printf("lane 0 after %d steps: %.6f, %.6f, %.1f\n", steps,
+           state.position.latitude, state.position.longitude, state.position.altitude);
+
+    for (size_t i = 0; i < lanes; i++) {
+        ins_batch_destroy(singles[i]);
+    }
+    free(singles);
+    ins_batch_destroy(batch);
+    return 0;
+}
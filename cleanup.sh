@@ -58,6 +58,7 @@ done
 
 # Clean up shared memory
 echo "Cleaning up shared memory..."
+rm -f /dev/shm/airplane_sim_bus* /dev/shm/airplane_sim_metrics* /dev/shm/sem.airplane_sim_bus
 for shm in $(ipcs -m | grep $USER | awk '{print $2}'); do
     ipcrm -m $shm 2>/dev/null
 done
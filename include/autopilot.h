@@ -4,6 +4,8 @@
 #include "common.h"
 #include "bus.h"
 
+#define AUTOPILOT_UPDATE_INTERVAL_MS 100  // 10Hz update rate, by default
+
 // Autopilot configuration structure
 typedef struct {
     // Target waypoint
@@ -28,21 +30,55 @@ typedef struct {
     double speed_pid[3];      // P, I, D gains for speed control
 } AutopilotConfig;
 
+// One step of one axis of the control law: the integral and last error
+// are updated for the new error, and the PID output is returned clamped
+// to [min_output, max_output] (-INFINITY/INFINITY for none). Shared by the
+// autopilot and the offline tuner (pid_batch.h), which must fly the same
+// law.
+static inline double autopilot_pid_step(double kp, double ki, double kd, double error,
+                                        double dt, double* integral, double* last_error,
+                                        double min_output, double max_output) {
+    *integral += error * dt;
+    double derivative = (error - *last_error) / dt;
+    double output = kp * error + ki * *integral + kd * derivative;
+    *last_error = error;
+    return fmax(min_output, fmin(max_output, output));
+}
+
 typedef struct Autopilot Autopilot;
 
 // Initialize autopilot
 Autopilot* autopilot_init(Bus* bus);
 
+// Initialize with the configuration in config_file instead of the default
+// config/autopilot_config.json. Under a flight controller the config
+// store's snapshot (config_store.h) is used instead of either file.
+Autopilot* autopilot_init_with_config(Bus* bus, const char* config_file);
+
 // Clean up autopilot
 void autopilot_cleanup(Autopilot* ap);
 
 // Process one iteration of autopilot control
 void autopilot_process(Autopilot* ap);
 
-// Load configuration from JSON file
+// The built-in configuration
+AutopilotConfig autopilot_default_config(void);
+
+// Read the JSON file over *config: keys in the file replace the values
+// already there. Fails with ERROR_GENERAL if the file cannot be read as
+// JSON and ERROR_INVALID_DATA for a value of the wrong type, leaving
+// *config unchanged either way.
+ErrorCode autopilot_parse_config(const char* filename, AutopilotConfig* config);
+
+// Load configuration from JSON file, falling back to the defaults
 AutopilotConfig autopilot_load_config(const char* filename);
 
 // Main entry point for autopilot process
 void autopilot_main(Bus* bus);
 
+// Entry point for a warm standby autopilot process (standby.h): load the
+// config, sleep until promoted, then carry on with the primary's last PID
+// state
+void autopilot_standby_main(Bus* bus);
+
 #endif // AUTOPILOT_H
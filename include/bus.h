@@ -2,38 +2,221 @@
 #define BUS_H
 
 #include "common.h"
+#include "flight_state.h"
 #include "messages.h"
 #include <stdbool.h>
+#include <stdio.h>
 
 // Maximum number of messages in the bus queue
 #define MAX_BUS_MESSAGES 100
 // Maximum number of subscribers
 #define MAX_SUBSCRIBERS 10
+// Slots in each per-subscriber ring (must be a power of two)
+#define BUS_RING_CAPACITY 64
+
+// Message delivery modes
+typedef enum {
+    BUS_MODE_QUEUE = 0,  // One queue per priority lane shared by all subscribers,
+                         // read under a semaphore
+    BUS_MODE_RINGS       // Lock-free ring per (subscriber, message type) pair
+} BusMode;
+
+// Mode used by bus_init(), can be overridden at build time
+#ifndef BUS_DEFAULT_MODE
+#define BUS_DEFAULT_MODE BUS_MODE_QUEUE
+#endif
+
+// Shared segment backends
+typedef enum {
+    BUS_BACKEND_SYSV = 0,   // Anonymous SysV segment, attach with bus_attach()
+    BUS_BACKEND_SHM_OPEN,   // Named POSIX segment, other processes use bus_open()
+    BUS_BACKEND_MEMFD,      // Anonymous memfd, shared with forked children only
+    BUS_BACKEND_MEMORY      // Private memory, shared by the threads of one process
+} BusBackend;
+
+// Backend used by bus_init(), can be overridden at build time
+#ifndef BUS_DEFAULT_BACKEND
+#define BUS_DEFAULT_BACKEND BUS_BACKEND_SHM_OPEN
+#endif
+
+// Prefix of the POSIX segment created by bus_init(). Each run's segment is
+// BUS_DEFAULT_NAME.<creator's pid>, printed at startup, so simulators on
+// the same host never share or replace one another's segment.
+#define BUS_DEFAULT_NAME "/airplane_sim_bus"
+
+typedef struct {
+    BusMode mode;
+    BusBackend backend;
+    const char* name;       // BUS_BACKEND_SHM_OPEN only, must start with '/';
+                            // NULL = BUS_DEFAULT_NAME.<pid>
+    bool huge_pages;        // Back with huge pages, falls back to normal pages
+    bool prefault;          // Populate page tables at map time
+    bool lock_memory;       // mlock the segment in every attached process
+} BusOptions;
+
+// Delivery guarantee of one (subscriber, message type) subscription
+typedef enum {
+    BUS_QOS_QUEUED = 0,  // Every message in order, dropped when the queue is full
+    BUS_QOS_LATEST       // Only the newest message from each sender; never fills up
+} BusQos;
+
+// What a publisher does when a topic's storage is full. Ring mode keeps
+// one ring per (subscriber, type), so topics never evict one another and
+// the evicting policies fall back to BUS_OVERFLOW_DROP_NEWEST there.
+typedef enum {
+    BUS_OVERFLOW_DROP_NEWEST = 0,  // Reject the new message (default)
+    BUS_OVERFLOW_DROP_OLDEST,      // Evict the oldest queued message
+    BUS_OVERFLOW_BLOCK,            // Wait up to timeout_ms for room, then reject
+    BUS_OVERFLOW_PRIORITY          // Evict the oldest message in the lane if it is of a
+                                   // lower-priority topic, else reject
+} BusOverflowPolicy;
+
+typedef struct {
+    BusOverflowPolicy overflow;
+    int timeout_ms;         // BUS_OVERFLOW_BLOCK only
+    int priority;           // Compared under BUS_OVERFLOW_PRIORITY, default 0
+} BusTopicPolicy;
+
+// Delivery counters for a topic (message type) or a subscriber, kept per
+// (subscriber, topic) pair. A topic's depth is its longest backlog at any
+// subscriber; a subscriber's is the sum over its topics. max_depth is the
+// largest backlog any one pair has reached.
+typedef struct {
+    uint64_t published;     // Topic: messages offered; subscriber: copies routed to it
+    uint64_t delivered;     // Copies read by subscribers
+    uint64_t dropped;       // Copies lost to a full queue, eviction or pruning
+    uint64_t conflated;     // Latest-value samples overwritten before being read
+    uint32_t depth;         // Copies waiting now
+    uint32_t max_depth;     // High-water mark of one pair's depth
+} BusStats;
 
 typedef struct Bus Bus;
 
+// Options used by bus_init(): default mode and backend, prefaulted
+BusOptions bus_default_options(void);
+
 // Initialize the message bus
 Bus* bus_init(void);
 
+// Initialize the message bus with explicit segment options
+Bus* bus_init_with_options(const BusOptions* options);
+
+// Initialize the message bus with an explicit delivery mode.
+// In BUS_MODE_RINGS every subscriber of a message type receives its own copy
+// at publish time, and reads are wait-free pops that never take the semaphore.
+Bus* bus_init_mode(BusMode mode);
+
+// Get the delivery mode of the bus
+BusMode bus_get_mode(const Bus* bus);
+
+// Release the latest-value slots a publisher left mid-write when it died,
+// dropping their samples, so its replacement (a restart or a standby) can
+// publish. Call once the old publisher is known to be gone.
+void bus_reset_sender(Bus* bus, ComponentId sender);
+
+// Latest flight state in the bus segment, written by the flight controller.
+// Read it with flight_state_read_snapshot(); works in any attached process.
+FlightStateSnapshot* bus_state_snapshot(Bus* bus);
+
 // Clean up the message bus
 void bus_cleanup(Bus* bus);
 
 // Subscribe to messages
 ErrorCode bus_subscribe(Bus* bus, ComponentId subscriber, MessageType msg_type);
 
-// Publish a message to the bus
+// Subscribe with an explicit QoS. BUS_QOS_LATEST keeps one slot per
+// (sender, type) that each publish overwrites, so high-rate samples never
+// occupy the queue. Subscribing again switches the QoS.
+ErrorCode bus_subscribe_qos(Bus* bus, ComponentId subscriber, MessageType msg_type, BusQos qos);
+
+// Subscribe in an explicit priority class instead of the type's default
+// from MESSAGE_PRIORITIES. Reads always return a pending message of the
+// highest class first; FIFO and round-robin order apply within a class.
+ErrorCode bus_subscribe_priority(Bus* bus, ComponentId subscriber, MessageType msg_type,
+                                 BusQos qos, MessagePriority priority);
+
+// Set the overflow policy of a message type, shared by every process on
+// the bus. Set it before publishing starts.
+ErrorCode bus_set_topic_policy(Bus* bus, MessageType type, const BusTopicPolicy* policy);
+
+// Counters since the bus was created; diff two reads for a rate
+ErrorCode bus_get_topic_stats(Bus* bus, MessageType type, BusStats* stats);
+ErrorCode bus_get_subscriber_stats(Bus* bus, ComponentId subscriber, BusStats* stats);
+
+// Print the counters of every active topic and subscriber
+void bus_dump_stats(Bus* bus, FILE* out);
+
+// Publish a message to the bus. Every subscriber of the type gets a copy;
+// returns ERROR_COMMUNICATION if the topic's overflow policy rejected it.
 ErrorCode bus_publish(Bus* bus, Message* message);
 
-// Read next message for a component (non-blocking)
+// Publish count messages with one slot claim per run of same-type messages.
+// Subscribers are woken once for the whole batch. Returns
+// ERROR_COMMUNICATION if any were dropped.
+ErrorCode bus_publish_batch(Bus* bus, const Message* messages, int count);
+
+// Called with every message accepted by a publish or commit, before it is
+// delivered, in whichever process or thread published it. Set it before
+// components start so forked ones inherit it; NULL removes it. The tap must
+// not block or publish.
+typedef void (*BusTap)(const Message* message);
+void bus_set_tap(BusTap tap);
+
+// Read next message for a component (non-blocking), highest priority first
 // Returns true if message was read, false if no message available
 bool bus_read_message(Bus* bus, ComponentId subscriber, Message* message);
 
-// Get shared memory ID for attaching in forked processes
+// Read up to max_count pending messages for a component (non-blocking)
+// Returns the number of messages read
+int bus_read_batch(Bus* bus, ComponentId subscriber, Message* messages, int max_count);
+
+// Wait up to timeout_ms milliseconds (negative waits forever) for the next
+// message for a component. The caller sleeps on a futex in the shared segment
+// and is woken by bus_publish. Returns true if a message was read.
+bool bus_wait_message(Bus* bus, ComponentId subscriber, Message* message, int timeout_ms);
+
+// Get a poll/epoll compatible descriptor that becomes readable when a message
+// is published for the subscriber. Descriptors are created by bus_init and
+// inherited by forked processes. Once it fires, call bus_ack_wait_fd() and
+// then drain with bus_read_message(). Returns -1 on error.
+int bus_get_wait_fd(Bus* bus, ComponentId subscriber);
+
+// Clear and re-arm a subscriber's wait descriptor (call before draining)
+void bus_ack_wait_fd(Bus* bus, ComponentId subscriber);
+
+// Reserve space for a message of the given type and payload size. In ring
+// mode the payload is written in place in a subscriber ring; fill in the
+// header sender/receiver and payload, then call bus_commit(). One
+// reservation may be outstanding per thread. Returns NULL on error.
+Message* bus_reserve(Bus* bus, MessageType type, uint32_t size);
+
+// Publish a message obtained from bus_reserve()
+ErrorCode bus_commit(Bus* bus, Message* message);
+
+// Look at the next message for a subscriber without copying it. The message
+// stays valid until bus_release(); call it before peeking or reading again.
+const Message* bus_peek(Bus* bus, ComponentId subscriber);
+
+// Release a message returned by bus_peek()
+void bus_release(Bus* bus, ComponentId subscriber, const Message* message);
+
+// Get shared memory ID for attaching in forked processes (SysV backend
+// only, -1 otherwise)
 int bus_get_shm_id(Bus* bus);
 
-// Attach to existing bus in forked process
+// Attach to existing bus in forked process (SysV backend)
 Bus* bus_attach(int shm_id);
 
+// Take a reference on a bus mapping inherited across fork (any backend
+// but BUS_BACKEND_MEMORY) or shared with a thread (any backend).
+// Returns bus; release with bus_cleanup() or bus_detach().
+Bus* bus_attach_inherited(Bus* bus);
+
+// Map a bus created with BUS_BACKEND_SHM_OPEN from an unrelated process,
+// by the name the creator printed. Wait descriptors are not available on
+// such a bus; use bus_wait_message().
+Bus* bus_open(const char* name);
+
 // Detach from bus (for forked processes)
 void bus_detach(Bus* bus);
 
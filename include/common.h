@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
+#include <sched.h>
+#include <time.h>
 
 // Math constants
 #define PI 3.14159265358979323846
@@ -42,6 +44,13 @@ typedef struct {
     uint32_t timestamp;   // unix timestamp
 } FlightState;
 
+// Causal chain a message belongs to. Sensors start one per fix, and
+// every message derived from it carries it on (see trace.h).
+typedef struct {
+    uint64_t id;            // 0 = untraced
+    uint64_t origin_ns;     // CLOCK_MONOTONIC time the chain started
+} TraceContext;
+
 // Error handling
 typedef enum {
     SUCCESS = 0,
@@ -56,4 +65,59 @@ typedef enum {
 // Validation macros
 #define VALIDATE_COMPONENT_ID(id) ((id) >= 0 && (id) < MAX_COMPONENTS)
 
+// Short name of a component ("autopilot", "landing_radio", ...), used in
+// logs, reports, metric labels and config keys; "unknown" if invalid
+static inline const char* component_name(ComponentId id) {
+    static const char* const names[MAX_COMPONENTS] = {
+        [COMPONENT_FLIGHT_CONTROLLER] = "flight_controller",
+        [COMPONENT_AUTOPILOT] = "autopilot",
+        [COMPONENT_GPS] = "gps",
+        [COMPONENT_INS] = "ins",
+        [COMPONENT_LANDING_RADIO] = "landing_radio",
+        [COMPONENT_SAT_COM] = "sat_com"
+    };
+    return VALIDATE_COMPONENT_ID(id) ? names[id] : "unknown";
+}
+
+// Milliseconds on the monotonic clock, for loop deadlines
+static inline int64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Nanoseconds on the monotonic clock, for message timestamps
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Bounded spin-waits on another thread or process, such as a seqlock
+// writer: give up after SPIN_LIMIT rounds, yielding every SPIN_YIELD_EVERY
+#define SPIN_LIMIT (1u << 20)
+#define SPIN_YIELD_EVERY 64
+
+// CPU hint that this is a spin-wait
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// One round of a bounded spin-wait. The yields let a writer preempted on
+// this core finish. Returns false once the wait has gone on so long that
+// the other side must have died mid-write.
+static inline bool spin_wait(uint32_t* spins) {
+    if (++*spins > SPIN_LIMIT) return false;
+    if (*spins % SPIN_YIELD_EVERY == 0) {
+        sched_yield();
+    } else {
+        cpu_relax();
+    }
+    return true;
+}
+
 #endif // COMMON_H
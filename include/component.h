@@ -0,0 +1,65 @@
+#ifndef COMPONENT_H
+#define COMPONENT_H
+
+#include "common.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Main loops of the component entry points (gps_receiver_main() and the
+// rest) run while this is true. Forked components are stopped with SIGTERM
+// and always see true; a component run as a thread sees false once the
+// flight controller asks it to stop, and then cleans up and returns.
+bool component_running(void);
+
+// Make component_running() on the calling thread follow *stop (NULL: run
+// until killed)
+void component_bind_stop_flag(const atomic_bool* stop);
+
+// Where and how a component runs, applied by the flight controller before
+// the component's main loop starts. The zero value changes nothing.
+typedef struct {
+    uint64_t cpu_mask;      // CPUs 0-63 the component may run on; 0 = inherit
+    int rt_priority;        // SCHED_FIFO priority 1-99; 0 = leave the policy alone
+    bool lock_memory;       // mlockall() current and future pages (whole process)
+} ComponentSchedule;
+
+// Apply a schedule to the calling thread. SCHED_FIFO and mlockall() need
+// CAP_SYS_NICE / CAP_IPC_LOCK or matching rlimits; on failure the rest is
+// still applied and ERROR_GENERAL returned.
+ErrorCode component_apply_schedule(const ComponentSchedule* schedule);
+
+// Fixed-rate main loop pacing on absolute CLOCK_MONOTONIC deadlines, so
+// time spent in a step does not push the next one back. How late each
+// wake-up is goes into the component's jitter histogram.
+typedef struct {
+    ComponentId component;
+    uint64_t period_ns;
+    uint64_t deadline_ns;   // Next step
+} ComponentPacer;
+
+// First deadline one period from now
+void component_pacer_init(ComponentPacer* pacer, ComponentId component, uint32_t period_ms);
+
+// Change the period. The next deadline moves to one new period after the
+// last step's, so a shorter period takes effect at once.
+void component_pacer_set_period(ComponentPacer* pacer, uint32_t period_ms);
+
+// Whole milliseconds left until the deadline, <= 0 once it is due
+int component_pacer_remaining_ms(const ComponentPacer* pacer);
+
+// Sleep until the deadline and move it on a period. More than a period
+// behind counts as an overrun and restarts the schedule from now rather
+// than running the missed steps back to back.
+void component_pacer_wait(ComponentPacer* pacer);
+
+// Map the per-component jitter tables. Call before forking components so
+// they all record into the same tables; without it nothing is recorded.
+bool component_timing_init(void);
+
+void component_timing_cleanup(void);
+
+// Print wake-up lateness percentiles and overruns per paced component
+void component_timing_dump(FILE* out);
+
+#endif // COMPONENT_H
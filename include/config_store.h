@@ -0,0 +1,84 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "common.h"
+#include "autopilot.h"
+#include "ins_batch.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Run-time configuration of the components, parsed and checked once by the
+// flight controller and shared with every component as a flat snapshot in
+// memory mapped before the fork. Components copy the snapshot when they
+// start and look at its version once per step; there is nothing to parse
+// on either path. A reload builds and validates a whole new snapshot
+// first, then publishes it in one step: readers see either the old or the
+// new one, never a mix, and a file that does not validate is never seen.
+//
+// Without config_store_init() in this process or a parent there is no
+// snapshot and components fall back to their files and built-in defaults.
+
+#define CONFIG_AUTOPILOT_FILE "config/autopilot_config.json"
+#define CONFIG_SIMULATION_FILE "config/simulation.json"
+
+typedef struct {
+    uint32_t version;                 // Changes with every published snapshot
+    AutopilotConfig autopilot;
+    uint32_t autopilot_interval_ms;   // Autopilot step period
+    uint32_t ins_interval_ms;         // INS step period
+    INSNoiseParams ins_noise;
+} ConfigSnapshot;
+
+// Map the shared region. Call before forking the components that use it.
+bool config_store_init(void);
+
+void config_store_cleanup(void);
+
+// The built-in configuration
+ConfigSnapshot config_store_defaults(void);
+
+// Build a snapshot from the autopilot config (see autopilot_parse_config())
+// and the simulation file, whose keys are "autopilot_update_interval_ms",
+// "ins_update_interval_ms", "ins_accel_noise", "ins_gyro_noise",
+// "ins_mag_noise", "ins_accel_bias_drift" and "ins_gyro_bias_drift". A
+// file that does not exist leaves its part at the defaults; one that does
+// not parse or validate fails the load. NULL files are the defaults above.
+ErrorCode config_store_load(ConfigSnapshot* snapshot, const char* autopilot_file,
+                            const char* simulation_file);
+
+// Check ranges: finite numbers, non-negative gains and noise, positive
+// limits, min_speed below max_speed, step periods of 1-1000 ms. Prints
+// what is wrong and returns ERROR_INVALID_DATA.
+ErrorCode config_store_validate(const ConfigSnapshot* snapshot);
+
+// Make the snapshot current and return its version (flight controller
+// only; one writer)
+uint32_t config_store_publish(const ConfigSnapshot* snapshot);
+
+// Version of the current snapshot, 0 if none. One load, cheap enough for
+// every step.
+uint32_t config_store_version(void);
+
+// Copy the current snapshot. Returns its version, or 0 (and leaves
+// *snapshot alone) if none has been published or its publisher died
+// mid-publish.
+uint32_t config_store_read(ConfigSnapshot* snapshot);
+
+// inotify watch on the directories holding the config files, reporting
+// writes that complete (close after write, or a rename into place)
+typedef struct {
+    int fd;                   // Non-blocking; -1 when not watching
+    const char* names[2];     // Base names of the watched files
+} ConfigWatch;
+
+// Watch the two files (NULL = the defaults above). Returns false, with
+// watch->fd -1, if inotify is not available.
+bool config_watch_init(ConfigWatch* watch, const char* autopilot_file,
+                       const char* simulation_file);
+
+// Drain pending events. True if any of them was for a watched file.
+bool config_watch_changed(ConfigWatch* watch);
+
+void config_watch_cleanup(ConfigWatch* watch);
+
+#endif // CONFIG_STORE_H
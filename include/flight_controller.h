@@ -3,25 +3,113 @@
 
 #include "common.h"
 #include "bus.h"
+#include "component.h"
 #include "flight_state.h"
+#include "replay.h"
 
 typedef struct FlightController FlightController;
 
-// Initialize the flight controller
+// How flight_controller_start() runs the components
+typedef enum {
+    FC_EXEC_PROCESSES = 0,  // fork() per component over a shared bus segment
+    FC_EXEC_THREADS,        // One pinned thread per component in this process
+    FC_EXEC_SCHEDULER       // Every *_process() step from one loop on simulated time
+} FlightControllerExecMode;
+
+// Settings for flight_controller_init_with_options()
+typedef struct {
+    FlightControllerExecMode mode;
+    // Parsed once into the config store (config_store.h) that every
+    // component reads
+    const char* autopilot_config;   // NULL = config/autopilot_config.json
+    const char* simulation_config;  // NULL = config/simulation.json
+    // Publish edits to those files while running; an edit that does not
+    // validate is reported and ignored. Not in FC_EXEC_SCHEDULER, whose
+    // runs only depend on their inputs.
+    bool reload_config;
+    // The rest apply to FC_EXEC_SCHEDULER, where components are set up in
+    // this process
+    bool sensor_feeds;              // Generate sender traffic in-process (sensor_feed.h)
+    unsigned int sensor_seed;       // Seeds the feeds' models and the INS noise
+    Replay* replay;                 // Recorded traffic replaces the GPS, landing
+                                    // radio and satcom receivers (replay.h)
+    // CPU, priority and memory locking per spawned component, applied in
+    // the forked process or the component's thread (not FC_EXEC_SCHEDULER)
+    ComponentSchedule schedules[MAX_COMPONENTS];
+    // Keep a warm standby process behind the component that takes over
+    // from its last checkpoint when it dies (standby.h). FC_EXEC_PROCESSES
+    // only; the INS and the autopilot support it.
+    bool standby[MAX_COMPONENTS];
+} FlightControllerOptions;
+
+// Processes, default config files watched for changes, sensors over the
+// network
+FlightControllerOptions flight_controller_default_options(void);
+
+// Read component schedules from a JSON file keyed by component ("ins",
+// "autopilot", "gps", "landing_radio", "sat_com"), each with optional
+// "cpus" (array of CPU numbers), "priority" (SCHED_FIFO 1-99) and
+// "lock_memory". Components not in the file keep their schedule.
+ErrorCode flight_controller_load_schedules(FlightControllerOptions* options,
+                                           const char* filename);
+
+// Initialize the flight controller (components run as processes). Fails
+// if the config files do not parse or validate.
 FlightController* flight_controller_init(Bus* bus);
 
-// Start the flight controller and spawn component processes
+// Initialize with an explicit execution mode. In FC_EXEC_THREADS any bus
+// backend works; BUS_BACKEND_MEMORY keeps the bus out of shared memory.
+// A component that returns is joined and restarted like a dead process.
+// FC_EXEC_SCHEDULER switches the process to simulated time (sim_clock.h)
+// and steps the flight controller and every component in turn, each at the
+// rate of its own main loop; runs repeat exactly as long as the inputs do.
+FlightController* flight_controller_init_mode(Bus* bus, FlightControllerExecMode mode);
+
+// Like flight_controller_init_mode(). With sensor_feeds the GPS, landing
+// radio and satcom receivers read a SensorFeed instead of their socket, so
+// a flight needs no senders; meant for FC_EXEC_SCHEDULER.
+FlightController* flight_controller_init_with_options(Bus* bus,
+                                                      const FlightControllerOptions* options);
+
+// Start the flight controller and spawn component processes or threads
 ErrorCode flight_controller_start(FlightController* fc);
 
+// True once every started component has reported ready on the bus: its
+// first active MSG_SYSTEM_STATUS since it was spawned (see messages.h).
+// Components fed by a replay are not waited for.
+bool flight_controller_ready(const FlightController* fc);
+
+// Process messages (or, in FC_EXEC_SCHEDULER, run steps) until every
+// component is ready, timeout_ms passes or *running is cleared (running may
+// be NULL). Returns SUCCESS when ready; otherwise lists the components
+// still missing and returns ERROR_COMMUNICATION.
+ErrorCode flight_controller_wait_ready(FlightController* fc, int timeout_ms,
+                                       const volatile bool* running);
+
 // Clean up and shutdown
 void flight_controller_cleanup(FlightController* fc);
 
 // Process incoming messages (called in main loop)
 void flight_controller_process_messages(FlightController* fc);
 
+// Block until a message arrives or timeout_ms elapses, then process
+// everything pending (including terminated components). In
+// FC_EXEC_SCHEDULER this instead runs every step due in the next
+// timeout_ms of simulated time.
+void flight_controller_wait_messages(FlightController* fc, int timeout_ms);
+
+// Pace FC_EXEC_SCHEDULER against real time: 1.0 = real time, 0 (the
+// default) = as fast as the steps run. No effect in other modes.
+void flight_controller_set_sim_speed(FlightController* fc, double speed);
+
 // Get current flight state
 const ExtendedFlightState* flight_controller_get_state(const FlightController* fc);
 
+// In FC_EXEC_PROCESSES the controller also sleeps on a pidfd per child, so
+// a component that dies is handled as soon as it exits: its standby, if it
+// has one, is promoted and a new standby forked behind it; otherwise the
+// component is spawned again.
+
 // Utility functions
 ErrorCode flight_controller_spawn_component(FlightController* fc, ComponentId component);
 void flight_controller_handle_component_exit(FlightController* fc, ComponentId component);
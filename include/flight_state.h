@@ -2,6 +2,7 @@
 #define FLIGHT_STATE_H
 
 #include "common.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <time.h>
 
@@ -47,6 +48,21 @@ typedef struct {
 
 } ExtendedFlightState;
 
+// What a snapshot holds besides the sequence counter
+typedef struct {
+    ExtendedFlightState state;
+    TraceContext trace;     // Fix behind state.basic.position
+    uint64_t write_ns;      // CLOCK_MONOTONIC time it was written
+} FlightStateSample;
+
+// Latest flight state for readers that only want the current value.
+// Seqlock with a single writer: seq is odd while a write is in progress.
+// Lives in shared memory (see bus_state_snapshot()).
+typedef struct {
+    _Atomic uint32_t seq;
+    FlightStateSample sample;
+} FlightStateSnapshot;
+
 // Initialize flight state with default values
 void flight_state_init(ExtendedFlightState* state);
 
@@ -59,6 +75,38 @@ void flight_state_update_system_status(ExtendedFlightState* state, ComponentId c
 // Get the best available position based on priority (INS > GPS > Radio)
 Position flight_state_get_best_position(const ExtendedFlightState* state);
 
+// Get the component whose position flight_state_get_best_position() returns.
+// Returns false if no source is valid.
+bool flight_state_get_best_source(const ExtendedFlightState* state, ComponentId* source);
+
+// Publish state to a snapshot. Only one process may write a given snapshot.
+void flight_state_write_snapshot(FlightStateSnapshot* snapshot, const ExtendedFlightState* state,
+                                 const TraceContext* trace);
+
+// Copy out a consistent sample without locking. Returns the snapshot
+// version, which increases with every write, or 0 if it was never written
+// or its writer died mid-write (sample is then left untouched, so callers
+// keep their last good copy).
+uint32_t flight_state_read_snapshot(const FlightStateSnapshot* snapshot, FlightStateSample* sample);
+
+// A reader's subscription to a snapshot at the rate it wants: it takes a
+// new sample only when the state changed since its last one and at least
+// min_interval_ms (simulated time) has passed, so the changes in between
+// are coalesced into the newest.
+typedef struct {
+    uint32_t min_interval_ms;   // 0 = every change
+    uint32_t version;           // Of the last sample taken, 0 = none yet
+    int64_t taken_ms;           // sim_clock_ms() when it was taken
+} FlightStateWatch;
+
+void flight_state_watch_init(FlightStateWatch* watch, uint32_t min_interval_ms);
+
+// Copy the newest sample if one is due for this watch. Returns its version,
+// or 0 (sample untouched) if nothing is due. An unchanged snapshot costs
+// one load and no copy.
+uint32_t flight_state_watch_take(const FlightStateSnapshot* snapshot, FlightStateWatch* watch,
+                                 FlightStateSample* sample);
+
 // Utility functions
 const char* flight_state_to_string(const ExtendedFlightState* state, char* buffer, size_t buffer_size);
 bool flight_state_is_valid(const ExtendedFlightState* state);
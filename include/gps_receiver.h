@@ -3,6 +3,8 @@
 
 #include "common.h"
 #include "bus.h"
+#include "ground_link.h"
+#include "sensor_feed.h"
 
 // GPS connection settings
 #define GPS_PORT 5555
@@ -13,9 +15,18 @@ typedef struct GpsReceiver GpsReceiver;
 // Initialize GPS receiver
 GpsReceiver* gps_receiver_init(Bus* bus);
 
+// Like gps_receiver_init(), with the link to the sender on a reactor the
+// caller runs (see ground_link.h) instead of one of its own
+GpsReceiver* gps_receiver_init_with_links(Bus* bus, GroundLinks* links);
+
 // Clean up GPS receiver
 void gps_receiver_cleanup(GpsReceiver* gps);
 
+// Read records from an in-process feed instead of the GPS sender (NULL: back
+// to the network). The receiver then counts as connected; the feed must
+// outlive it.
+void gps_receiver_set_feed(GpsReceiver* gps, SensorFeed* feed);
+
 // Process one iteration of GPS data
 void gps_receiver_process(GpsReceiver* gps);
 
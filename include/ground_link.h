@@ -0,0 +1,78 @@
+#ifndef GROUND_LINK_H
+#define GROUND_LINK_H
+
+#include "common.h"
+#include "log.h"
+#include "wire_protocol.h"
+#include <stdint.h>
+
+// TCP links from the receivers to the external senders, on one epoll loop.
+// A GroundLinks reactor holds any number of links. All events of all links
+// are handled in ground_links_run(): connects complete, records are
+// decoded and passed to the link's handlers, and links that are down are
+// reconnected when their backoff runs out.
+//
+// Host names are resolved once with getaddrinfo() and the addresses cached
+// for the process (the cache is thread-safe; the reactor is not, so each
+// reactor belongs to one thread). Connects never block. A failed attempt
+// waits GROUND_LINK_BACKOFF_MIN_MS, then twice as long each time up to
+// GROUND_LINK_BACKOFF_MAX_MS, each wait jittered down by up to half, so
+// components that lose their sender together do not retry in lockstep.
+// Backoff runs on the component clock (sim_clock.h).
+
+#define GROUND_LINK_BACKOFF_MIN_MS 250
+#define GROUND_LINK_BACKOFF_MAX_MS 8000
+#define GROUND_LINK_CONNECT_TIMEOUT_MS 3000
+#define GROUND_LINK_MAX_LINKS 8
+#define GROUND_LINK_MAX_ADDRESSES 4      // Cached per host and port; tried in turn
+#define GROUND_LINK_MAX_READS 16         // recv() calls per link per run
+
+typedef struct GroundLinks GroundLinks;
+typedef struct GroundLink GroundLink;
+
+typedef struct {
+    // A complete record from the sender. Return false to drop the
+    // connection (e.g. on persistent garbage); it is then reconnected.
+    bool (*on_record)(const WireMessage* record, void* context);
+    // After the records of one wakeup, e.g. to publish them together
+    // (optional)
+    void (*on_flush)(void* context);
+    // The link came up or went down (optional)
+    void (*on_state)(bool connected, void* context);
+    void* context;
+} GroundLinkHandlers;
+
+GroundLinks* ground_links_create(void);
+
+// Close every link still registered and free the reactor
+void ground_links_destroy(GroundLinks* links);
+
+// Register a link to host:port for a component (its metrics label),
+// logging under category. The first connect is made by the next
+// ground_links_run(). Returns NULL on error.
+GroundLink* ground_links_add(GroundLinks* links, const char* host, uint16_t port,
+                             ComponentId component, LogCategory category,
+                             const GroundLinkHandlers* handlers);
+
+// Close and unregister a link. Its handlers are not called.
+void ground_links_remove(GroundLinks* links, GroundLink* link);
+
+// Wait up to timeout_ms (0: do not wait) for any link, handle what is
+// ready and start the connects that are due. The wait is cut short when a
+// connect falls due. Returns false if the wait failed.
+bool ground_links_run(GroundLinks* links, int timeout_ms);
+
+// Readable when ground_links_run() has work, to wait on alongside other fds
+int ground_links_fd(const GroundLinks* links);
+
+// Milliseconds until the next connect attempt or connect timeout, -1 if
+// none is pending
+int ground_links_next_timeout_ms(const GroundLinks* links);
+
+bool ground_link_connected(const GroundLink* link);
+
+// Disabled links are closed, without calling on_state, and no longer
+// reconnected, e.g. while a receiver reads an in-process feed
+void ground_link_set_enabled(GroundLink* link, bool enabled);
+
+#endif // GROUND_LINK_H
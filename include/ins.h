@@ -14,6 +14,8 @@
 #define GRAVITY 9.81
 #define EARTH_RADIUS 6371000.0  // meters
 
+#define INS_UPDATE_INTERVAL_MS 10  // 100Hz update rate, by default
+
 // INS sensor data
 typedef struct {
     // Accelerometer data (m/s^2)
@@ -70,10 +72,16 @@ void ins_process(INS* ins);
 // Main entry point for INS process
 void ins_main(Bus* bus);
 
+// Entry point for a warm standby INS process (standby.h): set up off the
+// bus, sleep until promoted, then carry on from the primary's last
+// checkpoint, already aligned
+void ins_standby_main(Bus* bus);
+
 // Get the current INS state
 const INSState* ins_get_state(const INS* ins);
 
-// Simulate sensor readings based on current flight state
-INSSensorData ins_simulate_sensors(const FlightState* flight_state);
+// Restart the sensor noise from a seed, so the INS repeats exactly for
+// the same inputs (the default seed is the clock at ins_init())
+void ins_set_seed(INS* ins, uint64_t seed);
 
 #endif // INS_H
@@ -0,0 +1,97 @@
+#ifndef INS_BATCH_H
+#define INS_BATCH_H
+
+#include "ins.h"
+#include "flight_state.h"
+#include "rng.h"
+#include <stddef.h>
+
+// The INS sensor model and dead reckoning of ins.c over many lanes at
+// once: K aircraft stepped together, or one aircraft stepped K times per
+// call. Lanes are kept as structure-of-arrays so every loop runs straight
+// down contiguous doubles. Noise comes from a counter-based generator
+// (rng.h) addressed by seed, lane and step, so a lane's results depend only
+// on the seed, its lane number and its own inputs, never on how many lanes
+// run beside it, and the same seed repeats a run exactly.
+
+// Flight state inputs per lane (the parts of FlightState the model reads)
+typedef struct {
+    double* heading;          // degrees
+    double* speed;            // knots
+    double* vertical_speed;   // feet per minute
+} INSFlightBatch;
+
+// INSSensorData per lane
+typedef struct {
+    double* accel_x;
+    double* accel_y;
+    double* accel_z;
+    double* gyro_x;
+    double* gyro_y;
+    double* gyro_z;
+    double* mag_x;
+    double* mag_y;
+    double* mag_z;
+} INSSensorBatch;
+
+// INSState per lane
+typedef struct {
+    double* latitude;
+    double* longitude;
+    double* altitude;
+    double* roll;
+    double* pitch;
+    double* yaw;
+    double* velocity_n;
+    double* velocity_e;
+    double* velocity_d;
+    double* gyro_bias[3];
+    double* accel_bias[3];
+    double* position_error;
+    double* attitude_error;
+} INSStateBatch;
+
+// Sensor noise, the same for every lane
+typedef struct {
+    double accel;             // m/s^2
+    double gyro;              // rad/s
+    double mag;               // normalized
+    double accel_bias_drift;  // m/s^2 per second
+    double gyro_bias_drift;   // rad/s per second
+} INSNoiseParams;
+
+typedef struct {
+    size_t count;
+    INSFlightBatch flight;
+    INSSensorBatch sensors;
+    INSStateBatch state;
+    RngKey key;
+    uint64_t sensor_draws;    // Sensor simulations so far, counter for their noise
+    uint64_t steps;           // Integration steps so far, counter for theirs
+    INSNoiseParams noise_params;  // May be changed between calls
+    double* noise;            // Scratch rows of draws, one lane per column
+    void* storage;            // Every array above
+} INSBatch;
+
+// The model's own noise levels, which new batches start with
+INSNoiseParams ins_batch_default_noise(void);
+
+// Allocate count lanes, zeroed. Returns NULL on failure.
+INSBatch* ins_batch_create(size_t count, uint64_t seed);
+
+void ins_batch_destroy(INSBatch* batch);
+
+// Copy one lane in or out of the arrays
+void ins_batch_set_flight(INSBatch* batch, size_t lane, const FlightState* flight_state);
+void ins_batch_set_state(INSBatch* batch, size_t lane, const INSState* state);
+void ins_batch_get_state(const INSBatch* batch, size_t lane, INSState* state);
+void ins_batch_get_sensors(const INSBatch* batch, size_t lane, INSSensorData* sensors);
+
+// Simulate sensor readings of every lane from its flight state
+void ins_batch_simulate_sensors(INSBatch* batch);
+
+// Integrate the current sensor readings of every lane over steps steps of
+// dt seconds each
+void ins_batch_integrate(INSBatch* batch, double dt, int steps);
+
+#endif // INS_BATCH_H
@@ -3,6 +3,8 @@
 
 #include "common.h"
 #include "bus.h"
+#include "ground_link.h"
+#include "sensor_feed.h"
 
 // Landing radio connection settings
 #define LANDING_RADIO_PORT 5556
@@ -35,9 +37,18 @@ typedef struct LandingRadio LandingRadio;
 // Initialize landing radio receiver
 LandingRadio* landing_radio_init(Bus* bus);
 
+// Like landing_radio_init(), with the link to the sender on a reactor the
+// caller runs (see ground_link.h) instead of one of its own
+LandingRadio* landing_radio_init_with_links(Bus* bus, GroundLinks* links);
+
 // Clean up landing radio receiver
 void landing_radio_cleanup(LandingRadio* radio);
 
+// Read records from an in-process feed instead of the landing radio sender
+// (NULL: back to the network). The receiver then counts as connected; the
+// feed must outlive it.
+void landing_radio_set_feed(LandingRadio* radio, SensorFeed* feed);
+
 // Process one iteration of landing radio data
 void landing_radio_process(LandingRadio* radio);
 
@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "common.h"
 
 // Log levels
@@ -14,6 +15,19 @@ typedef enum {
     LOG_TRACE       // Detailed tracing messages
 } LogLevel;
 
+// Numeric levels for preprocessor use, matching LogLevel
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN  1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+// Most verbose level compiled in. Calls above it compile to nothing and
+// their arguments are never evaluated (e.g. -DLOG_COMPILE_LEVEL=LOG_LEVEL_INFO).
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+
 // Log categories
 typedef enum {
     LOG_CORE = 0,       // Core system messages
@@ -42,16 +56,66 @@ void log_set_category_level(LogCategory category, LogLevel level);
 // Enable/disable category
 void log_enable_category(LogCategory category, bool enable);
 
+// Switch to asynchronous logging: log calls push binary records into a
+// per-process lock-free ring and a writer thread formats them. The writer is
+// restarted in forked children. Disabling drains the ring first.
+void log_set_async(bool enable);
+
+// Number of enabled levels per category (0 = category disabled), kept in
+// sync with the configuration so the macros can filter without locking
+extern _Atomic unsigned char log_enabled_levels[LOG_NUM_CATEGORIES];
+
+#define LOG_ENABLED(cat, level) \
+    ((unsigned)(level) < atomic_load_explicit(&log_enabled_levels[(cat)], memory_order_relaxed))
+
 // Main logging function
 void log_write(LogCategory category, LogLevel level, const char* file, int line, 
                const char* func, const char* fmt, ...);
 
-// Convenience macros
-#define LOG_ERROR(cat, ...) log_write(cat, LOG_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_WARN(cat, ...)  log_write(cat, LOG_WARN,  __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_INFO(cat, ...)  log_write(cat, LOG_INFO,  __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_DEBUG(cat, ...) log_write(cat, LOG_DEBUG, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_TRACE(cat, ...) log_write(cat, LOG_TRACE, __FILE__, __LINE__, __func__, __VA_ARGS__)
+// Convenience macros. Arguments are only evaluated when the level is enabled.
+#define LOG_AT(cat, level, ...) \
+    do { \
+        if (LOG_ENABLED(cat, level)) \
+            log_write(cat, level, __FILE__, __LINE__, __func__, __VA_ARGS__); \
+    } while (0)
+
+// Compiled-out calls keep the arguments visible to the compiler, so
+// variables used only for logging do not trigger unused warnings
+#define LOG_ELIDED(cat, level, ...) \
+    do { \
+        if (0) \
+            log_write(cat, level, __FILE__, __LINE__, __func__, __VA_ARGS__); \
+    } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(cat, ...) LOG_AT(cat, LOG_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(cat, ...) LOG_ELIDED(cat, LOG_ERROR, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(cat, ...)  LOG_AT(cat, LOG_WARN,  __VA_ARGS__)
+#else
+#define LOG_WARN(cat, ...)  LOG_ELIDED(cat, LOG_WARN,  __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(cat, ...)  LOG_AT(cat, LOG_INFO,  __VA_ARGS__)
+#else
+#define LOG_INFO(cat, ...)  LOG_ELIDED(cat, LOG_INFO,  __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(cat, ...) LOG_AT(cat, LOG_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(cat, ...) LOG_ELIDED(cat, LOG_DEBUG, __VA_ARGS__)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(cat, ...) LOG_AT(cat, LOG_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(cat, ...) LOG_ELIDED(cat, LOG_TRACE, __VA_ARGS__)
+#endif
 
 // String conversion utilities
 const char* log_level_to_string(LogLevel level);
@@ -2,10 +2,13 @@
 #define MESSAGES_H
 
 #include "common.h"
+#include <stddef.h>
 
 #define MAX_MESSAGE_SIZE 1024
 
-// Message types must match the protocol being used
+// Message types must match the protocol being used. The flight controller
+// no longer answers MSG_STATE_REQUEST: components read the shared flight
+// state snapshot (flight_state_read_snapshot()) instead.
 typedef enum {
     MSG_POSITION_UPDATE = 0,    // Position updates from navigation components
     MSG_STATE_REQUEST = 1,      // Request for current state
@@ -14,13 +17,18 @@ typedef enum {
     MSG_SYSTEM_STATUS = 4       // System status updates
 } MessageType;
 
+// Number of message types (keep in sync with the last MessageType)
+#define MSG_NUM_TYPES (MSG_SYSTEM_STATUS + 1)
+
 // Message header structure
 typedef struct {
     MessageType type;
     ComponentId sender;
     ComponentId receiver;
-    uint32_t timestamp;
+    uint32_t timestamp;     // Wall clock seconds, set by the sender
     uint32_t message_size;
+    uint64_t send_time_ns;  // CLOCK_MONOTONIC, set by the bus on publish
+    TraceContext trace;
 } MessageHeader;
 
 // Message payload structures
@@ -38,6 +46,9 @@ typedef struct {
     double target_altitude;
 } AutopilotCommandMsg;
 
+// Posted by each component periodically and on changes. The first with
+// component_active set after a (re)start is its readiness report: it is
+// initialized and connected to its sender, or has its first fix (INS).
 typedef struct {
     bool component_active;
 } SystemStatusMsg;
@@ -53,7 +64,58 @@ typedef struct {
     } payload;
 } Message;
 
+// Short name of each message type, indexed by MessageType. Recordings,
+// metric labels and the benchmarks' --mix use these.
+static const char* const MESSAGE_TYPE_NAMES[MSG_NUM_TYPES] = {
+    [MSG_POSITION_UPDATE] = "position",
+    [MSG_STATE_REQUEST] = "state_request",
+    [MSG_STATE_RESPONSE] = "state_response",
+    [MSG_AUTOPILOT_COMMAND] = "command",
+    [MSG_SYSTEM_STATUS] = "status"
+};
+
+// Largest payload carried by each message type, indexed by MessageType.
+// header.message_size must not exceed this.
+static const uint32_t MESSAGE_PAYLOAD_SIZES[MSG_NUM_TYPES] = {
+    [MSG_POSITION_UPDATE] = sizeof(PositionUpdateMsg),
+    [MSG_STATE_REQUEST] = 0,
+    [MSG_STATE_RESPONSE] = sizeof(StateResponseMsg),
+    [MSG_AUTOPILOT_COMMAND] = sizeof(AutopilotCommandMsg),
+    [MSG_SYSTEM_STATUS] = sizeof(SystemStatusMsg)
+};
+
+// Delivery classes. Each class has its own lane on the bus and readers
+// drain higher lanes first, so commands never wait behind sensor traffic.
+typedef enum {
+    MSG_PRIORITY_LOW = 0,       // High-rate sensor streams
+    MSG_PRIORITY_NORMAL,        // State exchange and status
+    MSG_PRIORITY_HIGH           // Commands, including emergency overrides
+} MessagePriority;
+
+// Number of priority classes (keep in sync with the last MessagePriority)
+#define MSG_NUM_PRIORITIES (MSG_PRIORITY_HIGH + 1)
+
+// Class each message type is delivered in unless a subscription overrides
+// it, indexed by MessageType
+static const MessagePriority MESSAGE_PRIORITIES[MSG_NUM_TYPES] = {
+    [MSG_POSITION_UPDATE] = MSG_PRIORITY_LOW,
+    [MSG_STATE_REQUEST] = MSG_PRIORITY_NORMAL,
+    [MSG_STATE_RESPONSE] = MSG_PRIORITY_NORMAL,
+    [MSG_AUTOPILOT_COMMAND] = MSG_PRIORITY_HIGH,
+    [MSG_SYSTEM_STATUS] = MSG_PRIORITY_NORMAL
+};
+
+// Bytes of a Message that carry data for a given payload size
+#define MESSAGE_SIZE(payload_size) (offsetof(Message, payload) + (payload_size))
+
 // Validation macros
-#define VALIDATE_MESSAGE_TYPE(type) ((type) >= MSG_POSITION_UPDATE && (type) <= MSG_SYSTEM_STATUS)
+#define VALIDATE_MESSAGE_TYPE(type) ((type) >= MSG_POSITION_UPDATE && (type) < MSG_NUM_TYPES)
+#define VALIDATE_MESSAGE_PRIORITY(priority) \
+    ((priority) >= MSG_PRIORITY_LOW && (priority) < MSG_NUM_PRIORITIES)
+
+// Name from MESSAGE_TYPE_NAMES, "unknown" if the type is invalid
+static inline const char* message_type_name(MessageType type) {
+    return VALIDATE_MESSAGE_TYPE(type) ? MESSAGE_TYPE_NAMES[type] : "unknown";
+}
 
 #endif // MESSAGES_H
@@ -0,0 +1,108 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "common.h"
+#include "messages.h"
+#include "trace.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+// Process-wide metrics in a named shared memory region, so an exporter in
+// another process (metrics_exporter) can read them while the simulator
+// runs. Counters, gauges and histograms are fixed arrays indexed by metric
+// and label (a message type or a component), updated with relaxed atomics,
+// so recording is an add or two and never takes a lock. Without
+// metrics_init() in this process or a parent it is a no-op.
+
+// Prefix of region names: each run creates METRICS_DEFAULT_NAME.<pid>
+#define METRICS_DEFAULT_NAME "/airplane_sim_metrics"
+#define METRICS_MAGIC 0x315343495254454dull  // "METRICS1"
+#define METRICS_VERSION 2
+#define METRICS_MAX_LABELS 8                 // Message types and components
+
+typedef enum {
+    METRIC_BUS_PUBLISHED = 0,       // By message type
+    METRIC_BUS_DELIVERED,           // By message type, one per subscriber copy read
+    METRIC_BUS_DROPPED,             // By message type, one per subscriber copy lost
+    METRIC_LOOP_ITERATIONS,         // By component, *_process() calls
+    METRIC_LOOP_OVERRUNS,           // By component, iterations longer than the step period
+    METRIC_LINK_BYTES,              // By component, received from its sender
+    METRIC_LINK_PARSE_FAILURES,     // By component, malformed stream data and records
+    METRIC_LINK_CONNECTS,           // By component
+    METRIC_COMPONENT_RESTARTS,      // By component
+    METRIC_COMPONENT_FAILOVERS,     // By component, exits taken over by a warm standby
+    METRIC_NUM_COUNTERS
+} MetricCounter;
+
+typedef enum {
+    METRIC_COMPONENT_UP = 0,        // By component, 1 while running
+    METRIC_LINK_CONNECTED,          // By component, 1 while its sender is connected
+    METRIC_NUM_GAUGES
+} MetricGauge;
+
+typedef enum {
+    METRIC_LOOP_TIME = 0,           // By component, *_process() duration in ns
+    METRIC_NUM_HISTOGRAMS
+} MetricHistogram;
+
+typedef struct {
+    LatencyHistogram hist;
+    _Atomic uint64_t sum_ns;
+} MetricsHistogram;
+
+typedef struct {
+    _Atomic uint64_t magic;         // Stored last, once the header is valid
+    uint32_t version;
+    int32_t owner_pid;
+    int64_t start_time;             // Unix time of metrics_init()
+    _Atomic uint64_t counters[METRIC_NUM_COUNTERS][METRICS_MAX_LABELS];
+    _Atomic int64_t gauges[METRIC_NUM_GAUGES][METRICS_MAX_LABELS];
+    MetricsHistogram histograms[METRIC_NUM_HISTOGRAMS][METRICS_MAX_LABELS];
+} MetricsRegion;
+
+// This process's mapping, NULL when metrics are off
+extern MetricsRegion* metrics_region;
+
+// Create and map the region. Call before forking components so they all
+// record into it. NULL name: METRICS_DEFAULT_NAME.<pid>. An existing
+// region of that name is never replaced; init fails instead.
+bool metrics_init(const char* name);
+
+// Unmap, and unlink the region if this process created it
+void metrics_cleanup(void);
+
+// Map an existing region read-only, e.g. from an exporter. Returns NULL if
+// it does not exist or is not a metrics region of this version.
+const MetricsRegion* metrics_open(const char* name);
+
+// Write the name of the region created by the simulator with this pid
+void metrics_region_name(char* name, size_t size, pid_t pid);
+
+void metrics_close(const MetricsRegion* region);
+
+static inline void metrics_count(MetricCounter counter, int label, uint64_t n) {
+    if (!metrics_region || label < 0 || label >= METRICS_MAX_LABELS) return;
+    atomic_fetch_add_explicit(&metrics_region->counters[counter][label], n,
+                              memory_order_relaxed);
+}
+
+static inline void metrics_gauge_set(MetricGauge gauge, int label, int64_t value) {
+    if (!metrics_region || label < 0 || label >= METRICS_MAX_LABELS) return;
+    atomic_store_explicit(&metrics_region->gauges[gauge][label], value, memory_order_relaxed);
+}
+
+// Start of one loop iteration: a timestamp for metrics_loop_end(), or 0
+// when metrics are off
+static inline uint64_t metrics_loop_start(void) {
+    return metrics_region ? monotonic_ns() : 0;
+}
+
+// End of the iteration begun at start_ns: counts it, records its duration
+// and counts an overrun if it took longer than budget_ms
+void metrics_loop_end(ComponentId component, uint64_t start_ns, uint32_t budget_ms);
+
+// Write every metric in the Prometheus text exposition format
+void metrics_write_prometheus(const MetricsRegion* region, FILE* out);
+
+#endif // METRICS_H
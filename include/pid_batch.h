@@ -0,0 +1,82 @@
+#ifndef PID_BATCH_H
+#define PID_BATCH_H
+
+#include "autopilot.h"
+#include <stddef.h>
+
+// The autopilot's control law (update_pid_controls() in autopilot.c) over
+// many lanes at once, closed around a simple aircraft model, for tuning
+// gains offline. Every lane flies the same scenario from the same initial
+// state with its own heading, altitude and speed gains. Lanes are kept as
+// structure-of-arrays, like ins_batch.h, so each step is a few straight
+// loops over contiguous doubles with no branches, and disjoint lane ranges
+// can be stepped on different threads.
+//
+// The aircraft follows each command with a first-order lag, limited to the
+// config's heading rate, climb and descent rates, and PLANT_MAX_ACCEL_KTS.
+// The axes do not interact, so each lane's three responses are
+// independent experiments.
+
+typedef enum {
+    PID_AXIS_HEADING = 0,
+    PID_AXIS_ALTITUDE,
+    PID_AXIS_SPEED,
+    PID_NUM_AXES
+} PIDAxis;
+
+// One axis across all lanes
+typedef struct {
+    double* kp;
+    double* ki;
+    double* kd;
+    double* integral;         // The autopilot's pid_state
+    double* last_error;
+    double* value;            // Aircraft heading (deg), altitude (ft) or speed (kts)
+    double* overshoot;        // Furthest past the target so far, in the axis's units
+    double* last_outside;     // Steps until the error last left the settling band
+} PIDAxisBatch;
+
+typedef struct {
+    size_t count;
+    AutopilotConfig config;   // Targets and limits shared by every lane
+    double dt;                // Seconds per step, the autopilot's update interval
+    PIDAxisBatch axes[PID_NUM_AXES];
+    double initial_error[PID_NUM_AXES];  // Target minus the initial state
+    double band[PID_NUM_AXES];           // |error| counted as settled
+    uint64_t steps;           // Steps since pid_batch_reset()
+    void* storage;            // Every array above
+} PIDBatch;
+
+// How one lane's axis responded
+typedef struct {
+    double settling_s;        // Time until the error stayed inside the band
+    double overshoot_pct;     // Of the initial error
+    double final_error;       // Target minus the final value
+    bool settled;             // Inside the band at the end
+} PIDResponse;
+
+// Allocate count lanes flying to the config's targets, with the config's
+// gains in every lane. Returns NULL on failure.
+PIDBatch* pid_batch_create(size_t count, const AutopilotConfig* config);
+
+void pid_batch_destroy(PIDBatch* batch);
+
+// Gains of one lane's axis: P, I, D as in AutopilotConfig
+void pid_batch_set_gains(PIDBatch* batch, size_t lane, PIDAxis axis, const double gains[3]);
+
+// Put every lane's aircraft at the initial state, with cleared controller
+// state and metrics. Errors within settle_fraction of the initial error
+// count as settled.
+void pid_batch_reset(PIDBatch* batch, const FlightState* initial, double settle_fraction);
+
+// Run steps control periods for lanes [begin, end). Ranges that do not
+// overlap may run concurrently. Call with the same steps for every lane,
+// then count them once with pid_batch_advance().
+void pid_batch_run(PIDBatch* batch, size_t begin, size_t end, int steps);
+
+void pid_batch_advance(PIDBatch* batch, int steps);
+
+void pid_batch_get_response(const PIDBatch* batch, size_t lane, PIDAxis axis,
+                            PIDResponse* response);
+
+#endif // PID_BATCH_H
@@ -0,0 +1,128 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "common.h"
+#include "messages.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Binary flight recorder. Every message accepted by bus_publish() and its
+// siblings, in this process and in components forked after
+// recorder_start(), is copied into a shared lock-free ring and appended by
+// one writer thread to memory-mapped, preallocated segment files. Rotation
+// happens when a segment is full. Each segment indexes itself, so a reader
+// can slice it by time or message type without scanning it.
+//
+// Segment file <prefix>.NNNN.rec:
+//   RecorderSegmentHeader    first page
+//   RecorderIndexEntry[]     index_capacity entries, one per index interval
+//   records                  RecorderRecord + message header + payload,
+//                            each padded to 8 bytes
+// Offsets are from the start of the file; 0 means none. A segment that was
+// not closed cleanly is still readable up to data_end.
+
+#define RECORDER_MAGIC 0x43455241u    // "AREC"
+#define RECORDER_VERSION 2
+#define RECORDER_ANY_TYPE (-1)
+
+// One message as stored
+typedef struct {
+    uint64_t time_ns;           // sim_clock_ns() when it was published
+    uint64_t next_same_type;    // Offset of the next record of this type
+    uint32_t size;              // Bytes of MessageHeader + payload that follow
+    uint32_t reserved;
+} RecorderRecord;
+
+// First record of each type at or after time_ns, and of any type
+typedef struct {
+    uint64_t time_ns;
+    uint64_t first_offset;
+    uint64_t type_offset[MSG_NUM_TYPES];
+} RecorderIndexEntry;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t segment;           // Sequence number within the recording
+    uint32_t index_capacity;
+    uint64_t index_interval_ns;
+    uint64_t start_clock_ns;    // sim_clock_ns() when the recording started
+    uint64_t start_wall_ns;     // Wall clock then, simulated if the clock is
+    uint64_t data_start;        // Offset of the first record
+    _Atomic uint64_t data_end;  // End of the last complete record
+    uint32_t index_count;       // Entries in use
+    bool closed;                // Finished cleanly
+    uint64_t records;
+    uint64_t first_time_ns;
+    uint64_t last_time_ns;
+    uint64_t dropped;           // Messages lost to a full ring so far in the recording
+    uint64_t type_records[MSG_NUM_TYPES];
+    uint64_t type_first[MSG_NUM_TYPES];
+    uint64_t type_last[MSG_NUM_TYPES];
+} RecorderSegmentHeader;
+
+typedef struct {
+    const char* prefix;         // Segment files are <prefix>.NNNN.rec
+    uint64_t segment_bytes;     // Preallocated size of each segment
+    uint32_t max_segments;      // Oldest segments deleted beyond this, 0 = keep all
+    uint64_t index_interval_ns; // Time covered by one index entry
+} RecorderOptions;
+
+typedef struct {
+    uint64_t recorded;          // Messages written
+    uint64_t dropped;           // Messages lost to a full ring
+    uint64_t bytes;             // Record bytes written
+    uint32_t segments;          // Segments started
+} RecorderStats;
+
+// 64 MiB segments, all kept, one index entry per second
+RecorderOptions recorder_default_options(void);
+
+// Start recording before components are forked. One recorder per process
+// tree; the writer thread runs in the calling process.
+ErrorCode recorder_start(const RecorderOptions* options);
+
+// Record what is still queued, close the segment and stop. Only acts in
+// the process that started the recorder.
+void recorder_stop(void);
+
+bool recorder_active(void);
+
+void recorder_get_stats(RecorderStats* stats);
+
+// Print the recorder counters
+void recorder_dump_stats(FILE* out);
+
+// A segment file mapped read-only
+typedef struct {
+    const uint8_t* base;
+    size_t size;
+    const RecorderSegmentHeader* header;
+    const RecorderIndexEntry* index;
+} RecorderSegment;
+
+// Map a segment and check its header. Returns false on error.
+bool recorder_segment_open(RecorderSegment* segment, const char* path);
+
+void recorder_segment_close(RecorderSegment* segment);
+
+// Walks the records of one type (or RECORDER_ANY_TYPE) in a time range
+// through the segment's index and per-type links
+typedef struct {
+    const RecorderSegment* segment;
+    int type;
+    uint64_t offset;            // Next candidate record, 0 when done
+    uint64_t from_ns;
+    uint64_t to_ns;
+} RecorderCursor;
+
+// Position a cursor at the first matching record with from_ns <= time_ns
+// <= to_ns
+void recorder_cursor_init(RecorderCursor* cursor, const RecorderSegment* segment, int type,
+                          uint64_t from_ns, uint64_t to_ns);
+
+// Next matching record: its time and the message, payload zero-padded to
+// a full Message. Returns false at the end of the range.
+bool recorder_cursor_next(RecorderCursor* cursor, uint64_t* time_ns, Message* message);
+
+#endif // RECORDER_H
@@ -0,0 +1,70 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "common.h"
+#include "bus.h"
+#include "recorder.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+// Replay of a flight recording (recorder.h). The messages the GPS, landing
+// radio and satcom receivers published are injected back into the bus in
+// their place, each at its recorded offset from the start of the
+// recording, while the flight controller, autopilot and INS run again on
+// them. Meant for FC_EXEC_SCHEDULER (see FlightControllerOptions.replay),
+// which paces the simulated clock at any speed or runs flat out.
+//
+// Everything the rerun components publish is compared with what they
+// published in the recording, stream by stream (message type and sender)
+// in order. A replay of a scheduler-mode recording with the same code and
+// seeds reproduces it exactly; anything else shows up as differences.
+
+typedef struct Replay Replay;
+
+// Per output stream comparison
+typedef struct {
+    uint64_t recorded;          // Recorded messages compared or missing
+    uint64_t replayed;          // Messages published by the rerun
+    uint64_t identical;         // Same payload at the same offset
+    uint64_t missing;           // Recorded but not published by the end
+    uint64_t extra;             // Published beyond the recorded stream
+    bool differs;
+    uint64_t first_diff_ns;     // Offset of the first difference, if it differs
+    double max_position_error;  // Meters, messages carrying a position
+    uint64_t max_time_skew_ns;  // Largest offset difference of a pair
+} ReplayStreamStats;
+
+// Open the segments <prefix>.NNNN.rec, in order, and tap bus to compare
+// the outputs. Returns NULL on error.
+Replay* replay_open(Bus* bus, const char* prefix);
+
+void replay_close(Replay* replay);
+
+// True for components whose recorded traffic is injected instead of
+// running them
+bool replay_is_source(ComponentId component);
+
+// Publish what source published while it started up, taken to be its
+// records ahead of the first output of any rerun component. Call where the
+// source would have been initialized.
+void replay_start_source(Replay* replay, ComponentId source);
+
+// Publish the recorded messages of source that are due on the simulated
+// clock. The first call starts the replay's clock.
+void replay_publish_due(Replay* replay, ComponentId source);
+
+// Every input injected and the clock past the end of the recording
+bool replay_finished(const Replay* replay);
+
+// Comparison of one stream; false if it has no messages either way
+bool replay_get_stream_stats(Replay* replay, MessageType type, ComponentId sender,
+                             ReplayStreamStats* stats);
+
+// True if any output stream differs from the recording. Counts recorded
+// messages not reproduced, so call after the replay finished.
+bool replay_outputs_differ(Replay* replay);
+
+// Print injected inputs and the comparison of every output stream
+void replay_report(Replay* replay, FILE* out);
+
+#endif // REPLAY_H
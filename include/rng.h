@@ -0,0 +1,75 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+#include <math.h>
+
+// Philox4x32-10 counter-based random numbers (Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3"). A draw is a pure function of a key
+// and a 128-bit counter, so every lane and step can address its own draws:
+// results do not depend on how work is split or in what order it runs,
+// and loops filling arrays of draws carry no state between iterations.
+
+#define RNG_PHILOX_M0 0xD2511F53u
+#define RNG_PHILOX_M1 0xCD9E8D57u
+#define RNG_PHILOX_W0 0x9E3779B9u  // Golden ratio
+#define RNG_PHILOX_W1 0xBB67AE85u  // sqrt(3) - 1
+#define RNG_PHILOX_ROUNDS 10
+
+typedef struct {
+    uint32_t k0, k1;
+} RngKey;
+
+typedef struct {
+    uint32_t c0, c1, c2, c3;
+} RngBlock;
+
+static inline RngKey rng_key(uint64_t seed) {
+    RngKey key = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+    return key;
+}
+
+// Four random words for one counter
+static inline RngBlock rng_philox(RngKey key, RngBlock ctr) {
+    for (int round = 0; round < RNG_PHILOX_ROUNDS; round++) {
+        uint64_t p0 = (uint64_t)RNG_PHILOX_M0 * ctr.c0;
+        uint64_t p1 = (uint64_t)RNG_PHILOX_M1 * ctr.c2;
+        RngBlock next = {
+            (uint32_t)(p1 >> 32) ^ ctr.c1 ^ key.k0,
+            (uint32_t)p1,
+            (uint32_t)(p0 >> 32) ^ ctr.c3 ^ key.k1,
+            (uint32_t)p0
+        };
+        ctr = next;
+        key.k0 += RNG_PHILOX_W0;
+        key.k1 += RNG_PHILOX_W1;
+    }
+    return ctr;
+}
+
+// Two uniforms from one counter, u1 in (0, 1] (safe for log) and u2 in
+// [0, 1), each from 53 bits
+static inline void rng_uniform2(RngKey key, RngBlock ctr, double* u1, double* u2) {
+    RngBlock r = rng_philox(key, ctr);
+    uint64_t a = ((uint64_t)r.c0 << 32 | r.c1) >> 11;
+    uint64_t b = ((uint64_t)r.c2 << 32 | r.c3) >> 11;
+    *u1 = (double)(a + 1) * 0x1.0p-53;
+    *u2 = (double)b * 0x1.0p-53;
+}
+
+// Box-Muller: two independent standard normals from rng_uniform2() output
+static inline void rng_box_muller(double u1, double u2, double* z0, double* z1) {
+    double radius = sqrt(-2.0 * log(u1));
+    double angle = 6.283185307179586 * u2;
+    *z0 = radius * cos(angle);
+    *z1 = radius * sin(angle);
+}
+
+// Two independent standard normal draws from one counter
+static inline void rng_normal2(RngKey key, RngBlock ctr, double* z0, double* z1) {
+    double u1, u2;
+    rng_uniform2(key, ctr, &u1, &u2);
+    rng_box_muller(u1, u2, z0, z1);
+}
+
+#endif // RNG_H
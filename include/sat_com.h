@@ -3,6 +3,8 @@
 
 #include "common.h"
 #include "bus.h"
+#include "ground_link.h"
+#include "sensor_feed.h"
 
 #define SATCOM_PORT 5557
 #define SATCOM_HOST "localhost"
@@ -57,9 +59,18 @@ typedef struct SatCom SatCom;
 // Initialize satellite communication
 SatCom* sat_com_init(Bus* bus);
 
+// Like sat_com_init(), with the link to the ground station on a reactor the
+// caller runs (see ground_link.h) instead of one of its own
+SatCom* sat_com_init_with_links(Bus* bus, GroundLinks* links);
+
 // Clean up satellite communication
 void sat_com_cleanup(SatCom* sat);
 
+// Read records from an in-process feed instead of the ground station (NULL: back
+// to the network). The receiver then counts as connected; the feed must
+// outlive it.
+void sat_com_set_feed(SatCom* sat, SensorFeed* feed);
+
 // Process one iteration of satellite communication
 void sat_com_process(SatCom* sat);
 
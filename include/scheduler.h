@@ -0,0 +1,36 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "common.h"
+
+#define SCHEDULER_MAX_TASKS 8
+
+// One step of a task, e.g. a component's *_process()
+typedef void (*SchedulerStep)(void* context);
+
+typedef struct Scheduler Scheduler;
+
+// Cooperative single-threaded scheduler on simulated time. Creating one
+// switches the process to simulated time starting at epoch (see
+// sim_clock.h). It runs flat out until paced with scheduler_set_speed().
+Scheduler* scheduler_init(time_t epoch);
+
+void scheduler_cleanup(Scheduler* scheduler);
+
+// Pace simulated against real time from now on: 1.0 = real time, 2.0 =
+// twice as fast, 0 = flat out
+void scheduler_set_speed(Scheduler* scheduler, double speed);
+
+// Step every period_ms of simulated time, first at the current time.
+// Tasks due at the same time run in the order they were added.
+ErrorCode scheduler_add_task(Scheduler* scheduler, const char* name, uint32_t period_ms,
+                             SchedulerStep step, void* context);
+
+// Run due tasks in deadline order, advancing the clock to each deadline,
+// until duration_ms of simulated time has passed
+void scheduler_run_for(Scheduler* scheduler, uint32_t duration_ms);
+
+// Steps run so far
+uint64_t scheduler_steps(const Scheduler* scheduler);
+
+#endif // SCHEDULER_H
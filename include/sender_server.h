@@ -0,0 +1,93 @@
+#ifndef SENDER_SERVER_H
+#define SENDER_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// TCP fan-out shared by the external senders: one epoll loop accepts
+// clients, reads what they send and paces the sender with a timerfd. A
+// record batch is encoded once and broadcast to every client. Each client
+// has its own output queue, so a client that stops reading never blocks
+// the others. Its queue holds whole batches only: while it is full, new
+// batches are dropped for that client, and it is disconnected if the queue
+// stays full for slow_client_ms.
+
+#define SENDER_DEFAULT_MAX_CLIENTS 64
+#define SENDER_DEFAULT_CLIENT_QUEUE (64 * 1024)
+#define SENDER_DEFAULT_SLOW_CLIENT_MS 5000
+#define SENDER_MAX_TICKS_PER_WAKE 64   // Ticks handed over at once when behind
+#define SENDER_RECEIVE_BUFFER 1024
+
+typedef struct SenderServer SenderServer;
+
+typedef struct {
+    uint16_t port;
+    double rate_hz;                 // Ticks per second
+    int max_clients;
+    size_t client_queue_bytes;      // Output waiting per client
+    uint32_t slow_client_ms;
+    bool reuse_port;                // SO_REUSEPORT as well as SO_REUSEADDR
+    int bind_attempts;              // While the port is still held
+    uint32_t bind_retry_ms;
+    int ready_fd;                   // Gets "READY <port>" once listening, then closed; -1: none
+} SenderServerOptions;
+
+typedef struct {
+    // Every 1 / rate_hz seconds. ticks is above 1 when the loop fell
+    // behind (at most SENDER_MAX_TICKS_PER_WAKE; the rest are skipped);
+    // dt is the length of one tick in seconds.
+    void (*on_tick)(SenderServer* server, int ticks, double dt, void* context);
+    // New client, e.g. to send it an initial record (optional)
+    void (*on_connect)(SenderServer* server, int client, void* context);
+    // Bytes from a client, NUL-terminated (optional)
+    void (*on_receive)(SenderServer* server, int client, const char* data, size_t length,
+                       void* context);
+    void* context;
+} SenderServerHandlers;
+
+typedef struct {
+    uint64_t connections;           // Clients accepted
+    uint64_t rejected;              // Turned away at max_clients
+    uint64_t batches;               // Broadcasts
+    uint64_t bytes_sent;            // Accepted by client sockets
+    uint64_t bytes_dropped;         // Batches dropped for full queues
+    uint64_t slow_disconnects;
+    uint64_t ticks_skipped;
+} SenderServerStats;
+
+// Ticks at rate_hz, SENDER_DEFAULT_* for the rest
+SenderServerOptions sender_server_default_options(uint16_t port, double rate_hz);
+
+// Bind, listen and arm the tick timer, then report readiness (ready_fd and
+// systemd's NOTIFY_SOCKET). A listening socket passed by socket activation
+// (LISTEN_FDS) is used instead of binding. Returns NULL on error.
+SenderServer* sender_server_create(const SenderServerOptions* options,
+                                   const SenderServerHandlers* handlers);
+
+void sender_server_destroy(SenderServer* server);
+
+// Serve until *running is cleared (e.g. by a signal handler)
+void sender_server_run(SenderServer* server, volatile bool* running);
+
+// Queue data for every client. It must hold whole records and fit a client
+// queue.
+void sender_server_broadcast(SenderServer* server, const void* data, size_t length);
+
+// Queue data for one client. Returns false if it was dropped or the client
+// is gone.
+bool sender_server_send(SenderServer* server, int client, const void* data, size_t length);
+
+int sender_server_client_count(const SenderServer* server);
+
+void sender_server_get_stats(const SenderServer* server, SenderServerStats* stats);
+
+void sender_server_print_stats(const SenderServer* server, FILE* out);
+
+// Parse the options every sender takes: --rate HZ, --max-clients N and
+// --ready-fd FD. Returns the number of arguments consumed at argv[i], 0 if
+// argv[i] is not one of them, -1 if its value is invalid.
+int sender_server_parse_option(SenderServerOptions* options, int argc, char* argv[], int i);
+
+#endif // SENDER_SERVER_H
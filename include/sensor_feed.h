@@ -0,0 +1,40 @@
+#ifndef SENSOR_FEED_H
+#define SENSOR_FEED_H
+
+#include "common.h"
+#include "sensor_models.h"
+
+// In-process stand-in for an external sender. It runs the sender's model
+// (sensor_models.h) on the component clock (sim_clock.h) and hands out the
+// records a receiver would have read from the socket, so a flight needs no
+// network and repeats exactly for a given seed.
+
+typedef enum {
+    SENSOR_FEED_GPS = 0,          // gps_sender
+    SENSOR_FEED_ILS,              // landing_radio_sender
+    SENSOR_FEED_GROUND_STATION    // sat_com_sender
+} SensorFeedKind;
+
+#define SENSOR_FEED_MAX_PENDING (GROUND_STATION_MAX_RECORDS + 1)
+
+typedef struct {
+    SensorFeedKind kind;
+    union {
+        GpsFlightPath gps;
+        IlsApproach ils;
+        GroundStation ground;
+    } model;
+    uint32_t interval_ms;
+    bool started;
+    int64_t last_ms;              // sim_clock_ms() of the last update
+    WireMessage pending[SENSOR_FEED_MAX_PENDING];
+    int pending_count;
+    int pending_next;
+} SensorFeed;
+
+void sensor_feed_init(SensorFeed* feed, SensorFeedKind kind, unsigned int seed);
+
+// Take the next record due by now. Returns false when none is due yet.
+bool sensor_feed_next(SensorFeed* feed, WireMessage* record);
+
+#endif // SENSOR_FEED_H
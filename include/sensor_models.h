@@ -0,0 +1,77 @@
+#ifndef SENSOR_MODELS_H
+#define SENSOR_MODELS_H
+
+#include "wire_protocol.h"
+#include <time.h>
+
+// Traffic models behind the external senders, shared so the simulator can
+// also generate the same records in-process (see sensor_feed.h). Each model
+// draws from its own rand_r() seed, so several can run in one process and
+// a seed always yields the same records.
+
+// How often the senders emit a record
+#define GPS_MODEL_INTERVAL_MS 1000
+#define ILS_MODEL_INTERVAL_MS 1000
+#define GROUND_STATION_INTERVAL_MS 1000
+
+// Most records one ground station update produces
+#define GROUND_STATION_MAX_RECORDS 2
+
+// GPS: climb-out from SFO on a fixed heading
+typedef struct {
+    double latitude;
+    double longitude;
+    double altitude;       // feet
+    double heading;        // degrees
+    double ground_speed;   // knots
+    double climb_rate;     // feet per minute
+    double target_alt;     // feet
+    unsigned int seed;
+} GpsFlightPath;
+
+void gps_model_init(GpsFlightPath* path, unsigned int seed);
+
+// Fly dt seconds and report the new fix as a WIRE_GPS_POSITION record
+void gps_model_step(GpsFlightPath* path, double dt, WireMessage* record);
+
+// Landing radio: ILS approach to runway 28L, starting over at the threshold
+typedef struct {
+    double localizer;      // Degrees off the centreline
+    double glideslope;     // Degrees off the glide path
+    double distance;       // Nautical miles to the threshold
+    double elapsed;        // Seconds since the approach started
+    unsigned int seed;
+} IlsApproach;
+
+void ils_model_init(IlsApproach* approach, unsigned int seed);
+
+// Fly dt seconds and report the deviations as a WIRE_ILS_DATA record
+void ils_model_step(IlsApproach* approach, double dt, WireMessage* record);
+
+// Satellite ground station: a fixed flight plan, slowly changing weather
+// and the occasional emergency command
+typedef struct {
+    int current_waypoint;
+    double wind_speed;
+    double wind_direction;
+    double turbulence;
+    double temperature;
+    time_t weather_updated;
+    unsigned int seed;
+} GroundStation;
+
+void ground_station_init(GroundStation* station, unsigned int seed);
+
+// The waypoint being flown as a WIRE_SAT_WAYPOINT record. Returns false once
+// the flight plan is complete.
+bool ground_station_waypoint(const GroundStation* station, time_t now, WireMessage* record);
+
+// Move on to the next waypoint of the plan
+void ground_station_waypoint_reached(GroundStation* station);
+
+// One update at time now: a weather record and now and then an emergency.
+// Returns the number of records written.
+int ground_station_step(GroundStation* station, time_t now,
+                        WireMessage records[GROUND_STATION_MAX_RECORDS]);
+
+#endif // SENSOR_MODELS_H
@@ -0,0 +1,36 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include "common.h"
+
+// Start of simulated time when none is given: 2000-01-01T00:00:00Z
+#define SIM_CLOCK_DEFAULT_EPOCH 946684800
+
+// Time as components see it. They read the clock through these instead of
+// clock_gettime() and time(), so the cooperative scheduler can run them on
+// simulated time. Until sim_clock_use_simulated() is called these follow
+// CLOCK_MONOTONIC and CLOCK_REALTIME.
+//
+// Latency tracing and bus timeouts stay on the real clock.
+
+// Nanoseconds on the component clock, for dt and loop deadlines
+uint64_t sim_clock_ns(void);
+
+// Milliseconds on the component clock
+int64_t sim_clock_ms(void);
+
+// Unix seconds, for message timestamps and status intervals
+time_t sim_clock_time(void);
+
+// Switch this process to simulated time starting at epoch (Unix seconds).
+// Time then stands still between sim_clock_advance_to() calls, and the
+// monotonic and wall clocks read the same.
+void sim_clock_use_simulated(time_t epoch);
+
+bool sim_clock_is_simulated(void);
+
+// Move simulated time forward to ns (on the sim_clock_ns() scale). Going
+// backwards is ignored.
+void sim_clock_advance_to(uint64_t ns);
+
+#endif // SIM_CLOCK_H
@@ -0,0 +1,48 @@
+#ifndef STANDBY_H
+#define STANDBY_H
+
+#include "common.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Warm standby for forked components. While a component runs, its primary
+// process checkpoints the state it cannot rebuild quickly (the INS
+// alignment, the autopilot's PID integrators) into a shared region after
+// every step. A shadow process forked next to it has already attached the
+// bus and built everything else, and sleeps on a futex in the region. When
+// the primary dies the flight controller promotes the shadow, which
+// restores the last checkpoint and carries on in its place.
+//
+// Without standby_init() in this process or a parent every call is a no-op.
+
+#define STANDBY_CHECKPOINT_SIZE 512   // Largest state a component may checkpoint
+
+// Map the region. Call before forking the components that use it.
+bool standby_init(void);
+
+void standby_cleanup(void);
+
+// Checkpoint the component's state from now on (flight controller, before
+// forking its primary)
+void standby_enable(ComponentId component);
+
+// Record the promotion the next shadow of the component waits for. Call in
+// the flight controller just before forking the shadow.
+void standby_arm(ComponentId component);
+
+// Wake the component's shadow; it takes over from the last checkpoint
+void standby_promote(ComponentId component);
+
+// In a shadow: sleep until promoted. Returns false without a region or
+// when the component is not armed.
+bool standby_wait_promotion(ComponentId component);
+
+// In a primary: publish size bytes of state. Cheap enough for every step;
+// does nothing unless the component is enabled.
+void standby_checkpoint(ComponentId component, const void* state, size_t size);
+
+// Copy the last checkpoint of exactly size bytes. Returns false if there
+// is none.
+bool standby_restore(ComponentId component, void* state, size_t size);
+
+#endif // STANDBY_H
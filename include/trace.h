@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+#include "messages.h"
+#include <stdatomic.h>
+#include <stdio.h>
+
+// Log-linear latency histogram: 16 linear buckets per power of two of
+// nanoseconds, so percentiles are within ~6%. Safe to update from several
+// processes when it lives in shared memory.
+#define LATENCY_HIST_SUB_BITS 4
+#define LATENCY_HIST_BUCKETS (40 << LATENCY_HIST_SUB_BITS)
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[LATENCY_HIST_BUCKETS];
+} LatencyHistogram;
+
+void latency_histogram_add(LatencyHistogram* hist, uint64_t ns);
+void latency_histogram_merge(LatencyHistogram* into, const LatencyHistogram* from);
+
+// Largest value counted in a bucket
+uint64_t latency_histogram_bucket_limit(int bucket);
+
+// Upper bound of the bucket holding the given percentile (0-100)
+uint64_t latency_histogram_percentile(const LatencyHistogram* hist, double percentile);
+
+// Points on the sensor-to-actuation path where latency is recorded
+typedef enum {
+    TRACE_POSITION_TO_FC = 0,   // Position publish -> flight controller read
+    TRACE_STATE_TO_AUTOPILOT,   // State snapshot write -> autopilot read
+    TRACE_COMMAND_TO_FC,        // Autopilot command publish -> flight controller read
+    TRACE_FIX_TO_AUTOPILOT,     // Sensor fix -> state reaching the autopilot
+    TRACE_FIX_AGE_AT_CONTROL,   // Sensor fix -> autopilot control step using it
+    TRACE_FIX_TO_COMMAND,       // Sensor fix -> command applied by flight controller
+    TRACE_NUM_POINTS
+} TracePoint;
+
+// Map the per-point histograms. Call before forking components so they
+// all record into the same tables; without it recording is a no-op.
+bool trace_init(void);
+
+void trace_cleanup(void);
+
+// Start a new causal chain at a sensor fix
+TraceContext trace_begin(ComponentId origin);
+
+// Record the time elapsed since since_ns (a header's send_time_ns or a
+// chain's origin_ns) at a trace point. Zero timestamps are ignored.
+void trace_record(TracePoint point, uint64_t since_ns);
+
+// Print count, p50/p99/p999 and max per trace point
+void trace_dump(FILE* out);
+
+#endif // TRACE_H
@@ -0,0 +1,113 @@
+#ifndef WIRE_PROTOCOL_H
+#define WIRE_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Framing shared by the external senders and the component receivers.
+//
+// Frame layout (multi-byte fields big-endian):
+//   0  magic     0xA5 0x5A (never the start of a CSV line)
+//   2  version   WIRE_VERSION
+//   3  type      WireType
+//   4  length    payload bytes
+//   6  checksum  Fletcher-16 of the payload
+//   8  payload   fields in declaration order, doubles as IEEE 754
+//
+// Streams may also carry newline-terminated CSV records (the original
+// format); those are returned as WIRE_CSV_LINE.
+
+#define WIRE_MAGIC_0 0xA5
+#define WIRE_MAGIC_1 0x5A
+#define WIRE_VERSION 1
+#define WIRE_HEADER_SIZE 8
+#define WIRE_MAX_PAYLOAD 64
+#define WIRE_MAX_FRAME (WIRE_HEADER_SIZE + WIRE_MAX_PAYLOAD)
+#define WIRE_MAX_LINE 256
+#define WIRE_STREAM_BUFFER_SIZE 4096
+
+typedef enum {
+    WIRE_CSV_LINE = 0,       // Text record, see WireMessage.data.line
+    WIRE_GPS_POSITION,       // GPS sender fix
+    WIRE_ILS_DATA,           // Landing radio deviations
+    WIRE_SAT_WAYPOINT,       // Ground station waypoint
+    WIRE_SAT_WEATHER,        // Ground station weather
+    WIRE_SAT_EMERGENCY,      // Ground station emergency command
+    WIRE_NUM_TYPES
+} WireType;
+
+typedef struct {
+    double latitude;
+    double longitude;
+    double altitude;
+} WireGpsPosition;
+
+typedef struct {
+    double localizer;
+    double glideslope;
+    double distance;
+    bool localizer_valid;
+    bool glideslope_valid;
+    bool marker_beacon;
+} WireIlsData;
+
+typedef struct {
+    double latitude;
+    double longitude;
+    double altitude;
+    double speed;
+    double heading;
+    uint32_t eta;
+    bool is_final;
+} WireWaypoint;
+
+typedef struct {
+    double wind_speed;
+    double wind_direction;
+    double turbulence;
+    double temperature;
+} WireWeather;
+
+typedef struct {
+    WireType type;
+    union {
+        WireGpsPosition gps;
+        WireIlsData ils;
+        WireWaypoint waypoint;
+        WireWeather weather;
+        uint32_t emergency;
+        char line[WIRE_MAX_LINE];  // NUL-terminated, newline stripped
+    } data;
+} WireMessage;
+
+typedef enum {
+    WIRE_OK = 0,         // A message was decoded
+    WIRE_INCOMPLETE,     // Need more bytes
+    WIRE_MALFORMED       // Bytes were discarded; call again
+} WireResult;
+
+// Per-connection reassembly buffer
+typedef struct {
+    uint8_t data[WIRE_STREAM_BUFFER_SIZE];
+    size_t start;   // First unparsed byte
+    size_t end;     // One past the last received byte
+} WireStream;
+
+// Encode a binary frame. Returns the frame length, or 0 if the type cannot
+// be encoded or the buffer is too small.
+size_t wire_encode(const WireMessage* msg, uint8_t* out, size_t size);
+
+// Reset a stream, e.g. after reconnecting
+void wire_stream_reset(WireStream* stream);
+
+// Append whatever the socket has ready without blocking. Returns the recv
+// result: > 0 bytes read, 0 on orderly shutdown, -1 with errno set (EAGAIN
+// when nothing is pending; also when the buffer is full).
+ssize_t wire_stream_fill(WireStream* stream, int fd);
+
+// Take the next complete message from the buffer
+WireResult wire_stream_next(WireStream* stream, WireMessage* msg);
+
+#endif // WIRE_PROTOCOL_H
@@ -0,0 +1,417 @@
+// Autopilot tuner: sweeps heading, altitude and speed PID gains against a
+// closed-loop aircraft model and writes the best set as an autopilot
+// config.
+//
+// Every gain of an axis is tried at --levels values spaced evenly in log
+// scale from 1/--span to --span times the config's gain (a gain of 0 is
+// swept linearly from 0 to 1), and every P, I, D combination of those is
+// one lane of a pid_batch.h model: levels^3 lanes, plus one with the
+// config's own gains as the baseline. The axes do not interact, so each
+// lane tries one combination on all three at once and the best of each
+// axis is picked on its own. Lanes are split into chunks that a pool of
+// threads works through, stealing half of another thread's chunks when
+// their own run out.
+//
+// A lane's score on an axis is its settling time (the error stays within
+// --settle of the initial step) plus OVERSHOOT_COST_S per percent of
+// overshoot; one that never settles scores the whole duration plus its
+// final error as a fraction of the step, times the duration.
+//
+// Usage: autopilot_tuner [options]
+//   --config FILE     starting gains, targets and limits
+//                     (default config/autopilot_config.json)
+//   --output FILE     where the tuned config goes
+//                     (default config/autopilot_tuned.json)
+//   --levels N        values per gain (default 16)
+//   --span X          ratio swept either way from each gain (default 10)
+//   --duration S      simulated seconds per lane (default 300)
+//   --threads N       worker threads (default: online CPUs)
+//   --heading-step D, --altitude-step FT, --speed-step KTS
+//                     how far from the targets each lane starts
+//                     (default 90, 2000, 50)
+//   --settle F        settling band as a fraction of the step (default 0.02)
+
+#include "autopilot.h"
+#include "pid_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define DEFAULT_CONFIG "config/autopilot_config.json"
+#define DEFAULT_OUTPUT "config/autopilot_tuned.json"
+#define DEFAULT_LEVELS 16
+#define DEFAULT_SPAN 10.0
+#define DEFAULT_DURATION_S 300.0
+#define DEFAULT_SETTLE 0.02
+#define MAX_LEVELS 64
+#define MAX_THREADS 256
+
+#define CHUNK_LANES 64              // Lanes per unit of work, whole cache lines
+#define OVERSHOOT_COST_S 1.0        // Score seconds per percent of overshoot
+
+typedef struct {
+    const char* config_file;
+    const char* output_file;
+    int levels;
+    double span;
+    double duration_s;
+    int threads;
+    double steps[PID_NUM_AXES];
+    double settle;
+} TunerConfig;
+
+// Chunks [begin, end) still queued for one worker, packed into one word so
+// the owner taking from the front and thieves taking from the back agree
+typedef struct {
+    _Alignas(64) _Atomic uint64_t range;
+    uint64_t chunks_run;
+    uint64_t chunks_stolen;
+} WorkQueue;
+
+typedef struct {
+    PIDBatch* batch;
+    WorkQueue* queues;
+    int workers;
+    int steps;
+} WorkPool;
+
+typedef struct {
+    WorkPool* pool;
+    int index;
+} Worker;
+
+static const char* const AXIS_NAMES[PID_NUM_AXES] = {
+    [PID_AXIS_HEADING] = "heading",
+    [PID_AXIS_ALTITUDE] = "altitude",
+    [PID_AXIS_SPEED] = "speed"
+};
+
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+    return (uint64_t)begin << 32 | end;
+}
+
+// Next chunk from the front of the worker's own queue, or -1
+static int64_t take_own(WorkQueue* queue) {
+    uint64_t range = atomic_load(&queue->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)(range >> 32), end = (uint32_t)range;
+        if (begin >= end) return -1;
+        if (atomic_compare_exchange_weak(&queue->range, &range, pack_range(begin + 1, end))) {
+            return begin;
+        }
+    }
+}
+
+// Take the back half of a victim's queue: run its first chunk and queue
+// the rest as the thief's own. Returns the chunk, or -1.
+static int64_t steal(WorkQueue* thief, WorkQueue* victim) {
+    uint64_t range = atomic_load(&victim->range);
+    for (;;) {
+        uint32_t begin = (uint32_t)(range >> 32), end = (uint32_t)range;
+        if (begin >= end) return -1;
+        uint32_t taken = (end - begin + 1) / 2;
+        uint32_t split = end - taken;
+        if (atomic_compare_exchange_weak(&victim->range, &range, pack_range(begin, split))) {
+            // The thief's queue is empty, so nobody else is changing it
+            atomic_store(&thief->range, pack_range(split + 1, end));
+            thief->chunks_stolen += taken;
+            return split;
+        }
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = arg;
+    WorkPool* pool = worker->pool;
+    WorkQueue* own = &pool->queues[worker->index];
+
+    for (;;) {
+        int64_t chunk = take_own(own);
+        for (int i = 1; chunk < 0 && i < pool->workers; i++) {
+            chunk = steal(own, &pool->queues[(worker->index + i) % pool->workers]);
+        }
+        if (chunk < 0) break;  // Every queue is empty
+
+        size_t begin = (size_t)chunk * CHUNK_LANES;
+        size_t end = begin + CHUNK_LANES;
+        if (end > pool->batch->count) end = pool->batch->count;
+        pid_batch_run(pool->batch, begin, end, pool->steps);
+        own->chunks_run++;
+    }
+    return NULL;
+}
+
+// Run every lane for steps steps on the pool's workers
+static bool run_pool(WorkPool* pool) {
+    size_t chunks = (pool->batch->count + CHUNK_LANES - 1) / CHUNK_LANES;
+
+    // Contiguous shares to start with; stealing evens out the rest
+    for (int w = 0; w < pool->workers; w++) {
+        uint32_t begin = (uint32_t)(chunks * (size_t)w / (size_t)pool->workers);
+        uint32_t end = (uint32_t)(chunks * (size_t)(w + 1) / (size_t)pool->workers);
+        atomic_init(&pool->queues[w].range, pack_range(begin, end));
+        pool->queues[w].chunks_run = 0;
+        pool->queues[w].chunks_stolen = 0;
+    }
+
+    pthread_t threads[MAX_THREADS];
+    Worker workers[MAX_THREADS];
+    int started = 0;
+    for (int w = 0; w < pool->workers; w++) {
+        workers[w] = (Worker){ .pool = pool, .index = w };
+        int err = pthread_create(&threads[w], NULL, worker_main, &workers[w]);
+        if (err != 0) {
+            // The started workers steal this one's share
+            fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+            break;
+        }
+        started++;
+    }
+    if (started == 0) return false;
+
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    pid_batch_advance(pool->batch, pool->steps);
+    return true;
+}
+
+static double gain_level(double base, int level, int levels, double span) {
+    if (levels == 1) return base;
+    double position = (double)level / (levels - 1);   // 0 .. 1
+    if (base <= 0.0) return position;
+    return base * pow(span, 2.0 * position - 1.0);
+}
+
+// Lane l < levels^3 tries P level l % levels, I level (l / levels) % levels
+// and D level l / levels^2 on every axis; the last lane has the config's gains
+static void set_lane_gains(PIDBatch* batch, const TunerConfig* tuner, size_t lane) {
+    const double* bases[PID_NUM_AXES] = {
+        [PID_AXIS_HEADING] = batch->config.heading_pid,
+        [PID_AXIS_ALTITUDE] = batch->config.altitude_pid,
+        [PID_AXIS_SPEED] = batch->config.speed_pid
+    };
+    int n = tuner->levels;
+    int level[3] = { (int)(lane % (size_t)n), (int)(lane / (size_t)n % (size_t)n),
+                     (int)(lane / ((size_t)n * (size_t)n)) };
+
+    for (int a = 0; a < PID_NUM_AXES; a++) {
+        double gains[3];
+        for (int g = 0; g < 3; g++) {
+            gains[g] = gain_level(bases[a][g], level[g], n, tuner->span);
+        }
+        pid_batch_set_gains(batch, lane, (PIDAxis)a, gains);
+    }
+}
+
+static double score(const PIDResponse* response, double initial_error, double duration_s) {
+    if (!response->settled) {
+        double left = initial_error != 0.0 ? fabs(response->final_error / initial_error) : 0.0;
+        return duration_s + left * duration_s;
+    }
+    return response->settling_s + OVERSHOOT_COST_S * response->overshoot_pct;
+}
+
+static void print_row(const char* axis, const char* which, const PIDBatch* batch,
+                      size_t lane, PIDAxis a, double lane_score) {
+    PIDResponse response;
+    pid_batch_get_response(batch, lane, a, &response);
+
+    char settling[16] = "never";
+    if (response.settled) snprintf(settling, sizeof(settling), "%.1f", response.settling_s);
+    printf("%-9s %-5s %10.4g %10.4g %10.4g %9s %11.1f %10.3g %9.1f\n",
+           axis, which, batch->axes[a].kp[lane], batch->axes[a].ki[lane],
+           batch->axes[a].kd[lane], settling, response.overshoot_pct, response.final_error,
+           lane_score);
+}
+
+// The config as the autopilot reads it, with the chosen gains
+static bool write_config(const char* filename, const AutopilotConfig* config) {
+    FILE* out = fopen(filename, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot write %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "    \"target_latitude\": %.6f,\n", config->target_latitude);
+    fprintf(out, "    \"target_longitude\": %.6f,\n", config->target_longitude);
+    fprintf(out, "    \"target_altitude\": %.1f,\n", config->target_altitude);
+    fprintf(out, "    \"target_speed\": %.1f,\n", config->target_speed);
+    fprintf(out, "    \"target_heading\": %.6f,\n", config->target_heading);
+    fprintf(out, "    \"max_climb_rate\": %.1f,\n", config->max_climb_rate);
+    fprintf(out, "    \"max_descent_rate\": %.1f,\n", config->max_descent_rate);
+    fprintf(out, "    \"max_bank_angle\": %.1f,\n", config->max_bank_angle);
+    fprintf(out, "    \"max_pitch_angle\": %.1f,\n", config->max_pitch_angle);
+    fprintf(out, "    \"max_speed\": %.1f,\n", config->max_speed);
+    fprintf(out, "    \"min_speed\": %.1f,\n", config->min_speed);
+    fprintf(out, "    \"max_heading_rate\": %.1f,\n", config->max_heading_rate);
+    fprintf(out, "    \"heading_pid\": [%.6g, %.6g, %.6g],\n",
+            config->heading_pid[0], config->heading_pid[1], config->heading_pid[2]);
+    fprintf(out, "    \"altitude_pid\": [%.6g, %.6g, %.6g],\n",
+            config->altitude_pid[0], config->altitude_pid[1], config->altitude_pid[2]);
+    fprintf(out, "    \"speed_pid\": [%.6g, %.6g, %.6g]\n",
+            config->speed_pid[0], config->speed_pid[1], config->speed_pid[2]);
+    fprintf(out, "}\n");
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Cannot write %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--config FILE] [--output FILE] [--levels N] [--span X] "
+            "[--duration seconds] [--threads N] [--heading-step deg] [--altitude-step ft] "
+            "[--speed-step kts] [--settle fraction]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    TunerConfig tuner = {
+        .config_file = DEFAULT_CONFIG,
+        .output_file = DEFAULT_OUTPUT,
+        .levels = DEFAULT_LEVELS,
+        .span = DEFAULT_SPAN,
+        .duration_s = DEFAULT_DURATION_S,
+        .threads = cpus > 0 ? (int)cpus : 1,
+        .steps = { [PID_AXIS_HEADING] = 90.0, [PID_AXIS_ALTITUDE] = 2000.0,
+                   [PID_AXIS_SPEED] = 50.0 },
+        .settle = DEFAULT_SETTLE
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else if (strcmp(arg, "--config") == 0) {
+            tuner.config_file = value; i++;
+        } else if (strcmp(arg, "--output") == 0) {
+            tuner.output_file = value; i++;
+        } else if (strcmp(arg, "--levels") == 0) {
+            tuner.levels = atoi(value); i++;
+        } else if (strcmp(arg, "--span") == 0) {
+            tuner.span = atof(value); i++;
+        } else if (strcmp(arg, "--duration") == 0) {
+            tuner.duration_s = atof(value); i++;
+        } else if (strcmp(arg, "--threads") == 0) {
+            tuner.threads = atoi(value); i++;
+        } else if (strcmp(arg, "--heading-step") == 0) {
+            tuner.steps[PID_AXIS_HEADING] = atof(value); i++;
+        } else if (strcmp(arg, "--altitude-step") == 0) {
+            tuner.steps[PID_AXIS_ALTITUDE] = atof(value); i++;
+        } else if (strcmp(arg, "--speed-step") == 0) {
+            tuner.steps[PID_AXIS_SPEED] = atof(value); i++;
+        } else if (strcmp(arg, "--settle") == 0) {
+            tuner.settle = atof(value); i++;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (tuner.levels < 1 || tuner.levels > MAX_LEVELS || tuner.span < 1.0 ||
+        tuner.duration_s <= 0.0 || tuner.threads < 1 || tuner.settle <= 0.0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (tuner.threads > MAX_THREADS) tuner.threads = MAX_THREADS;
+
+    // A missing config would silently tune the autopilot's defaults
+    if (access(tuner.config_file, R_OK) != 0) {
+        fprintf(stderr, "Cannot read %s: %s\n", tuner.config_file, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    AutopilotConfig config = autopilot_load_config(tuner.config_file);
+
+    size_t grid = (size_t)tuner.levels * (size_t)tuner.levels * (size_t)tuner.levels;
+    size_t baseline = grid;
+    PIDBatch* batch = pid_batch_create(grid + 1, &config);
+    if (!batch) {
+        fprintf(stderr, "Failed to allocate %zu lanes\n", grid + 1);
+        return EXIT_FAILURE;
+    }
+    for (size_t lane = 0; lane < grid; lane++) {
+        set_lane_gains(batch, &tuner, lane);
+    }
+
+    // Every lane starts the same distance short of each target
+    FlightState initial = {0};
+    initial.heading = fmod(config.target_heading - tuner.steps[PID_AXIS_HEADING] + 360.0, 360.0);
+    initial.position.altitude = config.target_altitude - tuner.steps[PID_AXIS_ALTITUDE];
+    initial.speed = config.target_speed - tuner.steps[PID_AXIS_SPEED];
+    pid_batch_reset(batch, &initial, tuner.settle);
+
+    WorkQueue* queues = aligned_alloc(64, sizeof(WorkQueue) * (size_t)tuner.threads);
+    if (!queues) {
+        pid_batch_destroy(batch);
+        return EXIT_FAILURE;
+    }
+    WorkPool pool = {
+        .batch = batch,
+        .queues = queues,
+        .workers = tuner.threads,
+        .steps = (int)(tuner.duration_s / batch->dt + 0.5)
+    };
+
+    int64_t wall_start = monotonic_ms();
+    if (!run_pool(&pool)) {
+        free(queues);
+        pid_batch_destroy(batch);
+        return EXIT_FAILURE;
+    }
+    double wall_s = (double)(monotonic_ms() - wall_start) / 1000.0;
+
+    uint64_t stolen = 0;
+    for (int w = 0; w < pool.workers; w++) stolen += queues[w].chunks_stolen;
+    printf("%zu gain sets, %.0f simulated s each, in %.3f s on %d threads "
+           "(%.0f lane-steps/s, %llu of %zu chunks stolen)\n",
+           grid + 1, tuner.duration_s, wall_s, pool.workers,
+           wall_s > 0.0 ? (double)(grid + 1) * pool.steps / wall_s : 0.0,
+           (unsigned long long)stolen, (grid + CHUNK_LANES) / CHUNK_LANES);
+    printf("%-9s %-5s %10s %10s %10s %9s %11s %10s %9s\n",
+           "axis", "", "P", "I", "D", "settle s", "overshoot %", "final err", "score");
+
+    double* tuned[PID_NUM_AXES] = {
+        [PID_AXIS_HEADING] = config.heading_pid,
+        [PID_AXIS_ALTITUDE] = config.altitude_pid,
+        [PID_AXIS_SPEED] = config.speed_pid
+    };
+    for (int a = 0; a < PID_NUM_AXES; a++) {
+        PIDResponse response;
+        size_t best = baseline;
+        pid_batch_get_response(batch, baseline, (PIDAxis)a, &response);
+        double baseline_score = score(&response, batch->initial_error[a], tuner.duration_s);
+        double best_score = baseline_score;
+
+        for (size_t lane = 0; lane < grid; lane++) {
+            pid_batch_get_response(batch, lane, (PIDAxis)a, &response);
+            double lane_score = score(&response, batch->initial_error[a], tuner.duration_s);
+            if (lane_score < best_score) {
+                best_score = lane_score;
+                best = lane;
+            }
+        }
+
+        print_row(AXIS_NAMES[a], "base", batch, baseline, (PIDAxis)a, baseline_score);
+        print_row(AXIS_NAMES[a], "best", batch, best, (PIDAxis)a, best_score);
+        tuned[a][0] = batch->axes[a].kp[best];
+        tuned[a][1] = batch->axes[a].ki[best];
+        tuned[a][2] = batch->axes[a].kd[best];
+    }
+
+    bool written = write_config(tuner.output_file, &config);
+    if (written) printf("Wrote %s\n", tuner.output_file);
+
+    free(queues);
+    pid_batch_destroy(batch);
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
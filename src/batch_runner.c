@@ -0,0 +1,320 @@
+// Batch runner: many independent flights at once, faster than real time.
+//
+// Each flight is a child process with its own in-memory bus, its own
+// simulated clock and the flight controller stepping every component from
+// one loop (FC_EXEC_SCHEDULER). The external senders' traffic is generated
+// in-process (sensor_feed.h), so flights share no ports and can run side by
+// side on every core. At most --jobs flights run at a time; each reports a
+// summary line when the batch is done, in the order the configs were given.
+//
+// Usage: batch_runner [options] CONFIG.json...
+//   --jobs N          flights run at once (default: online CPUs)
+//   --duration S      simulated seconds per flight (default 600)
+//   --seed N          base sensor seed (default 1); every flight gets its own
+//   --verbose         keep the flights' stderr
+
+#include "autopilot.h"
+#include "bus.h"
+#include "flight_controller.h"
+#include "sim_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#define DEFAULT_DURATION_S 600.0
+#define SAMPLE_INTERVAL_MS 1000     // Flight state sampled once per simulated second
+#define SEEDS_PER_FLIGHT 16         // Feeds add the component id to the flight's seed
+#define METERS_PER_NM 1852.0
+
+typedef struct {
+    int jobs;
+    double duration_s;
+    unsigned int seed;
+    bool verbose;
+} BatchConfig;
+
+// What a flight reports to the runner
+typedef struct {
+    bool completed;
+    double sim_seconds;
+    double wall_seconds;
+    Position final_position;
+    double max_altitude;
+    double altitude_rms_error;  // Against the config's target altitude, per sample
+    double target_distance_nm;  // Final position to the config's target
+    double final_target_altitude;
+    double final_target_heading;
+    double final_target_speed;
+    uint64_t positions;         // Position updates published
+    uint64_t commands;          // Autopilot commands applied by the flight controller
+    uint64_t dropped;           // Messages to the flight controller lost on the bus
+} FlightSummary;
+
+// One flight in the batch
+typedef struct {
+    const char* config_file;
+    pid_t pid;
+    int result_fd;              // Read end of the child's summary pipe
+    FlightSummary summary;
+} Flight;
+
+static double distance_nm(const Position* a, double latitude, double longitude) {
+    double lat1 = DEG_TO_RAD(a->latitude);
+    double lat2 = DEG_TO_RAD(latitude);
+    double dlat = lat2 - lat1;
+    double dlon = DEG_TO_RAD(longitude - a->longitude);
+    double h = sin(dlat / 2) * sin(dlat / 2) +
+               cos(lat1) * cos(lat2) * sin(dlon / 2) * sin(dlon / 2);
+    return 2.0 * EARTH_RADIUS * asin(sqrt(h)) / METERS_PER_NM;
+}
+
+// Fly one config to the end of the duration. Runs in the child.
+static bool run_flight(const BatchConfig* batch, int index, const char* config_file,
+                       FlightSummary* summary) {
+    memset(summary, 0, sizeof(*summary));
+    int64_t wall_start = monotonic_ms();
+
+    BusOptions bus_options = bus_default_options();
+    bus_options.backend = BUS_BACKEND_MEMORY;
+    Bus* bus = bus_init_with_options(&bus_options);
+    if (!bus) return false;
+
+    FlightControllerOptions options = flight_controller_default_options();
+    options.mode = FC_EXEC_SCHEDULER;
+    options.autopilot_config = config_file;
+    options.sensor_feeds = true;
+    options.sensor_seed = batch->seed + (unsigned int)index * SEEDS_PER_FLIGHT;
+
+    FlightController* fc = flight_controller_init_with_options(bus, &options);
+    if (!fc) {
+        bus_cleanup(bus);
+        return false;
+    }
+    if (flight_controller_start(fc) != SUCCESS) {
+        return false;  // start() cleans up after itself
+    }
+
+    AutopilotConfig target = autopilot_load_config(config_file);
+    int64_t start_ms = sim_clock_ms();
+    int64_t end_ms = start_ms + (int64_t)(batch->duration_s * 1000.0);
+    double squared_error = 0.0;
+    int samples = 0;
+
+    while (sim_clock_ms() < end_ms) {
+        flight_controller_wait_messages(fc, SAMPLE_INTERVAL_MS);
+
+        const ExtendedFlightState* state = flight_controller_get_state(fc);
+        double altitude = state->basic.position.altitude;
+        double error = altitude - target.target_altitude;
+        squared_error += error * error;
+        samples++;
+        if (altitude > summary->max_altitude) summary->max_altitude = altitude;
+    }
+
+    const ExtendedFlightState* state = flight_controller_get_state(fc);
+    summary->final_position = state->basic.position;
+    summary->target_distance_nm = distance_nm(&state->basic.position,
+                                              target.target_latitude, target.target_longitude);
+    summary->final_target_altitude = state->autopilot.target_altitude;
+    summary->final_target_heading = state->autopilot.target_heading;
+    summary->final_target_speed = state->autopilot.target_speed;
+    summary->altitude_rms_error = samples ? sqrt(squared_error / samples) : 0.0;
+
+    BusStats stats;
+    if (bus_get_topic_stats(bus, MSG_POSITION_UPDATE, &stats) == SUCCESS) {
+        summary->positions = stats.published;
+    }
+    if (bus_get_topic_stats(bus, MSG_AUTOPILOT_COMMAND, &stats) == SUCCESS) {
+        summary->commands = stats.delivered;
+    }
+    if (bus_get_subscriber_stats(bus, COMPONENT_FLIGHT_CONTROLLER, &stats) == SUCCESS) {
+        summary->dropped = stats.dropped;
+    }
+
+    summary->sim_seconds = (double)(sim_clock_ms() - start_ms) / 1000.0;
+    flight_controller_cleanup(fc);  // Releases the bus too
+
+    summary->wall_seconds = (double)(monotonic_ms() - wall_start) / 1000.0;
+    summary->completed = true;
+    return true;
+}
+
+static bool start_flight(const BatchConfig* batch, Flight* flights, int index) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe failed");
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        if (!batch->verbose) {
+            int null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd >= 0) dup2(null_fd, STDERR_FILENO);
+        }
+
+        FlightSummary summary;
+        run_flight(batch, index, flights[index].config_file, &summary);
+
+        // The summary is well under PIPE_BUF, so this write is atomic
+        ssize_t written = write(fds[1], &summary, sizeof(summary));
+        _exit(written == (ssize_t)sizeof(summary) && summary.completed
+              ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    flights[index].pid = pid;
+    flights[index].result_fd = fds[0];
+    return true;
+}
+
+// Reap one finished flight and collect its summary
+static void finish_flight(Flight* flights, int count) {
+    int status;
+    pid_t pid;
+    while ((pid = wait(&status)) == -1 && errno == EINTR) {
+    }
+    if (pid == -1) return;
+
+    for (int i = 0; i < count; i++) {
+        if (flights[i].pid != pid) continue;
+
+        if (read(flights[i].result_fd, &flights[i].summary, sizeof(FlightSummary)) !=
+            (ssize_t)sizeof(FlightSummary)) {
+            flights[i].summary.completed = false;
+        }
+        close(flights[i].result_fd);
+        flights[i].pid = 0;
+        return;
+    }
+}
+
+static void print_summaries(const Flight* flights, int count, double wall_seconds) {
+    printf("%-4s %-32s %8s %8s %8s %11s %11s %8s %8s %8s %9s %8s %8s %8s %7s\n",
+           "#", "config", "sim s", "wall s", "speedup", "final lat", "final lon",
+           "alt ft", "max ft", "rms err", "to tgt nm", "cmd alt", "cmd hdg", "cmd kts",
+           "cmds");
+
+    double sim_total = 0.0;
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        const FlightSummary* s = &flights[i].summary;
+        if (!s->completed) {
+            printf("%-4d %-32s failed\n", i, flights[i].config_file);
+            failed++;
+            continue;
+        }
+
+        sim_total += s->sim_seconds;
+        printf("%-4d %-32s %8.0f %8.2f %8.0f %11.6f %11.6f %8.0f %8.0f %8.0f %9.1f "
+               "%8.0f %8.1f %8.1f %7llu\n",
+               i, flights[i].config_file, s->sim_seconds, s->wall_seconds,
+               s->wall_seconds > 0.0 ? s->sim_seconds / s->wall_seconds : 0.0,
+               s->final_position.latitude, s->final_position.longitude,
+               s->final_position.altitude, s->max_altitude, s->altitude_rms_error,
+               s->target_distance_nm, s->final_target_altitude, s->final_target_heading,
+               s->final_target_speed, (unsigned long long)s->commands);
+    }
+
+    printf("%d flights, %d failed, %.0f simulated s in %.2f s (%.0fx real time)\n",
+           count, failed, sim_total, wall_seconds,
+           wall_seconds > 0.0 ? sim_total / wall_seconds : 0.0);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [--jobs N] [--duration seconds] [--seed N] [--verbose] CONFIG.json...\n",
+            prog);
+}
+
+int main(int argc, char* argv[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    BatchConfig batch = {
+        .jobs = cpus > 0 ? (int)cpus : 1,
+        .duration_s = DEFAULT_DURATION_S,
+        .seed = 1,
+        .verbose = false
+    };
+
+    int first_config = argc;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strncmp(arg, "--", 2) != 0) {
+            first_config = i;
+            break;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            batch.verbose = true;
+        } else if (!value) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        } else if (strcmp(arg, "--jobs") == 0) {
+            batch.jobs = atoi(value); i++;
+        } else if (strcmp(arg, "--duration") == 0) {
+            batch.duration_s = atof(value); i++;
+        } else if (strcmp(arg, "--seed") == 0) {
+            batch.seed = (unsigned int)strtoul(value, NULL, 10); i++;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int count = argc - first_config;
+    if (count < 1 || batch.jobs < 1 || batch.duration_s <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Flight* flights = calloc((size_t)count, sizeof(Flight));
+    if (!flights) {
+        fprintf(stderr, "Failed to allocate %d flights\n", count);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; i++) {
+        flights[i].config_file = argv[first_config + i];
+        // A missing config would silently fly the autopilot's defaults
+        if (access(flights[i].config_file, R_OK) != 0) {
+            fprintf(stderr, "Cannot read %s: %s\n", flights[i].config_file, strerror(errno));
+            free(flights);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int64_t wall_start = monotonic_ms();
+    int running = 0;
+    for (int i = 0; i < count; i++) {
+        if (running == batch.jobs) {
+            finish_flight(flights, count);
+            running--;
+        }
+        if (start_flight(&batch, flights, i)) {
+            running++;
+        }
+    }
+    while (running-- > 0) {
+        finish_flight(flights, count);
+    }
+
+    print_summaries(flights, count, (double)(monotonic_ms() - wall_start) / 1000.0);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (!flights[i].summary.completed) failed++;
+    }
+    free(flights);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,62 +1,48 @@
 #include "gps_receiver.h"
+#include "component.h"
 #include "log.h"
+#include "metrics.h"
+#include "sensor_feed.h"
+#include "sim_clock.h"
+#include "trace.h"
+#include "wire_protocol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <fcntl.h>
-#include <errno.h>
 #include <time.h>
 
-#define BUFFER_SIZE 1024
-#define CONNECT_RETRY_INTERVAL_MS 1000
+#define POSITION_BATCH_SIZE 32
 #define STATUS_UPDATE_INTERVAL_S 1
+#define PROCESS_BUDGET_MS 10  // Step period under the scheduler
+
+// Positions decoded in one wakeup, published together
+typedef struct {
+    Message messages[POSITION_BATCH_SIZE];
+    int count;
+} PositionBatch;
 
 struct GpsReceiver {
     Bus* bus;
-    int socket_fd;
-    struct sockaddr_in server_addr;
+    GroundLinks* links;
+    bool owns_links;  // Created by init and run by gps_receiver_process()
+    GroundLink* link;
     bool connected;
     Position last_position;
     time_t last_status_update;
+    PositionBatch batch;
+    int invalid_count;
+    SensorFeed* feed;  // In-process sender, NULL to use the network
 };
 
-// Initialize socket connection
-static bool init_socket(GpsReceiver* gps) {
-    LOG_INFO(LOG_GPS, "Initializing socket");
-    
-    gps->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (gps->socket_fd < 0) {
-        LOG_ERROR(LOG_GPS, "Failed to create socket: %s", strerror(errno));
-        return false;
-    }
-
-    // Set socket to non-blocking
-    int flags = fcntl(gps->socket_fd, F_GETFL, 0);
-    fcntl(gps->socket_fd, F_SETFL, flags | O_NONBLOCK);
-
-    // Setup server address
-    memset(&gps->server_addr, 0, sizeof(gps->server_addr));
-    gps->server_addr.sin_family = AF_INET;
-    gps->server_addr.sin_port = htons(GPS_PORT);
-
-    struct hostent* server = gethostbyname(GPS_HOST);
-    if (server == NULL) {
-        LOG_ERROR(LOG_GPS, "Failed to resolve hostname %s", GPS_HOST);
-        close(gps->socket_fd);
-        return false;
-    }
+static bool on_record(const WireMessage* record, void* context);
+static void on_flush(void* context);
+static void on_link_state(bool connected, void* context);
 
-    memcpy(&gps->server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    LOG_INFO(LOG_GPS, "Socket initialized successfully");
-    return true;
+GpsReceiver* gps_receiver_init(Bus* bus) {
+    return gps_receiver_init_with_links(bus, NULL);
 }
 
-GpsReceiver* gps_receiver_init(Bus* bus) {
+GpsReceiver* gps_receiver_init_with_links(Bus* bus, GroundLinks* links) {
     LOG_INFO(LOG_GPS, "Starting initialization");
     
     if (!bus) {
@@ -73,10 +59,24 @@ GpsReceiver* gps_receiver_init(Bus* bus) {
     gps->bus = bus;
     gps->connected = false;
     gps->last_status_update = 0;
+    gps->batch.count = 0;
+    gps->invalid_count = 0;
+    gps->feed = NULL;
     memset(&gps->last_position, 0, sizeof(Position));
 
-    if (!init_socket(gps)) {
-        LOG_ERROR(LOG_GPS, "Socket initialization failed");
+    gps->owns_links = links == NULL;
+    gps->links = links ? links : ground_links_create();
+    GroundLinkHandlers handlers = {
+        .on_record = on_record,
+        .on_flush = on_flush,
+        .on_state = on_link_state,
+        .context = gps
+    };
+    gps->link = gps->links ? ground_links_add(gps->links, GPS_HOST, GPS_PORT, COMPONENT_GPS,
+                                              LOG_GPS, &handlers) : NULL;
+    if (!gps->link) {
+        LOG_ERROR(LOG_GPS, "Link initialization failed");
+        if (gps->owns_links) ground_links_destroy(gps->links);
         free(gps);
         return NULL;
     }
@@ -89,8 +89,10 @@ void gps_receiver_cleanup(GpsReceiver* gps) {
     if (!gps) return;
     
     LOG_INFO(LOG_GPS, "Cleaning up");
-    if (gps->socket_fd >= 0) {
-        close(gps->socket_fd);
+    if (gps->owns_links) {
+        ground_links_destroy(gps->links);
+    } else {
+        ground_links_remove(gps->links, gps->link);
     }
     free(gps);
 }
@@ -100,7 +102,7 @@ static void send_status_update(GpsReceiver* gps, bool connected) {
     msg.header.type = MSG_SYSTEM_STATUS;
     msg.header.sender = COMPONENT_GPS;
     msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
+    msg.header.timestamp = sim_clock_time();
     msg.header.message_size = sizeof(SystemStatusMsg);
     msg.payload.system_status.component_active = connected;
     
@@ -112,48 +114,34 @@ static void send_status_update(GpsReceiver* gps, bool connected) {
     }
 }
 
-static void publish_position(GpsReceiver* gps, const Position* pos) {
-    Message msg = {0};
-    msg.header.type = MSG_POSITION_UPDATE;
-    msg.header.sender = COMPONENT_GPS;
-    msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
-    msg.header.message_size = sizeof(PositionUpdateMsg);
-    msg.payload.position_update.position = *pos;
-    
-    if (bus_publish(gps->bus, &msg) == SUCCESS) {
-        gps->last_position = *pos;
-        LOG_DEBUG(LOG_GPS, "Published position: %.6f, %.6f, %.1f",
-                pos->latitude, pos->longitude, pos->altitude);
+static void flush_positions(GpsReceiver* gps, PositionBatch* batch) {
+    if (batch->count == 0) return;
+
+    if (bus_publish_batch(gps->bus, batch->messages, batch->count) == SUCCESS) {
+        LOG_DEBUG(LOG_GPS, "Published %d positions, last: %.6f, %.6f, %.1f", batch->count,
+                gps->last_position.latitude, gps->last_position.longitude,
+                gps->last_position.altitude);
     } else {
         LOG_ERROR(LOG_GPS, "Failed to publish position");
     }
+    batch->count = 0;
 }
 
-static bool try_connect(GpsReceiver* gps) {
-    if (gps->connected) return true;
-
-    LOG_INFO(LOG_GPS, "Attempting to connect to %s:%d", GPS_HOST, GPS_PORT);
-    
-    int result = connect(gps->socket_fd, 
-                        (struct sockaddr*)&gps->server_addr, 
-                        sizeof(gps->server_addr));
-
-    if (result == 0 || (result < 0 && errno == EISCONN)) {
-        gps->connected = true;
-        LOG_INFO(LOG_GPS, "Connected to GPS sender");
-        send_status_update(gps, true);
-        return true;
-    }
-    
-    if (result < 0 && (errno != EINPROGRESS && errno != EALREADY && 
-                       errno != EWOULDBLOCK)) {
-        LOG_ERROR(LOG_GPS, "Connect error: %s", strerror(errno));
-        close(gps->socket_fd);
-        init_socket(gps);
+static void queue_position(GpsReceiver* gps, PositionBatch* batch, const Position* pos) {
+    Message* msg = &batch->messages[batch->count++];
+    memset(&msg->header, 0, sizeof(msg->header));
+    msg->header.type = MSG_POSITION_UPDATE;
+    msg->header.sender = COMPONENT_GPS;
+    msg->header.receiver = COMPONENT_FLIGHT_CONTROLLER;
+    msg->header.timestamp = sim_clock_time();
+    msg->header.message_size = sizeof(PositionUpdateMsg);
+    msg->header.trace = trace_begin(COMPONENT_GPS);
+    msg->payload.position_update.position = *pos;
+    gps->last_position = *pos;
+
+    if (batch->count == POSITION_BATCH_SIZE) {
+        flush_positions(gps, batch);
     }
-
-    return false;
 }
 
 static bool validate_gps_data(const Position* current, const Position* new_pos) {
@@ -228,13 +216,97 @@ static bool parse_gps_data(GpsReceiver* gps, const char* buffer, Position* pos)
     return true;
 }
 
+static bool decode_record(GpsReceiver* gps, const WireMessage* record, Position* pos) {
+    switch (record->type) {
+        case WIRE_GPS_POSITION:
+            pos->latitude = record->data.gps.latitude;
+            pos->longitude = record->data.gps.longitude;
+            pos->altitude = record->data.gps.altitude;
+            return validate_gps_data(&gps->last_position, pos);
+
+        case WIRE_CSV_LINE:
+            return parse_gps_data(gps, record->data.line, pos);
+
+        default:
+            LOG_WARN(LOG_GPS, "Unexpected record type %d", record->type);
+            return false;
+    }
+}
+
+// A record from the GPS sender. Returns false to drop the connection.
+static bool on_record(const WireMessage* record, void* context) {
+    GpsReceiver* gps = context;
+
+    Position new_pos;
+    if (decode_record(gps, record, &new_pos)) {
+        LOG_TRACE(LOG_GPS, "Position update - delta lat: %.6f, delta lon: %.6f, delta alt: %.1f",
+                new_pos.latitude - gps->last_position.latitude,
+                new_pos.longitude - gps->last_position.longitude,
+                new_pos.altitude - gps->last_position.altitude);
+        queue_position(gps, &gps->batch, &new_pos);
+        gps->invalid_count = 0;
+        return true;
+    }
+
+    metrics_count(METRIC_LINK_PARSE_FAILURES, COMPONENT_GPS, 1);
+    if (++gps->invalid_count > 10) {
+        // If we get invalid data multiple times, consider reconnecting
+        LOG_ERROR(LOG_GPS, "Too many invalid GPS readings, reconnecting...");
+        gps->invalid_count = 0;
+        return false;
+    }
+    return true;
+}
+
+static void on_flush(void* context) {
+    GpsReceiver* gps = context;
+    flush_positions(gps, &gps->batch);
+}
+
+static void on_link_state(bool connected, void* context) {
+    GpsReceiver* gps = context;
+
+    if (connected) {
+        gps->connected = true;
+        LOG_INFO(LOG_GPS, "Connected to GPS sender");
+        send_status_update(gps, true);
+    } else if (gps->connected) {
+        gps->connected = false;
+        send_status_update(gps, false);
+    }
+}
+
+// Publish every record the in-process sender has due
+static void process_feed(GpsReceiver* gps) {
+    PositionBatch batch = { .count = 0 };
+    WireMessage record;
+
+    while (sensor_feed_next(gps->feed, &record)) {
+        Position new_pos;
+        if (decode_record(gps, &record, &new_pos)) {
+            queue_position(gps, &batch, &new_pos);
+        }
+    }
+
+    flush_positions(gps, &batch);
+}
+
+void gps_receiver_set_feed(GpsReceiver* gps, SensorFeed* feed) {
+    if (!gps) return;
+
+    gps->feed = feed;
+    gps->connected = feed != NULL;
+    ground_link_set_enabled(gps->link, feed == NULL);
+    LOG_INFO(LOG_GPS, "Reading from %s", feed ? "in-process feed" : "network");
+}
+
 void gps_receiver_process(GpsReceiver* gps) {
     if (!gps) {
         LOG_ERROR(LOG_GPS, "NULL GPS in process");
         return;
     }
 
-    time_t now = time(NULL);
+    time_t now = sim_clock_time();
 
     // Send periodic status updates
     if (now - gps->last_status_update >= STATUS_UPDATE_INTERVAL_S) {
@@ -242,51 +314,27 @@ void gps_receiver_process(GpsReceiver* gps) {
         gps->last_status_update = now;
     }
 
-    // Try to connect if not connected
-    if (!gps->connected) {
-        if (!try_connect(gps)) {
-            usleep(CONNECT_RETRY_INTERVAL_MS * 1000);
-            return;
-        }
+    if (gps->feed) {
+        process_feed(gps);
+        return;
     }
 
-    // Read data from socket
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_read = recv(gps->socket_fd, buffer, sizeof(buffer) - 1, 0);
-
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        Position new_pos;
-        if (parse_gps_data(gps, buffer, &new_pos)) {
-            LOG_TRACE(LOG_GPS, "Position update - delta lat: %.6f, delta lon: %.6f, delta alt: %.1f",
-                    new_pos.latitude - gps->last_position.latitude,
-                    new_pos.longitude - gps->last_position.longitude,
-                    new_pos.altitude - gps->last_position.altitude);
-            publish_position(gps, &new_pos);
-        } else {
-            // If we get invalid data multiple times, consider reconnecting
-            static int invalid_count = 0;
-            invalid_count++;
-            if (invalid_count > 10) {
-                LOG_ERROR(LOG_GPS, "Too many invalid GPS readings, reconnecting...");
-                close(gps->socket_fd);
-                gps->connected = false;
-                init_socket(gps);
-                invalid_count = 0;
-            }
-        }
-    } else if (bytes_read == 0 || (bytes_read < 0 && errno != EWOULDBLOCK)) {
-        LOG_ERROR(LOG_GPS, "Connection lost: %s",
-                bytes_read == 0 ? "Closed by peer" : strerror(errno));
-        close(gps->socket_fd);
-        if (gps->connected) {
-            gps->connected = false;
-            send_status_update(gps, false);
-        }
-        init_socket(gps);
+    // A shared reactor is run by its owner
+    if (gps->owns_links) {
+        ground_links_run(gps->links, 0);
     }
 }
 
+// Sleep until the sender has data for us, a status update is due or it is
+// time to retry the connection
+static void wait_for_data(GpsReceiver* gps) {
+    int64_t elapsed_ms = (sim_clock_time() - gps->last_status_update) * 1000;
+    int timeout_ms = STATUS_UPDATE_INTERVAL_S * 1000 - (int)elapsed_ms;
+    if (timeout_ms <= 0) return;
+
+    ground_links_run(gps->links, timeout_ms);
+}
+
 void gps_receiver_main(Bus* bus) {
     LOG_INFO(LOG_GPS, "Starting main function");
     
@@ -298,9 +346,11 @@ void gps_receiver_main(Bus* bus) {
 
     LOG_INFO(LOG_GPS, "Entering main loop");
     
-    while (1) {
+    while (component_running()) {
+        uint64_t loop_start = metrics_loop_start();
         gps_receiver_process(gps);
-        usleep(10000);  // 10ms sleep to prevent busy waiting
+        metrics_loop_end(COMPONENT_GPS, loop_start, PROCESS_BUDGET_MS);
+        wait_for_data(gps);
     }
 
     gps_receiver_cleanup(gps);
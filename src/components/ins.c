@@ -1,5 +1,12 @@
 #include "ins.h"
+#include "component.h"
+#include "config_store.h"
+#include "ins_batch.h"
 #include "log.h"
+#include "metrics.h"
+#include "sim_clock.h"
+#include "standby.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,43 +14,46 @@
 #include <time.h>
 #include <unistd.h>
 
-#define INS_UPDATE_INTERVAL_MS 10  // 100Hz update rate
 #define STATUS_UPDATE_INTERVAL_S 1
 #define INIT_TIMEOUT_S 10         // Time to wait for GPS before failing
-
-// Sensor noise parameters
-#define ACCEL_NOISE 0.05         // m/s^2
-#define GYRO_NOISE 0.001         // rad/s
-#define MAG_NOISE 0.01          // normalized
-#define ACCEL_BIAS_DRIFT 0.0001  // m/s^2 per second
-#define GYRO_BIAS_DRIFT 0.0001   // rad/s per second
+#define MESSAGE_BATCH_SIZE 16     // Bus messages drained per read
+#define STATE_INTERVAL_MS 100     // Flight state changes taken at most this often
 
 struct INS {
     Bus* bus;
+    INSBatch* model;             // One-lane ins_batch.h model behind state and sensors
     INSState state;
     INSSensorData sensors;
     FlightState current_state;
+    FlightStateWatch state_watch;  // Where current_state came from
     Position gps_position;
     bool gps_valid;
-    struct timespec last_update;
+    uint64_t last_update_ns;     // sim_clock_ns() at the previous step
     time_t last_status_update;
     time_t start_time;
     bool initialized;
+    uint32_t interval_ms;        // Step period
+    uint32_t config_version;     // Config store snapshot in use, 0 without one
 };
 
-// Generate random sensor noise using Box-Muller transform
-static double generate_noise(double magnitude) {
-    double u1 = (double)rand() / RAND_MAX;
-    double u2 = (double)rand() / RAND_MAX;
-    return magnitude * sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
-}
+// What a standby INS needs to carry on without waiting for a new GPS fix
+typedef struct {
+    INSState state;
+    Position gps_position;
+    bool gps_valid;
+    bool initialized;
+    uint64_t step_ns;            // last_update_ns of the step that wrote it
+    RngKey key;                  // Noise stream, continued where it left off
+    uint64_t sensor_draws;
+    uint64_t steps;
+} INSCheckpoint;
 
 static void send_status_update(INS* ins, bool operational) {
     Message msg = {0};
     msg.header.type = MSG_SYSTEM_STATUS;
     msg.header.sender = COMPONENT_INS;
     msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
+    msg.header.timestamp = sim_clock_time();
     msg.header.message_size = sizeof(SystemStatusMsg);
     msg.payload.system_status.component_active = operational;
     
@@ -54,9 +64,22 @@ static void send_status_update(INS* ins, bool operational) {
     }
 }
 
-INS* ins_init(Bus* bus) {
-    LOG_INFO(LOG_INS, "Starting initialization");
-    
+// Take up the config store's current snapshot, if it changed. Only the
+// rate and the sensor noise come from it; the alignment carries on.
+static void refresh_config(INS* ins) {
+    uint32_t version = config_store_version();
+    if (version == ins->config_version) return;
+
+    ConfigSnapshot snapshot;
+    if (!(version = config_store_read(&snapshot))) return;
+    ins->config_version = version;
+    ins->interval_ms = snapshot.ins_interval_ms;
+    ins->model->noise_params = snapshot.ins_noise;
+    LOG_INFO(LOG_INS, "Config %u applied, every %u ms", version, ins->interval_ms);
+}
+
+// Everything but the bus subscription
+static INS* ins_create(Bus* bus) {
     if (!bus) {
         LOG_ERROR(LOG_INS, "NULL bus in init");
         return NULL;
@@ -68,28 +91,52 @@ INS* ins_init(Bus* bus) {
         return NULL;
     }
 
+    // Noise seeded from the clock as by default; ins_set_seed() for
+    // repeatable runs
+    ins->model = ins_batch_create(1, (uint64_t)sim_clock_time());
+    if (!ins->model) {
+        LOG_ERROR(LOG_INS, "Failed to allocate sensor model");
+        free(ins);
+        return NULL;
+    }
+
     ins->bus = bus;
     memset(&ins->state, 0, sizeof(INSState));
     memset(&ins->sensors, 0, sizeof(INSSensorData));
     memset(&ins->current_state, 0, sizeof(FlightState));
+    flight_state_watch_init(&ins->state_watch, STATE_INTERVAL_MS);
     memset(&ins->gps_position, 0, sizeof(Position));
     ins->gps_valid = false;
-    clock_gettime(CLOCK_MONOTONIC, &ins->last_update);
+    ins->last_update_ns = sim_clock_ns();
     ins->last_status_update = 0;
-    ins->start_time = time(NULL);
+    ins->start_time = sim_clock_time();
     ins->initialized = false;
+    ins->interval_ms = INS_UPDATE_INTERVAL_MS;
+    ins->config_version = 0;
+    refresh_config(ins);
+    return ins;
+}
 
-    // Subscribe to messages
-    ErrorCode err;
-    if ((err = bus_subscribe(bus, COMPONENT_INS, MSG_STATE_RESPONSE)) != SUCCESS ||
-        (err = bus_subscribe(bus, COMPONENT_INS, MSG_POSITION_UPDATE)) != SUCCESS) {
+static ErrorCode ins_subscribe(INS* ins) {
+    // Only the newest GPS fix is used
+    ErrorCode err = bus_subscribe_qos(ins->bus, COMPONENT_INS, MSG_POSITION_UPDATE,
+                                      BUS_QOS_LATEST);
+    if (err != SUCCESS) {
         LOG_ERROR(LOG_INS, "Failed to subscribe to messages: %d", err);
-        free(ins);
-        return NULL;
     }
+    return err;
+}
+
+INS* ins_init(Bus* bus) {
+    LOG_INFO(LOG_INS, "Starting initialization");
+
+    INS* ins = ins_create(bus);
+    if (!ins) return NULL;
 
-    // Initialize random number generator for noise
-    srand(time(NULL));
+    if (ins_subscribe(ins) != SUCCESS) {
+        ins_cleanup(ins);
+        return NULL;
+    }
 
     LOG_INFO(LOG_INS, "Initialization complete, waiting for GPS fix");
     return ins;
@@ -98,130 +145,113 @@ INS* ins_init(Bus* bus) {
 void ins_cleanup(INS* ins) {
     if (!ins) return;
     LOG_INFO(LOG_INS, "Cleaning up");
+    ins_batch_destroy(ins->model);
     free(ins);
 }
 
-INSSensorData ins_simulate_sensors(const FlightState* flight_state) {
-    INSSensorData sensors = {0};
-    
-    if (!flight_state) {
-        LOG_WARN(LOG_INS, "NULL flight state in sensor simulation");
-        return sensors;
-    }
+static void write_checkpoint(const INS* ins) {
+    INSCheckpoint checkpoint = {
+        .state = ins->state,
+        .gps_position = ins->gps_position,
+        .gps_valid = ins->gps_valid,
+        .initialized = ins->initialized,
+        .step_ns = ins->last_update_ns,
+        .key = ins->model->key,
+        .sensor_draws = ins->model->sensor_draws,
+        .steps = ins->model->steps
+    };
+    standby_checkpoint(COMPONENT_INS, &checkpoint, sizeof(checkpoint));
+}
 
-    // Convert flight parameters to sensor readings
-    double pitch_rad = 0.0;  // Assume level flight for now
-    double roll_rad = 0.0;   // Assume no bank
-    double yaw_rad = DEG_TO_RAD(flight_state->heading);
-    
-    // Convert speed from knots to m/s
-    double speed_ms = flight_state->speed * KNOTS_TO_MS;
-    
-    // Calculate accelerations
-    double forward_accel = 0.0;  // Assume constant speed
-    double centripetal_accel = speed_ms * speed_ms / EARTH_RADIUS;  // Earth curvature
-    
-    // Convert vertical speed from feet/min to m/s
-    double vertical_speed_ms = flight_state->vertical_speed * 0.00508;
-    
-    // Transform accelerations to body frame
-    double cos_pitch = cos(pitch_rad);
-    double sin_pitch = sin(pitch_rad);
-    double cos_roll = cos(roll_rad);
-    double sin_roll = sin(roll_rad);
-    
-    // Simulate accelerometer readings with noise
-    sensors.accel_x = forward_accel * cos_pitch + 
-                     centripetal_accel * sin_pitch +
-                     generate_noise(ACCEL_NOISE);
-                     
-    sensors.accel_y = forward_accel * sin_roll * sin_pitch +
-                     centripetal_accel * sin_roll * cos_pitch +
-                     generate_noise(ACCEL_NOISE);
-                     
-    sensors.accel_z = -forward_accel * cos_roll * sin_pitch +
-                     centripetal_accel * cos_roll * cos_pitch +
-                     GRAVITY +
-                     generate_noise(ACCEL_NOISE);
-    
-    // Simulate gyroscope readings
-    sensors.gyro_x = generate_noise(GYRO_NOISE);  // Roll rate
-    sensors.gyro_y = generate_noise(GYRO_NOISE);  // Pitch rate
-    sensors.gyro_z = DEG_TO_RAD(flight_state->heading) +  // Yaw rate
-                    generate_noise(GYRO_NOISE);
-    
-    // Simulate magnetometer readings
-    sensors.mag_x = cos(yaw_rad) + generate_noise(MAG_NOISE);
-    sensors.mag_y = sin(yaw_rad) + generate_noise(MAG_NOISE);
-    sensors.mag_z = generate_noise(MAG_NOISE);
-
-    // Add vertical acceleration component
-    if (fabs(vertical_speed_ms) > 0.1) {
-        sensors.accel_z += vertical_speed_ms * 0.1 + generate_noise(ACCEL_NOISE);
+// Take over from the primary's last step. The time since then is
+// integrated on the next step like any other.
+static void restore_checkpoint(INS* ins) {
+    INSCheckpoint checkpoint;
+    if (!standby_restore(COMPONENT_INS, &checkpoint, sizeof(checkpoint))) {
+        LOG_WARN(LOG_INS, "No checkpoint to restore, waiting for GPS fix");
+        return;
     }
 
-    LOG_TRACE(LOG_INS, "Simulated sensors - Acc(x,y,z): %.2f,%.2f,%.2f Gyro(x,y,z): %.3f,%.3f,%.3f",
-              sensors.accel_x, sensors.accel_y, sensors.accel_z,
-              sensors.gyro_x, sensors.gyro_y, sensors.gyro_z);
+    ins->state = checkpoint.state;
+    ins->gps_position = checkpoint.gps_position;
+    ins->gps_valid = checkpoint.gps_valid;
+    ins->initialized = checkpoint.initialized;
+    ins->last_update_ns = checkpoint.step_ns;
+    ins->model->key = checkpoint.key;
+    ins->model->sensor_draws = checkpoint.sensor_draws;
+    ins->model->steps = checkpoint.steps;
+    ins_batch_set_state(ins->model, 0, &ins->state);
+    LOG_INFO(LOG_INS, "Restored checkpoint %.1f ms old",
+             (double)(sim_clock_ns() - checkpoint.step_ns) / 1e6);
+}
 
-    return sensors;
+void ins_set_seed(INS* ins, uint64_t seed) {
+    if (!ins) return;
+    ins->model->key = rng_key(seed);
+    ins->model->sensor_draws = 0;
+    ins->model->steps = 0;
 }
 
 static void process_sensors(INS* ins, double dt) {
     LOG_TRACE(LOG_INS, "Processing sensor data with dt=%f", dt);
 
-    // Update velocities based on accelerometer readings
-    ins->state.velocity_n += ins->sensors.accel_x * dt;
-    ins->state.velocity_e += ins->sensors.accel_y * dt;
-    ins->state.velocity_d += ins->sensors.accel_z * dt;
-
-    // Apply damping to prevent unbounded growth
-    const double damping = 0.99;
-    ins->state.velocity_n *= damping;
-    ins->state.velocity_e *= damping;
-    ins->state.velocity_d *= damping;
+    ins_batch_integrate(ins->model, dt, 1);
+    ins_batch_get_state(ins->model, 0, &ins->state);
 
     LOG_TRACE(LOG_INS, "Velocities (m/s) - N: %.2f, E: %.2f, D: %.2f",
               ins->state.velocity_n, ins->state.velocity_e, ins->state.velocity_d);
+    LOG_TRACE(LOG_INS, "Position - Lat: %.6f, Lon: %.6f, Alt: %.1f",
+              ins->state.position.latitude, ins->state.position.longitude,
+              ins->state.position.altitude);
+    LOG_TRACE(LOG_INS, "Error estimates - Pos: %.2f m, Att: %.3f rad",
+              ins->state.position_error, ins->state.attitude_error);
+}
 
-    // Update position
-    const double meters_per_degree_lat = 111111.0;
-    double meters_per_degree_lon = meters_per_degree_lat * 
-                                 cos(DEG_TO_RAD(ins->state.position.latitude));
-
-    double lat_change = (ins->state.velocity_n * dt) / meters_per_degree_lat;
-    double lon_change = (ins->state.velocity_e * dt) / meters_per_degree_lon;
-    double alt_change = -ins->state.velocity_d * dt;
-
-    ins->state.position.latitude += lat_change;
-    ins->state.position.longitude += lon_change;
-    ins->state.position.altitude += alt_change;
-
-    LOG_TRACE(LOG_INS, "Position updates - Lat: %.6f, Lon: %.6f, Alt: %.1f",
-              lat_change, lon_change, alt_change);
-
-    // Update attitude
-    ins->state.roll += ins->sensors.gyro_x * dt;
-    ins->state.pitch += ins->sensors.gyro_y * dt;
-    ins->state.yaw += ins->sensors.gyro_z * dt;
+static void handle_message(INS* ins, const Message* msg) {
+    LOG_DEBUG(LOG_INS, "Received message type %d from component %d",
+             msg->header.type, msg->header.sender);
 
-    // Normalize angles
-    ins->state.roll = fmod(ins->state.roll + PI, 2*PI) - PI;
-    ins->state.pitch = fmod(ins->state.pitch + PI, 2*PI) - PI;
-    ins->state.yaw = fmod(ins->state.yaw, 2*PI);
+    if (msg->header.type == MSG_POSITION_UPDATE && 
+        msg->header.sender == COMPONENT_GPS) {
+        // Got GPS position
+        ins->gps_position = msg->payload.position_update.position;
+        ins->gps_valid = true;
+        
+        if (!ins->initialized) {
+            // Initialize INS with GPS position
+            ins->state.position = ins->gps_position;
+            memset(&ins->state.gyro_bias, 0, sizeof(ins->state.gyro_bias));
+            memset(&ins->state.accel_bias, 0, sizeof(ins->state.accel_bias));
+            ins->state.position_error = 0;
+            ins->state.attitude_error = 0;
+            ins_batch_set_state(ins->model, 0, &ins->state);
+            ins->initialized = true;
+            LOG_INFO(LOG_INS, "Initialized with GPS position: %.6f, %.6f, %.1f",
+                    ins->gps_position.latitude,
+                    ins->gps_position.longitude,
+                    ins->gps_position.altitude);
+            send_status_update(ins, true);
+        }
+    }
+}
 
-    // Update sensor biases with random walk
-    for (int i = 0; i < 3; i++) {
-        ins->state.gyro_bias[i] += generate_noise(GYRO_BIAS_DRIFT * dt);
-        ins->state.accel_bias[i] += generate_noise(ACCEL_BIAS_DRIFT * dt);
+// Resimulate the sensors when the flight state has changed, at most every
+// STATE_INTERVAL_MS
+static void refresh_state(INS* ins) {
+    FlightStateSample sample;
+    if (!flight_state_watch_take(bus_state_snapshot(ins->bus), &ins->state_watch, &sample)) {
+        return;
     }
 
-    // Update error estimates
-    ins->state.position_error += 0.1 * dt;  // 0.1 meters per second drift
-    ins->state.attitude_error += 0.001 * dt;  // 0.001 radians per second drift
+    ins->current_state = sample.state.basic;
+    ins_batch_set_flight(ins->model, 0, &ins->current_state);
+    ins_batch_simulate_sensors(ins->model);
+    ins_batch_get_sensors(ins->model, 0, &ins->sensors);
 
-    LOG_TRACE(LOG_INS, "Error estimates - Pos: %.2f m, Att: %.3f rad",
-              ins->state.position_error, ins->state.attitude_error);
+    LOG_TRACE(LOG_INS, "Simulated sensors - Acc(x,y,z): %.2f,%.2f,%.2f Gyro(x,y,z): %.3f,%.3f,%.3f",
+              ins->sensors.accel_x, ins->sensors.accel_y, ins->sensors.accel_z,
+              ins->sensors.gyro_x, ins->sensors.gyro_y, ins->sensors.gyro_z);
+    LOG_DEBUG(LOG_INS, "Updated flight state and sensors");
 }
 
 void ins_process(INS* ins) {
@@ -230,54 +260,27 @@ void ins_process(INS* ins) {
         return;
     }
 
-    struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
-    double dt = (now.tv_sec - ins->last_update.tv_sec) +
-                (now.tv_nsec - ins->last_update.tv_nsec) / 1e9;
+    refresh_config(ins);
+
+    uint64_t now = sim_clock_ns();
+    double dt = (double)(now - ins->last_update_ns) / 1e9;
 
     // Send periodic status updates
-    time_t current_time = time(NULL);
+    time_t current_time = sim_clock_time();
     if (current_time - ins->last_status_update >= STATUS_UPDATE_INTERVAL_S) {
         send_status_update(ins, ins->initialized);
         ins->last_status_update = current_time;
     }
 
-    // Process incoming messages
-    Message msg;
-    while (bus_read_message(ins->bus, COMPONENT_INS, &msg)) {
-        LOG_DEBUG(LOG_INS, "Received message type %d from component %d",
-                 msg.header.type, msg.header.sender);
-
-        if (msg.header.type == MSG_POSITION_UPDATE && 
-            msg.header.sender == COMPONENT_GPS) {
-            // Got GPS position
-            ins->gps_position = msg.payload.position_update.position;
-            ins->gps_valid = true;
-            
-            if (!ins->initialized) {
-                // Initialize INS with GPS position
-                ins->state.position = ins->gps_position;
-                memset(&ins->state.gyro_bias, 0, sizeof(ins->state.gyro_bias));
-                memset(&ins->state.accel_bias, 0, sizeof(ins->state.accel_bias));
-                ins->state.position_error = 0;
-                ins->state.attitude_error = 0;
-                ins->initialized = true;
-                LOG_INFO(LOG_INS, "Initialized with GPS position: %.6f, %.6f, %.1f",
-                        ins->gps_position.latitude,
-                        ins->gps_position.longitude,
-                        ins->gps_position.altitude);
-                send_status_update(ins, true);
-            }
-        } else if (msg.header.type == MSG_STATE_RESPONSE) {
-            // Got flight state update
-            memcpy(&ins->current_state, &msg.payload.state_response.state, 
-                   sizeof(FlightState));
-            
-            // Update sensor readings
-            ins->sensors = ins_simulate_sensors(&ins->current_state);
-            LOG_DEBUG(LOG_INS, "Updated flight state and sensors");
+    // Process incoming messages a burst at a time
+    Message batch[MESSAGE_BATCH_SIZE];
+    int count;
+    while ((count = bus_read_batch(ins->bus, COMPONENT_INS, batch, MESSAGE_BATCH_SIZE)) > 0) {
+        for (int i = 0; i < count; i++) {
+            handle_message(ins, &batch[i]);
         }
     }
+    refresh_state(ins);
 
     // Check timeout for initialization
     if (!ins->initialized && 
@@ -292,15 +295,18 @@ void ins_process(INS* ins) {
         process_sensors(ins, dt);
         
         // Publish position update
-        Message pos_msg = {0};
-        pos_msg.header.type = MSG_POSITION_UPDATE;
-        pos_msg.header.sender = COMPONENT_INS;
-        pos_msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-        pos_msg.header.timestamp = current_time;
-        pos_msg.header.message_size = sizeof(PositionUpdateMsg);
-        pos_msg.payload.position_update.position = ins->state.position;
-        
-        if (bus_publish(ins->bus, &pos_msg) == SUCCESS) {
+        Message* pos_msg = bus_reserve(ins->bus, MSG_POSITION_UPDATE, sizeof(PositionUpdateMsg));
+        if (!pos_msg) {
+            LOG_ERROR(LOG_INS, "Failed to reserve position message");
+        } else {
+            pos_msg->header.sender = COMPONENT_INS;
+            pos_msg->header.receiver = COMPONENT_FLIGHT_CONTROLLER;
+            pos_msg->header.timestamp = current_time;
+            pos_msg->header.trace = trace_begin(COMPONENT_INS);
+            pos_msg->payload.position_update.position = ins->state.position;
+        }
+
+        if (pos_msg && bus_commit(ins->bus, pos_msg) == SUCCESS) {
             LOG_DEBUG(LOG_INS, "Published position: %.6f, %.6f, %.1f",
                      ins->state.position.latitude,
                      ins->state.position.longitude,
@@ -310,7 +316,32 @@ void ins_process(INS* ins) {
         }
     }
 
-    ins->last_update = now;
+    ins->last_update_ns = now;
+    write_checkpoint(ins);
+}
+
+static void run_loop(INS* ins) {
+    LOG_INFO(LOG_INS, "Entering main loop");
+    
+    ComponentPacer pacer;
+    component_pacer_init(&pacer, COMPONENT_INS, ins->interval_ms);
+    while (component_running()) {
+        uint64_t loop_start = metrics_loop_start();
+        ins_process(ins);
+        metrics_loop_end(COMPONENT_INS, loop_start, ins->interval_ms);
+        component_pacer_set_period(&pacer, ins->interval_ms);
+
+        // Handle GPS fixes as they arrive until just short of the next
+        // step, then sleep out the rest to the exact deadline
+        Message msg;
+        int remaining;
+        while ((remaining = component_pacer_remaining_ms(&pacer)) > 1) {
+            if (bus_wait_message(ins->bus, COMPONENT_INS, &msg, remaining - 1)) {
+                handle_message(ins, &msg);
+            }
+        }
+        component_pacer_wait(&pacer);
+    }
 }
 
 void ins_main(Bus* bus) {
@@ -322,12 +353,40 @@ void ins_main(Bus* bus) {
         return;
     }
 
-    LOG_INFO(LOG_INS, "Entering main loop");
-    
-    while (1) {
-        ins_process(ins);
-        usleep(INS_UPDATE_INTERVAL_MS * 1000);
+    run_loop(ins);
+    ins_cleanup(ins);
+}
+
+void ins_standby_main(Bus* bus) {
+    LOG_INFO(LOG_INS, "Starting as standby");
+
+    INS* ins = ins_create(bus);
+    if (!ins) {
+        LOG_ERROR(LOG_INS, "Failed to initialize standby");
+        return;
+    }
+
+    // Stay off the bus until the primary is gone; its queue and
+    // subscription carry over
+    if (!standby_wait_promotion(COMPONENT_INS)) {
+        LOG_ERROR(LOG_INS, "Standby was not armed");
+        ins_cleanup(ins);
+        return;
+    }
+
+    LOG_INFO(LOG_INS, "Promoted from standby");
+    restore_checkpoint(ins);
+    ins->start_time = sim_clock_time();
+    if (ins_subscribe(ins) != SUCCESS) {
+        ins_cleanup(ins);
+        return;
+    }
+    if (ins->initialized) {
+        // Readiness report, as after the first fix
+        send_status_update(ins, true);
+        ins->last_status_update = ins->start_time;
     }
 
+    run_loop(ins);
     ins_cleanup(ins);
 }
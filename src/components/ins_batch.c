@@ -0,0 +1,280 @@
+#include "ins_batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Default sensor noise parameters
+#define ACCEL_NOISE 0.05         // m/s^2
+#define GYRO_NOISE 0.001         // rad/s
+#define MAG_NOISE 0.01           // normalized
+#define ACCEL_BIAS_DRIFT 0.0001  // m/s^2 per second
+#define GYRO_BIAS_DRIFT 0.0001   // rad/s per second
+
+#define VELOCITY_DAMPING 0.99    // Per step, keeps the integration bounded
+#define METERS_PER_DEGREE_LAT 111111.0
+
+// Arrays start on a cache line and are padded to whole lines, so any lane
+// loop can use full-width aligned vectors
+#define ARRAY_ALIGN 64
+#define LANES_PER_LINE (ARRAY_ALIGN / sizeof(double))
+
+#define FLIGHT_ARRAYS 3
+#define SENSOR_ARRAYS 9
+#define STATE_ARRAYS 17
+
+// Normal draws per lane for one sensor simulation and one step
+#define SENSOR_NOISE_ROWS 10
+#define STEP_NOISE_ROWS 6
+#define NOISE_ROWS SENSOR_NOISE_ROWS
+
+// First counter word: which kind of draw, and which pair of rows
+#define SENSOR_STREAM 0x00000000u
+#define STEP_STREAM 0x80000000u
+
+static size_t lane_stride(size_t count) {
+    return (count + LANES_PER_LINE - 1) / LANES_PER_LINE * LANES_PER_LINE;
+}
+
+INSNoiseParams ins_batch_default_noise(void) {
+    INSNoiseParams params = {
+        .accel = ACCEL_NOISE,
+        .gyro = GYRO_NOISE,
+        .mag = MAG_NOISE,
+        .accel_bias_drift = ACCEL_BIAS_DRIFT,
+        .gyro_bias_drift = GYRO_BIAS_DRIFT
+    };
+    return params;
+}
+
+INSBatch* ins_batch_create(size_t count, uint64_t seed) {
+    if (count == 0) return NULL;
+
+    INSBatch* batch = calloc(1, sizeof(INSBatch));
+    if (!batch) return NULL;
+
+    size_t stride = lane_stride(count);
+    size_t rows = FLIGHT_ARRAYS + SENSOR_ARRAYS + STATE_ARRAYS + NOISE_ROWS;
+    size_t bytes = rows * stride * sizeof(double);
+    batch->storage = aligned_alloc(ARRAY_ALIGN, bytes);
+    if (!batch->storage) {
+        free(batch);
+        return NULL;
+    }
+    memset(batch->storage, 0, bytes);
+
+    double** arrays[FLIGHT_ARRAYS + SENSOR_ARRAYS + STATE_ARRAYS] = {
+        &batch->flight.heading, &batch->flight.speed, &batch->flight.vertical_speed,
+        &batch->sensors.accel_x, &batch->sensors.accel_y, &batch->sensors.accel_z,
+        &batch->sensors.gyro_x, &batch->sensors.gyro_y, &batch->sensors.gyro_z,
+        &batch->sensors.mag_x, &batch->sensors.mag_y, &batch->sensors.mag_z,
+        &batch->state.latitude, &batch->state.longitude, &batch->state.altitude,
+        &batch->state.roll, &batch->state.pitch, &batch->state.yaw,
+        &batch->state.velocity_n, &batch->state.velocity_e, &batch->state.velocity_d,
+        &batch->state.gyro_bias[0], &batch->state.gyro_bias[1], &batch->state.gyro_bias[2],
+        &batch->state.accel_bias[0], &batch->state.accel_bias[1], &batch->state.accel_bias[2],
+        &batch->state.position_error, &batch->state.attitude_error
+    };
+    double* next = batch->storage;
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        *arrays[i] = next;
+        next += stride;
+    }
+    batch->noise = next;
+
+    batch->count = count;
+    batch->key = rng_key(seed);
+    batch->noise_params = ins_batch_default_noise();
+    return batch;
+}
+
+void ins_batch_destroy(INSBatch* batch) {
+    if (!batch) return;
+    free(batch->storage);
+    free(batch);
+}
+
+void ins_batch_set_flight(INSBatch* batch, size_t lane, const FlightState* flight_state) {
+    if (!batch || lane >= batch->count || !flight_state) return;
+    batch->flight.heading[lane] = flight_state->heading;
+    batch->flight.speed[lane] = flight_state->speed;
+    batch->flight.vertical_speed[lane] = flight_state->vertical_speed;
+}
+
+void ins_batch_set_state(INSBatch* batch, size_t lane, const INSState* state) {
+    if (!batch || lane >= batch->count || !state) return;
+    INSStateBatch* s = &batch->state;
+    s->latitude[lane] = state->position.latitude;
+    s->longitude[lane] = state->position.longitude;
+    s->altitude[lane] = state->position.altitude;
+    s->roll[lane] = state->roll;
+    s->pitch[lane] = state->pitch;
+    s->yaw[lane] = state->yaw;
+    s->velocity_n[lane] = state->velocity_n;
+    s->velocity_e[lane] = state->velocity_e;
+    s->velocity_d[lane] = state->velocity_d;
+    for (int i = 0; i < 3; i++) {
+        s->gyro_bias[i][lane] = state->gyro_bias[i];
+        s->accel_bias[i][lane] = state->accel_bias[i];
+    }
+    s->position_error[lane] = state->position_error;
+    s->attitude_error[lane] = state->attitude_error;
+}
+
+void ins_batch_get_state(const INSBatch* batch, size_t lane, INSState* state) {
+    if (!batch || lane >= batch->count || !state) return;
+    const INSStateBatch* s = &batch->state;
+    state->position.latitude = s->latitude[lane];
+    state->position.longitude = s->longitude[lane];
+    state->position.altitude = s->altitude[lane];
+    state->roll = s->roll[lane];
+    state->pitch = s->pitch[lane];
+    state->yaw = s->yaw[lane];
+    state->velocity_n = s->velocity_n[lane];
+    state->velocity_e = s->velocity_e[lane];
+    state->velocity_d = s->velocity_d[lane];
+    for (int i = 0; i < 3; i++) {
+        state->gyro_bias[i] = s->gyro_bias[i][lane];
+        state->accel_bias[i] = s->accel_bias[i][lane];
+    }
+    state->position_error = s->position_error[lane];
+    state->attitude_error = s->attitude_error[lane];
+}
+
+void ins_batch_get_sensors(const INSBatch* batch, size_t lane, INSSensorData* sensors) {
+    if (!batch || lane >= batch->count || !sensors) return;
+    const INSSensorBatch* s = &batch->sensors;
+    sensors->accel_x = s->accel_x[lane];
+    sensors->accel_y = s->accel_y[lane];
+    sensors->accel_z = s->accel_z[lane];
+    sensors->gyro_x = s->gyro_x[lane];
+    sensors->gyro_y = s->gyro_y[lane];
+    sensors->gyro_z = s->gyro_z[lane];
+    sensors->mag_x = s->mag_x[lane];
+    sensors->mag_y = s->mag_y[lane];
+    sensors->mag_z = s->mag_z[lane];
+}
+
+// Fill the first rows of the scratch with standard normal draws for this
+// stream and counter, two rows per generator call. The integer generator
+// and the transcendental Box-Muller run as separate passes so the first
+// vectorizes whatever libm does.
+static void fill_noise(INSBatch* batch, uint32_t stream, uint64_t counter, int rows) {
+    size_t stride = lane_stride(batch->count);
+    RngKey key = batch->key;
+    uint32_t counter_lo = (uint32_t)counter;
+    uint32_t counter_hi = (uint32_t)(counter >> 32);
+
+    for (int row = 0; row < rows; row += 2) {
+        double* restrict z0 = batch->noise + (size_t)row * stride;
+        double* restrict z1 = z0 + stride;
+        uint32_t word = stream | (uint32_t)(row / 2);
+        size_t count = batch->count;
+
+        for (size_t lane = 0; lane < count; lane++) {
+            RngBlock ctr = { word, counter_lo, counter_hi, (uint32_t)lane };
+            rng_uniform2(key, ctr, &z0[lane], &z1[lane]);
+        }
+        for (size_t lane = 0; lane < count; lane++) {
+            rng_box_muller(z0[lane], z1[lane], &z0[lane], &z1[lane]);
+        }
+    }
+}
+
+void ins_batch_simulate_sensors(INSBatch* batch) {
+    if (!batch) return;
+    fill_noise(batch, SENSOR_STREAM, batch->sensor_draws++, SENSOR_NOISE_ROWS);
+
+    size_t stride = lane_stride(batch->count);
+    const double* noise[SENSOR_NOISE_ROWS];
+    for (int row = 0; row < SENSOR_NOISE_ROWS; row++) {
+        noise[row] = batch->noise + (size_t)row * stride;
+    }
+
+    const double* restrict heading = batch->flight.heading;
+    const double* restrict speed = batch->flight.speed;
+    const double* restrict vertical_speed = batch->flight.vertical_speed;
+    INSSensorBatch s = batch->sensors;
+    const double accel_noise = batch->noise_params.accel;
+    const double gyro_noise = batch->noise_params.gyro;
+    const double mag_noise = batch->noise_params.mag;
+
+    // Level flight without bank at constant speed
+    const double sin_pitch = 0.0, cos_pitch = 1.0;
+    const double sin_roll = 0.0, cos_roll = 1.0;
+    const double forward_accel = 0.0;
+
+    for (size_t i = 0; i < batch->count; i++) {
+        double yaw_rad = DEG_TO_RAD(heading[i]);
+        double speed_ms = speed[i] * KNOTS_TO_MS;
+        double centripetal_accel = speed_ms * speed_ms / EARTH_RADIUS;  // Earth curvature
+        double vertical_speed_ms = vertical_speed[i] * 0.00508;        // feet/min to m/s
+
+        s.accel_x[i] = forward_accel * cos_pitch + centripetal_accel * sin_pitch +
+                       accel_noise * noise[0][i];
+        s.accel_y[i] = forward_accel * sin_roll * sin_pitch +
+                       centripetal_accel * sin_roll * cos_pitch +
+                       accel_noise * noise[1][i];
+        s.accel_z[i] = -forward_accel * cos_roll * sin_pitch +
+                       centripetal_accel * cos_roll * cos_pitch + GRAVITY +
+                       accel_noise * noise[2][i];
+
+        // Vertical acceleration component while climbing or descending
+        double climbing = fabs(vertical_speed_ms) > 0.1 ? 1.0 : 0.0;
+        s.accel_z[i] += climbing * (vertical_speed_ms * 0.1 + accel_noise * noise[9][i]);
+
+        s.gyro_x[i] = gyro_noise * noise[3][i];           // Roll rate
+        s.gyro_y[i] = gyro_noise * noise[4][i];           // Pitch rate
+        s.gyro_z[i] = yaw_rad + gyro_noise * noise[5][i]; // Yaw rate
+
+        s.mag_x[i] = cos(yaw_rad) + mag_noise * noise[6][i];
+        s.mag_y[i] = sin(yaw_rad) + mag_noise * noise[7][i];
+        s.mag_z[i] = mag_noise * noise[8][i];
+    }
+}
+
+void ins_batch_integrate(INSBatch* batch, double dt, int steps) {
+    if (!batch) return;
+
+    size_t stride = lane_stride(batch->count);
+    const double* noise[STEP_NOISE_ROWS];
+    for (int row = 0; row < STEP_NOISE_ROWS; row++) {
+        noise[row] = batch->noise + (size_t)row * stride;
+    }
+
+    const INSSensorBatch in = batch->sensors;
+    INSStateBatch s = batch->state;
+    const double accel_drift = batch->noise_params.accel_bias_drift;
+    const double gyro_drift = batch->noise_params.gyro_bias_drift;
+
+    for (int step = 0; step < steps; step++) {
+        fill_noise(batch, STEP_STREAM, batch->steps++, STEP_NOISE_ROWS);
+
+        for (size_t i = 0; i < batch->count; i++) {
+            // Velocities from the accelerometers, damped
+            s.velocity_n[i] = (s.velocity_n[i] + in.accel_x[i] * dt) * VELOCITY_DAMPING;
+            s.velocity_e[i] = (s.velocity_e[i] + in.accel_y[i] * dt) * VELOCITY_DAMPING;
+            s.velocity_d[i] = (s.velocity_d[i] + in.accel_z[i] * dt) * VELOCITY_DAMPING;
+
+            // Position
+            double meters_per_degree_lon = METERS_PER_DEGREE_LAT *
+                                           cos(DEG_TO_RAD(s.latitude[i]));
+            s.latitude[i] += s.velocity_n[i] * dt / METERS_PER_DEGREE_LAT;
+            s.longitude[i] += s.velocity_e[i] * dt / meters_per_degree_lon;
+            s.altitude[i] -= s.velocity_d[i] * dt;
+
+            // Attitude, normalized
+            s.roll[i] = fmod(s.roll[i] + in.gyro_x[i] * dt + PI, 2 * PI) - PI;
+            s.pitch[i] = fmod(s.pitch[i] + in.gyro_y[i] * dt + PI, 2 * PI) - PI;
+            s.yaw[i] = fmod(s.yaw[i] + in.gyro_z[i] * dt, 2 * PI);
+
+            // Sensor biases as a random walk
+            for (int axis = 0; axis < 3; axis++) {
+                s.gyro_bias[axis][i] += gyro_drift * dt * noise[axis][i];
+                s.accel_bias[axis][i] += accel_drift * dt * noise[3 + axis][i];
+            }
+
+            // Error estimates: 0.1 m and 0.001 rad of drift per second
+            s.position_error[i] += 0.1 * dt;
+            s.attitude_error[i] += 0.001 * dt;
+        }
+    }
+}
@@ -1,65 +1,50 @@
 #include "landing_radio.h"
+#include "component.h"
 #include "log.h"
+#include "metrics.h"
+#include "sensor_feed.h"
+#include "sim_clock.h"
+#include "trace.h"
+#include "wire_protocol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <fcntl.h>
-#include <errno.h>
 #include <time.h>
 #include <math.h>
 
-#define BUFFER_SIZE 1024
-#define UPDATE_INTERVAL_MS 100  // 10 Hz update rate
-#define CONNECT_RETRY_INTERVAL_MS 1000
+#define POSITION_BATCH_SIZE 32
+#define STATUS_UPDATE_INTERVAL_S 1
+#define PROCESS_BUDGET_MS 10  // Step period under the scheduler
 #define PI 3.14159265358979323846
 #define DEG_TO_RAD(x) ((x) * PI / 180.0)
 
+// Positions decoded in one wakeup, published together
+typedef struct {
+    Message messages[POSITION_BATCH_SIZE];
+    int count;
+} PositionBatch;
+
 struct LandingRadio {
     Bus* bus;
-    int socket_fd;
-    struct sockaddr_in server_addr;
+    GroundLinks* links;
+    bool owns_links;  // Created by init and run by landing_radio_process()
+    GroundLink* link;
     bool connected;
     ILSData last_ils_data;
     time_t last_status_update;
+    PositionBatch batch;
+    SensorFeed* feed;  // In-process sender, NULL to use the network
 };
 
-// Initialize socket connection
-static bool init_socket(LandingRadio* radio) {
-    LOG_INFO(LOG_LANDING, "Initializing socket");
-    
-    radio->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (radio->socket_fd < 0) {
-        LOG_ERROR(LOG_LANDING, "Failed to create socket: %s", strerror(errno));
-        return false;
-    }
-
-    // Set socket to non-blocking
-    int flags = fcntl(radio->socket_fd, F_GETFL, 0);
-    fcntl(radio->socket_fd, F_SETFL, flags | O_NONBLOCK);
+static bool on_record(const WireMessage* record, void* context);
+static void on_flush(void* context);
+static void on_link_state(bool connected, void* context);
 
-    // Setup server address
-    memset(&radio->server_addr, 0, sizeof(radio->server_addr));
-    radio->server_addr.sin_family = AF_INET;
-    radio->server_addr.sin_port = htons(LANDING_RADIO_PORT);
-
-    struct hostent* server = gethostbyname(LANDING_RADIO_HOST);
-    if (server == NULL) {
-        LOG_ERROR(LOG_LANDING, "Failed to resolve hostname");
-        close(radio->socket_fd);
-        return false;
-    }
-    memcpy(&radio->server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-
-    LOG_INFO(LOG_LANDING, "Socket initialized");
-    return true;
+LandingRadio* landing_radio_init(Bus* bus) {
+    return landing_radio_init_with_links(bus, NULL);
 }
 
-LandingRadio* landing_radio_init(Bus* bus) {
+LandingRadio* landing_radio_init_with_links(Bus* bus, GroundLinks* links) {
     LOG_INFO(LOG_LANDING, "Starting initialization");
     
     if (!bus) {
@@ -76,10 +61,24 @@ LandingRadio* landing_radio_init(Bus* bus) {
     radio->bus = bus;
     radio->connected = false;
     radio->last_status_update = 0;
+    radio->batch.count = 0;
+    radio->feed = NULL;
     memset(&radio->last_ils_data, 0, sizeof(ILSData));
 
-    if (!init_socket(radio)) {
-        LOG_ERROR(LOG_LANDING, "Socket initialization failed");
+    radio->owns_links = links == NULL;
+    radio->links = links ? links : ground_links_create();
+    GroundLinkHandlers handlers = {
+        .on_record = on_record,
+        .on_flush = on_flush,
+        .on_state = on_link_state,
+        .context = radio
+    };
+    radio->link = radio->links ? ground_links_add(radio->links, LANDING_RADIO_HOST,
+                                                  LANDING_RADIO_PORT, COMPONENT_LANDING_RADIO,
+                                                  LOG_LANDING, &handlers) : NULL;
+    if (!radio->link) {
+        LOG_ERROR(LOG_LANDING, "Link initialization failed");
+        if (radio->owns_links) ground_links_destroy(radio->links);
         free(radio);
         return NULL;
     }
@@ -92,8 +91,10 @@ void landing_radio_cleanup(LandingRadio* radio) {
     if (!radio) return;
     
     LOG_INFO(LOG_LANDING, "Cleaning up");
-    if (radio->socket_fd >= 0) {
-        close(radio->socket_fd);
+    if (radio->owns_links) {
+        ground_links_destroy(radio->links);
+    } else {
+        ground_links_remove(radio->links, radio->link);
     }
     free(radio);
 }
@@ -103,7 +104,7 @@ static void send_status_update(LandingRadio* radio, bool connected) {
     msg.header.type = MSG_SYSTEM_STATUS;
     msg.header.sender = COMPONENT_LANDING_RADIO;
     msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
+    msg.header.timestamp = sim_clock_time();
     msg.header.message_size = sizeof(SystemStatusMsg);
     msg.payload.system_status.component_active = connected;
     
@@ -115,48 +116,33 @@ static void send_status_update(LandingRadio* radio, bool connected) {
     }
 }
 
-static void publish_position(LandingRadio* radio, const Position* pos) {
-    Message msg = {0};
-    msg.header.type = MSG_POSITION_UPDATE;
-    msg.header.sender = COMPONENT_LANDING_RADIO;
-    msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
-    msg.header.message_size = sizeof(PositionUpdateMsg);
-    msg.payload.position_update.position = *pos;
+static void flush_positions(LandingRadio* radio, PositionBatch* batch) {
+    if (batch->count == 0) return;
 
-    if (bus_publish(radio->bus, &msg) == SUCCESS) {
-        LOG_DEBUG(LOG_LANDING, "Published position: %.6f, %.6f, %.1f",
-                pos->latitude, pos->longitude, pos->altitude);
+    if (bus_publish_batch(radio->bus, batch->messages, batch->count) == SUCCESS) {
+        const Position* last = &batch->messages[batch->count - 1].payload.position_update.position;
+        LOG_DEBUG(LOG_LANDING, "Published %d positions, last: %.6f, %.6f, %.1f", batch->count,
+                last->latitude, last->longitude, last->altitude);
     } else {
         LOG_ERROR(LOG_LANDING, "Failed to publish position");
     }
+    batch->count = 0;
 }
 
-static bool try_connect(LandingRadio* radio) {
-    if (radio->connected) return true;
-
-    LOG_INFO(LOG_LANDING, "Attempting to connect to %s:%d", 
-            LANDING_RADIO_HOST, LANDING_RADIO_PORT);
-            
-    int result = connect(radio->socket_fd, 
-                        (struct sockaddr*)&radio->server_addr, 
-                        sizeof(radio->server_addr));
-
-    if (result == 0 || (result < 0 && errno == EISCONN)) {
-        radio->connected = true;
-        LOG_INFO(LOG_LANDING, "Connected to sender");
-        send_status_update(radio, true);
-        return true;
+static void queue_position(LandingRadio* radio, PositionBatch* batch, const Position* pos) {
+    Message* msg = &batch->messages[batch->count++];
+    memset(&msg->header, 0, sizeof(msg->header));
+    msg->header.type = MSG_POSITION_UPDATE;
+    msg->header.sender = COMPONENT_LANDING_RADIO;
+    msg->header.receiver = COMPONENT_FLIGHT_CONTROLLER;
+    msg->header.timestamp = sim_clock_time();
+    msg->header.message_size = sizeof(PositionUpdateMsg);
+    msg->header.trace = trace_begin(COMPONENT_LANDING_RADIO);
+    msg->payload.position_update.position = *pos;
+
+    if (batch->count == POSITION_BATCH_SIZE) {
+        flush_positions(radio, batch);
     }
-
-    if (result < 0 && (errno != EINPROGRESS && errno != EALREADY && 
-                       errno != EWOULDBLOCK)) {
-        LOG_ERROR(LOG_LANDING, "Connect error: %s", strerror(errno));
-        close(radio->socket_fd);
-        init_socket(radio);
-    }
-
-    return false;
 }
 
 static bool parse_ils_data(const char* buffer, ILSData* ils) {
@@ -226,6 +212,84 @@ Position ils_deviations_to_position(const ILSData* ils, const Position* runway_t
     return pos;
 }
 
+static bool decode_record(const WireMessage* record, ILSData* ils) {
+    switch (record->type) {
+        case WIRE_ILS_DATA:
+            ils->localizer = record->data.ils.localizer;
+            ils->glideslope = record->data.ils.glideslope;
+            ils->distance = record->data.ils.distance;
+            ils->localizer_valid = record->data.ils.localizer_valid;
+            ils->glideslope_valid = record->data.ils.glideslope_valid;
+            ils->marker_beacon = record->data.ils.marker_beacon;
+            return true;
+
+        case WIRE_CSV_LINE:
+            return parse_ils_data(record->data.line, ils);
+
+        default:
+            LOG_WARN(LOG_LANDING, "Unexpected record type %d", record->type);
+            return false;
+    }
+}
+
+// Publish a position for every record from the sender
+static bool on_record(const WireMessage* record, void* context) {
+    LandingRadio* radio = context;
+
+    if (decode_record(record, &radio->last_ils_data)) {
+        // Convert ILS data to position update
+        Position pos = ils_deviations_to_position(&radio->last_ils_data, 
+                                                &RUNWAY_THRESHOLD);
+        queue_position(radio, &radio->batch, &pos);
+    } else {
+        metrics_count(METRIC_LINK_PARSE_FAILURES, COMPONENT_LANDING_RADIO, 1);
+    }
+    return true;
+}
+
+static void on_flush(void* context) {
+    LandingRadio* radio = context;
+    flush_positions(radio, &radio->batch);
+}
+
+static void on_link_state(bool connected, void* context) {
+    LandingRadio* radio = context;
+
+    if (connected) {
+        radio->connected = true;
+        LOG_INFO(LOG_LANDING, "Connected to sender");
+        send_status_update(radio, true);
+    } else if (radio->connected) {
+        radio->connected = false;
+        send_status_update(radio, false);
+    }
+}
+
+// Publish a position for every record the in-process sender has due
+static void process_feed(LandingRadio* radio) {
+    PositionBatch batch = { .count = 0 };
+    WireMessage record;
+
+    while (sensor_feed_next(radio->feed, &record)) {
+        if (decode_record(&record, &radio->last_ils_data)) {
+            Position pos = ils_deviations_to_position(&radio->last_ils_data,
+                                                    &RUNWAY_THRESHOLD);
+            queue_position(radio, &batch, &pos);
+        }
+    }
+
+    flush_positions(radio, &batch);
+}
+
+void landing_radio_set_feed(LandingRadio* radio, SensorFeed* feed) {
+    if (!radio) return;
+
+    radio->feed = feed;
+    radio->connected = feed != NULL;
+    ground_link_set_enabled(radio->link, feed == NULL);
+    LOG_INFO(LOG_LANDING, "Reading from %s", feed ? "in-process feed" : "network");
+}
+
 void landing_radio_process(LandingRadio* radio) {
     if (!radio) {
         LOG_ERROR(LOG_LANDING, "NULL radio in process");
@@ -233,46 +297,33 @@ void landing_radio_process(LandingRadio* radio) {
     }
 
     // Send periodic status updates
-    time_t now = time(NULL);
-    if (now - radio->last_status_update >= 1) {
+    time_t now = sim_clock_time();
+    if (now - radio->last_status_update >= STATUS_UPDATE_INTERVAL_S) {
         send_status_update(radio, radio->connected);
         radio->last_status_update = now;
     }
 
-    // Try to connect if not connected
-    if (!radio->connected) {
-        if (!try_connect(radio)) {
-            usleep(CONNECT_RETRY_INTERVAL_MS * 1000);
-            return;
-        }
+    if (radio->feed) {
+        process_feed(radio);
+        return;
     }
 
-    // Read data from socket
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_read = recv(radio->socket_fd, buffer, sizeof(buffer) - 1, 0);
-
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
-        
-        if (parse_ils_data(buffer, &radio->last_ils_data)) {
-            // Convert ILS data to position update
-            Position pos = ils_deviations_to_position(&radio->last_ils_data, 
-                                                    &RUNWAY_THRESHOLD);
-            publish_position(radio, &pos);
-        }
-    } else if (bytes_read == 0 || (bytes_read < 0 && errno != EWOULDBLOCK)) {
-        // Connection closed or error
-        LOG_ERROR(LOG_LANDING, "Connection lost: %s", 
-                bytes_read == 0 ? "Closed by peer" : strerror(errno));
-        close(radio->socket_fd);
-        if (radio->connected) {
-            radio->connected = false;
-            send_status_update(radio, false);
-        }
-        init_socket(radio);
+    // A shared reactor is run by its owner
+    if (radio->owns_links) {
+        ground_links_run(radio->links, 0);
     }
 }
 
+// Sleep until the sender has data for us, a status update is due or it is
+// time to retry the connection
+static void wait_for_data(LandingRadio* radio) {
+    int64_t elapsed_ms = (sim_clock_time() - radio->last_status_update) * 1000;
+    int timeout_ms = STATUS_UPDATE_INTERVAL_S * 1000 - (int)elapsed_ms;
+    if (timeout_ms <= 0) return;
+
+    ground_links_run(radio->links, timeout_ms);
+}
+
 void landing_radio_main(Bus* bus) {
     LOG_INFO(LOG_LANDING, "Starting main function");
     
@@ -284,9 +335,11 @@ void landing_radio_main(Bus* bus) {
 
     LOG_INFO(LOG_LANDING, "Entering main loop");
     
-    while (1) {
+    while (component_running()) {
+        uint64_t loop_start = metrics_loop_start();
         landing_radio_process(radio);
-        usleep(UPDATE_INTERVAL_MS * 1000);
+        metrics_loop_end(COMPONENT_LANDING_RADIO, loop_start, PROCESS_BUDGET_MS);
+        wait_for_data(radio);
     }
 
     landing_radio_cleanup(radio);
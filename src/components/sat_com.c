@@ -1,72 +1,44 @@
 #include "sat_com.h"
+#include "component.h"
 #include "log.h"
+#include "metrics.h"
+#include "sensor_feed.h"
+#include "sim_clock.h"
+#include "wire_protocol.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
-#include <fcntl.h>
+#include <poll.h>
 #include <errno.h>
 #include <time.h>
 
-#define BUFFER_SIZE 1024
 #define SATCOM_UPDATE_INTERVAL_MS 1000
 #define STATUS_UPDATE_INTERVAL_S 1
+#define STATE_INTERVAL_MS 1000    // Flight state changes taken at most this often
 
 
 struct SatCom {
     Bus* bus;
-    int socket_fd;
-    struct sockaddr_in server_addr;
+    GroundLinks* links;
+    bool owns_links;  // Created by init and run by sat_com_process()
+    GroundLink* link;
     bool connected;
     SatelliteMessage last_message;
     FlightState current_state;
+    FlightStateWatch state_watch;
+    SensorFeed* feed;  // In-process ground station, NULL to use the network
 };
 
 // Forward declarations of static functions
-static bool init_socket(SatCom* sat);
 static void send_status_update(SatCom* sat, bool connected);
-static bool try_connect(SatCom* sat);
 static bool parse_sat_message(const char* buffer, SatelliteMessage* msg);
 
-// Initialize socket connection
-static bool init_socket(SatCom* sat) {
-    LOG_INFO(LOG_SATCOM, "Initializing socket");
-    
-    sat->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sat->socket_fd < 0) {
-        LOG_ERROR(LOG_SATCOM, "Failed to create socket: %s", strerror(errno));
-        return false;
-    }
-
-    // Set socket to non-blocking
-    int flags = fcntl(sat->socket_fd, F_GETFL, 0);
-    fcntl(sat->socket_fd, F_SETFL, flags | O_NONBLOCK);
-
-    // Setup server address
-    memset(&sat->server_addr, 0, sizeof(sat->server_addr));
-    sat->server_addr.sin_family = AF_INET;
-    sat->server_addr.sin_port = htons(SATCOM_PORT);
-
-    struct hostent* server = gethostbyname(SATCOM_HOST);
-    if (server == NULL) {
-        LOG_ERROR(LOG_SATCOM, "Failed to resolve hostname");
-        return false;
-    }
-    
-    memcpy(&sat->server_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    return true;
-}
-
 static void send_status_update(SatCom* sat, bool connected) {
     Message msg = {0};
     msg.header.type = MSG_SYSTEM_STATUS;
     msg.header.sender = COMPONENT_SAT_COM;
     msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
+    msg.header.timestamp = sim_clock_time();
     msg.header.message_size = sizeof(SystemStatusMsg);
     msg.payload.system_status.component_active = connected;
     
@@ -77,32 +49,6 @@ static void send_status_update(SatCom* sat, bool connected) {
     }
 }
 
-static bool try_connect(SatCom* sat) {
-    if (sat->connected) return true;
-
-    LOG_INFO(LOG_SATCOM, "Attempting to connect to %s:%d", SATCOM_HOST, SATCOM_PORT);
-    
-    int result = connect(sat->socket_fd, 
-                        (struct sockaddr*)&sat->server_addr, 
-                        sizeof(sat->server_addr));
-
-    if (result == 0 || (result < 0 && errno == EISCONN)) {
-        sat->connected = true;
-        LOG_INFO(LOG_SATCOM, "Connected to ground station");
-        send_status_update(sat, true);
-        return true;
-    }
-    
-    if (result < 0 && (errno != EINPROGRESS && errno != EALREADY && 
-                       errno != EWOULDBLOCK)) {
-        LOG_ERROR(LOG_SATCOM, "Connect error: %s", strerror(errno));
-        close(sat->socket_fd);
-        init_socket(sat);
-    }
-
-    return false;
-}
-
 // Parse satellite message from sender
 static bool parse_sat_message(const char* buffer, SatelliteMessage* msg) {
     char type_str[32];
@@ -150,7 +96,75 @@ static bool parse_sat_message(const char* buffer, SatelliteMessage* msg) {
     return false;
 }
 
+static bool decode_record(const WireMessage* record, SatelliteMessage* msg) {
+    switch (record->type) {
+        case WIRE_SAT_WAYPOINT: {
+            Waypoint* wp = &msg->data.waypoint;
+            msg->type = SAT_MSG_WAYPOINT;
+            wp->position.latitude = record->data.waypoint.latitude;
+            wp->position.longitude = record->data.waypoint.longitude;
+            wp->position.altitude = record->data.waypoint.altitude;
+            wp->speed = record->data.waypoint.speed;
+            wp->heading = record->data.waypoint.heading;
+            wp->eta = record->data.waypoint.eta;
+            wp->is_final = record->data.waypoint.is_final;
+            return true;
+        }
+
+        case WIRE_SAT_WEATHER:
+            msg->type = SAT_MSG_WEATHER;
+            msg->data.weather.wind_speed = record->data.weather.wind_speed;
+            msg->data.weather.wind_direction = record->data.weather.wind_direction;
+            msg->data.weather.turbulence = record->data.weather.turbulence;
+            msg->data.weather.temperature = record->data.weather.temperature;
+            return true;
+
+        case WIRE_SAT_EMERGENCY:
+            msg->type = SAT_MSG_EMERGENCY;
+            msg->data.emergency = (EmergencyCommand)record->data.emergency;
+            return true;
+
+        case WIRE_CSV_LINE:
+            return parse_sat_message(record->data.line, msg);
+
+        default:
+            LOG_WARN(LOG_SATCOM, "Unexpected record type %d", record->type);
+            return false;
+    }
+}
+
+// A record from the ground station
+static bool on_record(const WireMessage* record, void* context) {
+    SatCom* sat = context;
+
+    SatelliteMessage msg;
+    if (decode_record(record, &msg)) {
+        // Process the message based on type...
+        sat->last_message = msg;
+    } else {
+        metrics_count(METRIC_LINK_PARSE_FAILURES, COMPONENT_SAT_COM, 1);
+    }
+    return true;
+}
+
+static void on_link_state(bool connected, void* context) {
+    SatCom* sat = context;
+
+    if (connected) {
+        sat->connected = true;
+        LOG_INFO(LOG_SATCOM, "Connected to ground station");
+        send_status_update(sat, true);
+    } else if (sat->connected) {
+        sat->connected = false;
+        send_status_update(sat, false);
+    }
+}
+
 SatCom* sat_com_init(Bus* bus) {
+    return sat_com_init_with_links(bus, NULL);
+}
+
+SatCom* sat_com_init_with_links(Bus* bus, GroundLinks* links) {
     LOG_INFO(LOG_SATCOM, "Starting initialization");
     
     if (!bus) {
@@ -168,17 +182,21 @@ SatCom* sat_com_init(Bus* bus) {
     sat->connected = false;
     memset(&sat->last_message, 0, sizeof(SatelliteMessage));
     memset(&sat->current_state, 0, sizeof(FlightState));
-
-    if (!init_socket(sat)) {
-        LOG_ERROR(LOG_SATCOM, "Socket initialization failed");
-        free(sat);
-        return NULL;
-    }
-
-    // Subscribe to state updates from flight controller
-    ErrorCode err = bus_subscribe(bus, COMPONENT_SAT_COM, MSG_STATE_RESPONSE);
-    if (err != SUCCESS) {
-        LOG_ERROR(LOG_SATCOM, "Failed to subscribe to state responses: %d", err);
+    flight_state_watch_init(&sat->state_watch, STATE_INTERVAL_MS);
+    sat->feed = NULL;
+
+    sat->owns_links = links == NULL;
+    sat->links = links ? links : ground_links_create();
+    GroundLinkHandlers handlers = {
+        .on_record = on_record,
+        .on_state = on_link_state,
+        .context = sat
+    };
+    sat->link = sat->links ? ground_links_add(sat->links, SATCOM_HOST, SATCOM_PORT,
+                                              COMPONENT_SAT_COM, LOG_SATCOM, &handlers) : NULL;
+    if (!sat->link) {
+        LOG_ERROR(LOG_SATCOM, "Link initialization failed");
+        if (sat->owns_links) ground_links_destroy(sat->links);
         free(sat);
         return NULL;
     }
@@ -190,11 +208,32 @@ SatCom* sat_com_init(Bus* bus) {
     return sat;
 }
 
+void sat_com_cleanup(SatCom* sat) {
+    if (!sat) return;
+
+    LOG_INFO(LOG_SATCOM, "Cleaning up");
+    if (sat->owns_links) {
+        ground_links_destroy(sat->links);
+    } else {
+        ground_links_remove(sat->links, sat->link);
+    }
+    free(sat);
+}
+
+void sat_com_set_feed(SatCom* sat, SensorFeed* feed) {
+    if (!sat) return;
+
+    sat->feed = feed;
+    sat->connected = feed != NULL;
+    ground_link_set_enabled(sat->link, feed == NULL);
+    LOG_INFO(LOG_SATCOM, "Reading from %s", feed ? "in-process feed" : "network");
+}
+
 void sat_com_process(SatCom* sat) {
     if (!sat) return;
 
     static time_t last_status_update = 0;
-    time_t now = time(NULL);
+    time_t now = sim_clock_time();
 
     // Send periodic status updates
     if (now - last_status_update >= STATUS_UPDATE_INTERVAL_S) {
@@ -202,32 +241,26 @@ void sat_com_process(SatCom* sat) {
         last_status_update = now;
     }
 
-    // Try to connect if not connected
-    if (!sat->connected) {
-        try_connect(sat);
-        return;
+    // Keep the latest flight state for status reports to the ground
+    FlightStateSample sample;
+    if (flight_state_watch_take(bus_state_snapshot(sat->bus), &sat->state_watch, &sample)) {
+        sat->current_state = sample.state.basic;
     }
 
-    // Process messages from ground station
-    char buffer[BUFFER_SIZE];
-    ssize_t bytes_read = recv(sat->socket_fd, buffer, BUFFER_SIZE - 1, 0);
-
-    if (bytes_read > 0) {
-        buffer[bytes_read] = '\0';
+    if (sat->feed) {
+        WireMessage record;
         SatelliteMessage msg;
-        if (parse_sat_message(buffer, &msg)) {
-            // Process the message based on type...
-        }
-    } else if (bytes_read == 0 || (bytes_read < 0 && errno != EWOULDBLOCK)) {
-        // Connection closed or error
-        LOG_ERROR(LOG_SATCOM, "Connection lost: %s", 
-                bytes_read == 0 ? "Closed by peer" : strerror(errno));
-        close(sat->socket_fd);
-        if (sat->connected) {
-            sat->connected = false;
-            send_status_update(sat, false);
+        while (sensor_feed_next(sat->feed, &record)) {
+            if (decode_record(&record, &msg)) {
+                sat->last_message = msg;
+            }
         }
-        init_socket(sat);
+        return;
+    }
+
+    // A shared reactor is run by its owner
+    if (sat->owns_links) {
+        ground_links_run(sat->links, 0);
     }
 }
 
@@ -242,9 +275,21 @@ void sat_com_main(Bus* bus) {
 
     LOG_INFO(LOG_SATCOM, "Entering main loop");
 
-    while (1) {
+    while (component_running()) {
+        uint64_t loop_start = metrics_loop_start();
         sat_com_process(sat);
-        usleep(SATCOM_UPDATE_INTERVAL_MS * 1000);
+        metrics_loop_end(COMPONENT_SAT_COM, loop_start, SATCOM_UPDATE_INTERVAL_MS);
+
+        // Woken early by the link's next connect attempt
+        int timeout_ms = ground_links_next_timeout_ms(sat->links);
+        if (timeout_ms < 0 || timeout_ms > SATCOM_UPDATE_INTERVAL_MS) {
+            timeout_ms = SATCOM_UPDATE_INTERVAL_MS;
+        }
+
+        struct pollfd fd = { .fd = ground_links_fd(sat->links), .events = POLLIN };
+        if (poll(&fd, 1, timeout_ms) < 0 && errno != EINTR) {
+            LOG_WARN(LOG_SATCOM, "poll failed: %s", strerror(errno));
+        }
     }
 
     sat_com_cleanup(sat);
@@ -1,5 +1,11 @@
 #include "autopilot.h"
+#include "component.h"
+#include "config_store.h"
 #include "log.h"
+#include "metrics.h"
+#include "sim_clock.h"
+#include "standby.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,10 +14,6 @@
 #include <json-c/json.h>
 #include <time.h>
 
-#define UPDATE_INTERVAL_MS 100  // 10Hz update rate
-#define STATE_REQUEST_INTERVAL_S 1
-#define CONFIG_FILE "config/autopilot_config.json"
-
 // Default PID controller constants
 #define DEFAULT_HEADING_P 1.0
 #define DEFAULT_HEADING_I 0.1
@@ -34,51 +36,40 @@
 #define DEFAULT_MIN_SPEED 120.0          // knots
 #define DEFAULT_MAX_HEADING_RATE 3.0     // degrees per second
 
+// PID control state, all a standby autopilot needs from its primary
+typedef struct {
+    double heading_error;
+    double heading_integral;
+    double heading_last_error;
+    double altitude_error;
+    double altitude_integral;
+    double altitude_last_error;
+    double speed_error;
+    double speed_integral;
+    double speed_last_error;
+} PIDState;
+
 struct Autopilot {
     Bus* bus;
     AutopilotConfig config;
     FlightState current_state;
     bool state_valid;
-    time_t last_state_request;
-    
-    // PID control state
-    struct {
-        double heading_error;
-        double heading_integral;
-        double heading_last_error;
-        double altitude_error;
-        double altitude_integral;
-        double altitude_last_error;
-        double speed_error;
-        double speed_integral;
-        double speed_last_error;
-    } pid_state;
+    TraceContext state_trace;   // Fix behind current_state
+    FlightStateWatch state_watch;  // Every change, taken once per step
+    PIDState pid_state;
+    uint32_t interval_ms;       // Step period
+    uint32_t config_version;    // Config store snapshot in use, 0 without one
 };
 
-static void request_state(Autopilot* ap) {
-    Message msg = {0};
-    msg.header.type = MSG_STATE_REQUEST;
-    msg.header.sender = COMPONENT_AUTOPILOT;
-    msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
-    
-    if (bus_publish(ap->bus, &msg) != SUCCESS) {
-        LOG_ERROR(LOG_AUTOPILOT, "Failed to publish state request");
-    } else {
-        LOG_DEBUG(LOG_AUTOPILOT, "Requested state update");
-    }
-    
-    ap->last_state_request = msg.header.timestamp;
-}
-
 static void send_control_command(Autopilot* ap, double target_heading, 
                                double target_speed, double target_altitude) {
     Message msg = {0};
     msg.header.type = MSG_AUTOPILOT_COMMAND;
     msg.header.sender = COMPONENT_AUTOPILOT;
     msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
-    msg.header.timestamp = time(NULL);
+    msg.header.timestamp = sim_clock_time();
     msg.header.message_size = sizeof(AutopilotCommandMsg);
+    msg.header.trace = ap->state_trace;
 
     msg.payload.autopilot_command.target_heading = target_heading;
     msg.payload.autopilot_command.target_speed = target_speed;
@@ -93,7 +84,10 @@ static void send_control_command(Autopilot* ap, double target_heading,
 }
 
 static void update_pid_controls(Autopilot* ap) {
-    double dt = UPDATE_INTERVAL_MS / 1000.0;
+    double dt = ap->interval_ms / 1000.0;
+
+    // How old the position driving this step is
+    trace_record(TRACE_FIX_AGE_AT_CONTROL, ap->state_trace.origin_ns);
 
     // Heading control
     double heading_error = ap->config.target_heading - ap->current_state.heading;
@@ -101,53 +95,36 @@ static void update_pid_controls(Autopilot* ap) {
     if (heading_error > 180) heading_error -= 360;
     if (heading_error < -180) heading_error += 360;
 
-    ap->pid_state.heading_integral += heading_error * dt;
-    double heading_derivative = (heading_error - ap->pid_state.heading_last_error) / dt;
+    // Limited to the heading rate
+    const double* gains = ap->config.heading_pid;
+    double heading_output = autopilot_pid_step(gains[0], gains[1], gains[2], heading_error, dt,
+                                               &ap->pid_state.heading_integral,
+                                               &ap->pid_state.heading_last_error,
+                                               -ap->config.max_heading_rate,
+                                               ap->config.max_heading_rate);
 
-    double heading_output = ap->config.heading_pid[0] * heading_error +
-                          ap->config.heading_pid[1] * ap->pid_state.heading_integral +
-                          ap->config.heading_pid[2] * heading_derivative;
-
-    // Limit heading rate
-    heading_output = fmax(-ap->config.max_heading_rate,
-                         fmin(ap->config.max_heading_rate, heading_output));
-
-    ap->pid_state.heading_last_error = heading_error;
-
-    // Altitude control
+    // Altitude control, limited to the vertical speeds
     double altitude_error = ap->config.target_altitude - ap->current_state.position.altitude;
-    ap->pid_state.altitude_integral += altitude_error * dt;
-    double altitude_derivative = (altitude_error - ap->pid_state.altitude_last_error) / dt;
-
-    double altitude_output = ap->config.altitude_pid[0] * altitude_error +
-                           ap->config.altitude_pid[1] * ap->pid_state.altitude_integral +
-                           ap->config.altitude_pid[2] * altitude_derivative;
-
-    // Limit vertical speed
-    if (altitude_output > 0) {
-        altitude_output = fmin(altitude_output, ap->config.max_climb_rate);
-    } else {
-        altitude_output = fmax(altitude_output, -ap->config.max_descent_rate);
-    }
-
-    ap->pid_state.altitude_last_error = altitude_error;
+    gains = ap->config.altitude_pid;
+    double altitude_output = autopilot_pid_step(gains[0], gains[1], gains[2], altitude_error, dt,
+                                                &ap->pid_state.altitude_integral,
+                                                &ap->pid_state.altitude_last_error,
+                                                -ap->config.max_descent_rate,
+                                                ap->config.max_climb_rate);
 
     // Speed control
     double speed_error = ap->config.target_speed - ap->current_state.speed;
-    ap->pid_state.speed_integral += speed_error * dt;
-    double speed_derivative = (speed_error - ap->pid_state.speed_last_error) / dt;
-
-    double speed_output = ap->config.speed_pid[0] * speed_error +
-                        ap->config.speed_pid[1] * ap->pid_state.speed_integral +
-                        ap->config.speed_pid[2] * speed_derivative;
+    gains = ap->config.speed_pid;
+    double speed_output = autopilot_pid_step(gains[0], gains[1], gains[2], speed_error, dt,
+                                             &ap->pid_state.speed_integral,
+                                             &ap->pid_state.speed_last_error,
+                                             -INFINITY, INFINITY);
 
     // Limit speed
     speed_output = fmax(ap->config.min_speed,
                        fmin(ap->config.max_speed, ap->current_state.speed + speed_output)) -
                   ap->current_state.speed;
 
-    ap->pid_state.speed_last_error = speed_error;
-
     LOG_TRACE(LOG_AUTOPILOT, "PID outputs - Hdg: %.2f, Alt: %.2f, Spd: %.2f",
               heading_output, altitude_output, speed_output);
 
@@ -165,11 +142,30 @@ static void update_pid_controls(Autopilot* ap) {
 
     // Send command
     send_control_command(ap, new_heading, new_speed, new_altitude);
+    standby_checkpoint(COMPONENT_AUTOPILOT, &ap->pid_state, sizeof(ap->pid_state));
+}
+
+// Tell the flight controller the autopilot is up (its readiness report)
+static void send_status_update(Autopilot* ap, bool active) {
+    Message msg = {0};
+    msg.header.type = MSG_SYSTEM_STATUS;
+    msg.header.sender = COMPONENT_AUTOPILOT;
+    msg.header.receiver = COMPONENT_FLIGHT_CONTROLLER;
+    msg.header.timestamp = sim_clock_time();
+    msg.header.message_size = sizeof(SystemStatusMsg);
+    msg.payload.system_status.component_active = active;
+
+    if (bus_publish(ap->bus, &msg) != SUCCESS) {
+        LOG_ERROR(LOG_AUTOPILOT, "Failed to publish status update");
+    }
 }
 
 Autopilot* autopilot_init(Bus* bus) {
-    LOG_INFO(LOG_AUTOPILOT, "Starting initialization");
-    
+    return autopilot_init_with_config(bus, CONFIG_AUTOPILOT_FILE);
+}
+
+// Everything but the readiness report
+static Autopilot* autopilot_create(Bus* bus, const char* config_file) {
     if (!bus) {
         LOG_ERROR(LOG_AUTOPILOT, "NULL bus in init");
         return NULL;
@@ -183,23 +179,33 @@ Autopilot* autopilot_init(Bus* bus) {
 
     ap->bus = bus;
     ap->state_valid = false;
-    ap->last_state_request = 0;
+    memset(&ap->state_trace, 0, sizeof(ap->state_trace));
+    flight_state_watch_init(&ap->state_watch, 0);
     memset(&ap->current_state, 0, sizeof(FlightState));
     memset(&ap->pid_state, 0, sizeof(ap->pid_state));
 
-    // Load configuration
-    LOG_INFO(LOG_AUTOPILOT, "Loading config from %s", CONFIG_FILE);
-    ap->config = autopilot_load_config(CONFIG_FILE);
-
-    // Subscribe to state responses
-    ErrorCode err = bus_subscribe(bus, COMPONENT_AUTOPILOT, MSG_STATE_RESPONSE);
-    if (err != SUCCESS) {
-        LOG_ERROR(LOG_AUTOPILOT, "Failed to subscribe to state responses: %d", err);
-        free(ap);
-        return NULL;
+    // The flight controller's snapshot when there is one, else the file
+    ConfigSnapshot snapshot;
+    ap->config_version = config_store_read(&snapshot);
+    if (ap->config_version) {
+        ap->config = snapshot.autopilot;
+        ap->interval_ms = snapshot.autopilot_interval_ms;
+    } else {
+        LOG_INFO(LOG_AUTOPILOT, "Loading config from %s", config_file);
+        ap->config = autopilot_load_config(config_file);
+        ap->interval_ms = AUTOPILOT_UPDATE_INTERVAL_MS;
     }
+    return ap;
+}
+
+Autopilot* autopilot_init_with_config(Bus* bus, const char* config_file) {
+    LOG_INFO(LOG_AUTOPILOT, "Starting initialization");
+
+    Autopilot* ap = autopilot_create(bus, config_file);
+    if (!ap) return NULL;
 
     LOG_INFO(LOG_AUTOPILOT, "Initialization complete");
+    send_status_update(ap, true);
     return ap;
 }
 
@@ -209,7 +215,7 @@ void autopilot_cleanup(Autopilot* ap) {
     free(ap);
 }
 
-AutopilotConfig autopilot_load_config(const char* filename) {
+AutopilotConfig autopilot_default_config(void) {
     AutopilotConfig config = {
         // Initial waypoint
         .target_latitude = 37.7749,      // San Francisco by default
@@ -232,78 +238,90 @@ AutopilotConfig autopilot_load_config(const char* filename) {
         .altitude_pid = {DEFAULT_ALTITUDE_P, DEFAULT_ALTITUDE_I, DEFAULT_ALTITUDE_D},
         .speed_pid = {DEFAULT_SPEED_P, DEFAULT_SPEED_I, DEFAULT_SPEED_D}
     };
+    return config;
+}
 
-    LOG_INFO(LOG_AUTOPILOT, "Loading config from %s", filename);
+static bool parse_number(json_object* val, double* out) {
+    if (!json_object_is_type(val, json_type_double) && !json_object_is_type(val, json_type_int)) {
+        return false;
+    }
+    *out = json_object_get_double(val);
+    return true;
+}
+
+static bool parse_gains(json_object* val, double gains[3]) {
+    if (json_object_get_type(val) != json_type_array || json_object_array_length(val) != 3) {
+        return false;
+    }
+    double parsed[3];
+    for (int i = 0; i < 3; i++) {
+        if (!parse_number(json_object_array_get_idx(val, i), &parsed[i])) return false;
+    }
+    memcpy(gains, parsed, sizeof(parsed));
+    return true;
+}
+
+ErrorCode autopilot_parse_config(const char* filename, AutopilotConfig* out) {
+    if (!filename || !out) return ERROR_GENERAL;
 
     json_object *root = json_object_from_file(filename);
     if (!root) {
-        LOG_WARN(LOG_AUTOPILOT, "Failed to load config file, using defaults");
-        return config;
+        return ERROR_GENERAL;
+    }
+    if (json_object_get_type(root) != json_type_object) {
+        json_object_put(root);
+        return ERROR_INVALID_DATA;
     }
 
-    // Load waypoint configuration
+    AutopilotConfig config = *out;
+    bool valid = true;
     json_object_object_foreach(root, key, val) {
+        // Load waypoint configuration
         if (strcmp(key, "target_latitude") == 0)
-            config.target_latitude = json_object_get_double(val);
+            valid = parse_number(val, &config.target_latitude);
         else if (strcmp(key, "target_longitude") == 0)
-            config.target_longitude = json_object_get_double(val);
+            valid = parse_number(val, &config.target_longitude);
         else if (strcmp(key, "target_altitude") == 0)
-            config.target_altitude = json_object_get_double(val);
+            valid = parse_number(val, &config.target_altitude);
         else if (strcmp(key, "target_speed") == 0)
-            config.target_speed = json_object_get_double(val);
+            valid = parse_number(val, &config.target_speed);
         else if (strcmp(key, "target_heading") == 0)
-            config.target_heading = json_object_get_double(val);
-        
+            valid = parse_number(val, &config.target_heading);
+
         // Load performance limits
         else if (strcmp(key, "max_climb_rate") == 0)
-            config.max_climb_rate = json_object_get_double(val);
+            valid = parse_number(val, &config.max_climb_rate);
         else if (strcmp(key, "max_descent_rate") == 0)
-            config.max_descent_rate = json_object_get_double(val);
+            valid = parse_number(val, &config.max_descent_rate);
         else if (strcmp(key, "max_bank_angle") == 0)
-            config.max_bank_angle = json_object_get_double(val);
+            valid = parse_number(val, &config.max_bank_angle);
         else if (strcmp(key, "max_pitch_angle") == 0)
-            config.max_pitch_angle = json_object_get_double(val);
+            valid = parse_number(val, &config.max_pitch_angle);
         else if (strcmp(key, "max_speed") == 0)
-            config.max_speed = json_object_get_double(val);
+            valid = parse_number(val, &config.max_speed);
         else if (strcmp(key, "min_speed") == 0)
-            config.min_speed = json_object_get_double(val);
+            valid = parse_number(val, &config.min_speed);
         else if (strcmp(key, "max_heading_rate") == 0)
-            config.max_heading_rate = json_object_get_double(val);
-        
+            valid = parse_number(val, &config.max_heading_rate);
+
         // Load PID gains if present
-        else if (strcmp(key, "heading_pid") == 0) {
-            json_object* pid_array = val;
-            if (json_object_get_type(pid_array) == json_type_array &&
-                json_object_array_length(pid_array) == 3) {
-                for (int i = 0; i < 3; i++) {
-                    config.heading_pid[i] = json_object_get_double(
-                        json_object_array_get_idx(pid_array, i));
-                }
-            }
-        }
-        else if (strcmp(key, "altitude_pid") == 0) {
-            json_object* pid_array = val;
-            if (json_object_get_type(pid_array) == json_type_array &&
-                json_object_array_length(pid_array) == 3) {
-                for (int i = 0; i < 3; i++) {
-                    config.altitude_pid[i] = json_object_get_double(
-                        json_object_array_get_idx(pid_array, i));
-                }
-            }
-        }
-        else if (strcmp(key, "speed_pid") == 0) {
-            json_object* pid_array = val;
-            if (json_object_get_type(pid_array) == json_type_array &&
-                json_object_array_length(pid_array) == 3) {
-                for (int i = 0; i < 3; i++) {
-                    config.speed_pid[i] = json_object_get_double(
-                        json_object_array_get_idx(pid_array, i));
-                }
-            }
+        else if (strcmp(key, "heading_pid") == 0)
+            valid = parse_gains(val, config.heading_pid);
+        else if (strcmp(key, "altitude_pid") == 0)
+            valid = parse_gains(val, config.altitude_pid);
+        else if (strcmp(key, "speed_pid") == 0)
+            valid = parse_gains(val, config.speed_pid);
+        else
+            LOG_WARN(LOG_AUTOPILOT, "Unknown config key %s", key);
+
+        if (!valid) {
+            LOG_ERROR(LOG_AUTOPILOT, "Invalid value for %s in %s", key, filename);
+            break;
         }
     }
 
     json_object_put(root);
+    if (!valid) return ERROR_INVALID_DATA;
 
     // Calculate initial heading if not specified
     if (config.target_heading == 0.0) {
@@ -322,6 +340,20 @@ AutopilotConfig autopilot_load_config(const char* filename) {
         }
     }
 
+    *out = config;
+    return SUCCESS;
+}
+
+AutopilotConfig autopilot_load_config(const char* filename) {
+    AutopilotConfig config = autopilot_default_config();
+
+    LOG_INFO(LOG_AUTOPILOT, "Loading config from %s", filename);
+
+    if (autopilot_parse_config(filename, &config) != SUCCESS) {
+        LOG_WARN(LOG_AUTOPILOT, "Failed to load config file, using defaults");
+        return config;
+    }
+
     LOG_INFO(LOG_AUTOPILOT, "Loaded config - Target: %.6f,%.6f @ %.0f ft, Hdg: %.1f°, Spd: %.0f kts",
              config.target_latitude, config.target_longitude,
              config.target_altitude, config.target_heading, config.target_speed);
@@ -329,37 +361,50 @@ AutopilotConfig autopilot_load_config(const char* filename) {
     return config;
 }
 
+// Pick up the latest state from the shared snapshot
+static void refresh_state(Autopilot* ap) {
+    FlightStateSample sample;
+    if (!flight_state_watch_take(bus_state_snapshot(ap->bus), &ap->state_watch, &sample)) {
+        return;
+    }
+
+    trace_record(TRACE_STATE_TO_AUTOPILOT, sample.write_ns);
+    trace_record(TRACE_FIX_TO_AUTOPILOT, sample.trace.origin_ns);
+    ap->state_trace = sample.trace;
+    ap->current_state = sample.state.basic;
+    ap->state_valid = true;
+    LOG_DEBUG(LOG_AUTOPILOT, "State updated - Pos: %.6f,%.6f @ %.0f ft, Hdg: %.1f°, Spd: %.1f kts",
+             ap->current_state.position.latitude,
+             ap->current_state.position.longitude,
+             ap->current_state.position.altitude,
+             ap->current_state.heading,
+             ap->current_state.speed);
+}
+
+// Take up a reloaded config between steps. The PID state carries over, so
+// new gains start from the integrators as they are.
+static void refresh_config(Autopilot* ap) {
+    if (!ap->config_version || config_store_version() == ap->config_version) return;
+
+    ConfigSnapshot snapshot;
+    uint32_t version = config_store_read(&snapshot);
+    if (!version) return;
+    ap->config_version = version;
+    ap->config = snapshot.autopilot;
+    ap->interval_ms = snapshot.autopilot_interval_ms;
+    LOG_INFO(LOG_AUTOPILOT, "Config %u applied - Target: %.0f ft, Hdg: %.1f°, Spd: %.0f kts, every %u ms",
+             version, ap->config.target_altitude, ap->config.target_heading,
+             ap->config.target_speed, ap->interval_ms);
+}
+
 void autopilot_process(Autopilot* ap) {
     if (!ap) {
         LOG_ERROR(LOG_AUTOPILOT, "NULL autopilot in process");
         return;
     }
 
-    // Request current state if needed
-    time_t now = time(NULL);
-    if (now - ap->last_state_request >= STATE_REQUEST_INTERVAL_S) {
-        LOG_DEBUG(LOG_AUTOPILOT, "Requesting state update");
-        request_state(ap);
-    }
-
-    // Process any incoming messages
-    Message msg;
-    while (bus_read_message(ap->bus, COMPONENT_AUTOPILOT, &msg)) {
-        LOG_TRACE(LOG_AUTOPILOT, "Received message type %d from component %d",
-                 msg.header.type, msg.header.sender);
-
-        if (msg.header.type == MSG_STATE_RESPONSE) {
-            memcpy(&ap->current_state, &msg.payload.state_response.state, 
-                   sizeof(FlightState));
-            ap->state_valid = true;
-            LOG_DEBUG(LOG_AUTOPILOT, "State updated - Pos: %.6f,%.6f @ %.0f ft, Hdg: %.1f°, Spd: %.1f kts",
-                     ap->current_state.position.latitude,
-                     ap->current_state.position.longitude,
-                     ap->current_state.position.altitude,
-                     ap->current_state.heading,
-                     ap->current_state.speed);
-        }
-    }
+    refresh_config(ap);
+    refresh_state(ap);
 
     // Update controls if we have valid state
     if (ap->state_valid) {
@@ -369,6 +414,22 @@ void autopilot_process(Autopilot* ap) {
     }
 }
 
+static void run_loop(Autopilot* ap) {
+    LOG_INFO(LOG_AUTOPILOT, "Entering main loop");
+    
+    ComponentPacer pacer;
+    component_pacer_init(&pacer, COMPONENT_AUTOPILOT, ap->interval_ms);
+    while (component_running()) {
+        uint64_t loop_start = metrics_loop_start();
+        autopilot_process(ap);
+        metrics_loop_end(COMPONENT_AUTOPILOT, loop_start, ap->interval_ms);
+        component_pacer_set_period(&pacer, ap->interval_ms);
+
+        // State is read at the step, so just sleep until then
+        component_pacer_wait(&pacer);
+    }
+}
+
 void autopilot_main(Bus* bus) {
     LOG_INFO(LOG_AUTOPILOT, "Starting main function");
     
@@ -378,12 +439,34 @@ void autopilot_main(Bus* bus) {
         return;
     }
 
-    LOG_INFO(LOG_AUTOPILOT, "Entering main loop");
-    
-    while (1) {
-        autopilot_process(ap);
-        usleep(UPDATE_INTERVAL_MS * 1000);
+    run_loop(ap);
+    autopilot_cleanup(ap);
+}
+
+void autopilot_standby_main(Bus* bus) {
+    LOG_INFO(LOG_AUTOPILOT, "Starting as standby");
+
+    // The config is loaded now, not on the failover path
+    Autopilot* ap = autopilot_create(bus, CONFIG_AUTOPILOT_FILE);
+    if (!ap) {
+        LOG_ERROR(LOG_AUTOPILOT, "Failed to initialize standby");
+        return;
+    }
+
+    if (!standby_wait_promotion(COMPONENT_AUTOPILOT)) {
+        LOG_ERROR(LOG_AUTOPILOT, "Standby was not armed");
+        autopilot_cleanup(ap);
+        return;
+    }
+
+    // Keep the integrators, so the aircraft sees no step in the commands
+    if (standby_restore(COMPONENT_AUTOPILOT, &ap->pid_state, sizeof(ap->pid_state))) {
+        LOG_INFO(LOG_AUTOPILOT, "Promoted from standby, PID state restored");
+    } else {
+        LOG_WARN(LOG_AUTOPILOT, "Promoted from standby without a checkpoint");
     }
+    send_status_update(ap, true);
 
+    run_loop(ap);
     autopilot_cleanup(ap);
 }
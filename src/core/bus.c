@@ -1,5 +1,7 @@
+#define _GNU_SOURCE  // memfd_create, MAP_POPULATE
 #include "bus.h"
 #include "log.h"
+#include "metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,158 +12,1523 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-// Message timeout in seconds
-#define MESSAGE_TIMEOUT_S 5
+// Queued messages older than this are pruned
+#define MESSAGE_TIMEOUT_NS (5 * 1000000000ull)
+// Identifies an initialized bus segment to bus_open()
+#define BUS_MAGIC 0x42555331u
+// Huge page size assumed when rounding hugetlb-backed segments
+#define HUGE_PAGE_SIZE (2u * 1024 * 1024)
+// Named segments mapped with bus_open() in this process
+#define MAX_OPENED_BUSES 4
+// Cache line size used to keep ring indices apart
+#define CACHE_LINE_SIZE 64
+// Longest a BUS_OVERFLOW_BLOCK publisher sleeps before rechecking for room
+#define SPACE_POLL_NS 1000000ull
+
+#if (BUS_RING_CAPACITY & (BUS_RING_CAPACITY - 1)) != 0
+#error "BUS_RING_CAPACITY must be a power of two"
+#endif
 
 // Subscription entry
 typedef struct {
     ComponentId subscriber;
     MessageType msg_type;
+    BusQos qos;
+    MessagePriority priority;
     bool active;
 } Subscription;
 
-// Circular message queue
+// Newest message from one sender of one type, for BUS_QOS_LATEST. seq is a
+// seqlock (odd while a publisher writes); publishers take it with a CAS, so
+// a restarted sender racing its predecessor cannot tear the message.
 typedef struct {
-    Message messages[MAX_BUS_MESSAGES];
-    time_t timestamps[MAX_BUS_MESSAGES];
-    int read_idx;
-    int write_idx;
-    int count;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t seq;
+    Message message;
+} LatestSlot;
+
+// Bit for a (sender, type) slot in a subscriber's pending mask
+#define LATEST_BIT(sender, type) (1ull << ((sender) * MSG_NUM_TYPES + (type)))
+
+#if MAX_COMPONENTS * MSG_NUM_TYPES > 64
+#error "Latest-value pending masks need one bit per (sender, type)"
+#endif
+
+// Queue slot. seq follows the same handshake as RingSlot below (pos free,
+// pos + 1 committed). Pruning goes by the header's send time, so it only
+// touches lines the reader loads anyway.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t seq;
+    uint32_t pending;       // Subscribers that have not read it; mutex once committed
+    Message message;
+} QueueSlot;
+
+// Circular message queue, one per priority lane. Producers claim positions on tail without the
+// mutex; readers and evictors advance head while holding it. A slot is
+// freed once every subscriber it was published to has read it or it is
+// dropped. Each index has its own cache line so publishers and readers do
+// not bounce one another's.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;
+    _Atomic uint64_t read_pos[MAX_COMPONENTS];  // Nothing pending for it before this
+    QueueSlot slots[MAX_BUS_MESSAGES];
 } MessageQueue;
 
-// Bus structure (will be in shared memory)
-struct Bus {
-    MessageQueue queue;
-    Subscription subscriptions[MAX_SUBSCRIBERS];
-    sem_t* mutex;
-    int ref_count;
-    int shm_id;
-};
+// Counters behind BusStats for one (subscriber, type) pair. Depth is what
+// has been routed and not yet delivered, dropped or conflated, so it needs
+// no counter of its own. Only the subscriber writes delivered, which keeps
+// locked instructions off the read path.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t published;
+    _Atomic uint64_t delivered;
+    _Atomic uint64_t dropped;
+    _Atomic uint64_t conflated;
+    _Atomic uint32_t max_depth;
+} StatCounters;
+
+// Messages offered per type, whether or not anyone subscribed
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t published;
+} TopicCounter;
+
+// Publishers blocked by BUS_OVERFLOW_BLOCK. Readers check waiters without a
+// fence, so blocked publishers also recheck every SPACE_POLL_NS.
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t futex;  // Bumped when slots are freed
+    _Atomic uint32_t waiters;
+} SpaceWakeup;
+
+// Ring slot. The sequence number implements Vyukov's bounded queue
+// handshake: seq == pos means free for producers, seq == pos + 1 means
+// committed and readable by the consumer. Slots are laid out with a
+// per-type stride, so only the header and that type's payload are backed.
+typedef struct {
+    _Atomic uint64_t seq;
+    Message message;
+} RingSlot;
+
+// Multi-producer, single-consumer ring for one (subscriber, type) pair
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t tail;  // Claimed by producers
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t head;  // Owned by the consumer
+} SubscriberRing;
+
+// Per-subscriber ring table used in BUS_MODE_RINGS
+typedef struct {
+    uint32_t slot_stride[MSG_NUM_TYPES];               // Bytes per slot of each type
+    uint32_t storage_offset[MSG_NUM_TYPES];            // First slot of each type
+    uint32_t read_cursor[MAX_COMPONENTS];              // Round-robin start type
+    uint32_t peeked_type[MAX_COMPONENTS];              // Ring of the last bus_peek
+    SubscriberRing rings[MAX_COMPONENTS][MSG_NUM_TYPES];
+} RingTable;
+
+// Wakeup state for one subscriber
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t futex;  // Bumped on every delivery
+    _Atomic uint32_t waiters;                          // Callers parked on futex
+    _Atomic bool fd_armed;                             // Signal event_fd on next delivery
+    int event_fd;                                      // Inherited across fork
+} SubscriberWakeup;
+
+// Bus structure (will be in shared memory). Nothing in it may depend on the
+// address the segment is mapped at: bus_open() maps it elsewhere.
+struct Bus {
+    uint32_t magic;
+    BusMode mode;
+    BusBackend backend;
+    size_t segment_size;          // Mapped bytes, including ring storage
+    bool lock_memory;             // mlock in every attaching process
+    char name[64];                // shm_open name (BUS_BACKEND_SHM_OPEN)
+    bool name_linked;             // name still exists; guarded by mutex
+    pid_t creator;                // Process that created the segment
+    sem_t mutex;                  // Process-shared, guards queue and ref_count
+    int ref_count;
+    int shm_id;                   // BUS_BACKEND_SYSV only
+    Subscription subscriptions[MAX_SUBSCRIBERS];
+    // Routing masks, read on every publish and read, written on subscribe.
+    // The first two cover BUS_QOS_QUEUED subscriptions, the last two
+    // BUS_QOS_LATEST ones.
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t type_subscribers[MSG_NUM_TYPES];  // ComponentIds
+    _Atomic uint32_t subscriber_types[MAX_COMPONENTS];                         // MessageTypes
+    _Atomic uint32_t latest_subscribers[MSG_NUM_TYPES];                        // ComponentIds
+    _Atomic uint32_t latest_types[MAX_COMPONENTS];                             // MessageTypes
+    // Priority lane of each subscription, either QoS
+    _Atomic uint32_t lane_subscribers[MSG_NUM_PRIORITIES][MSG_NUM_TYPES];      // ComponentIds
+    _Atomic uint32_t lane_types[MSG_NUM_PRIORITIES][MAX_COMPONENTS];           // MessageTypes
+    // Latest-value slots each subscriber has not read yet (LATEST_BIT)
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t latest_pending[MAX_COMPONENTS];
+    LatestSlot latest[MAX_COMPONENTS][MSG_NUM_TYPES];
+    BusTopicPolicy policies[MSG_NUM_TYPES];
+    TopicCounter topic_published[MSG_NUM_TYPES];
+    StatCounters stats[MAX_COMPONENTS][MSG_NUM_TYPES];
+    SpaceWakeup space;
+    MessageQueue queues[MSG_NUM_PRIORITIES];  // Indexed by MessagePriority
+    SubscriberWakeup wakeups[MAX_COMPONENTS];
+    _Alignas(CACHE_LINE_SIZE) FlightStateSnapshot state_snapshot;
+    RingTable rings;
+    _Alignas(CACHE_LINE_SIZE) uint8_t ring_storage[];  // Slots for all rings
+};
+
+// Reservation handed out by bus_reserve (one outstanding per thread)
+typedef struct {
+    Bus* bus;
+    RingSlot* slot;         // NULL when the message lives in scratch_message
+    uint64_t pos;           // Ring position of slot
+    int primary;            // Subscriber owning slot
+    uint32_t subscribers;   // Other subscribers to copy to on commit
+    MessageType type;
+    uint32_t size;
+    uint32_t skipped;       // Rings that were full at reserve time, retried on commit
+} Reservation;
+
+static _Thread_local Reservation reservation;
+static _Thread_local Message scratch_message;
+// Queue mode cannot hand out pointers into the shared queue, so bus_peek
+// takes a burst for the subscriber under one lock and serves it from here.
+// Each lane has its own buffer, so a buffered burst never delays a message
+// published later in a higher lane.
+#define PEEK_BATCH 16
+
+typedef struct {
+    const Bus* bus;
+    int next;
+    int count;
+    Message messages[PEEK_BATCH];
+} PeekBuffer;
+
+static _Thread_local PeekBuffer peek_buffers[MAX_COMPONENTS][MSG_NUM_PRIORITIES];
+// Where each subscriber's next latest-value scan starts, so a fast sender
+// cannot starve the other slots
+static _Thread_local uint32_t latest_cursor[MAX_COMPONENTS];
+
+// Buses this process mapped with bus_open(). Their wakeup descriptors
+// belong to the creator's process tree and must not be touched here.
+static const Bus* opened_buses[MAX_OPENED_BUSES];
+static int opened_bus_count;
+
+// Sees every published message; see bus_set_tap()
+static BusTap publish_tap;
+
+static bool is_opened_by_name(const Bus* bus) {
+    if (opened_bus_count == 0) return false;
+    for (int i = 0; i < MAX_OPENED_BUSES; i++) {
+        if (opened_buses[i] == bus) return true;
+    }
+    return false;
+}
+
+static void set_opened_by_name(const Bus* bus, bool opened) {
+    for (int i = 0; i < MAX_OPENED_BUSES; i++) {
+        if (opened && !opened_buses[i]) {
+            opened_buses[i] = bus;
+            opened_bus_count++;
+            return;
+        }
+        if (!opened && opened_buses[i] == bus) {
+            opened_buses[i] = NULL;
+            opened_bus_count--;
+            return;
+        }
+    }
+}
+
+static uint32_t ring_slot_stride(MessageType type) {
+    size_t size = offsetof(RingSlot, message) + MESSAGE_SIZE(MESSAGE_PAYLOAD_SIZES[type]);
+    return (uint32_t)((size + 7) & ~(size_t)7);
+}
+
+// Total bytes of ring storage that follow struct Bus in the segment
+static size_t ring_storage_size(void) {
+    size_t size = 0;
+    for (int t = 0; t < MSG_NUM_TYPES; t++) {
+        size += (size_t)ring_slot_stride(t) * BUS_RING_CAPACITY * MAX_COMPONENTS;
+    }
+    return size;
+}
+
+static size_t bus_segment_size(void) {
+    return sizeof(Bus) + ring_storage_size();
+}
+
+static RingSlot* ring_slot(Bus* bus, int subscriber, MessageType type, uint64_t pos) {
+    const RingTable* table = &bus->rings;
+    size_t index = (size_t)subscriber * BUS_RING_CAPACITY + (pos & (BUS_RING_CAPACITY - 1));
+    return (RingSlot*)(bus->ring_storage + table->storage_offset[type] +
+                       index * table->slot_stride[type]);
+}
+
+static void init_rings(Bus* bus) {
+    RingTable* table = &bus->rings;
+    uint32_t offset = 0;
+
+    for (int t = 0; t < MSG_NUM_TYPES; t++) {
+        table->slot_stride[t] = ring_slot_stride(t);
+        table->storage_offset[t] = offset;
+        offset += table->slot_stride[t] * BUS_RING_CAPACITY * MAX_COMPONENTS;
+    }
+
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        for (int t = 0; t < MSG_NUM_TYPES; t++) {
+            SubscriberRing* ring = &table->rings[c][t];
+            atomic_init(&ring->head, 0);
+            atomic_init(&ring->tail, 0);
+            for (uint64_t i = 0; i < BUS_RING_CAPACITY; i++) {
+                atomic_init(&ring_slot(bus, c, t, i)->seq, i);
+            }
+        }
+    }
+}
+
+static void init_queues(Bus* bus) {
+    for (int lane = 0; lane < MSG_NUM_PRIORITIES; lane++) {
+        MessageQueue* queue = &bus->queues[lane];
+        atomic_init(&queue->head, 0);
+        atomic_init(&queue->tail, 0);
+        for (uint64_t i = 0; i < MAX_BUS_MESSAGES; i++) {
+            atomic_init(&queue->slots[i].seq, i);
+        }
+        for (int c = 0; c < MAX_COMPONENTS; c++) {
+            atomic_init(&queue->read_pos[c], 0);
+        }
+    }
+}
+
+static bool init_wakeups(Bus* bus) {
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        SubscriberWakeup* wakeup = &bus->wakeups[c];
+        atomic_init(&wakeup->futex, 0);
+        atomic_init(&wakeup->waiters, 0);
+        atomic_init(&wakeup->fd_armed, false);
+        wakeup->event_fd = eventfd(0, EFD_NONBLOCK);
+        if (wakeup->event_fd < 0) {
+            fprintf(stderr, "Bus: eventfd failed: %s\n", strerror(errno));
+            for (int i = 0; i < c; i++) {
+                close(bus->wakeups[i].event_fd);
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+static void close_wakeups(Bus* bus) {
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        if (bus->wakeups[c].event_fd >= 0) {
+            close(bus->wakeups[c].event_fd);
+        }
+    }
+}
+
+static long futex(_Atomic uint32_t* addr, int op, uint32_t val,
+                  const struct timespec* timeout) {
+    // Shared (non-private) futex: waiters and wakers live in different processes
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, NULL, 0);
+}
+
+// Called after a message has been made visible to a subscriber
+static void notify_subscriber(Bus* bus, int subscriber) {
+    SubscriberWakeup* wakeup = &bus->wakeups[subscriber];
+
+    atomic_fetch_add(&wakeup->futex, 1);
+    if (atomic_load(&wakeup->waiters) > 0) {
+        futex(&wakeup->futex, FUTEX_WAKE, INT_MAX, NULL);
+    }
+
+    if (atomic_load_explicit(&wakeup->fd_armed, memory_order_relaxed) &&
+        !is_opened_by_name(bus) &&
+        atomic_exchange(&wakeup->fd_armed, false)) {
+        uint64_t one = 1;
+        if (write(wakeup->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            LOG_WARN(LOG_BUS, "Failed to signal wait fd: %s", strerror(errno));
+        }
+    }
+}
+
+static void notify_subscribers(Bus* bus, uint32_t subscribers) {
+    while (subscribers) {
+        int subscriber = __builtin_ctz(subscribers);
+        subscribers &= subscribers - 1;
+        notify_subscriber(bus, subscriber);
+    }
+}
+
+// Called after slots have been handed back to producers
+static void signal_space(Bus* bus) {
+    if (atomic_load_explicit(&bus->space.waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&bus->space.futex, 1);
+        futex(&bus->space.futex, FUTEX_WAKE, INT_MAX, NULL);
+    }
+}
+
+// Deadline for a publisher that ran out of room, 0 if its topic does not block
+static uint64_t block_deadline(Bus* bus, MessageType type) {
+    const BusTopicPolicy* policy = &bus->policies[type];
+    if (policy->overflow != BUS_OVERFLOW_BLOCK || policy->timeout_ms <= 0) return 0;
+    return monotonic_ns() + (uint64_t)policy->timeout_ms * 1000000ull;
+}
+
+// Sleep until slots are freed or SPACE_POLL_NS passes. Returns false once
+// the deadline has passed.
+static bool wait_for_space(Bus* bus, uint64_t deadline_ns) {
+    uint64_t now = monotonic_ns();
+    if (deadline_ns == 0 || now >= deadline_ns) return false;
+
+    uint64_t wait_ns = deadline_ns - now < SPACE_POLL_NS ? deadline_ns - now : SPACE_POLL_NS;
+    struct timespec timeout = { .tv_sec = 0, .tv_nsec = (long)wait_ns };
+
+    atomic_fetch_add(&bus->space.waiters, 1);
+    futex(&bus->space.futex, FUTEX_WAIT, atomic_load(&bus->space.futex), &timeout);
+    atomic_fetch_sub(&bus->space.waiters, 1);
+    return true;
+}
+
+static void count_published(Bus* bus, MessageType type, uint64_t count) {
+    atomic_fetch_add_explicit(&bus->topic_published[type].published, count,
+                              memory_order_relaxed);
+    metrics_count(METRIC_BUS_PUBLISHED, type, count);
+}
+
+void bus_set_tap(BusTap tap) {
+    publish_tap = tap;
+}
+
+static void tap_published(const Message* messages, int count) {
+    if (!publish_tap) return;
+    for (int i = 0; i < count; i++) {
+        publish_tap(&messages[i]);
+    }
+}
+
+// Copies waiting. Counters are loaded before published, which is bumped
+// first, so the difference does not go negative.
+static uint64_t stat_depth(const StatCounters* stats) {
+    uint64_t done = atomic_load_explicit(&stats->delivered, memory_order_relaxed) +
+                    atomic_load_explicit(&stats->dropped, memory_order_relaxed) +
+                    atomic_load_explicit(&stats->conflated, memory_order_relaxed);
+    uint64_t published = atomic_load_explicit(&stats->published, memory_order_relaxed);
+    return published > done ? published - done : 0;
+}
+
+// A copy of a message was stored for each subscriber in the mask
+static void count_stored(Bus* bus, MessageType type, uint32_t subscribers) {
+    for (; subscribers; subscribers &= subscribers - 1) {
+        StatCounters* stats = &bus->stats[__builtin_ctz(subscribers)][type];
+        atomic_fetch_add_explicit(&stats->published, 1, memory_order_relaxed);
+
+        uint32_t depth = (uint32_t)stat_depth(stats);
+        uint32_t max = atomic_load_explicit(&stats->max_depth, memory_order_relaxed);
+        while (depth > max &&
+               !atomic_compare_exchange_weak_explicit(&stats->max_depth, &max, depth,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+        }
+    }
+}
+
+// A copy was lost before reaching each subscriber in the mask. stored says
+// whether it had been counted by count_stored().
+static void count_dropped(Bus* bus, MessageType type, uint32_t subscribers, bool stored) {
+    for (; subscribers; subscribers &= subscribers - 1) {
+        StatCounters* stats = &bus->stats[__builtin_ctz(subscribers)][type];
+        if (!stored) {
+            atomic_fetch_add_explicit(&stats->published, 1, memory_order_relaxed);
+        }
+        atomic_fetch_add_explicit(&stats->dropped, 1, memory_order_relaxed);
+        metrics_count(METRIC_BUS_DROPPED, type, 1);
+    }
+}
+
+// A latest-value sample replaced one the subscriber had not read
+static void count_conflated(Bus* bus, MessageType type, ComponentId subscriber) {
+    StatCounters* stats = &bus->stats[subscriber][type];
+    atomic_fetch_add_explicit(&stats->published, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->conflated, 1, memory_order_relaxed);
+}
+
+static void count_delivered(Bus* bus, MessageType type, ComponentId subscriber) {
+    _Atomic uint64_t* delivered = &bus->stats[subscriber][type].delivered;
+    atomic_store_explicit(delivered, atomic_load_explicit(delivered, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    metrics_count(METRIC_BUS_DELIVERED, type, 1);
+}
+
+BusOptions bus_default_options(void) {
+    BusOptions options = {
+        .mode = BUS_DEFAULT_MODE,
+        .backend = BUS_DEFAULT_BACKEND,
+        .name = NULL,
+        .huge_pages = false,
+        .prefault = true,
+        .lock_memory = false
+    };
+    return options;
+}
+
+Bus* bus_init(void) {
+    return bus_init_mode(BUS_DEFAULT_MODE);
+}
+
+Bus* bus_init_mode(BusMode mode) {
+    BusOptions options = bus_default_options();
+    options.mode = mode;
+    return bus_init_with_options(&options);
+}
+
+static const char* backend_name(BusBackend backend) {
+    switch (backend) {
+        case BUS_BACKEND_SYSV: return "sysv";
+        case BUS_BACKEND_SHM_OPEN: return "shm_open";
+        case BUS_BACKEND_MEMFD: return "memfd";
+        case BUS_BACKEND_MEMORY: return "memory";
+    }
+    return "unknown";
+}
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+// Map a file descriptor backed segment (shm_open or memfd)
+static void* map_shared_fd(int fd, size_t size, bool prefault) {
+    int flags = MAP_SHARED | (prefault ? MAP_POPULATE : 0);
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    return addr == MAP_FAILED ? NULL : addr;
+}
+
+static void* create_sysv_segment(const BusOptions* options, size_t* size, int* shm_id) {
+    int flags = IPC_CREAT | 0666;
+
+    if (options->huge_pages) {
+        size_t huge_size = round_up(*size, HUGE_PAGE_SIZE);
+        *shm_id = shmget(IPC_PRIVATE, huge_size, flags | SHM_HUGETLB);
+        if (*shm_id != -1) {
+            *size = huge_size;
+        } else {
+            fprintf(stderr, "Bus: Huge pages unavailable (%s), using normal pages\n",
+                    strerror(errno));
+        }
+    }
+    if (!options->huge_pages || *shm_id == -1) {
+        *shm_id = shmget(IPC_PRIVATE, *size, flags);
+    }
+    if (*shm_id == -1) {
+        fprintf(stderr, "Bus: shmget failed: %s\n", strerror(errno));
+        return NULL;
+    }
+    fprintf(stderr, "Bus: Created shared memory with ID: %d\n", *shm_id);
+
+    void* addr = shmat(*shm_id, NULL, 0);
+    if (addr == (void*)-1) {
+        fprintf(stderr, "Bus: shmat failed: %s\n", strerror(errno));
+        shmctl(*shm_id, IPC_RMID, NULL);
+        return NULL;
+    }
+    return addr;
+}
+
+static void* create_shm_open_segment(const BusOptions* options, size_t size) {
+    // Never replace a segment that exists: it may belong to a live run
+    int fd = shm_open(options->name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0 && errno == EEXIST) {
+        fprintf(stderr, "Bus: %s already exists, in use by another simulator or left "
+                "by a crashed one (./cleanup.sh removes stale segments)\n", options->name);
+        return NULL;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Bus: shm_open %s failed: %s\n", options->name, strerror(errno));
+        return NULL;
+    }
+
+    void* addr = NULL;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        addr = map_shared_fd(fd, size, options->prefault);
+    }
+    if (!addr) {
+        fprintf(stderr, "Bus: Failed to map %s: %s\n", options->name, strerror(errno));
+        shm_unlink(options->name);
+    } else if (options->huge_pages && madvise(addr, size, MADV_HUGEPAGE) != 0) {
+        // tmpfs only offers transparent huge pages, and only if enabled
+        fprintf(stderr, "Bus: Transparent huge pages unavailable: %s\n", strerror(errno));
+    }
+
+    close(fd);
+    return addr;
+}
+
+static void* create_memfd_segment(const BusOptions* options, size_t* size) {
+    int fd = -1;
+
+    if (options->huge_pages) {
+        fd = memfd_create("airplane_sim_bus", MFD_HUGETLB);
+        if (fd >= 0 && ftruncate(fd, (off_t)round_up(*size, HUGE_PAGE_SIZE)) == 0) {
+            void* addr = map_shared_fd(fd, round_up(*size, HUGE_PAGE_SIZE), options->prefault);
+            if (addr) {
+                *size = round_up(*size, HUGE_PAGE_SIZE);
+                close(fd);
+                return addr;
+            }
+        }
+        fprintf(stderr, "Bus: Huge pages unavailable (%s), using normal pages\n",
+                strerror(errno));
+        if (fd >= 0) close(fd);
+    }
+
+    fd = memfd_create("airplane_sim_bus", 0);
+    if (fd < 0) {
+        fprintf(stderr, "Bus: memfd_create failed: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    void* addr = NULL;
+    if (ftruncate(fd, (off_t)*size) == 0) {
+        addr = map_shared_fd(fd, *size, options->prefault);
+    }
+    if (!addr) {
+        fprintf(stderr, "Bus: Failed to map memfd: %s\n", strerror(errno));
+    }
+
+    // Forked children inherit the mapping itself, so the descriptor can go
+    close(fd);
+    return addr;
+}
+
+// Plain process memory for a bus used only by threads
+static void* create_memory_segment(const BusOptions* options, size_t size) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (options->prefault ? MAP_POPULATE : 0);
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Bus: Failed to map memory: %s\n", strerror(errno));
+        return NULL;
+    }
+    if (options->huge_pages && madvise(addr, size, MADV_HUGEPAGE) != 0) {
+        fprintf(stderr, "Bus: Transparent huge pages unavailable: %s\n", strerror(errno));
+    }
+    return addr;
+}
+
+static void unmap_segment(Bus* bus) {
+    if (bus->backend == BUS_BACKEND_SYSV) {
+        shmdt(bus);
+    } else {
+        munmap(bus, bus->segment_size);
+    }
+}
+
+// Pin the segment in this process; mlock is not inherited across fork
+static void lock_segment(Bus* bus) {
+    if (bus->lock_memory && mlock(bus, bus->segment_size) != 0) {
+        fprintf(stderr, "Bus: mlock failed: %s\n", strerror(errno));
+    }
+}
+
+Bus* bus_init_with_options(const BusOptions* options) {
+    BusOptions defaults = bus_default_options();
+    if (!options) options = &defaults;
+
+    // A name of this run's own unless the caller chose one
+    char run_name[sizeof(((Bus*)0)->name)];
+    BusOptions named;
+    if (options->backend == BUS_BACKEND_SHM_OPEN && !options->name) {
+        snprintf(run_name, sizeof(run_name), "%s.%d", BUS_DEFAULT_NAME, (int)getpid());
+        named = *options;
+        named.name = run_name;
+        options = &named;
+    }
+
+    fprintf(stderr, "Bus: Initializing (mode: %s, backend: %s)...\n",
+            options->mode == BUS_MODE_RINGS ? "rings" : "queue",
+            backend_name(options->backend));
+
+    size_t size = bus_segment_size();
+    int shm_id = -1;
+    Bus* bus;
+
+    switch (options->backend) {
+        case BUS_BACKEND_SYSV:
+            bus = create_sysv_segment(options, &size, &shm_id);
+            break;
+        case BUS_BACKEND_SHM_OPEN:
+            if (!options->name || options->name[0] != '/' ||
+                strlen(options->name) >= sizeof(((Bus*)0)->name)) {
+                fprintf(stderr, "Bus: Invalid segment name\n");
+                return NULL;
+            }
+            bus = create_shm_open_segment(options, size);
+            break;
+        case BUS_BACKEND_MEMFD:
+            bus = create_memfd_segment(options, &size);
+            break;
+        case BUS_BACKEND_MEMORY:
+            bus = create_memory_segment(options, size);
+            break;
+        default:
+            fprintf(stderr, "Bus: Unknown backend %d\n", options->backend);
+            return NULL;
+    }
+    if (!bus) {
+        return NULL;
+    }
+
+    // Initialize bus structure. For mmap backends this also faults in any
+    // page MAP_POPULATE could not.
+    memset(bus, 0, size);
+    bus->backend = options->backend;
+    bus->segment_size = size;
+    bus->lock_memory = options->lock_memory;
+    bus->shm_id = shm_id;
+    bus->creator = getpid();
+    if (options->backend == BUS_BACKEND_SHM_OPEN) {
+        strcpy(bus->name, options->name);
+        bus->name_linked = true;
+    }
+
+    if (sem_init(&bus->mutex, 1, 1) != 0) {
+        fprintf(stderr, "Bus: Failed to create mutex: %s\n", strerror(errno));
+        goto fail;
+    }
+
+    if (!init_wakeups(bus)) {
+        sem_destroy(&bus->mutex);
+        goto fail;
+    }
+
+    bus->mode = options->mode;
+    bus->ref_count = 1;
+    init_queues(bus);
+    init_rings(bus);
+    lock_segment(bus);
+
+    // Published last: bus_open() rejects segments without it
+    atomic_thread_fence(memory_order_release);
+    bus->magic = BUS_MAGIC;
+
+    fprintf(stderr, "Bus: Initialization complete (%zu bytes)\n", size);
+    if (options->backend == BUS_BACKEND_SHM_OPEN) {
+        fprintf(stderr, "Bus: Segment %s, for bus_open()\n", bus->name);
+    }
+    return bus;
+
+fail:
+    if (options->backend == BUS_BACKEND_SHM_OPEN) {
+        shm_unlink(options->name);
+    }
+    unmap_segment(bus);
+    if (shm_id != -1) {
+        shmctl(shm_id, IPC_RMID, NULL);
+    }
+    return NULL;
+}
+
+void bus_cleanup(Bus* bus) {
+    if (!bus) {
+        fprintf(stderr, "Bus: NULL bus in cleanup\n");
+        return;
+    }
+
+    fprintf(stderr, "Bus: Starting cleanup (ref_count: %d)\n", bus->ref_count);
+    
+    bool opened_by_name = is_opened_by_name(bus);
+    set_opened_by_name(bus, false);
+
+    sem_wait(&bus->mutex);
+    bus->ref_count--;
+    fprintf(stderr, "Bus: Decreased ref_count to %d\n", bus->ref_count);
+
+    // The name goes with the run that created it, even while components
+    // killed at shutdown still hold references they will never drop.
+    // Mappings already made stay valid.
+    char name[sizeof(bus->name)];
+    memcpy(name, bus->name, sizeof(name));
+    bool unlink_name = bus->name_linked &&
+                       (bus->ref_count == 0 || bus->creator == getpid());
+    if (unlink_name) bus->name_linked = false;
+    if (unlink_name && shm_unlink(name) == -1) {
+        fprintf(stderr, "Bus: Failed to unlink %s: %s\n", name, strerror(errno));
+    }
+    
+    if (bus->ref_count == 0) {
+        fprintf(stderr, "Bus: Last reference, cleaning up resources\n");
+        sem_post(&bus->mutex);
+        sem_destroy(&bus->mutex);
+        if (!opened_by_name) {
+            close_wakeups(bus);
+        }
+        
+        BusBackend backend = bus->backend;
+        int shm_id = bus->shm_id;
+
+        bus->magic = 0;
+        unmap_segment(bus);
+        if (backend == BUS_BACKEND_SYSV && shmctl(shm_id, IPC_RMID, NULL) == -1) {
+            fprintf(stderr, "Bus: Failed to remove shared memory: %s\n", strerror(errno));
+        }
+    } else {
+        sem_post(&bus->mutex);
+        // Threads share the creator's mapping; other backends map per process
+        if (bus->backend != BUS_BACKEND_MEMORY) {
+            unmap_segment(bus);
+        }
+    }
+}
+
+static QueueSlot* queue_slot(MessageQueue* queue, uint64_t pos) {
+    return &queue->slots[pos % MAX_BUS_MESSAGES];
+}
+
+// Number of claimed positions, including ones still being written
+static uint64_t queue_depth(MessageQueue* queue) {
+    return atomic_load_explicit(&queue->tail, memory_order_relaxed) -
+           atomic_load_explicit(&queue->head, memory_order_relaxed);
+}
+
+// Hand finished slots at the head back to producers. Called with the mutex
+// held, so slots are always freed in order.
+static void queue_advance_locked(Bus* bus, MessageQueue* queue) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint64_t pos = head;
+
+    for (; pos < tail; pos++) {
+        QueueSlot* slot = queue_slot(queue, pos);
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1 ||
+            slot->pending) {
+            break;
+        }
+        atomic_store_explicit(&slot->seq, pos + MAX_BUS_MESSAGES, memory_order_release);
+    }
+
+    if (pos > head) {
+        atomic_store_explicit(&queue->head, pos, memory_order_release);
+        signal_space(bus);
+    }
+}
+
+// Drop a committed slot for every subscriber still waiting for it
+static void queue_drop_locked(Bus* bus, QueueSlot* slot) {
+    if (!slot->pending) return;
+    count_dropped(bus, slot->message.header.type, slot->pending, true);
+    slot->pending = 0;
+}
+
+static void prune_old_messages(Bus* bus, MessageQueue* queue) {
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint64_t now = monotonic_ns();
+    uint64_t pos = head;
+    int pruned = 0;
+
+    for (; pos < tail; pos++) {
+        QueueSlot* slot = queue_slot(queue, pos);
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1 ||
+            now - slot->message.header.send_time_ns <= MESSAGE_TIMEOUT_NS) {
+            break;
+        }
+        if (slot->pending) pruned++;
+        queue_drop_locked(bus, slot);
+    }
+
+    if (pos > head) {
+        queue_advance_locked(bus, queue);
+    }
+    if (pruned) {
+        fprintf(stderr, "Bus: Pruned %d old messages\n", pruned);
+    }
+}
+
+// Make room in a full lane for a message of the given type, as its policy
+// allows. Returns false if the publish should be rejected.
+static bool queue_make_room(Bus* bus, MessageQueue* queue, MessageType type,
+                            uint64_t deadline_ns) {
+    const BusTopicPolicy* policy = &bus->policies[type];
+
+    if (policy->overflow == BUS_OVERFLOW_BLOCK) {
+        return wait_for_space(bus, deadline_ns);
+    }
+    if (policy->overflow != BUS_OVERFLOW_DROP_OLDEST &&
+        policy->overflow != BUS_OVERFLOW_PRIORITY) {
+        return false;
+    }
+
+    sem_wait(&bus->mutex);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    bool evicted = false;
+
+    for (uint64_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+         pos < tail; pos++) {
+        QueueSlot* slot = queue_slot(queue, pos);
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+            break;  // A producer is still writing it
+        }
+        if (!slot->pending) continue;
+
+        // Only the first message still pending can be evicted: dropping one
+        // further back frees nothing until the head reaches it. Drop-oldest
+        // always takes it; priority only if it is of a lower priority.
+        if (policy->overflow == BUS_OVERFLOW_DROP_OLDEST ||
+            bus->policies[slot->message.header.type].priority < policy->priority) {
+            LOG_DEBUG(LOG_BUS, "Evicting type %d for type %d", slot->message.header.type, type);
+            queue_drop_locked(bus, slot);
+            evicted = true;
+        }
+        break;
+    }
+
+    queue_advance_locked(bus, queue);
+    sem_post(&bus->mutex);
+    return evicted;
+}
+
+// Route (subscriber, type) by qos and priority. The new masks are set
+// before the old ones are cleared, so messages published meanwhile are not
+// lost.
+static void set_subscription_masks(Bus* bus, ComponentId subscriber, MessageType msg_type,
+                                   BusQos qos, MessagePriority priority) {
+    uint32_t type_bit = 1u << msg_type;
+    uint32_t subscriber_bit = 1u << subscriber;
+
+    atomic_fetch_or(&bus->lane_types[priority][subscriber], type_bit);
+    atomic_fetch_or(&bus->lane_subscribers[priority][msg_type], subscriber_bit);
+
+    if (qos == BUS_QOS_LATEST) {
+        atomic_fetch_or(&bus->latest_types[subscriber], type_bit);
+        atomic_fetch_or(&bus->latest_subscribers[msg_type], subscriber_bit);
+        atomic_fetch_and(&bus->subscriber_types[subscriber], ~type_bit);
+        atomic_fetch_and(&bus->type_subscribers[msg_type], ~subscriber_bit);
+    } else {
+        atomic_fetch_or(&bus->subscriber_types[subscriber], type_bit);
+        atomic_fetch_or(&bus->type_subscribers[msg_type], subscriber_bit);
+        atomic_fetch_and(&bus->latest_types[subscriber], ~type_bit);
+        atomic_fetch_and(&bus->latest_subscribers[msg_type], ~subscriber_bit);
+    }
+
+    for (int lane = 0; lane < MSG_NUM_PRIORITIES; lane++) {
+        if (lane == (int)priority) continue;
+        atomic_fetch_and(&bus->lane_types[lane][subscriber], ~type_bit);
+        atomic_fetch_and(&bus->lane_subscribers[lane][msg_type], ~subscriber_bit);
+    }
+}
+
+ErrorCode bus_subscribe(Bus* bus, ComponentId subscriber, MessageType msg_type) {
+    return bus_subscribe_qos(bus, subscriber, msg_type, BUS_QOS_QUEUED);
+}
+
+ErrorCode bus_subscribe_qos(Bus* bus, ComponentId subscriber, MessageType msg_type, BusQos qos) {
+    MessagePriority priority = VALIDATE_MESSAGE_TYPE(msg_type) ? MESSAGE_PRIORITIES[msg_type]
+                                                               : MSG_PRIORITY_NORMAL;
+    return bus_subscribe_priority(bus, subscriber, msg_type, qos, priority);
+}
+
+ErrorCode bus_subscribe_priority(Bus* bus, ComponentId subscriber, MessageType msg_type,
+                                 BusQos qos, MessagePriority priority) {
+    if (!bus) {
+        fprintf(stderr, "Bus: NULL bus in subscribe\n");
+        return ERROR_GENERAL;
+    }
+
+    fprintf(stderr, "Bus: Component %d subscribing to message type %d (priority %d)%s\n",
+            subscriber, msg_type, priority, qos == BUS_QOS_LATEST ? " (latest value)" : "");
+
+    if (!VALIDATE_COMPONENT_ID(subscriber) || !VALIDATE_MESSAGE_TYPE(msg_type) ||
+        (qos != BUS_QOS_QUEUED && qos != BUS_QOS_LATEST) ||
+        !VALIDATE_MESSAGE_PRIORITY(priority)) {
+        fprintf(stderr, "Bus: Invalid subscription %d/%d\n", subscriber, msg_type);
+        return ERROR_INVALID_DATA;
+    }
+
+    if (bus->mode == BUS_MODE_RINGS) {
+        // Subscribing is idempotent so restarted components keep their ring
+        set_subscription_masks(bus, subscriber, msg_type, qos, priority);
+        fprintf(stderr, "Bus: Ring subscription added\n");
+        return SUCCESS;
+    }
+
+    sem_wait(&bus->mutex);
+
+    // Resubscribing (e.g. after a restart) reuses the existing entry
+    int free_slot = -1;
+    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+        Subscription* entry = &bus->subscriptions[i];
+        if (entry->active && entry->subscriber == subscriber && entry->msg_type == msg_type) {
+            free_slot = i;
+            break;
+        }
+        if (!entry->active && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if (free_slot < 0) {
+        sem_post(&bus->mutex);
+        fprintf(stderr, "Bus: No free subscription slots\n");
+        return ERROR_GENERAL;
+    }
+
+    bus->subscriptions[free_slot].subscriber = subscriber;
+    bus->subscriptions[free_slot].msg_type = msg_type;
+    bus->subscriptions[free_slot].qos = qos;
+    bus->subscriptions[free_slot].priority = priority;
+    bus->subscriptions[free_slot].active = true;
+    // Producers and readers route on the masks without the mutex
+    set_subscription_masks(bus, subscriber, msg_type, qos, priority);
+    sem_post(&bus->mutex);
+    fprintf(stderr, "Bus: Subscription added at slot %d\n", free_slot);
+    return SUCCESS;
+}
+
+// Overwrite the (sender, type) slot and flag it for the given subscribers.
+// Returns the subscribers flagged.
+static uint32_t latest_publish(Bus* bus, const Message* message, uint32_t subscribers) {
+    ComponentId sender = message->header.sender;
+    MessageType type = message->header.type;
+
+    if (!subscribers) return 0;
+    if (!VALIDATE_COMPONENT_ID(sender)) {
+        LOG_WARN(LOG_BUS, "Cannot conflate type %d from invalid sender %d", type, sender);
+        return 0;
+    }
+
+    LatestSlot* slot = &bus->latest[sender][type];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    uint32_t spins = 0;
+    for (;;) {
+        if (seq & 1) {
+            if (!spin_wait(&spins)) {
+                // Left odd by a publisher that died; bus_reset_sender() clears it
+                LOG_WARN(LOG_BUS, "Latest slot of type %d from %d stuck mid-write", type, sender);
+                count_dropped(bus, type, subscribers, false);
+                return 0;
+            }
+            seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak_explicit(&slot->seq, &seq, seq + 1,
+                                                         memory_order_relaxed,
+                                                         memory_order_relaxed)) {
+            break;
+        }
+    }
+    atomic_thread_fence(memory_order_release);  // Odd seq is visible before any data
+
+    memcpy(&slot->message, message, MESSAGE_SIZE(message->header.message_size));
+    slot->message.header.send_time_ns = monotonic_ns();
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+
+    uint64_t bit = LATEST_BIT(sender, type);
+    for (uint32_t rest = subscribers; rest; rest &= rest - 1) {
+        int subscriber = __builtin_ctz(rest);
+        uint64_t was = atomic_fetch_or_explicit(&bus->latest_pending[subscriber], bit,
+                                                memory_order_release);
+        if (was & bit) {
+            count_conflated(bus, type, (ComponentId)subscriber);  // Previous one unread
+        } else {
+            count_stored(bus, type, 1u << subscriber);
+        }
+    }
+    return subscribers;
+}
+
+static uint32_t latest_subscribers(Bus* bus, MessageType type) {
+    return atomic_load_explicit(&bus->latest_subscribers[type], memory_order_acquire);
+}
+
+// Pending-mask bits of the given types from every sender
+static uint64_t latest_type_bits(uint32_t types) {
+    uint64_t bits = 0;
+    for (int sender = 0; sender < MAX_COMPONENTS; sender++) {
+        bits |= (uint64_t)types << (sender * MSG_NUM_TYPES);
+    }
+    return bits;
+}
+
+// Take the next unread latest-value slot of a priority lane for a
+// subscriber, lock-free
+static bool latest_take(Bus* bus, ComponentId subscriber, int lane, Message* message) {
+    if (!VALIDATE_COMPONENT_ID(subscriber)) return false;
+
+    _Atomic uint64_t* pending = &bus->latest_pending[subscriber];
+    uint64_t bits = atomic_load_explicit(pending, memory_order_acquire);
+    if (!bits) return false;
+
+    bits &= latest_type_bits(atomic_load_explicit(&bus->lane_types[lane][subscriber],
+                                                  memory_order_relaxed));
+
+    while (bits) {
+        // Rotate the start like ring_peek so every sender gets a turn
+        uint64_t ahead = bits & (~0ull << latest_cursor[subscriber]);
+        int index = __builtin_ctzll(ahead ? ahead : bits);
+        uint64_t bit = 1ull << index;
+        latest_cursor[subscriber] = (uint32_t)index + 1;
+
+        // Clear before copying: a publish during the copy flags it again
+        atomic_fetch_and_explicit(pending, ~bit, memory_order_acquire);
+        bits &= ~bit;
+
+        int type = index % MSG_NUM_TYPES;
+        if (!(atomic_load_explicit(&bus->latest_types[subscriber], memory_order_relaxed) &
+              (1u << type))) {
+            count_dropped(bus, (MessageType)type, 1u << subscriber, true);
+            continue;  // Switched back to BUS_QOS_QUEUED since it was flagged
+        }
+
+        const LatestSlot* slot = &bus->latest[index / MSG_NUM_TYPES][type];
+        uint32_t spins = 0;
+        for (;;) {
+            uint32_t begin = atomic_load_explicit(&slot->seq, memory_order_acquire);
+            if (!(begin & 1)) {  // Else publisher mid-write
+                memcpy(message, &slot->message, sizeof(*message));
+                atomic_thread_fence(memory_order_acquire);  // Copy completes before the recheck
+                if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == begin) {
+                    count_delivered(bus, (MessageType)type, subscriber);
+                    return true;
+                }
+            }
+            if (!spin_wait(&spins)) {
+                // The publisher died mid-write; the sample is stale
+                count_dropped(bus, (MessageType)type, 1u << subscriber, true);
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+void bus_reset_sender(Bus* bus, ComponentId sender) {
+    if (!bus || !VALIDATE_COMPONENT_ID(sender)) return;
+
+    for (int type = 0; type < MSG_NUM_TYPES; type++) {
+        LatestSlot* slot = &bus->latest[sender][type];
+        uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        if (!(seq & 1)) continue;
+
+        // The half-written sample is never delivered
+        uint64_t bit = LATEST_BIT(sender, type);
+        for (int subscriber = 0; subscriber < MAX_COMPONENTS; subscriber++) {
+            uint64_t was = atomic_fetch_and_explicit(&bus->latest_pending[subscriber], ~bit,
+                                                     memory_order_relaxed);
+            if (was & bit) count_dropped(bus, (MessageType)type, 1u << subscriber, true);
+        }
+        atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+        fprintf(stderr, "Bus: Released latest slot of type %d left mid-write by %d\n",
+                type, sender);
+    }
+}
+
+// Claim a free slot for a producer. Lock-free for any number of producers;
+// returns NULL without blocking when the ring is full.
+static RingSlot* ring_claim(Bus* bus, int subscriber, MessageType type, uint64_t* claimed) {
+    SubscriberRing* ring = &bus->rings.rings[subscriber][type];
+    uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    for (;;) {
+        RingSlot* slot = ring_slot(bus, subscriber, type, pos);
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *claimed = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL;  // Consumer has not released this slot yet
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// Stamp the send time and make a claimed slot visible to the consumer
+static void ring_commit(Bus* bus, int subscriber, RingSlot* slot, uint64_t pos) {
+    slot->message.header.send_time_ns = monotonic_ns();
+    count_stored(bus, slot->message.header.type, 1u << subscriber);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+static bool ring_push(Bus* bus, int subscriber, const Message* message) {
+    uint64_t pos;
+    RingSlot* slot = ring_claim(bus, subscriber, message->header.type, &pos);
+    if (!slot) return false;
+
+    memcpy(&slot->message, message, MESSAGE_SIZE(message->header.message_size));
+    ring_commit(bus, subscriber, slot, pos);
+    return true;
+}
+
+// ring_push that waits for room under BUS_OVERFLOW_BLOCK and counts the
+// copy as dropped if there is none
+static bool ring_push_policy(Bus* bus, int subscriber, const Message* message) {
+    if (ring_push(bus, subscriber, message)) return true;
+
+    uint64_t deadline = block_deadline(bus, message->header.type);
+    while (wait_for_space(bus, deadline)) {
+        if (ring_push(bus, subscriber, message)) return true;
+    }
+
+    LOG_WARN(LOG_BUS, "Ring full for subscriber %d, type %d",
+            subscriber, message->header.type);
+    count_dropped(bus, message->header.type, 1u << subscriber, false);
+    return false;
+}
+
+// Oldest committed slot of a ring, or NULL. Only the owning subscriber calls
+// this and ring_release, so consuming is wait-free.
+static RingSlot* ring_front(Bus* bus, int subscriber, MessageType type) {
+    SubscriberRing* ring = &bus->rings.rings[subscriber][type];
+    uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    RingSlot* slot = ring_slot(bus, subscriber, type, pos);
+
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
+        return NULL;
+    }
+    return slot;
+}
+
+static void ring_release(Bus* bus, int subscriber, MessageType type) {
+    SubscriberRing* ring = &bus->rings.rings[subscriber][type];
+    uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    RingSlot* slot = ring_slot(bus, subscriber, type, pos);
+
+    count_delivered(bus, type, (ComponentId)subscriber);
+    atomic_store_explicit(&slot->seq, pos + BUS_RING_CAPACITY, memory_order_release);
+    atomic_store_explicit(&ring->head, pos + 1, memory_order_relaxed);
+    signal_space(bus);
+}
+
+// Push a run of messages of one type with a single tail claim when the
+// ring has room for all of them, otherwise one at a time. Returns the
+// number pushed.
+static int ring_push_run(Bus* bus, int subscriber, const Message* messages, int count) {
+    MessageType type = messages[0].header.type;
+
+    if (count > 1 && count <= BUS_RING_CAPACITY) {
+        SubscriberRing* ring = &bus->rings.rings[subscriber][type];
+        uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+        for (;;) {
+            // The consumer frees slots in order, so the last one being free
+            // means the whole run is
+            uint64_t last = pos + (uint64_t)count - 1;
+            uint64_t seq = atomic_load_explicit(&ring_slot(bus, subscriber, type, last)->seq,
+                                                memory_order_acquire);
+            int64_t diff = (int64_t)(seq - last);
+
+            if (diff < 0) break;  // Not enough room for the whole run
+            if (diff > 0) {
+                pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+                continue;
+            }
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + (uint64_t)count,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                for (int i = 0; i < count; i++) {
+                    RingSlot* slot = ring_slot(bus, subscriber, type, pos + (uint64_t)i);
+                    memcpy(&slot->message, &messages[i],
+                           MESSAGE_SIZE(messages[i].header.message_size));
+                    ring_commit(bus, subscriber, slot, pos + (uint64_t)i);
+                }
+                return count;
+            }
+        }
+    }
+
+    int pushed = 0;
+    while (pushed < count && ring_push(bus, subscriber, &messages[pushed])) {
+        pushed++;
+    }
+    return pushed;
+}
+
+// Fan a run of same-type messages out to every subscriber of the type.
+// Subscribers that received something are added to *delivered.
+static ErrorCode ring_publish_run(Bus* bus, const Message* messages, int count,
+                                  uint32_t* delivered) {
+    MessageType type = messages[0].header.type;
+    uint32_t subscribers = atomic_load_explicit(&bus->type_subscribers[type],
+                                                memory_order_acquire);
+    ErrorCode result = SUCCESS;
+
+    while (subscribers) {
+        int subscriber = __builtin_ctz(subscribers);
+        subscribers &= subscribers - 1;
+
+        int pushed = ring_push_run(bus, subscriber, messages, count);
+        uint64_t deadline = pushed < count ? block_deadline(bus, type) : 0;
+        while (pushed < count && wait_for_space(bus, deadline)) {
+            pushed += ring_push_run(bus, subscriber, messages + pushed, count - pushed);
+        }
+
+        if (pushed > 0) {
+            *delivered |= 1u << subscriber;
+        }
+        if (pushed < count) {
+            LOG_WARN(LOG_BUS, "Ring full for subscriber %d, type %d (dropped %d)",
+                    subscriber, type, count - pushed);
+            for (int i = pushed; i < count; i++) {
+                count_dropped(bus, type, 1u << subscriber, false);
+            }
+            result = ERROR_COMMUNICATION;
+        }
+    }
+
+    return result;
+}
+
+static ErrorCode ring_publish(Bus* bus, const Message* message) {
+    uint32_t delivered = 0;
+    ErrorCode result = ring_publish_run(bus, message, 1, &delivered);
+    notify_subscribers(bus, delivered);
+
+    LOG_DEBUG(LOG_BUS, "Published message type %d from %d to %d (rings)",
+            message->header.type, message->header.sender, message->header.receiver);
+    return result;
+}
+
+// Front of the subscriber's next non-empty ring in one priority lane
+static const Message* ring_peek(Bus* bus, ComponentId subscriber, int lane) {
+    if (!VALIDATE_COMPONENT_ID(subscriber)) {
+        return NULL;
+    }
+
+    uint32_t types = atomic_load_explicit(&bus->subscriber_types[subscriber],
+                                          memory_order_relaxed) &
+                     atomic_load_explicit(&bus->lane_types[lane][subscriber],
+                                          memory_order_relaxed);
+    if (!types) return NULL;
+
+    uint32_t start = bus->rings.read_cursor[subscriber];
+
+    // Rotate the starting type so one busy topic cannot starve the others
+    uint32_t ordered = ((types >> start) | (types << (MSG_NUM_TYPES - start))) &
+                       ((1u << MSG_NUM_TYPES) - 1);
+    for (; ordered; ordered &= ordered - 1) {
+        uint32_t type = (start + (uint32_t)__builtin_ctz(ordered)) % MSG_NUM_TYPES;
+
+        RingSlot* slot = ring_front(bus, subscriber, type);
+        if (slot) {
+            bus->rings.peeked_type[subscriber] = type;
+            bus->rings.read_cursor[subscriber] = (type + 1) % MSG_NUM_TYPES;
+            return &slot->message;
+        }
+    }
+
+    return NULL;
+}
+
+static bool ring_read(Bus* bus, ComponentId subscriber, int lane, Message* message) {
+    const Message* front = ring_peek(bus, subscriber, lane);
+    if (!front) return false;
 
-// Create or get named semaphore
-static sem_t* create_mutex(void) {
-    sem_t* mutex = sem_open("/airplane_sim_bus", O_CREAT, 0644, 1);
-    if (mutex == SEM_FAILED) {
-        fprintf(stderr, "Bus: sem_open failed: %s\n", strerror(errno));
-        return NULL;
+    memcpy(message, front, MESSAGE_SIZE(front->header.message_size));
+    ring_release(bus, subscriber, bus->rings.peeked_type[subscriber]);
+    return true;
+}
+
+static bool validate_message(const Message* message) {
+    if (!VALIDATE_MESSAGE_TYPE(message->header.type) ||
+        message->header.message_size > MESSAGE_PAYLOAD_SIZES[message->header.type]) {
+        LOG_ERROR(LOG_BUS, "Invalid message type %d or size %u",
+                message->header.type, message->header.message_size);
+        return false;
     }
-    fprintf(stderr, "Bus: Created/opened semaphore\n");
-    return mutex;
+    return true;
 }
 
-Bus* bus_init(void) {
-    fprintf(stderr, "Bus: Initializing...\n");
-    
-    // Create shared memory
-    int shm_id = shmget(IPC_PRIVATE, sizeof(Bus), IPC_CREAT | 0666);
-    if (shm_id == -1) {
-        fprintf(stderr, "Bus: shmget failed: %s\n", strerror(errno));
-        return NULL;
+// Claim count consecutive queue positions without the mutex. Readers free
+// slots in order, so the last one being free means all of them are.
+// Returns false without blocking when the queue lacks room.
+static bool queue_claim(MessageQueue* queue, uint32_t count, uint64_t* claimed) {
+    uint64_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+
+    for (;;) {
+        uint64_t last = pos + count - 1;
+        uint64_t seq = atomic_load_explicit(&queue_slot(queue, last)->seq,
+                                            memory_order_acquire);
+        int64_t diff = (int64_t)(seq - last);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + count,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *claimed = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;  // A reader has not freed the slot yet
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
     }
-    fprintf(stderr, "Bus: Created shared memory with ID: %d\n", shm_id);
+}
 
-    // Attach to shared memory
-    Bus* bus = (Bus*)shmat(shm_id, NULL, 0);
-    if (bus == (void*)-1) {
-        fprintf(stderr, "Bus: shmat failed: %s\n", strerror(errno));
-        return NULL;
+// Fill a claimed slot and make it visible to the subscribers in recipients
+static void queue_fill(Bus* bus, MessageQueue* queue, uint64_t pos, const Message* message,
+                       uint32_t recipients) {
+    QueueSlot* slot = queue_slot(queue, pos);
+
+    slot->pending = recipients;
+    memcpy(&slot->message, message, MESSAGE_SIZE(message->header.message_size));
+    slot->message.header.send_time_ns = monotonic_ns();
+    count_stored(bus, message->header.type, recipients);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    LOG_DEBUG(LOG_BUS, "Published message type %d from %d to %d (depth: %d)",
+            message->header.type, message->header.sender,
+            message->header.receiver, (int)queue_depth(queue));
+}
+
+// Append same-type messages to one lane for recipients, all of them with
+// one claim when there is room. A full lane is handled by the type's
+// overflow policy. Returns the number appended; the rest are counted as
+// dropped.
+static int queue_push(Bus* bus, MessageQueue* queue, const Message* messages, int count,
+                      uint32_t recipients, uint32_t* woken) {
+    MessageType type = messages[0].header.type;
+    uint64_t pos;
+    int pushed = 0;
+
+    if (!recipients) return count;  // Nobody could ever read them
+    *woken |= recipients;
+
+    if (count > 1 && count <= MAX_BUS_MESSAGES &&
+        queue_claim(queue, (uint32_t)count, &pos)) {
+        for (; pushed < count; pushed++) {
+            queue_fill(bus, queue, pos + (uint64_t)pushed, &messages[pushed], recipients);
+        }
+        return pushed;
     }
 
-    // Initialize bus structure
-    memset(bus, 0, sizeof(Bus));
-    bus->mutex = create_mutex();
-    if (!bus->mutex) {
-        fprintf(stderr, "Bus: Failed to create mutex\n");
-        shmdt(bus);
-        return NULL;
+    uint64_t deadline = block_deadline(bus, type);
+    while (pushed < count) {
+        if (queue_claim(queue, 1, &pos)) {
+            queue_fill(bus, queue, pos, &messages[pushed++], recipients);
+        } else if (!queue_make_room(bus, queue, type, deadline)) {
+            break;
+        }
     }
-    
-    bus->ref_count = 1;
-    bus->shm_id = shm_id;
-    
-    fprintf(stderr, "Bus: Initialization complete\n");
-    return bus;
+    if (pushed < count) {
+        LOG_WARN(LOG_BUS, "Message queue lane %d full (depth: %d)",
+                (int)(queue - bus->queues), (int)queue_depth(queue));
+        for (int i = pushed; i < count; i++) {
+            count_dropped(bus, type, recipients, false);
+        }
+    }
+    return pushed;
 }
 
-void bus_cleanup(Bus* bus) {
-    if (!bus) {
-        fprintf(stderr, "Bus: NULL bus in cleanup\n");
-        return;
-    }
+// Append same-type messages to each recipient's lane. Lanes are filled
+// highest first and each recipient is taken once, so a subscriber moving
+// between lanes does not get two copies. Returns false if any were dropped.
+static bool queue_publish(Bus* bus, const Message* messages, int count, uint32_t recipients,
+                          uint32_t* woken) {
+    MessageType type = messages[0].header.type;
+    bool complete = true;
 
-    fprintf(stderr, "Bus: Starting cleanup (ref_count: %d)\n", bus->ref_count);
-    
-    sem_wait(bus->mutex);
-    bus->ref_count--;
-    fprintf(stderr, "Bus: Decreased ref_count to %d\n", bus->ref_count);
-    
-    if (bus->ref_count == 0) {
-        fprintf(stderr, "Bus: Last reference, cleaning up resources\n");
-        sem_post(bus->mutex);
-        sem_close(bus->mutex);
-        sem_unlink("/airplane_sim_bus");
-        
-        int shm_id = bus->shm_id;
-        shmdt(bus);
-        if (shmctl(shm_id, IPC_RMID, NULL) == -1) {
-            fprintf(stderr, "Bus: Failed to remove shared memory: %s\n", strerror(errno));
+    for (int lane = MSG_NUM_PRIORITIES - 1; lane >= 0 && recipients; lane--) {
+        uint32_t in_lane = recipients &
+                           atomic_load_explicit(&bus->lane_subscribers[lane][type],
+                                                memory_order_acquire);
+        if (!in_lane) continue;
+
+        recipients &= ~in_lane;
+        if (queue_push(bus, &bus->queues[lane], messages, count, in_lane, woken) != count) {
+            complete = false;
         }
-    } else {
-        sem_post(bus->mutex);
-        shmdt(bus);
     }
+    return complete;
 }
 
-static void prune_old_messages(MessageQueue* queue) {
-    if (queue->count == 0) return;
-    
-    time_t now = time(NULL);
-    int pruned = 0;
-    int read_idx = queue->read_idx;
-    
-    while (queue->count > 0) {
-        if (now - queue->timestamps[read_idx] > MESSAGE_TIMEOUT_S) {
-            read_idx = (read_idx + 1) % MAX_BUS_MESSAGES;
-            queue->count--;
-            pruned++;
-        } else {
+// Take the subscriber's next message from one lane. Called with the mutex
+// held. Messages other subscribers still need stay where they are.
+static bool queue_take_locked(Bus* bus, MessageQueue* queue, ComponentId subscriber,
+                              Message* message) {
+    // Try to prune old messages first
+    if (queue_depth(queue) > MAX_BUS_MESSAGES / 2) {
+        prune_old_messages(bus, queue);
+    }
+
+    uint32_t bit = 1u << subscriber;
+    uint64_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    uint64_t pos = atomic_load_explicit(&queue->read_pos[subscriber], memory_order_relaxed);
+    if (pos < head) pos = head;
+
+    for (; pos < tail; pos++) {
+        QueueSlot* slot = queue_slot(queue, pos);
+
+        // Stop at a slot whose producer is still writing it
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) {
             break;
         }
+        if (slot->pending & bit) {
+            memcpy(message, &slot->message, MESSAGE_SIZE(slot->message.header.message_size));
+            slot->pending &= ~bit;
+            count_delivered(bus, message->header.type, subscriber);
+            atomic_store_explicit(&queue->read_pos[subscriber], pos + 1, memory_order_relaxed);
+            queue_advance_locked(bus, queue);
+            return true;
+        }
     }
-    
-    if (pruned > 0) {
-        queue->read_idx = read_idx;
-        fprintf(stderr, "Bus: Pruned %d old messages\n", pruned);
-    }
+
+    atomic_store_explicit(&queue->read_pos[subscriber], pos, memory_order_relaxed);
+    return false;
 }
 
-ErrorCode bus_subscribe(Bus* bus, ComponentId subscriber, MessageType msg_type) {
-    if (!bus) {
-        fprintf(stderr, "Bus: NULL bus in subscribe\n");
-        return ERROR_GENERAL;
+// Reads that cannot find anything skip the mutex entirely
+static bool queue_maybe_pending(Bus* bus, MessageQueue* queue, ComponentId subscriber) {
+    if (!VALIDATE_COMPONENT_ID(subscriber) ||
+        !atomic_load_explicit(&bus->subscriber_types[subscriber], memory_order_relaxed)) {
+        return false;
     }
+    return atomic_load_explicit(&queue->read_pos[subscriber], memory_order_relaxed) <
+           atomic_load_explicit(&queue->tail, memory_order_relaxed);
+}
 
-    fprintf(stderr, "Bus: Component %d subscribing to message type %d\n", 
-            subscriber, msg_type);
+// Hand out messages bus_peek already copied out of a lane's queue or
+// latest-value slots, so mixing peek and read keeps order
+static bool take_peeked(Bus* bus, ComponentId subscriber, int lane, Message* message) {
+    if (!VALIDATE_COMPONENT_ID(subscriber)) return false;
 
-    sem_wait(bus->mutex);
+    PeekBuffer* buffer = &peek_buffers[subscriber][lane];
+    if (buffer->bus != bus || buffer->next == buffer->count) return false;
 
-    // Find free subscription slot
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
-        if (!bus->subscriptions[i].active) {
-            bus->subscriptions[i].subscriber = subscriber;
-            bus->subscriptions[i].msg_type = msg_type;
-            bus->subscriptions[i].active = true;
-            sem_post(bus->mutex);
-            fprintf(stderr, "Bus: Subscription added at slot %d\n", i);
-            return SUCCESS;
-        }
+    const Message* next = &buffer->messages[buffer->next++];
+    memcpy(message, next, MESSAGE_SIZE(next->header.message_size));
+    return true;
+}
+
+// Take the subscriber's next message in one priority lane: anything bus_peek
+// buffered, then its queued messages, then its latest-value slots. Empty
+// lanes are skipped with plain loads, since every poll walks all of them.
+static bool lane_read(Bus* bus, ComponentId subscriber, int lane, Message* message) {
+    const PeekBuffer* buffer = &peek_buffers[subscriber][lane];
+    if (buffer->next < buffer->count && take_peeked(bus, subscriber, lane, message)) {
+        return true;
     }
 
-    sem_post(bus->mutex);
-    fprintf(stderr, "Bus: No free subscription slots\n");
-    return ERROR_GENERAL;
+    if (bus->mode == BUS_MODE_RINGS) {
+        if (ring_read(bus, subscriber, lane, message)) return true;
+    } else if (queue_maybe_pending(bus, &bus->queues[lane], subscriber)) {
+        sem_wait(&bus->mutex);
+        bool found = queue_take_locked(bus, &bus->queues[lane], subscriber, message);
+        sem_post(&bus->mutex);
+        if (found) return true;
+    }
+    return atomic_load_explicit(&bus->latest_pending[subscriber], memory_order_relaxed) &&
+           latest_take(bus, subscriber, lane, message);
+}
+
+// Subscribers that get their own queued copy of a type
+static uint32_t queued_subscribers(Bus* bus, MessageType type) {
+    return atomic_load_explicit(&bus->type_subscribers[type], memory_order_acquire);
 }
 
 ErrorCode bus_publish(Bus* bus, Message* message) {
@@ -170,25 +1537,71 @@ ErrorCode bus_publish(Bus* bus, Message* message) {
         return ERROR_GENERAL;
     }
 
-    sem_wait(bus->mutex);
+    if (!validate_message(message)) {
+        return ERROR_INVALID_DATA;
+    }
+
+    MessageType type = message->header.type;
+    count_published(bus, type, 1);
+    tap_published(message, 1);
+    notify_subscribers(bus, latest_publish(bus, message, latest_subscribers(bus, type)));
 
-    if (bus->queue.count >= MAX_BUS_MESSAGES) {
-        LOG_WARN(LOG_BUS, "Message queue full (count: %d)", bus->queue.count);
-        sem_post(bus->mutex);
-        return ERROR_COMMUNICATION;
+    if (bus->mode == BUS_MODE_RINGS) {
+        return ring_publish(bus, message);
     }
 
-    // Add message to queue
-    memcpy(&bus->queue.messages[bus->queue.write_idx], message, sizeof(Message));
-    bus->queue.write_idx = (bus->queue.write_idx + 1) % MAX_BUS_MESSAGES;
-    bus->queue.count++;
+    uint32_t subscribers = 0;
+    bool complete = queue_publish(bus, message, 1, queued_subscribers(bus, type), &subscribers);
+    notify_subscribers(bus, subscribers);
+    return complete ? SUCCESS : ERROR_COMMUNICATION;
+}
+
+ErrorCode bus_publish_batch(Bus* bus, const Message* messages, int count) {
+    if (!bus || !messages || count < 0) {
+        LOG_ERROR(LOG_BUS, "Invalid parameter in publish_batch");
+        return ERROR_GENERAL;
+    }
 
-    LOG_DEBUG(LOG_BUS, "Published message type %d from %d to %d (count: %d)",
-            message->header.type, message->header.sender, 
-            message->header.receiver, bus->queue.count);
+    for (int i = 0; i < count; i++) {
+        if (!validate_message(&messages[i])) {
+            return ERROR_INVALID_DATA;
+        }
+    }
 
-    sem_post(bus->mutex);
-    return SUCCESS;
+    ErrorCode result = SUCCESS;
+    uint32_t subscribers = 0;
+
+    // Publish each run of same-type messages with one claim per ring or
+    // queue
+    int start = 0;
+    while (start < count) {
+        MessageType type = messages[start].header.type;
+        int end = start + 1;
+        while (end < count && messages[end].header.type == type) {
+            end++;
+        }
+
+        count_published(bus, type, (uint64_t)(end - start));
+        tap_published(&messages[start], end - start);
+        uint32_t latest = latest_subscribers(bus, type);
+        for (int i = start; latest && i < end; i++) {
+            subscribers |= latest_publish(bus, &messages[i], latest);
+        }
+
+        if (bus->mode == BUS_MODE_RINGS) {
+            if (ring_publish_run(bus, &messages[start], end - start, &subscribers) != SUCCESS) {
+                result = ERROR_COMMUNICATION;
+            }
+        } else if (!queue_publish(bus, &messages[start], end - start,
+                                  queued_subscribers(bus, type), &subscribers)) {
+            result = ERROR_COMMUNICATION;
+        }
+        start = end;
+    }
+
+    // One wakeup per subscriber for the whole batch
+    notify_subscribers(bus, subscribers);
+    return result;
 }
 
 bool bus_read_message(Bus* bus, ComponentId subscriber, Message* message) {
@@ -196,52 +1609,376 @@ bool bus_read_message(Bus* bus, ComponentId subscriber, Message* message) {
         fprintf(stderr, "Bus: NULL parameter in read_message\n");
         return false;
     }
+    if (!VALIDATE_COMPONENT_ID(subscriber)) {
+        return false;
+    }
+
+    for (int lane = MSG_NUM_PRIORITIES - 1; lane >= 0; lane--) {
+        if (lane_read(bus, subscriber, lane, message)) return true;
+    }
+    return false;
+}
 
-    sem_wait(bus->mutex);
+int bus_read_batch(Bus* bus, ComponentId subscriber, Message* messages, int max_count) {
+    if (!bus || !messages || max_count < 0) {
+        fprintf(stderr, "Bus: Invalid parameter in read_batch\n");
+        return 0;
+    }
 
-    // Try to prune old messages first
-    if (bus->queue.count > MAX_BUS_MESSAGES / 2) {
-        prune_old_messages(&bus->queue);
+    int count = 0;
+
+    // Drain lane by lane, so the batch is in priority order
+    for (int lane = MSG_NUM_PRIORITIES - 1; lane >= 0 && count < max_count; lane--) {
+        MessageQueue* queue = &bus->queues[lane];
+
+        while (count < max_count && take_peeked(bus, subscriber, lane, &messages[count])) {
+            count++;
+        }
+
+        if (bus->mode == BUS_MODE_RINGS) {
+            while (count < max_count && ring_read(bus, subscriber, lane, &messages[count])) {
+                count++;
+            }
+        } else if (queue_maybe_pending(bus, queue, subscriber)) {
+            sem_wait(&bus->mutex);
+            while (count < max_count &&
+                   queue_take_locked(bus, queue, subscriber, &messages[count])) {
+                count++;
+            }
+            sem_post(&bus->mutex);
+        }
+
+        while (count < max_count && latest_take(bus, subscriber, lane, &messages[count])) {
+            count++;
+        }
     }
+    return count;
+}
 
-    if (bus->queue.count == 0) {
-        sem_post(bus->mutex);
+bool bus_wait_message(Bus* bus, ComponentId subscriber, Message* message, int timeout_ms) {
+    if (!bus || !message || !VALIDATE_COMPONENT_ID(subscriber)) {
+        LOG_ERROR(LOG_BUS, "Invalid parameter in wait_message");
         return false;
     }
 
-    // Check if message is for this subscriber
-    int current = bus->queue.read_idx;
-    int checked = 0;
-    bool found = false;
+    SubscriberWakeup* wakeup = &bus->wakeups[subscriber];
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms > 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    for (;;) {
+        // Register as a waiter before checking, so a publish racing with the
+        // check either is seen by the read or changes the futex word
+        atomic_fetch_add(&wakeup->waiters, 1);
+        uint32_t seen = atomic_load(&wakeup->futex);
 
-    while (checked < bus->queue.count && !found) {
-        Message* current_msg = &bus->queue.messages[current];
-        
-        // Check subscriptions
-        for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
-            if (bus->subscriptions[i].active &&
-                bus->subscriptions[i].subscriber == subscriber &&
-                bus->subscriptions[i].msg_type == current_msg->header.type) {
-                memcpy(message, current_msg, sizeof(Message));
-                found = true;
+        if (bus_read_message(bus, subscriber, message)) {
+            atomic_fetch_sub(&wakeup->waiters, 1);
+            return true;
+        }
+        if (timeout_ms == 0) {
+            atomic_fetch_sub(&wakeup->waiters, 1);
+            return false;
+        }
+
+        struct timespec remaining;
+        struct timespec* timeout = NULL;
+        if (timeout_ms > 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+            remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (remaining.tv_nsec < 0) {
+                remaining.tv_sec--;
+                remaining.tv_nsec += 1000000000;
+            }
+            if (remaining.tv_sec < 0) {
+                atomic_fetch_sub(&wakeup->waiters, 1);
+                return false;
+            }
+            timeout = &remaining;
+        }
+
+        long result = futex(&wakeup->futex, FUTEX_WAIT, seen, timeout);
+        atomic_fetch_sub(&wakeup->waiters, 1);
+
+        if (result < 0 && errno == ETIMEDOUT) {
+            return bus_read_message(bus, subscriber, message);
+        }
+        if (result < 0 && errno == EINTR) {
+            // Let signal handlers (e.g. shutdown requests) take effect
+            return bus_read_message(bus, subscriber, message);
+        }
+    }
+}
+
+Message* bus_reserve(Bus* bus, MessageType type, uint32_t size) {
+    if (!bus || !VALIDATE_MESSAGE_TYPE(type) || size > MESSAGE_PAYLOAD_SIZES[type]) {
+        LOG_ERROR(LOG_BUS, "Invalid parameter in reserve (type %d, size %u)", type, size);
+        return NULL;
+    }
+    if (reservation.bus) {
+        LOG_ERROR(LOG_BUS, "Reserve called with a reservation outstanding");
+        return NULL;
+    }
+
+    Message* message = &scratch_message;
+    reservation = (Reservation){ .bus = bus, .type = type, .size = size };
+
+    if (bus->mode == BUS_MODE_RINGS) {
+        uint32_t subscribers = queued_subscribers(bus, type);
+
+        // Write in place into the first subscriber ring with room; the
+        // others get a copy of the finished message at commit
+        while (subscribers) {
+            int subscriber = __builtin_ctz(subscribers);
+            subscribers &= subscribers - 1;
+
+            RingSlot* slot = ring_claim(bus, subscriber, type, &reservation.pos);
+            if (slot) {
+                reservation.slot = slot;
+                reservation.primary = subscriber;
+                reservation.subscribers = subscribers;
+                message = &slot->message;
                 break;
             }
+            reservation.skipped |= 1u << subscriber;
+        }
+    }
+
+    memset(&message->header, 0, sizeof(message->header));
+    message->header.type = type;
+    message->header.message_size = size;
+    return message;
+}
+
+ErrorCode bus_commit(Bus* bus, Message* message) {
+    if (!bus || !message || reservation.bus != bus) {
+        LOG_ERROR(LOG_BUS, "Commit without a matching reservation");
+        return ERROR_GENERAL;
+    }
+
+    Reservation current = reservation;
+    reservation.bus = NULL;
+
+    // Type and size are fixed by the reservation; the slot is sized for them
+    message->header.type = current.type;
+    message->header.message_size = current.size;
+
+    if (!current.slot) {
+        return bus_publish(bus, message);
+    }
+
+    ErrorCode result = SUCCESS;
+    uint32_t subscribers = current.subscribers | current.skipped;
+
+    count_published(bus, current.type, 1);
+    tap_published(message, 1);
+    notify_subscribers(bus, latest_publish(bus, message, latest_subscribers(bus, current.type)));
+
+    // Copy out before committing the primary slot, whose consumer may
+    // release and recycle it as soon as it becomes visible
+    while (subscribers) {
+        int subscriber = __builtin_ctz(subscribers);
+        subscribers &= subscribers - 1;
+
+        if (ring_push_policy(bus, subscriber, message)) {
+            notify_subscriber(bus, subscriber);
+        } else {
+            result = ERROR_COMMUNICATION;
+        }
+    }
+
+    ring_commit(bus, current.primary, current.slot, current.pos);
+    notify_subscriber(bus, current.primary);
+    return result;
+}
+
+const Message* bus_peek(Bus* bus, ComponentId subscriber) {
+    if (!bus) {
+        fprintf(stderr, "Bus: NULL parameter in peek\n");
+        return NULL;
+    }
+
+    if (!VALIDATE_COMPONENT_ID(subscriber)) {
+        return NULL;
+    }
+
+    for (int lane = MSG_NUM_PRIORITIES - 1; lane >= 0; lane--) {
+        PeekBuffer* buffer = &peek_buffers[subscriber][lane];
+        MessageQueue* queue = &bus->queues[lane];
+
+        if (buffer->bus != bus) {
+            buffer->bus = bus;
+            buffer->next = buffer->count = 0;
+        }
+        if (buffer->next < buffer->count) {
+            return &buffer->messages[buffer->next];
+        }
+        buffer->next = buffer->count = 0;
+
+        if (bus->mode == BUS_MODE_RINGS) {
+            const Message* front = ring_peek(bus, subscriber, lane);
+            if (front) return front;
+        } else if (queue_maybe_pending(bus, queue, subscriber)) {
+            sem_wait(&bus->mutex);
+            while (buffer->count < PEEK_BATCH &&
+                   queue_take_locked(bus, queue, subscriber, &buffer->messages[buffer->count])) {
+                buffer->count++;
+            }
+            sem_post(&bus->mutex);
         }
 
-        if (!found) {
-            current = (current + 1) % MAX_BUS_MESSAGES;
-            checked++;
+        // Latest-value slots are copied out, so they are served from the
+        // buffer in both modes
+        while (buffer->count < PEEK_BATCH &&
+               latest_take(bus, subscriber, lane, &buffer->messages[buffer->count])) {
+            buffer->count++;
+        }
+        if (buffer->count) return &buffer->messages[0];
+    }
+
+    return NULL;
+}
+
+void bus_release(Bus* bus, ComponentId subscriber, const Message* message) {
+    if (!bus || !message || !VALIDATE_COMPONENT_ID(subscriber)) return;
+
+    for (int lane = 0; lane < MSG_NUM_PRIORITIES; lane++) {
+        PeekBuffer* buffer = &peek_buffers[subscriber][lane];
+        if (buffer->bus == bus && buffer->next < buffer->count &&
+            message == &buffer->messages[buffer->next]) {
+            buffer->next++;
+            return;
         }
     }
 
-    if (found) {
-        // Remove message from queue
-        bus->queue.read_idx = (current + 1) % MAX_BUS_MESSAGES;
-        bus->queue.count--;
+    if (bus->mode == BUS_MODE_RINGS) {
+        ring_release(bus, subscriber, bus->rings.peeked_type[subscriber]);
+    }
+}
+
+int bus_get_wait_fd(Bus* bus, ComponentId subscriber) {
+    if (!bus || !VALIDATE_COMPONENT_ID(subscriber)) {
+        fprintf(stderr, "Bus: Invalid parameter in get_wait_fd\n");
+        return -1;
+    }
+
+    if (is_opened_by_name(bus)) {
+        return -1;  // The descriptors live in the creator's process tree
     }
 
-    sem_post(bus->mutex);
-    return found;
+    atomic_store(&bus->wakeups[subscriber].fd_armed, true);
+    return bus->wakeups[subscriber].event_fd;
+}
+
+void bus_ack_wait_fd(Bus* bus, ComponentId subscriber) {
+    if (!bus || !VALIDATE_COMPONENT_ID(subscriber)) return;
+
+    SubscriberWakeup* wakeup = &bus->wakeups[subscriber];
+    uint64_t value;
+    if (read(wakeup->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        LOG_WARN(LOG_BUS, "Failed to clear wait fd: %s", strerror(errno));
+    }
+
+    // Re-arm before the caller drains; anything published after this point
+    // signals the descriptor again
+    atomic_store(&wakeup->fd_armed, true);
+}
+
+ErrorCode bus_set_topic_policy(Bus* bus, MessageType type, const BusTopicPolicy* policy) {
+    if (!bus || !policy || !VALIDATE_MESSAGE_TYPE(type) ||
+        policy->overflow < BUS_OVERFLOW_DROP_NEWEST || policy->overflow > BUS_OVERFLOW_PRIORITY) {
+        LOG_ERROR(LOG_BUS, "Invalid topic policy for type %d", type);
+        return ERROR_INVALID_DATA;
+    }
+
+    bus->policies[type] = *policy;
+    LOG_INFO(LOG_BUS, "Type %d overflow policy %d (timeout %d ms, priority %d)",
+             type, policy->overflow, policy->timeout_ms, policy->priority);
+    return SUCCESS;
+}
+
+// Fold one (subscriber, type) cell into an aggregate. Depths of a topic
+// are its longest backlog at any subscriber, depths of a subscriber the sum
+// over its topics.
+static void add_stats(const StatCounters* counters, BusStats* stats, bool sum_depth) {
+    uint32_t depth = (uint32_t)stat_depth(counters);
+    uint32_t max_depth = atomic_load_explicit(&counters->max_depth, memory_order_relaxed);
+
+    stats->published += atomic_load_explicit(&counters->published, memory_order_relaxed);
+    stats->delivered += atomic_load_explicit(&counters->delivered, memory_order_relaxed);
+    stats->dropped += atomic_load_explicit(&counters->dropped, memory_order_relaxed);
+    stats->conflated += atomic_load_explicit(&counters->conflated, memory_order_relaxed);
+    if (sum_depth) {
+        stats->depth += depth;
+    } else if (depth > stats->depth) {
+        stats->depth = depth;
+    }
+    if (max_depth > stats->max_depth) stats->max_depth = max_depth;
+}
+
+ErrorCode bus_get_topic_stats(Bus* bus, MessageType type, BusStats* stats) {
+    if (!bus || !stats || !VALIDATE_MESSAGE_TYPE(type)) return ERROR_INVALID_DATA;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        add_stats(&bus->stats[c][type], stats, false);
+    }
+    // Offered messages, not copies routed to subscribers
+    stats->published = atomic_load_explicit(&bus->topic_published[type].published,
+                                            memory_order_relaxed);
+    return SUCCESS;
+}
+
+ErrorCode bus_get_subscriber_stats(Bus* bus, ComponentId subscriber, BusStats* stats) {
+    if (!bus || !stats || !VALIDATE_COMPONENT_ID(subscriber)) return ERROR_INVALID_DATA;
+
+    memset(stats, 0, sizeof(*stats));
+    for (int t = 0; t < MSG_NUM_TYPES; t++) {
+        add_stats(&bus->stats[subscriber][t], stats, true);
+    }
+    return SUCCESS;
+}
+
+static void print_stats_row(FILE* out, const char* kind, int id, const BusStats* stats) {
+    fprintf(out, "%-10s %2d %12llu %12llu %10llu %10llu %6u %6u\n", kind, id,
+            (unsigned long long)stats->published, (unsigned long long)stats->delivered,
+            (unsigned long long)stats->dropped, (unsigned long long)stats->conflated,
+            stats->depth, stats->max_depth);
+}
+
+void bus_dump_stats(Bus* bus, FILE* out) {
+    if (!bus || !out) return;
+
+    fprintf(out, "%-13s %12s %12s %10s %10s %6s %6s\n", "Bus stats",
+            "published", "delivered", "dropped", "conflated", "depth", "max");
+
+    BusStats stats;
+    for (int t = 0; t < MSG_NUM_TYPES; t++) {
+        bus_get_topic_stats(bus, (MessageType)t, &stats);
+        if (stats.published) print_stats_row(out, "type", t, &stats);
+    }
+    for (int c = 0; c < MAX_COMPONENTS; c++) {
+        bus_get_subscriber_stats(bus, (ComponentId)c, &stats);
+        if (stats.published) print_stats_row(out, "subscriber", c, &stats);
+    }
+    fflush(out);
+}
+
+FlightStateSnapshot* bus_state_snapshot(Bus* bus) {
+    return bus ? &bus->state_snapshot : NULL;
+}
+
+BusMode bus_get_mode(const Bus* bus) {
+    return bus ? bus->mode : BUS_MODE_QUEUE;
 }
 
 int bus_get_shm_id(Bus* bus) {
@@ -261,11 +1998,69 @@ Bus* bus_attach(int shm_id) {
         return NULL;
     }
     
-    sem_wait(bus->mutex);
+    sem_wait(&bus->mutex);
     bus->ref_count++;
     fprintf(stderr, "Bus: Attached successfully, ref_count now %d\n", bus->ref_count);
-    sem_post(bus->mutex);
+    sem_post(&bus->mutex);
     
+    lock_segment(bus);
+    return bus;
+}
+
+Bus* bus_attach_inherited(Bus* bus) {
+    if (!bus) {
+        fprintf(stderr, "Bus: NULL bus in attach_inherited\n");
+        return NULL;
+    }
+
+    sem_wait(&bus->mutex);
+    bus->ref_count++;
+    fprintf(stderr, "Bus: Attached inherited mapping, ref_count now %d\n", bus->ref_count);
+    sem_post(&bus->mutex);
+
+    lock_segment(bus);
+    return bus;
+}
+
+Bus* bus_open(const char* name) {
+    if (!name) {
+        fprintf(stderr, "Bus: bus_open needs the segment name printed by its creator\n");
+        return NULL;
+    }
+    fprintf(stderr, "Bus: Opening %s\n", name);
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Bus: shm_open %s failed: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    Bus* bus = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Bus)) {
+        bus = map_shared_fd(fd, (size_t)st.st_size, true);
+    }
+    close(fd);
+
+    if (!bus) {
+        fprintf(stderr, "Bus: Failed to map %s\n", name);
+        return NULL;
+    }
+    if (bus->magic != BUS_MAGIC || bus->segment_size != (size_t)st.st_size ||
+        bus->segment_size < bus_segment_size()) {
+        fprintf(stderr, "Bus: %s is not an initialized bus segment\n", name);
+        munmap(bus, (size_t)st.st_size);
+        return NULL;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    sem_wait(&bus->mutex);
+    bus->ref_count++;
+    fprintf(stderr, "Bus: Opened %s, ref_count now %d\n", name, bus->ref_count);
+    sem_post(&bus->mutex);
+
+    set_opened_by_name(bus, true);
+    lock_segment(bus);
     return bus;
 }
 
@@ -0,0 +1,151 @@
+#define _GNU_SOURCE  // pthread affinity
+#include "component.h"
+#include "trace.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+// Loop timing of one component
+typedef struct {
+    LatencyHistogram jitter;      // Wake-up time minus deadline
+    _Atomic uint64_t overruns;    // Steps restarted after falling a period behind
+} ComponentTiming;
+
+// Stop request of the component running on this thread, if any
+static _Thread_local const atomic_bool* stop_flag;
+
+// Shared with forked components; NULL until component_timing_init()
+static ComponentTiming* timings;
+
+bool component_running(void) {
+    return !stop_flag || !atomic_load_explicit(stop_flag, memory_order_acquire);
+}
+
+void component_bind_stop_flag(const atomic_bool* stop) {
+    stop_flag = stop;
+}
+
+ErrorCode component_apply_schedule(const ComponentSchedule* schedule) {
+    if (!schedule) return ERROR_GENERAL;
+    ErrorCode result = SUCCESS;
+
+    if (schedule->cpu_mask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if (schedule->cpu_mask & (1ull << cpu)) CPU_SET(cpu, &cpus);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            fprintf(stderr, "Setting CPU affinity failed: %s\n", strerror(err));
+            result = ERROR_GENERAL;
+        }
+    }
+
+    if (schedule->rt_priority > 0) {
+        struct sched_param param = { .sched_priority = schedule->rt_priority };
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            fprintf(stderr, "Setting SCHED_FIFO priority %d failed: %s\n",
+                    schedule->rt_priority, strerror(err));
+            result = ERROR_GENERAL;
+        }
+    }
+
+    // Fault everything in now, and what is mapped later as it is mapped,
+    // so the loop never stalls on a page fault
+    if (schedule->lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fprintf(stderr, "mlockall failed: %s\n", strerror(errno));
+        result = ERROR_GENERAL;
+    }
+
+    return result;
+}
+
+void component_pacer_init(ComponentPacer* pacer, ComponentId component, uint32_t period_ms) {
+    pacer->component = component;
+    pacer->period_ns = (uint64_t)period_ms * 1000000ull;
+    pacer->deadline_ns = monotonic_ns() + pacer->period_ns;
+}
+
+void component_pacer_set_period(ComponentPacer* pacer, uint32_t period_ms) {
+    uint64_t period_ns = (uint64_t)period_ms * 1000000ull;
+    if (period_ns == pacer->period_ns) return;
+    pacer->deadline_ns = pacer->deadline_ns - pacer->period_ns + period_ns;
+    pacer->period_ns = period_ns;
+}
+
+int component_pacer_remaining_ms(const ComponentPacer* pacer) {
+    int64_t remaining = (int64_t)(pacer->deadline_ns - monotonic_ns());
+    return (int)(remaining / 1000000);
+}
+
+void component_pacer_wait(ComponentPacer* pacer) {
+    struct timespec deadline = {
+        .tv_sec = (time_t)(pacer->deadline_ns / 1000000000ull),
+        .tv_nsec = (long)(pacer->deadline_ns % 1000000000ull)
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+
+    uint64_t now = monotonic_ns();
+    uint64_t late = now > pacer->deadline_ns ? now - pacer->deadline_ns : 0;
+    ComponentTiming* timing = timings && VALIDATE_COMPONENT_ID(pacer->component)
+        ? &timings[pacer->component] : NULL;
+    if (timing) {
+        latency_histogram_add(&timing->jitter, late);
+    }
+
+    if (late > pacer->period_ns) {
+        if (timing) atomic_fetch_add_explicit(&timing->overruns, 1, memory_order_relaxed);
+        pacer->deadline_ns = now + pacer->period_ns;  // Fell behind, don't try to catch up
+    } else {
+        pacer->deadline_ns += pacer->period_ns;
+    }
+}
+
+bool component_timing_init(void) {
+    if (timings) return true;
+
+    void* addr = mmap(NULL, sizeof(ComponentTiming) * MAX_COMPONENTS,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return false;
+
+    timings = addr;  // Anonymous mappings start zeroed
+    return true;
+}
+
+void component_timing_cleanup(void) {
+    if (!timings) return;
+    munmap(timings, sizeof(ComponentTiming) * MAX_COMPONENTS);
+    timings = NULL;
+}
+
+void component_timing_dump(FILE* out) {
+    if (!timings) {
+        fprintf(out, "Loop timing: not initialized\n");
+        return;
+    }
+
+    fprintf(out, "%-38s %10s %10s %10s %10s %10s %10s\n",
+            "Loop jitter (us)", "steps", "p50", "p99", "p999", "max", "overruns");
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        const ComponentTiming* timing = &timings[i];
+        uint64_t steps = atomic_load_explicit(&timing->jitter.count, memory_order_relaxed);
+        if (steps == 0) continue;  // Not a paced loop
+
+        fprintf(out, "%-38s %10llu %10.1f %10.1f %10.1f %10.1f %10llu\n", component_name(i),
+                (unsigned long long)steps,
+                latency_histogram_percentile(&timing->jitter, 50.0) / 1e3,
+                latency_histogram_percentile(&timing->jitter, 99.0) / 1e3,
+                latency_histogram_percentile(&timing->jitter, 99.9) / 1e3,
+                atomic_load_explicit(&timing->jitter.max, memory_order_relaxed) / 1e3,
+                (unsigned long long)atomic_load_explicit(&timing->overruns,
+                                                         memory_order_relaxed));
+    }
+    fflush(out);
+}
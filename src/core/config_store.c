@@ -0,0 +1,309 @@
+#include "config_store.h"
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <json-c/json.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+
+#define MIN_INTERVAL_MS 1
+#define MAX_INTERVAL_MS 1000
+
+// Seqlock with a single writer, as the flight state snapshot: seq is odd
+// while a publish is in progress, and a reader that saw it change while it
+// copied copies again. The current version is seq / 2.
+typedef struct {
+    _Atomic uint32_t seq;
+    ConfigSnapshot snapshot;
+} ConfigRegion;
+
+// Shared with forked components; NULL until config_store_init()
+static ConfigRegion* region;
+
+bool config_store_init(void) {
+    if (region) return true;
+
+    void* addr = mmap(NULL, sizeof(ConfigRegion), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return false;
+
+    region = addr;  // Anonymous mappings start zeroed
+    return true;
+}
+
+void config_store_cleanup(void) {
+    if (!region) return;
+    munmap(region, sizeof(ConfigRegion));
+    region = NULL;
+}
+
+ConfigSnapshot config_store_defaults(void) {
+    ConfigSnapshot snapshot = {
+        .version = 0,
+        .autopilot = autopilot_default_config(),
+        .autopilot_interval_ms = AUTOPILOT_UPDATE_INTERVAL_MS,
+        .ins_interval_ms = INS_UPDATE_INTERVAL_MS,
+        .ins_noise = ins_batch_default_noise()
+    };
+    return snapshot;
+}
+
+static bool parse_number(json_object* val, double* out) {
+    if (!json_object_is_type(val, json_type_double) && !json_object_is_type(val, json_type_int)) {
+        return false;
+    }
+    *out = json_object_get_double(val);
+    return true;
+}
+
+static bool parse_interval(json_object* val, uint32_t* out) {
+    if (!json_object_is_type(val, json_type_int)) return false;
+    int64_t ms = json_object_get_int64(val);
+    if (ms < 0 || ms > UINT32_MAX) return false;
+    *out = (uint32_t)ms;
+    return true;
+}
+
+static ErrorCode parse_simulation(const char* filename, ConfigSnapshot* snapshot) {
+    json_object* root = json_object_from_file(filename);
+    if (!root) {
+        fprintf(stderr, "Config: failed to parse %s\n", filename);
+        return ERROR_GENERAL;
+    }
+    if (json_object_get_type(root) != json_type_object) {
+        fprintf(stderr, "Config: %s is not a JSON object\n", filename);
+        json_object_put(root);
+        return ERROR_INVALID_DATA;
+    }
+
+    ErrorCode result = SUCCESS;
+    json_object_object_foreach(root, key, val) {
+        bool valid;
+        if (strcmp(key, "autopilot_update_interval_ms") == 0)
+            valid = parse_interval(val, &snapshot->autopilot_interval_ms);
+        else if (strcmp(key, "ins_update_interval_ms") == 0)
+            valid = parse_interval(val, &snapshot->ins_interval_ms);
+        else if (strcmp(key, "ins_accel_noise") == 0)
+            valid = parse_number(val, &snapshot->ins_noise.accel);
+        else if (strcmp(key, "ins_gyro_noise") == 0)
+            valid = parse_number(val, &snapshot->ins_noise.gyro);
+        else if (strcmp(key, "ins_mag_noise") == 0)
+            valid = parse_number(val, &snapshot->ins_noise.mag);
+        else if (strcmp(key, "ins_accel_bias_drift") == 0)
+            valid = parse_number(val, &snapshot->ins_noise.accel_bias_drift);
+        else if (strcmp(key, "ins_gyro_bias_drift") == 0)
+            valid = parse_number(val, &snapshot->ins_noise.gyro_bias_drift);
+        else {
+            fprintf(stderr, "Config: unknown setting %s in %s\n", key, filename);
+            valid = true;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Config: invalid value for %s in %s\n", key, filename);
+            result = ERROR_INVALID_DATA;
+            break;
+        }
+    }
+
+    json_object_put(root);
+    return result;
+}
+
+ErrorCode config_store_load(ConfigSnapshot* snapshot, const char* autopilot_file,
+                            const char* simulation_file) {
+    if (!snapshot) return ERROR_GENERAL;
+    if (!autopilot_file) autopilot_file = CONFIG_AUTOPILOT_FILE;
+    if (!simulation_file) simulation_file = CONFIG_SIMULATION_FILE;
+
+    ConfigSnapshot loaded = config_store_defaults();
+
+    if (access(autopilot_file, F_OK) != 0) {
+        fprintf(stderr, "Config: no %s, using the default autopilot config\n", autopilot_file);
+    } else {
+        ErrorCode err = autopilot_parse_config(autopilot_file, &loaded.autopilot);
+        if (err != SUCCESS) {
+            fprintf(stderr, "Config: %s %s\n", err == ERROR_INVALID_DATA
+                    ? "wrong type of value in" : "failed to parse", autopilot_file);
+            return ERROR_INVALID_DATA;
+        }
+    }
+
+    if (access(simulation_file, F_OK) == 0) {
+        ErrorCode err = parse_simulation(simulation_file, &loaded);
+        if (err != SUCCESS) return err;
+    }
+
+    ErrorCode err = config_store_validate(&loaded);
+    if (err != SUCCESS) return err;
+
+    *snapshot = loaded;
+    return SUCCESS;
+}
+
+static bool check(bool ok, const char* what) {
+    if (!ok) fprintf(stderr, "Config: %s\n", what);
+    return ok;
+}
+
+static bool finite_all(const double* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!isfinite(values[i])) return false;
+    }
+    return true;
+}
+
+static bool non_negative_all(const double* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (values[i] < 0.0) return false;
+    }
+    return true;
+}
+
+ErrorCode config_store_validate(const ConfigSnapshot* snapshot) {
+    if (!snapshot) return ERROR_GENERAL;
+
+    const AutopilotConfig* ap = &snapshot->autopilot;
+    const INSNoiseParams* noise = &snapshot->ins_noise;
+
+    // Both structs are nothing but doubles
+    bool ok = check(finite_all((const double*)ap, sizeof(*ap) / sizeof(double)) &&
+                    finite_all((const double*)noise, sizeof(*noise) / sizeof(double)),
+                    "every value must be a finite number");
+    ok &= check(non_negative_all(ap->heading_pid, 3) && non_negative_all(ap->altitude_pid, 3) &&
+                non_negative_all(ap->speed_pid, 3), "PID gains must not be negative");
+    ok &= check(ap->target_latitude >= -90.0 && ap->target_latitude <= 90.0 &&
+                ap->target_longitude >= -180.0 && ap->target_longitude <= 180.0,
+                "target position out of range");
+    ok &= check(ap->target_heading >= 0.0 && ap->target_heading < 360.0,
+                "target_heading must be in [0, 360)");
+    ok &= check(ap->max_climb_rate > 0.0 && ap->max_descent_rate > 0.0 &&
+                ap->max_heading_rate > 0.0, "rate limits must be positive");
+    ok &= check(ap->max_bank_angle > 0.0 && ap->max_bank_angle <= 90.0 &&
+                ap->max_pitch_angle > 0.0 && ap->max_pitch_angle <= 90.0,
+                "angle limits must be in (0, 90]");
+    ok &= check(ap->min_speed > 0.0 && ap->min_speed < ap->max_speed,
+                "need 0 < min_speed < max_speed");
+    ok &= check(snapshot->autopilot_interval_ms >= MIN_INTERVAL_MS &&
+                snapshot->autopilot_interval_ms <= MAX_INTERVAL_MS &&
+                snapshot->ins_interval_ms >= MIN_INTERVAL_MS &&
+                snapshot->ins_interval_ms <= MAX_INTERVAL_MS,
+                "update intervals must be 1-1000 ms");
+    ok &= check(non_negative_all((const double*)noise, sizeof(*noise) / sizeof(double)),
+                "INS noise must not be negative");
+
+    return ok ? SUCCESS : ERROR_INVALID_DATA;
+}
+
+uint32_t config_store_publish(const ConfigSnapshot* snapshot) {
+    if (!region || !snapshot) return 0;
+
+    // Single writer: only the flight controller publishes
+    uint32_t seq = atomic_load_explicit(&region->seq, memory_order_relaxed);
+    uint32_t version = seq / 2 + 1;
+    atomic_store_explicit(&region->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);  // Odd seq is visible before any data
+
+    region->snapshot = *snapshot;
+    region->snapshot.version = version;
+
+    atomic_store_explicit(&region->seq, seq + 2, memory_order_release);
+    return version;
+}
+
+uint32_t config_store_version(void) {
+    return region ? atomic_load_explicit(&region->seq, memory_order_acquire) / 2 : 0;
+}
+
+uint32_t config_store_read(ConfigSnapshot* snapshot) {
+    if (!region || !snapshot) return 0;
+
+    uint32_t spins = 0;
+    do {
+        uint32_t begin = atomic_load_explicit(&region->seq, memory_order_acquire);
+        if (begin == 0) return 0;
+        if (begin & 1) continue;  // Publish in progress
+
+        ConfigSnapshot copy;
+        memcpy(&copy, &region->snapshot, sizeof(copy));
+        atomic_thread_fence(memory_order_acquire);  // Copy completes before the recheck
+
+        // Unchanged sequence means no publish overlapped the copy
+        if (atomic_load_explicit(&region->seq, memory_order_relaxed) == begin) {
+            *snapshot = copy;
+            return begin / 2;
+        }
+    } while (spin_wait(&spins));
+
+    // The publisher died mid-publish
+    fprintf(stderr, "Config: snapshot stuck mid-publish\n");
+    return 0;
+}
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static bool watch_directory(int fd, const char* path) {
+    char dir[PATH_MAX];
+    const char* slash = strrchr(path, '/');
+    if (!slash) {
+        snprintf(dir, sizeof(dir), ".");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    }
+    // Editors and tools that write a temporary file and rename it over
+    // the original only show up as IN_MOVED_TO
+    return inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) >= 0;
+}
+
+bool config_watch_init(ConfigWatch* watch, const char* autopilot_file,
+                       const char* simulation_file) {
+    if (!watch) return false;
+    if (!autopilot_file) autopilot_file = CONFIG_AUTOPILOT_FILE;
+    if (!simulation_file) simulation_file = CONFIG_SIMULATION_FILE;
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        fprintf(stderr, "Config: inotify failed: %s\n", strerror(errno));
+        return false;
+    }
+    if (!watch_directory(watch->fd, autopilot_file) ||
+        !watch_directory(watch->fd, simulation_file)) {
+        fprintf(stderr, "Config: cannot watch the config directory: %s\n", strerror(errno));
+        config_watch_cleanup(watch);
+        return false;
+    }
+    watch->names[0] = base_name(autopilot_file);
+    watch->names[1] = base_name(simulation_file);
+    return true;
+}
+
+bool config_watch_changed(ConfigWatch* watch) {
+    if (!watch || watch->fd < 0) return false;
+
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (char* next = buffer; next < buffer + length; ) {
+            const struct inotify_event* event = (const struct inotify_event*)next;
+            if (event->len > 0 && (strcmp(event->name, watch->names[0]) == 0 ||
+                                   strcmp(event->name, watch->names[1]) == 0)) {
+                changed = true;
+            }
+            next += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return changed;
+}
+
+void config_watch_cleanup(ConfigWatch* watch) {
+    if (!watch || watch->fd < 0) return;
+    close(watch->fd);
+    watch->fd = -1;
+}
@@ -1,35 +1,232 @@
+#define _GNU_SOURCE  // pthread affinity and thread names
 #include "flight_controller.h"
+#include "autopilot.h"
+#include "component.h"
+#include "config_store.h"
+#include "gps_receiver.h"
+#include "ins.h"
+#include "landing_radio.h"
 #include "log.h"
+#include "metrics.h"
+#include "sat_com.h"
+#include "scheduler.h"
+#include "sensor_feed.h"
+#include "sim_clock.h"
+#include "standby.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <signal.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <json-c/json.h>
 
 #define MAX_COMPONENTS 6  
+// How long cleanup waits for threaded components to leave their main loops
+#define THREAD_STOP_TIMEOUT_MS 2000
+// Longest single wait in flight_controller_wait_ready(), to notice a stop
+#define READY_POLL_MS 100
+
+// Step periods under FC_EXEC_SCHEDULER, matching the rates of the
+// components' own main loops
+static const uint32_t COMPONENT_STEP_MS[MAX_COMPONENTS] = {
+    [COMPONENT_FLIGHT_CONTROLLER] = 10,
+    [COMPONENT_AUTOPILOT] = 100,
+    [COMPONENT_GPS] = 10,
+    [COMPONENT_INS] = 10,
+    [COMPONENT_LANDING_RADIO] = 10,
+    [COMPONENT_SAT_COM] = 100
+};
+
+// Component run as a thread (FC_EXEC_THREADS)
+typedef struct {
+    FlightController* fc;
+    ComponentId component;
+    pthread_t thread;
+    bool started;                 // Not joined yet
+    atomic_bool stop;             // Read by the component through component_running()
+    atomic_bool exited;           // Set by the thread once the component returned
+} ComponentThread;
+
+// Component stepped by the scheduler (FC_EXEC_SCHEDULER)
+typedef struct {
+    ComponentId component;
+    void* instance;               // From the component's *_init(), NULL if not scheduled
+    Replay* replay;               // Injects the component's recorded traffic instead
+    uint32_t period_ms;
+} ScheduledComponent;
+
+// Components that can run with a warm standby (standby.h)
+static const bool STANDBY_SUPPORTED[MAX_COMPONENTS] = {
+    [COMPONENT_AUTOPILOT] = true,
+    [COMPONENT_INS] = true
+};
 
 struct FlightController {
     Bus* bus;
     ExtendedFlightState state;
+    FlightControllerExecMode exec_mode;
     pid_t component_pids[MAX_COMPONENTS];
-    int shm_id;
+    pid_t standby_pids[MAX_COMPONENTS];   // Warm standbys waiting behind them
+    int pidfds[MAX_COMPONENTS];           // Readable once the process exits, -1 if none
+    int standby_pidfds[MAX_COMPONENTS];
+    int wait_fd;                  // Controller's bus wait descriptor, FC_EXEC_PROCESSES
+    ConfigWatch config_watch;     // With options.reload_config, from start on
+    ComponentThread component_threads[MAX_COMPONENTS];
+    Scheduler* scheduler;         // FC_EXEC_SCHEDULER only
+    ScheduledComponent scheduled[MAX_COMPONENTS];
+    FlightControllerOptions options;
+    SensorFeed sensor_feeds[MAX_COMPONENTS];  // Used with options.sensor_feeds
+    GroundLinks* ground_links;    // Scheduled receivers' links to the senders
+    TraceContext position_trace;  // Fix behind state.basic.position
+    uint32_t ready_expected;      // Bit per started component that reports readiness
+    uint32_t ready;               // Of those, reported ready since its last start
+    int64_t spawn_ms[MAX_COMPONENTS];  // sim_clock_ms() at each component's last spawn
     bool running;
 };
 
-// Forward declarations for component entry points
-extern void gps_receiver_main(Bus* bus);
-extern void ins_main(Bus* bus);
-extern void landing_radio_main(Bus* bus);
-extern void sat_com_main(Bus* bus);
-extern void autopilot_main(Bus* bus);
+FlightControllerOptions flight_controller_default_options(void) {
+    FlightControllerOptions options = {
+        .mode = FC_EXEC_PROCESSES,
+        .autopilot_config = NULL,
+        .simulation_config = NULL,
+        .reload_config = true,
+        .sensor_feeds = false,
+        .sensor_seed = 0,
+        .replay = NULL
+    };
+    return options;
+}
+
+static ErrorCode parse_schedule(json_object* config, ComponentSchedule* schedule) {
+    if (json_object_get_type(config) != json_type_object) return ERROR_INVALID_DATA;
+
+    json_object_object_foreach(config, key, val) {
+        if (strcmp(key, "cpus") == 0) {
+            if (json_object_get_type(val) != json_type_array) return ERROR_INVALID_DATA;
+            schedule->cpu_mask = 0;
+            for (size_t i = 0; i < json_object_array_length(val); i++) {
+                int cpu = json_object_get_int(json_object_array_get_idx(val, i));
+                if (cpu < 0 || cpu >= 64) return ERROR_INVALID_DATA;
+                schedule->cpu_mask |= 1ull << cpu;
+            }
+        } else if (strcmp(key, "priority") == 0) {
+            schedule->rt_priority = json_object_get_int(val);
+            if (schedule->rt_priority < 0 || schedule->rt_priority > 99) return ERROR_INVALID_DATA;
+        } else if (strcmp(key, "lock_memory") == 0) {
+            schedule->lock_memory = json_object_get_boolean(val);
+        } else {
+            fprintf(stderr, "Schedule: unknown setting %s\n", key);
+        }
+    }
+    return SUCCESS;
+}
+
+ErrorCode flight_controller_load_schedules(FlightControllerOptions* options,
+                                           const char* filename) {
+    if (!options || !filename) return ERROR_GENERAL;
+
+    json_object* root = json_object_from_file(filename);
+    if (!root) {
+        fprintf(stderr, "Failed to load schedules from %s\n", filename);
+        return ERROR_GENERAL;
+    }
+
+    ErrorCode result = SUCCESS;
+    json_object_object_foreach(root, key, val) {
+        // Keyed by component name; the controller itself has no schedule
+        int component = COMPONENT_AUTOPILOT;
+        while (component < MAX_COMPONENTS && strcmp(component_name(component), key) != 0) {
+            component++;
+        }
+        if (component == MAX_COMPONENTS) {
+            fprintf(stderr, "Schedule: unknown component %s\n", key);
+            result = ERROR_INVALID_DATA;
+            break;
+        }
+
+        ComponentSchedule schedule = options->schedules[component];
+        if (parse_schedule(val, &schedule) != SUCCESS) {
+            fprintf(stderr, "Schedule: invalid settings for %s\n", key);
+            result = ERROR_INVALID_DATA;
+            break;
+        }
+        options->schedules[component] = schedule;
+    }
+
+    json_object_put(root);
+    return result;
+}
+
+// Place the calling process or thread as configured before the component
+// starts. Failures are reported and the component runs anyway.
+static void apply_schedule(FlightController* fc, ComponentId component) {
+    const ComponentSchedule* schedule = &fc->options.schedules[component];
+    if (!schedule->cpu_mask && !schedule->rt_priority && !schedule->lock_memory) return;
+
+    if (component_apply_schedule(schedule) != SUCCESS) {
+        fprintf(stderr, "Component %d: schedule only partly applied\n", component);
+    } else {
+        fprintf(stderr, "Component %d: cpus 0x%llx, priority %d%s\n", component,
+                (unsigned long long)schedule->cpu_mask, schedule->rt_priority,
+                schedule->lock_memory ? ", memory locked" : "");
+    }
+}
 
 FlightController* flight_controller_init(Bus* bus) {
-    if (!bus) {
+    return flight_controller_init_mode(bus, FC_EXEC_PROCESSES);
+}
+
+FlightController* flight_controller_init_mode(Bus* bus, FlightControllerExecMode mode) {
+    FlightControllerOptions options = flight_controller_default_options();
+    options.mode = mode;
+    return flight_controller_init_with_options(bus, &options);
+}
+
+FlightController* flight_controller_init_with_options(Bus* bus,
+                                                      const FlightControllerOptions* options) {
+    if (!bus || !options) {
         fprintf(stderr, "Flight controller init: NULL bus\n");
         return NULL;
     }
+    if (options->replay && options->mode != FC_EXEC_SCHEDULER) {
+        fprintf(stderr, "Flight controller init: replay needs the scheduler\n");
+        return NULL;
+    }
+    bool standby = false;
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (!options->standby[i]) continue;
+        if (!STANDBY_SUPPORTED[i] || options->mode != FC_EXEC_PROCESSES) {
+            fprintf(stderr, "Flight controller init: no standby for %s in this mode\n",
+                    component_name(i));
+            return NULL;
+        }
+        standby = true;
+    }
+    // The checkpoints are shared with every process forked from here on
+    if (standby && !standby_init()) {
+        fprintf(stderr, "Flight controller init: standby region failed\n");
+        return NULL;
+    }
+
+    // Parsed and checked here, once, for every component started later
+    ConfigSnapshot config;
+    if (!config_store_init()) {
+        fprintf(stderr, "Flight controller init: config region failed\n");
+        return NULL;
+    }
+    if (config_store_load(&config, options->autopilot_config,
+                          options->simulation_config) != SUCCESS) {
+        fprintf(stderr, "Flight controller init: invalid configuration\n");
+        return NULL;
+    }
+    fprintf(stderr, "Configuration %u published\n", config_store_publish(&config));
     
     FlightController* fc = malloc(sizeof(FlightController));
     if (!fc) {
@@ -38,38 +235,60 @@ FlightController* flight_controller_init(Bus* bus) {
     }
     
     fc->bus = bus;
-    fc->shm_id = bus_get_shm_id(bus);
-    if (fc->shm_id == -1) {
-        fprintf(stderr, "Flight controller init: failed to get shared memory ID\n");
+    fc->running = false;
+    memset(&fc->position_trace, 0, sizeof(fc->position_trace));
+    fc->exec_mode = options->mode;
+    fc->options = *options;
+    memset(fc->component_pids, 0, sizeof(fc->component_pids));
+    memset(fc->standby_pids, 0, sizeof(fc->standby_pids));
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        fc->pidfds[i] = -1;
+        fc->standby_pidfds[i] = -1;
+        if (options->standby[i]) standby_enable((ComponentId)i);
+    }
+    fc->wait_fd = -1;
+    fc->config_watch.fd = -1;
+    memset(fc->component_threads, 0, sizeof(fc->component_threads));
+    memset(fc->scheduled, 0, sizeof(fc->scheduled));
+    fc->scheduler = NULL;
+    fc->ground_links = NULL;
+
+    // Everything from the flight state on runs on simulated time
+    if (fc->exec_mode == FC_EXEC_SCHEDULER &&
+        !(fc->scheduler = scheduler_init(SIM_CLOCK_DEFAULT_EPOCH))) {
         free(fc);
         return NULL;
     }
-
-    fc->running = false;
-    memset(fc->component_pids, 0, sizeof(fc->component_pids));
     
     // Initialize flight state
     flight_state_init(&fc->state);
     
-    // Subscribe to relevant message types
+    // Commands have a lane of their own, so only older commands compete
+    // with a new one; the newest wins
+    BusTopicPolicy command_policy = { .overflow = BUS_OVERFLOW_DROP_OLDEST };
+    bus_set_topic_policy(bus, MSG_AUTOPILOT_COMMAND, &command_policy);
+
+    // Subscribe to relevant message types. Only the newest position and
+    // status from each component matter, so those are conflated and cannot
+    // crowd commands out of the queue.
     ErrorCode err;
-    if ((err = bus_subscribe(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_POSITION_UPDATE)) != SUCCESS) {
+    if ((err = bus_subscribe_qos(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_POSITION_UPDATE,
+                                 BUS_QOS_LATEST)) != SUCCESS) {
         fprintf(stderr, "Failed to subscribe to position updates: %d\n", err);
-        free(fc);
-        return NULL;
-    }
-    if ((err = bus_subscribe(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_STATE_REQUEST)) != SUCCESS) {
-        fprintf(stderr, "Failed to subscribe to state requests: %d\n", err);
+        scheduler_cleanup(fc->scheduler);
         free(fc);
         return NULL;
     }
     if ((err = bus_subscribe(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_AUTOPILOT_COMMAND)) != SUCCESS) {
         fprintf(stderr, "Failed to subscribe to autopilot commands: %d\n", err);
+        scheduler_cleanup(fc->scheduler);
         free(fc);
         return NULL;
     }
-    if ((err = bus_subscribe(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_SYSTEM_STATUS)) != SUCCESS) {
+    if ((err = bus_subscribe_qos(bus, COMPONENT_FLIGHT_CONTROLLER, MSG_SYSTEM_STATUS,
+                                 BUS_QOS_LATEST)) != SUCCESS) {
         fprintf(stderr, "Failed to subscribe to system status: %d\n", err);
+        scheduler_cleanup(fc->scheduler);
         free(fc);
         return NULL;
     }
@@ -78,54 +297,367 @@ FlightController* flight_controller_init(Bus* bus) {
     return fc;
 }
 
-ErrorCode flight_controller_spawn_component(FlightController* fc, ComponentId component) {
-    if (!fc || component >= MAX_COMPONENTS) {
-        fprintf(stderr, "Invalid spawn parameters\n");
+// Run a component's entry point until it returns
+static void run_component(Bus* bus, ComponentId component) {
+    switch (component) {
+        case COMPONENT_GPS:
+            fprintf(stderr, "Starting GPS receiver\n");
+            gps_receiver_main(bus);
+            break;
+        case COMPONENT_INS:
+            fprintf(stderr, "Starting INS\n");
+            ins_main(bus);
+            break;
+        case COMPONENT_LANDING_RADIO:
+            fprintf(stderr, "Starting Landing Radio\n");
+            landing_radio_main(bus);
+            break;
+        case COMPONENT_SAT_COM:
+            fprintf(stderr, "Starting SATCOM\n");
+            sat_com_main(bus);
+            break;
+        case COMPONENT_AUTOPILOT:
+            fprintf(stderr, "Starting Autopilot\n");
+            autopilot_main(bus);
+            break;
+        default:
+            fprintf(stderr, "Unknown component type\n");
+            break;
+    }
+}
+
+// Run a component's warm standby entry point until it returns
+static void run_standby(Bus* bus, ComponentId component) {
+    switch (component) {
+        case COMPONENT_INS:
+            fprintf(stderr, "Starting INS standby\n");
+            ins_standby_main(bus);
+            break;
+        case COMPONENT_AUTOPILOT:
+            fprintf(stderr, "Starting Autopilot standby\n");
+            autopilot_standby_main(bus);
+            break;
+        default:
+            fprintf(stderr, "No standby for component type\n");
+            break;
+    }
+}
+
+static void* component_thread_main(void* arg) {
+    ComponentThread* thread = arg;
+
+    component_bind_stop_flag(&thread->stop);
+    fprintf(stderr, "Thread for component %d started\n", thread->component);
+    apply_schedule(thread->fc, thread->component);
+
+    Bus* bus = bus_attach_inherited(thread->fc->bus);
+    if (bus) {
+        run_component(bus, thread->component);
+        bus_detach(bus);
+    } else {
+        fprintf(stderr, "Thread failed to attach to bus\n");
+    }
+
+    atomic_store_explicit(&thread->exited, true, memory_order_release);
+    return NULL;
+}
+
+// Pin to one CPU of the process's affinity mask, spreading components
+// round-robin. Returns false when there is only one CPU to run on.
+static bool component_cpu(ComponentId component, cpu_set_t* set) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) < 2) {
+        return false;
+    }
+
+    int index = component % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && index-- == 0) {
+            CPU_ZERO(set);
+            CPU_SET(cpu, set);
+            return true;
+        }
+    }
+    return false;
+}
+
+static ErrorCode spawn_thread(FlightController* fc, ComponentId component) {
+    ComponentThread* thread = &fc->component_threads[component];
+    thread->fc = fc;
+    thread->component = component;
+    atomic_store(&thread->stop, false);
+    atomic_store(&thread->exited, false);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    cpu_set_t cpu;
+    if (!fc->options.schedules[component].cpu_mask && component_cpu(component, &cpu)) {
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu), &cpu);
+    }
+
+    // Signals stay with the main thread, as they would with the parent
+    // process, so shutdown and dump requests still interrupt its wait
+    sigset_t blocked, previous;
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    int err = pthread_create(&thread->thread, &attr, component_thread_main, thread);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
         return ERROR_GENERAL;
     }
-    
-    fprintf(stderr, "Spawning component %d...\n", component);
+
+    char name[16];
+    snprintf(name, sizeof(name), "component-%d", component);
+    pthread_setname_np(thread->thread, name);
+
+    thread->started = true;
+    fprintf(stderr, "Parent: Component %d spawned as a thread\n", component);
+    return SUCCESS;
+}
+
+// Step one scheduled component, as its main loop would
+static void step_component(void* context) {
+    ScheduledComponent* scheduled = context;
+    uint64_t loop_start = metrics_loop_start();
+    switch (scheduled->component) {
+        case COMPONENT_GPS:
+            gps_receiver_process(scheduled->instance);
+            break;
+        case COMPONENT_INS:
+            ins_process(scheduled->instance);
+            break;
+        case COMPONENT_LANDING_RADIO:
+            landing_radio_process(scheduled->instance);
+            break;
+        case COMPONENT_SAT_COM:
+            sat_com_process(scheduled->instance);
+            break;
+        case COMPONENT_AUTOPILOT:
+            autopilot_process(scheduled->instance);
+            break;
+        default:
+            break;
+    }
+    metrics_loop_end(scheduled->component, loop_start, scheduled->period_ms);
+}
+
+static void cleanup_scheduled(ScheduledComponent* scheduled) {
+    switch (scheduled->component) {
+        case COMPONENT_GPS:
+            gps_receiver_cleanup(scheduled->instance);
+            break;
+        case COMPONENT_INS:
+            ins_cleanup(scheduled->instance);
+            break;
+        case COMPONENT_LANDING_RADIO:
+            landing_radio_cleanup(scheduled->instance);
+            break;
+        case COMPONENT_SAT_COM:
+            sat_com_cleanup(scheduled->instance);
+            break;
+        case COMPONENT_AUTOPILOT:
+            autopilot_cleanup(scheduled->instance);
+            break;
+        default:
+            break;
+    }
+    scheduled->instance = NULL;
+}
+
+// Give a network receiver its sender's traffic in-process. Each feed gets
+// its own seed so the streams differ but repeat.
+static void attach_sensor_feed(FlightController* fc, ScheduledComponent* scheduled) {
+    SensorFeed* feed = &fc->sensor_feeds[scheduled->component];
+    unsigned int seed = fc->options.sensor_seed + (unsigned int)scheduled->component;
+
+    switch (scheduled->component) {
+        case COMPONENT_GPS:
+            sensor_feed_init(feed, SENSOR_FEED_GPS, seed);
+            gps_receiver_set_feed(scheduled->instance, feed);
+            break;
+        case COMPONENT_LANDING_RADIO:
+            sensor_feed_init(feed, SENSOR_FEED_ILS, seed);
+            landing_radio_set_feed(scheduled->instance, feed);
+            break;
+        case COMPONENT_SAT_COM:
+            sensor_feed_init(feed, SENSOR_FEED_GROUND_STATION, seed);
+            sat_com_set_feed(scheduled->instance, feed);
+            break;
+        default:
+            break;
+    }
+}
+
+static void step_replay(void* context) {
+    ScheduledComponent* scheduled = context;
+    replay_publish_due(scheduled->replay, scheduled->component);
+}
+
+// Stand in for a receiver with its recorded traffic, stepped at the rate
+// and in the slot the receiver had
+static ErrorCode schedule_replay(FlightController* fc, ComponentId component) {
+    ScheduledComponent* scheduled = &fc->scheduled[component];
+    if (scheduled->replay) return SUCCESS;
+
+    scheduled->component = component;
+    scheduled->replay = fc->options.replay;
+    ErrorCode err = scheduler_add_task(fc->scheduler, component_name(component),
+                                       COMPONENT_STEP_MS[component], step_replay, scheduled);
+    if (err != SUCCESS) {
+        scheduled->replay = NULL;
+        return err;
+    }
+    replay_start_source(scheduled->replay, component);
+
+    fprintf(stderr, "Parent: Component %d replayed every %u ms\n",
+            component, COMPONENT_STEP_MS[component]);
+    return SUCCESS;
+}
+
+static void step_flight_controller(void* context) {
+    flight_controller_process_messages(context);
+}
+
+static void step_ground_links(void* context) {
+    ground_links_run(context, 0);
+}
+
+// One reactor for the links of every scheduled receiver, run ahead of the
+// first of them. NULL with in-process feeds, where the receivers never
+// connect and keep a reactor of their own that stays idle.
+static GroundLinks* scheduled_ground_links(FlightController* fc) {
+    if (fc->options.sensor_feeds || fc->ground_links) return fc->ground_links;
+
+    GroundLinks* links = ground_links_create();
+    if (!links) return NULL;
+    if (scheduler_add_task(fc->scheduler, "ground links", COMPONENT_STEP_MS[COMPONENT_GPS],
+                           step_ground_links, links) != SUCCESS) {
+        ground_links_destroy(links);
+        return NULL;
+    }
+    fc->ground_links = links;
+    return links;
+}
+
+// Step period of a component: the config's for the INS and the autopilot
+static uint32_t component_step_ms(ComponentId component) {
+    ConfigSnapshot config;
+    if (config_store_read(&config)) {
+        if (component == COMPONENT_INS) return config.ins_interval_ms;
+        if (component == COMPONENT_AUTOPILOT) return config.autopilot_interval_ms;
+    }
+    return COMPONENT_STEP_MS[component];
+}
+
+// Initialize a component in this process and hand its step to the
+// scheduler. The component shares the flight controller's bus handle.
+static ErrorCode schedule_component(FlightController* fc, ComponentId component) {
+    if (fc->options.replay && replay_is_source(component)) {
+        return schedule_replay(fc, component);
+    }
+
+    ScheduledComponent* scheduled = &fc->scheduled[component];
+    if (scheduled->instance) return SUCCESS;
+
+    scheduled->component = component;
+    switch (component) {
+        case COMPONENT_GPS:
+            scheduled->instance = gps_receiver_init_with_links(fc->bus,
+                                                               scheduled_ground_links(fc));
+            break;
+        case COMPONENT_INS:
+            scheduled->instance = ins_init(fc->bus);
+            break;
+        case COMPONENT_LANDING_RADIO:
+            scheduled->instance = landing_radio_init_with_links(fc->bus,
+                                                                scheduled_ground_links(fc));
+            break;
+        case COMPONENT_SAT_COM:
+            scheduled->instance = sat_com_init_with_links(fc->bus, scheduled_ground_links(fc));
+            break;
+        case COMPONENT_AUTOPILOT:
+            scheduled->instance = fc->options.autopilot_config
+                ? autopilot_init_with_config(fc->bus, fc->options.autopilot_config)
+                : autopilot_init(fc->bus);
+            break;
+        default:
+            fprintf(stderr, "Unknown component type\n");
+            return ERROR_GENERAL;
+    }
+
+    if (!scheduled->instance) {
+        fprintf(stderr, "Component %d failed to initialize\n", component);
+        return ERROR_GENERAL;
+    }
+    if (fc->options.sensor_feeds) {
+        attach_sensor_feed(fc, scheduled);
+    }
+    if (component == COMPONENT_INS) {
+        // Seeded like the feeds, so flights differ by seed but repeat
+        ins_set_seed(scheduled->instance, fc->options.sensor_seed + (unsigned int)component);
+    }
+
+    scheduled->period_ms = component_step_ms(component);
+    ErrorCode err = scheduler_add_task(fc->scheduler, component_name(component),
+                                       scheduled->period_ms, step_component, scheduled);
+    if (err != SUCCESS) {
+        cleanup_scheduled(scheduled);
+        return err;
+    }
+
+    fprintf(stderr, "Parent: Component %d scheduled every %u ms\n",
+            component, scheduled->period_ms);
+    return SUCCESS;
+}
+
+// Descriptor that polls readable once the process exits, or -1 where
+// pidfds are not available (the waitpid() sweep still catches the exit)
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+static void close_pidfd(int* fd) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+}
+
+// Fork a process running the component, or its standby. Returns the
+// child's PID, or -1.
+static pid_t fork_component(FlightController* fc, ComponentId component, bool standby) {
     pid_t pid = fork();
     
     if (pid == -1) {
         perror("fork failed");
-        return ERROR_GENERAL;
+        return -1;
     }
     
     if (pid == 0) {
-        // Child process
-        fprintf(stderr, "Child process for component %d started\n", component);
-        Bus* child_bus = bus_attach(fc->shm_id);
+        // Child process; the controller's pidfds are of no use here
+        fprintf(stderr, "Child process for component %d%s started\n", component,
+                standby ? " standby" : "");
+        for (int i = 0; i < MAX_COMPONENTS; i++) {
+            close_pidfd(&fc->pidfds[i]);
+            close_pidfd(&fc->standby_pidfds[i]);
+        }
+        apply_schedule(fc, component);
+        Bus* child_bus = bus_attach_inherited(fc->bus);
         if (!child_bus) {
             fprintf(stderr, "Child failed to attach to bus\n");
             exit(EXIT_FAILURE);
         }
         
-        // Call appropriate component main function
-        switch (component) {
-            case COMPONENT_GPS:
-                fprintf(stderr, "Starting GPS receiver\n");
-                gps_receiver_main(child_bus);
-                break;
-            case COMPONENT_INS:
-                fprintf(stderr, "Starting INS\n");
-                ins_main(child_bus);
-                break;
-            case COMPONENT_LANDING_RADIO:
-                fprintf(stderr, "Starting Landing Radio\n");
-                landing_radio_main(child_bus);
-                break;
-            case COMPONENT_SAT_COM:
-                fprintf(stderr, "Starting SATCOM\n");
-                sat_com_main(child_bus);
-                break;
-            case COMPONENT_AUTOPILOT:
-                fprintf(stderr, "Starting Autopilot\n");
-                autopilot_main(child_bus);
-                break;
-            default:
-                fprintf(stderr, "Unknown component type\n");
-                exit(EXIT_FAILURE);
+        if (standby) {
+            run_standby(child_bus, component);
+        } else {
+            run_component(child_bus, component);
         }
         
         bus_detach(child_bus);
@@ -133,95 +665,284 @@ ErrorCode flight_controller_spawn_component(FlightController* fc, ComponentId co
     }
     
     // Parent process
-    fprintf(stderr, "Parent: Component %d spawned with PID %d\n", component, pid);
+    fprintf(stderr, "Parent: Component %d%s spawned with PID %d\n", component,
+            standby ? " standby" : "", pid);
+    return pid;
+}
+
+// Fork a warm standby behind the component's running process. A failure
+// leaves the component without one; it is restarted cold if it dies.
+static void spawn_standby(FlightController* fc, ComponentId component) {
+    standby_arm(component);
+    pid_t pid = fork_component(fc, component, true);
+    if (pid < 0) return;
+
+    fc->standby_pids[component] = pid;
+    fc->standby_pidfds[component] = open_pidfd(pid);
+}
+
+// Hand a dead component's place to its standby, then fork the next one
+static void promote_standby(FlightController* fc, ComponentId component) {
+    fprintf(stderr, "Component %s failing over to standby PID %d\n",
+            component_name(component), fc->standby_pids[component]);
+
+    // It reports ready again once it has taken over
+    fc->ready &= ~(1u << component);
+    fc->spawn_ms[component] = sim_clock_ms();
+
+    fc->component_pids[component] = fc->standby_pids[component];
+    fc->pidfds[component] = fc->standby_pidfds[component];
+    fc->standby_pids[component] = 0;
+    fc->standby_pidfds[component] = -1;
+    standby_promote(component);
+
+    spawn_standby(fc, component);
+}
+
+ErrorCode flight_controller_spawn_component(FlightController* fc, ComponentId component) {
+    if (!fc || component >= MAX_COMPONENTS) {
+        fprintf(stderr, "Invalid spawn parameters\n");
+        return ERROR_GENERAL;
+    }
+    
+    fprintf(stderr, "Spawning component %d...\n", component);
+    fc->ready &= ~(1u << component);
+    fc->spawn_ms[component] = sim_clock_ms();
+    // Replayed traffic stands in for a receiver; it reports nothing
+    if (!(fc->options.replay && replay_is_source(component))) {
+        fc->ready_expected |= 1u << component;
+    }
+
+    if (fc->exec_mode == FC_EXEC_THREADS) {
+        return spawn_thread(fc, component);
+    }
+    if (fc->exec_mode == FC_EXEC_SCHEDULER) {
+        return schedule_component(fc, component);
+    }
+
+    pid_t pid = fork_component(fc, component, false);
+    if (pid < 0) return ERROR_GENERAL;
+
     fc->component_pids[component] = pid;
+    fc->pidfds[component] = open_pidfd(pid);
+
+    // The first start also puts the standby in place; later ones find it
+    // still waiting
+    if (fc->options.standby[component] && fc->standby_pids[component] == 0) {
+        spawn_standby(fc, component);
+    }
     return SUCCESS;
 }
 
-void handle_position_update(FlightController* fc, Message* msg) {
+// Call after every flight_state_update_*: refreshes the shared snapshot
+static void state_changed(FlightController* fc) {
+    flight_state_write_snapshot(bus_state_snapshot(fc->bus), &fc->state, &fc->position_trace);
+}
+
+void handle_position_update(FlightController* fc, const Message* msg) {
     if (!fc || !msg) return;
     
-    PositionUpdateMsg* update = &msg->payload.position_update;
+    trace_record(TRACE_POSITION_TO_FC, msg->header.send_time_ns);
+
+    const PositionUpdateMsg* update = &msg->payload.position_update;
     flight_state_update_position(&fc->state, &update->position, msg->header.sender);
-    
-    // Send state update to autopilot
-    Message response = {0};
-    response.header.type = MSG_STATE_RESPONSE;
-    response.header.sender = COMPONENT_FLIGHT_CONTROLLER;
-    response.header.receiver = COMPONENT_AUTOPILOT;
-    response.header.timestamp = time(NULL);
-    response.header.message_size = sizeof(StateResponseMsg);
-    
-    memcpy(&response.payload.state_response.state, &fc->state.basic, sizeof(FlightState));
-    
-    bus_publish(fc->bus, &response);
+
+    // Only a fix that became the best position starts what we publish
+    ComponentId source;
+    if (flight_state_get_best_source(&fc->state, &source) && source == msg->header.sender) {
+        fc->position_trace = msg->header.trace;
+    }
+    state_changed(fc);
 }
 
-void handle_autopilot_command(FlightController* fc, Message* msg) {
+void handle_autopilot_command(FlightController* fc, const Message* msg) {
     if (!fc || !msg) return;
     
-    AutopilotCommandMsg* cmd = &msg->payload.autopilot_command;
+    trace_record(TRACE_COMMAND_TO_FC, msg->header.send_time_ns);
+    trace_record(TRACE_FIX_TO_COMMAND, msg->header.trace.origin_ns);
+
+    const AutopilotCommandMsg* cmd = &msg->payload.autopilot_command;
     flight_state_update_autopilot(&fc->state, 
                                 cmd->target_altitude,
                                 cmd->target_heading,
                                 cmd->target_speed);
+    state_changed(fc);
+}
+
+// First active status of a started component since it was (re)spawned
+static void note_ready(FlightController* fc, ComponentId component) {
+    if (!VALIDATE_COMPONENT_ID(component)) return;
+
+    uint32_t bit = 1u << component;
+    if (!(fc->ready_expected & bit) || (fc->ready & bit)) return;
+
+    fc->ready |= bit;
+    fprintf(stderr, "Component %s ready after %lld ms\n", component_name(component),
+            (long long)(sim_clock_ms() - fc->spawn_ms[component]));
+}
+
+static void dispatch_message(FlightController* fc, const Message* msg) {
+    switch (msg->header.type) {
+        case MSG_POSITION_UPDATE:
+            handle_position_update(fc, msg);
+            break;
+            
+        case MSG_AUTOPILOT_COMMAND:
+            handle_autopilot_command(fc, msg);
+            break;
+            
+        case MSG_SYSTEM_STATUS:
+            if (msg->payload.system_status.component_active) {
+                note_ready(fc, msg->header.sender);
+            }
+            flight_state_update_system_status(&fc->state, 
+                                            msg->header.sender,
+                                            true);
+            state_changed(fc);
+            break;
+
+        case MSG_STATE_REQUEST:
+        case MSG_STATE_RESPONSE:
+            // Components read the shared state snapshot instead
+            break;
+    }
+}
+
+void flight_controller_handle_component_exit(FlightController* fc, ComponentId component) {
+    if (!fc || !VALIDATE_COMPONENT_ID(component)) return;
+
+    flight_state_update_system_status(&fc->state, component, false);
+    state_changed(fc);
+    metrics_gauge_set(METRIC_COMPONENT_UP, component, 0);
+    bus_reset_sender(fc->bus, component);
+
+    if (fc->standby_pids[component] > 0) {
+        promote_standby(fc, component);
+        metrics_count(METRIC_COMPONENT_FAILOVERS, component, 1);
+        metrics_gauge_set(METRIC_COMPONENT_UP, component, 1);
+        return;
+    }
+
+    // Optionally restart the component
+    if (flight_controller_spawn_component(fc, component) == SUCCESS) {
+        metrics_count(METRIC_COMPONENT_RESTARTS, component, 1);
+        metrics_gauge_set(METRIC_COMPONENT_UP, component, 1);
+    }
+}
+
+// Publish the config files as they are now, if they are valid. Components
+// pick the new snapshot up at their next step.
+static void reload_config(FlightController* fc) {
+    ConfigSnapshot config;
+    if (config_store_load(&config, fc->options.autopilot_config,
+                          fc->options.simulation_config) != SUCCESS) {
+        fprintf(stderr, "Config change rejected, keeping configuration %u\n",
+                config_store_version());
+        return;
+    }
+    fprintf(stderr, "Configuration %u published\n", config_store_publish(&config));
 }
 
 void flight_controller_process_messages(FlightController* fc) {
     if (!fc || !fc->running) return;
-    
-    Message msg;
-    while (bus_read_message(fc->bus, COMPONENT_FLIGHT_CONTROLLER, &msg)) {
-        switch (msg.header.type) {
-            case MSG_POSITION_UPDATE:
-                handle_position_update(fc, &msg);
-                break;
-                
-            case MSG_STATE_REQUEST: {
-                Message response = {0};
-                response.header.type = MSG_STATE_RESPONSE;
-                response.header.sender = COMPONENT_FLIGHT_CONTROLLER;
-                response.header.receiver = msg.header.sender;
-                response.header.timestamp = time(NULL);
-                response.header.message_size = sizeof(StateResponseMsg);
-                
-                memcpy(&response.payload.state_response.state, &fc->state.basic, sizeof(FlightState));
-                bus_publish(fc->bus, &response);
-                break;
-            }
-                
-            case MSG_AUTOPILOT_COMMAND:
-                handle_autopilot_command(fc, &msg);
-                break;
-                
-            case MSG_SYSTEM_STATUS:
-                flight_state_update_system_status(&fc->state, 
-                                                msg.header.sender,
-                                                true);
-                break;
 
-            case MSG_STATE_RESPONSE:
-                // Flight controller doesn't handle state responses
-                break;
-        }
+    uint64_t loop_start = metrics_loop_start();
+    const Message* msg;
+    while ((msg = bus_peek(fc->bus, COMPONENT_FLIGHT_CONTROLLER))) {
+        dispatch_message(fc, msg);
+        bus_release(fc->bus, COMPONENT_FLIGHT_CONTROLLER, msg);
     }
     
     // Check for any terminated child processes
     int status;
     pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    while (fc->exec_mode == FC_EXEC_PROCESSES && (pid = waitpid(-1, &status, WNOHANG)) > 0) {
         fprintf(stderr, "Child process %d terminated\n", pid);
         for (int i = 0; i < MAX_COMPONENTS; i++) {
             if (fc->component_pids[i] == pid) {
-                flight_state_update_system_status(&fc->state, i, false);
                 fc->component_pids[i] = 0;
-                
-                // Optionally restart the component
-                flight_controller_spawn_component(fc, i);
+                close_pidfd(&fc->pidfds[i]);
+                flight_controller_handle_component_exit(fc, i);
+                break;
+            }
+            if (fc->standby_pids[i] == pid) {
+                // Nothing was lost; put a new one in place
+                fc->standby_pids[i] = 0;
+                close_pidfd(&fc->standby_pidfds[i]);
+                spawn_standby(fc, i);
                 break;
             }
         }
     }
+
+    if (config_watch_changed(&fc->config_watch)) {
+        reload_config(fc);
+    }
+
+    // Threaded components that returned are handled the same way
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        ComponentThread* thread = &fc->component_threads[i];
+        if (thread->started && atomic_load_explicit(&thread->exited, memory_order_acquire)) {
+            pthread_join(thread->thread, NULL);
+            thread->started = false;
+            fprintf(stderr, "Component thread %d terminated\n", i);
+            flight_controller_handle_component_exit(fc, i);
+        }
+    }
+
+    metrics_loop_end(COMPONENT_FLIGHT_CONTROLLER, loop_start,
+                     COMPONENT_STEP_MS[COMPONENT_FLIGHT_CONTROLLER]);
+}
+
+// Sleep until a message arrives for the controller, a child exits or a
+// config file changes, so a dead component is handled at once rather than
+// with the next message. Returns false if there are no descriptors to
+// sleep on besides the bus.
+static bool wait_processes(FlightController* fc, int timeout_ms) {
+    if (fc->wait_fd < 0) return false;
+
+    struct pollfd fds[2 + 2 * MAX_COMPONENTS];
+    nfds_t count = 0;
+    fds[count++] = (struct pollfd){ .fd = fc->wait_fd, .events = POLLIN };
+    if (fc->config_watch.fd >= 0) {
+        fds[count++] = (struct pollfd){ .fd = fc->config_watch.fd, .events = POLLIN };
+    }
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (fc->pidfds[i] >= 0) {
+            fds[count++] = (struct pollfd){ .fd = fc->pidfds[i], .events = POLLIN };
+        }
+        if (fc->standby_pidfds[i] >= 0) {
+            fds[count++] = (struct pollfd){ .fd = fc->standby_pidfds[i], .events = POLLIN };
+        }
+    }
+    if (count == 1) return false;  // Only the bus; the futex wait is cheaper
+
+    if (poll(fds, count, timeout_ms) > 0 && (fds[0].revents & POLLIN)) {
+        // Re-armed before process_messages drains the queue
+        bus_ack_wait_fd(fc->bus, COMPONENT_FLIGHT_CONTROLLER);
+    }
+    return true;
+}
+
+void flight_controller_wait_messages(FlightController* fc, int timeout_ms) {
+    if (!fc || !fc->running) return;
+
+    // Nothing to wait for: everything runs in this thread on simulated time
+    if (fc->exec_mode == FC_EXEC_SCHEDULER) {
+        scheduler_run_for(fc->scheduler, timeout_ms > 0 ? (uint32_t)timeout_ms : 0);
+        return;
+    }
+
+    if (fc->exec_mode == FC_EXEC_PROCESSES && wait_processes(fc, timeout_ms)) {
+        flight_controller_process_messages(fc);
+        return;
+    }
+
+    Message msg;
+    if (bus_wait_message(fc->bus, COMPONENT_FLIGHT_CONTROLLER, &msg, timeout_ms)) {
+        dispatch_message(fc, &msg);
+    }
+    flight_controller_process_messages(fc);
 }
 
 ErrorCode flight_controller_start(FlightController* fc) {
@@ -230,7 +951,8 @@ ErrorCode flight_controller_start(FlightController* fc) {
         return ERROR_GENERAL;
     }
 
-    // Spawn all components in correct order
+    // Spawn every component at once; they come up in parallel and report
+    // readiness on the bus (flight_controller_wait_ready())
     ComponentId components[] = {
         COMPONENT_AUTOPILOT,
         COMPONENT_GPS,
@@ -241,6 +963,25 @@ ErrorCode flight_controller_start(FlightController* fc) {
 
     size_t num_components = sizeof(components) / sizeof(components[0]);
     LOG_INFO(LOG_FLIGHT_CTRL, "Starting %zu components...", num_components);
+    fc->ready_expected = 1u << COMPONENT_FLIGHT_CONTROLLER;
+    if (fc->exec_mode == FC_EXEC_PROCESSES) {
+        fc->wait_fd = bus_get_wait_fd(fc->bus, COMPONENT_FLIGHT_CONTROLLER);
+    }
+    if (fc->options.reload_config && fc->exec_mode != FC_EXEC_SCHEDULER &&
+        !config_watch_init(&fc->config_watch, fc->options.autopilot_config,
+                           fc->options.simulation_config)) {
+        fprintf(stderr, "Config files will not be reloaded\n");
+    }
+
+    // At each tick the flight controller steps first, so every round
+    // starts from a state that includes everything published in the last
+    if (fc->exec_mode == FC_EXEC_SCHEDULER &&
+        scheduler_add_task(fc->scheduler, component_name(COMPONENT_FLIGHT_CONTROLLER),
+                           COMPONENT_STEP_MS[COMPONENT_FLIGHT_CONTROLLER],
+                           step_flight_controller, fc) != SUCCESS) {
+        LOG_ERROR(LOG_FLIGHT_CTRL, "Failed to schedule flight controller");
+        return ERROR_GENERAL;
+    }
 
     for (size_t i = 0; i < num_components; i++) {
         ComponentId component = components[i];
@@ -258,51 +999,110 @@ ErrorCode flight_controller_start(FlightController* fc) {
             flight_controller_cleanup(fc);
             return err;
         }
-
-        // Small delay between spawns to ensure orderly startup
-        usleep(100000);  // 100ms
+        metrics_gauge_set(METRIC_COMPONENT_UP, component, 1);
     }
 
     fc->running = true;
+    fc->ready |= 1u << COMPONENT_FLIGHT_CONTROLLER;
+    metrics_gauge_set(METRIC_COMPONENT_UP, COMPONENT_FLIGHT_CONTROLLER, 1);
     LOG_INFO(LOG_FLIGHT_CTRL, "All components started successfully");
     return SUCCESS;
 }
 
+// Ask every threaded component to leave its main loop and join it. A thread
+// still inside a long wait at the deadline is left running, detached; it
+// holds its own bus reference.
+static void stop_threads(FlightController* fc) {
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (fc->component_threads[i].started) {
+            atomic_store_explicit(&fc->component_threads[i].stop, true, memory_order_release);
+        }
+    }
+
+    int64_t deadline = monotonic_ms() + THREAD_STOP_TIMEOUT_MS;
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        ComponentThread* thread = &fc->component_threads[i];
+        if (!thread->started) continue;
+
+        fprintf(stderr, "Flight controller: Stopping component thread %d...\n", i);
+        while (!atomic_load_explicit(&thread->exited, memory_order_acquire) &&
+               monotonic_ms() < deadline) {
+            usleep(10000);
+        }
+
+        if (atomic_load_explicit(&thread->exited, memory_order_acquire)) {
+            pthread_join(thread->thread, NULL);
+        } else {
+            fprintf(stderr, "Flight controller: Component thread %d did not stop, detaching\n", i);
+            pthread_detach(thread->thread);
+        }
+        thread->started = false;
+    }
+}
+
+static void terminate_process(pid_t pid, int component) {
+    // Send SIGTERM first
+    kill(pid, SIGTERM);
+    
+    // Wait a bit for graceful shutdown
+    int status;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    
+    if (result == 0) {  // Process still running
+        usleep(100000);  // Wait 100ms
+        
+        // Check again
+        result = waitpid(pid, &status, WNOHANG);
+        if (result == 0) {
+            // Force kill if still running
+            fprintf(stderr, "Flight controller: Force killing component %d...\n", component);
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+    }
+}
+
 void flight_controller_cleanup(FlightController* fc) {
     if (!fc) return;
     
     fprintf(stderr, "Flight controller: Starting cleanup...\n");
     fc->running = false;
+    stop_threads(fc);
+
+    // Scheduled components run on the flight controller's bus handle, so
+    // they go before it
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (fc->scheduled[i].instance) {
+            cleanup_scheduled(&fc->scheduled[i]);
+        }
+    }
+    ground_links_destroy(fc->ground_links);
+    fc->ground_links = NULL;
+    scheduler_cleanup(fc->scheduler);
+    fc->scheduler = NULL;
     
-    // Terminate all child processes
+    // Terminate all child processes, standbys first so none is promoted
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (fc->standby_pids[i] > 0) {
+            fprintf(stderr, "Flight controller: Terminating component %d standby (PID %d)...\n",
+                    i, fc->standby_pids[i]);
+            terminate_process(fc->standby_pids[i], i);
+            fc->standby_pids[i] = 0;
+        }
+        close_pidfd(&fc->standby_pidfds[i]);
+    }
     for (int i = 0; i < MAX_COMPONENTS; i++) {
         if (fc->component_pids[i] > 0) {
             fprintf(stderr, "Flight controller: Terminating component %d (PID %d)...\n", 
                     i, fc->component_pids[i]);
-            
-            // Send SIGTERM first
-            kill(fc->component_pids[i], SIGTERM);
-            
-            // Wait a bit for graceful shutdown
-            int status;
-            pid_t result = waitpid(fc->component_pids[i], &status, WNOHANG);
-            
-            if (result == 0) {  // Process still running
-                usleep(100000);  // Wait 100ms
-                
-                // Check again
-                result = waitpid(fc->component_pids[i], &status, WNOHANG);
-                if (result == 0) {
-                    // Force kill if still running
-                    fprintf(stderr, "Flight controller: Force killing component %d...\n", i);
-                    kill(fc->component_pids[i], SIGKILL);
-                    waitpid(fc->component_pids[i], NULL, 0);
-                }
-            }
-            
+            terminate_process(fc->component_pids[i], i);
             fc->component_pids[i] = 0;
         }
+        close_pidfd(&fc->pidfds[i]);
     }
+    standby_cleanup();
+    config_watch_cleanup(&fc->config_watch);
+    config_store_cleanup();
     
     if (fc->bus) {
         bus_cleanup(fc->bus);
@@ -313,6 +1113,34 @@ void flight_controller_cleanup(FlightController* fc) {
     fprintf(stderr, "Flight controller: Cleanup complete\n");
 }
 
+bool flight_controller_ready(const FlightController* fc) {
+    return fc && fc->running && (fc->ready & fc->ready_expected) == fc->ready_expected;
+}
+
+ErrorCode flight_controller_wait_ready(FlightController* fc, int timeout_ms,
+                                       const volatile bool* running) {
+    if (!fc || !fc->running) return ERROR_GENERAL;
+
+    int64_t deadline = sim_clock_ms() + timeout_ms;
+    int64_t left;
+    while (!flight_controller_ready(fc) && (!running || *running) &&
+           (left = deadline - sim_clock_ms()) > 0) {
+        flight_controller_wait_messages(fc, left < READY_POLL_MS ? (int)left : READY_POLL_MS);
+    }
+    if (flight_controller_ready(fc)) return SUCCESS;
+
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if ((fc->ready_expected & ~fc->ready) & (1u << i)) {
+            fprintf(stderr, "Component %s not ready\n", component_name(i));
+        }
+    }
+    return ERROR_COMMUNICATION;
+}
+
+void flight_controller_set_sim_speed(FlightController* fc, double speed) {
+    if (fc) scheduler_set_speed(fc->scheduler, speed);
+}
+
 const ExtendedFlightState* flight_controller_get_state(const FlightController* fc) {
     return fc ? &fc->state : NULL;
 }
@@ -1,5 +1,6 @@
 #include "flight_state.h"
 #include "log.h"
+#include "sim_clock.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -12,7 +13,7 @@ void flight_state_init(ExtendedFlightState* state) {
     state->basic.heading = 0.0;
     state->basic.speed = 0.0;
     state->basic.vertical_speed = 0.0;
-    state->basic.timestamp = time(NULL);
+    state->basic.timestamp = sim_clock_time();
     
     state->parameters.pitch = 0.0;
     state->parameters.roll = 0.0;
@@ -24,14 +25,14 @@ void flight_state_init(ExtendedFlightState* state) {
     state->autopilot.target_heading = 0.0;
     state->autopilot.target_speed = 0.0;
     
-    state->system_status.last_update_time = time(NULL);
+    state->system_status.last_update_time = sim_clock_time();
 }
 
 void flight_state_update_position(ExtendedFlightState* state, const Position* pos, ComponentId source) {
     if (!state || !pos) return;
 
     // Update timestamp
-    state->basic.timestamp = time(NULL);
+    state->basic.timestamp = sim_clock_time();
     state->system_status.last_update_time = state->basic.timestamp;
 
     // Update position based on source
@@ -67,7 +68,7 @@ void flight_state_update_parameters(ExtendedFlightState* state, double pitch, do
     state->parameters.yaw = yaw;
     state->parameters.thrust = thrust;
     
-    state->basic.timestamp = time(NULL);
+    state->basic.timestamp = sim_clock_time();
     state->system_status.last_update_time = state->basic.timestamp;
 }
 
@@ -78,7 +79,7 @@ void flight_state_update_autopilot(ExtendedFlightState* state, double target_alt
     state->autopilot.target_heading = target_heading;
     state->autopilot.target_speed = target_speed;
     
-    state->basic.timestamp = time(NULL);
+    state->basic.timestamp = sim_clock_time();
     state->system_status.last_update_time = state->basic.timestamp;
 }
 
@@ -118,34 +119,120 @@ void flight_state_update_system_status(ExtendedFlightState* state, ComponentId c
             return;
     }
     
-    state->basic.timestamp = time(NULL);
+    state->basic.timestamp = sim_clock_time();
     state->system_status.last_update_time = state->basic.timestamp;
     
     // Update basic position after status change
     state->basic.position = flight_state_get_best_position(state);
 }
 
+bool flight_state_get_best_source(const ExtendedFlightState* state, ComponentId* source) {
+    if (!state || !source) return false;
+
+    // Priority: GPS > INS > Radio
+    if (state->nav_data.gps_valid) {
+        *source = COMPONENT_GPS;
+    } else if (state->nav_data.ins_valid) {
+        *source = COMPONENT_INS;
+    } else if (state->nav_data.radio_valid) {
+        *source = COMPONENT_LANDING_RADIO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
 Position flight_state_get_best_position(const ExtendedFlightState* state) {
     if (!state) {
         Position invalid = {0};
         return invalid;
     }
     
-    // Priority: GPS > INS > Radio
-    if (state->nav_data.gps_valid) {
-        return state->nav_data.gps_position;
+    ComponentId source;
+    if (!flight_state_get_best_source(state, &source)) {
+        // If no valid position available, return current basic position
+        return state->basic.position;
     }
-    
-    if (state->nav_data.ins_valid) {
-        return state->nav_data.ins_position;
+
+    switch (source) {
+        case COMPONENT_GPS:
+            return state->nav_data.gps_position;
+        case COMPONENT_INS:
+            return state->nav_data.ins_position;
+        default:
+            return state->nav_data.radio_position;
     }
-    
-    if (state->nav_data.radio_valid) {
-        return state->nav_data.radio_position;
+}
+
+void flight_state_write_snapshot(FlightStateSnapshot* snapshot, const ExtendedFlightState* state,
+                                 const TraceContext* trace) {
+    if (!snapshot || !state) return;
+
+    uint32_t seq = atomic_load_explicit(&snapshot->seq, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);  // Odd seq is visible before any data
+
+    snapshot->sample.state = *state;
+    if (trace) {
+        snapshot->sample.trace = *trace;
+    } else {
+        memset(&snapshot->sample.trace, 0, sizeof(snapshot->sample.trace));
     }
-    
-    // If no valid position available, return current basic position
-    return state->basic.position;
+    snapshot->sample.write_ns = monotonic_ns();
+
+    atomic_store_explicit(&snapshot->seq, seq + 2, memory_order_release);
+}
+
+uint32_t flight_state_read_snapshot(const FlightStateSnapshot* snapshot, FlightStateSample* sample) {
+    if (!snapshot || !sample) return 0;
+
+    uint32_t spins = 0;
+    do {
+        uint32_t begin = atomic_load_explicit(&snapshot->seq, memory_order_acquire);
+        if (begin == 0) return 0;
+        if (begin & 1) continue;  // Write in progress
+
+        FlightStateSample copy;
+        memcpy(&copy, &snapshot->sample, sizeof(copy));
+        atomic_thread_fence(memory_order_acquire);  // Copy completes before the recheck
+
+        // Unchanged sequence means no write overlapped the copy
+        if (atomic_load_explicit(&snapshot->seq, memory_order_relaxed) == begin) {
+            *sample = copy;
+            return begin / 2;
+        }
+    } while (spin_wait(&spins));
+
+    // The writer died mid-write
+    LOG_WARN(LOG_CORE, "Flight state snapshot stuck mid-write");
+    return 0;
+}
+
+void flight_state_watch_init(FlightStateWatch* watch, uint32_t min_interval_ms) {
+    if (!watch) return;
+    watch->min_interval_ms = min_interval_ms;
+    watch->version = 0;
+    watch->taken_ms = 0;
+}
+
+uint32_t flight_state_watch_take(const FlightStateSnapshot* snapshot, FlightStateWatch* watch,
+                                 FlightStateSample* sample) {
+    if (!snapshot || !watch || !sample) return 0;
+
+    // Version as flight_state_read_snapshot() reports it; a write in
+    // progress still counts as the version before it
+    uint32_t current = atomic_load_explicit(&snapshot->seq, memory_order_relaxed) / 2;
+    if (current == watch->version) return 0;
+
+    int64_t now = sim_clock_ms();
+    if (watch->version && now - watch->taken_ms < (int64_t)watch->min_interval_ms) return 0;
+
+    uint32_t version = flight_state_read_snapshot(snapshot, sample);
+    if (version == 0) return 0;
+
+    watch->version = version;
+    watch->taken_ms = now;
+    return version;
 }
 
 const char* flight_state_to_string(const ExtendedFlightState* state, char* buffer, size_t buffer_size) {
@@ -184,7 +271,7 @@ bool flight_state_is_valid(const ExtendedFlightState* state) {
     }
     
     // Check if the state is too old (more than 10 seconds)
-    time_t now = time(NULL);
+    time_t now = sim_clock_time();
     if (now - state->system_status.last_update_time > 10) {
         return false;
     }
@@ -0,0 +1,398 @@
+#include "ground_link.h"
+#include "metrics.h"
+#include "rng.h"
+#include "sim_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+
+#define MAX_HOST_LENGTH 64
+#define ADDRESS_CACHE_SIZE 16
+#define MAX_EVENTS GROUND_LINK_MAX_LINKS
+
+typedef enum {
+    LINK_DOWN = 0,      // Waiting for due_ms to connect
+    LINK_CONNECTING,    // Connect in flight until due_ms
+    LINK_CONNECTED
+} LinkState;
+
+struct GroundLink {
+    bool used;
+    bool enabled;
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    ComponentId component;  // Metrics label
+    LogCategory category;
+    GroundLinkHandlers handlers;
+    LinkState state;
+    int fd;
+    int address;            // Cached address to try next
+    int64_t due_ms;         // sim_clock_ms() of the next attempt or the connect timeout
+    uint32_t failures;      // In a row, for the backoff
+    uint32_t attempts;      // Counter of the jitter draws
+    RngKey jitter_key;
+    WireStream stream;
+};
+
+struct GroundLinks {
+    int epoll_fd;
+    GroundLink links[GROUND_LINK_MAX_LINKS];
+};
+
+// Resolved addresses per host and port, for every reactor in the process
+typedef struct {
+    char host[MAX_HOST_LENGTH];
+    uint16_t port;
+    int count;
+    struct sockaddr_storage addresses[GROUND_LINK_MAX_ADDRESSES];
+    socklen_t lengths[GROUND_LINK_MAX_ADDRESSES];
+} CachedAddresses;
+
+static CachedAddresses address_cache[ADDRESS_CACHE_SIZE];
+static int address_cache_count;
+static pthread_mutex_t address_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Copy address index of host:port, resolving it on first use. Failures are
+// not cached, so a later attempt resolves again. Returns 0 or the
+// getaddrinfo() error.
+static int cached_address(const GroundLink* link, int index, struct sockaddr_storage* address,
+                          socklen_t* length) {
+    pthread_mutex_lock(&address_cache_lock);
+
+    CachedAddresses* entry = NULL;
+    for (int i = 0; i < address_cache_count; i++) {
+        if (address_cache[i].port == link->port && strcmp(address_cache[i].host, link->host) == 0) {
+            entry = &address_cache[i];
+            break;
+        }
+    }
+
+    CachedAddresses resolved = {0};
+    if (!entry) {
+        // The senders listen on IPv4 only
+        struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+        struct addrinfo* results = NULL;
+        char service[8];
+        snprintf(service, sizeof(service), "%u", link->port);
+
+        int err = getaddrinfo(link->host, service, &hints, &results);
+        if (err != 0) {
+            pthread_mutex_unlock(&address_cache_lock);
+            return err;
+        }
+
+        snprintf(resolved.host, sizeof(resolved.host), "%s", link->host);
+        resolved.port = link->port;
+        for (struct addrinfo* ai = results; ai && resolved.count < GROUND_LINK_MAX_ADDRESSES;
+             ai = ai->ai_next) {
+            memcpy(&resolved.addresses[resolved.count], ai->ai_addr, ai->ai_addrlen);
+            resolved.lengths[resolved.count++] = ai->ai_addrlen;
+        }
+        freeaddrinfo(results);
+
+        entry = &resolved;
+        if (address_cache_count < ADDRESS_CACHE_SIZE && resolved.count > 0) {
+            address_cache[address_cache_count] = resolved;
+            entry = &address_cache[address_cache_count++];
+        }
+    }
+
+    int err = EAI_NONAME;
+    if (entry->count > 0) {
+        *address = entry->addresses[index % entry->count];
+        *length = entry->lengths[index % entry->count];
+        err = 0;
+    }
+    pthread_mutex_unlock(&address_cache_lock);
+    return err;
+}
+
+// Next wait after a failure: the doubling delay, minus up to half of it
+static int64_t backoff_ms(GroundLink* link) {
+    uint32_t shift = link->failures > 1 ? link->failures - 1 : 0;
+    int64_t delay = GROUND_LINK_BACKOFF_MAX_MS;
+    if (shift < 16 && ((int64_t)GROUND_LINK_BACKOFF_MIN_MS << shift) < delay) {
+        delay = (int64_t)GROUND_LINK_BACKOFF_MIN_MS << shift;
+    }
+
+    double u1, u2;
+    RngBlock counter = { link->attempts++, 0, 0, 0 };
+    rng_uniform2(link->jitter_key, counter, &u1, &u2);
+    return delay - (int64_t)(u2 * (double)(delay / 2));
+}
+
+static void close_socket(GroundLink* link) {
+    if (link->fd >= 0) {
+        close(link->fd);  // Also leaves the epoll set
+        link->fd = -1;
+    }
+    if (link->state == LINK_CONNECTED) {
+        metrics_gauge_set(METRIC_LINK_CONNECTED, link->component, 0);
+    }
+    link->state = LINK_DOWN;
+}
+
+static void connect_failed(GroundLink* link, const char* reason) {
+    close_socket(link);
+    link->address++;
+    link->failures++;
+    int64_t wait_ms = backoff_ms(link);
+    link->due_ms = sim_clock_ms() + wait_ms;
+
+    // Every failure while the sender is away is expected; say so once
+    if (link->failures == 1) {
+        LOG_WARN(link->category, "Connect to %s:%u failed: %s, retrying with backoff",
+                 link->host, link->port, reason);
+    } else {
+        LOG_DEBUG(link->category, "Connect to %s:%u failed: %s, retry %u in %lld ms",
+                  link->host, link->port, reason, link->failures, (long long)wait_ms);
+    }
+}
+
+static void set_interest(GroundLinks* links, GroundLink* link, uint32_t events, int op) {
+    struct epoll_event event = { .events = events, .data.ptr = link };
+    if (epoll_ctl(links->epoll_fd, op, link->fd, &event) < 0) {
+        LOG_ERROR(link->category, "epoll_ctl failed: %s", strerror(errno));
+    }
+}
+
+static void connected(GroundLinks* links, GroundLink* link) {
+    link->state = LINK_CONNECTED;
+    link->failures = 0;
+    wire_stream_reset(&link->stream);
+    set_interest(links, link, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+
+    LOG_INFO(link->category, "Connected to %s:%u", link->host, link->port);
+    metrics_count(METRIC_LINK_CONNECTS, link->component, 1);
+    metrics_gauge_set(METRIC_LINK_CONNECTED, link->component, 1);
+    if (link->handlers.on_state) link->handlers.on_state(true, link->handlers.context);
+}
+
+// Drop an established connection and reconnect right away
+static void connection_lost(GroundLink* link, const char* reason) {
+    LOG_ERROR(link->category, "Connection lost: %s", reason);
+    close_socket(link);
+    link->due_ms = sim_clock_ms();
+    if (link->handlers.on_state) link->handlers.on_state(false, link->handlers.context);
+}
+
+static void start_connect(GroundLinks* links, GroundLink* link) {
+    struct sockaddr_storage address;
+    socklen_t length;
+    int err = cached_address(link, link->address, &address, &length);
+    if (err != 0) {
+        connect_failed(link, gai_strerror(err));
+        return;
+    }
+
+    LOG_DEBUG(link->category, "Attempting to connect to %s:%u", link->host, link->port);
+    link->fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (link->fd < 0) {
+        connect_failed(link, strerror(errno));
+        return;
+    }
+
+    // Completion, or failure, shows up as EPOLLOUT
+    set_interest(links, link, EPOLLOUT, EPOLL_CTL_ADD);
+    if (connect(link->fd, (struct sockaddr*)&address, length) == 0) {
+        connected(links, link);
+    } else if (errno == EINPROGRESS) {
+        link->state = LINK_CONNECTING;
+        link->due_ms = sim_clock_ms() + GROUND_LINK_CONNECT_TIMEOUT_MS;
+    } else {
+        connect_failed(link, strerror(errno));
+    }
+}
+
+static void finish_connect(GroundLinks* links, GroundLink* link) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(link->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        error = errno;
+    }
+    if (error == 0) {
+        connected(links, link);
+    } else {
+        connect_failed(link, strerror(error));
+    }
+}
+
+// Drain the socket, handing every complete record to the link's handler
+static void read_records(GroundLink* link) {
+    const char* lost = NULL;
+    bool rejected = false;
+
+    for (int reads = 0; reads < GROUND_LINK_MAX_READS && !lost && !rejected; reads++) {
+        ssize_t bytes_read = wire_stream_fill(&link->stream, link->fd);
+        if (bytes_read == 0) {
+            lost = "Closed by peer";
+        } else if (bytes_read < 0 && errno != EWOULDBLOCK && errno != EAGAIN) {
+            lost = strerror(errno);
+        } else if (bytes_read > 0) {
+            metrics_count(METRIC_LINK_BYTES, link->component, (uint64_t)bytes_read);
+        }
+
+        // Records received ahead of a close still count
+        WireMessage record;
+        WireResult result;
+        while (!rejected && (result = wire_stream_next(&link->stream, &record)) != WIRE_INCOMPLETE) {
+            if (result == WIRE_MALFORMED) {
+                LOG_DEBUG(link->category, "Skipped malformed bytes in stream");
+                metrics_count(METRIC_LINK_PARSE_FAILURES, link->component, 1);
+                continue;
+            }
+            rejected = !link->handlers.on_record(&record, link->handlers.context);
+        }
+
+        if (bytes_read < 0) break;
+    }
+
+    if (link->handlers.on_flush) link->handlers.on_flush(link->handlers.context);
+    if (lost) {
+        connection_lost(link, lost);
+    } else if (rejected) {
+        connection_lost(link, "Rejected by receiver");
+    }
+}
+
+GroundLinks* ground_links_create(void) {
+    GroundLinks* links = calloc(1, sizeof(GroundLinks));
+    if (!links) return NULL;
+
+    links->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (links->epoll_fd < 0) {
+        LOG_ERROR(LOG_CORE, "Ground links: epoll_create1 failed: %s", strerror(errno));
+        free(links);
+        return NULL;
+    }
+    return links;
+}
+
+void ground_links_destroy(GroundLinks* links) {
+    if (!links) return;
+
+    for (int i = 0; i < GROUND_LINK_MAX_LINKS; i++) {
+        if (links->links[i].used) ground_links_remove(links, &links->links[i]);
+    }
+    close(links->epoll_fd);
+    free(links);
+}
+
+GroundLink* ground_links_add(GroundLinks* links, const char* host, uint16_t port,
+                             ComponentId component, LogCategory category,
+                             const GroundLinkHandlers* handlers) {
+    if (!links || !host || !handlers || !handlers->on_record ||
+        strlen(host) >= MAX_HOST_LENGTH) {
+        LOG_ERROR(category, "Invalid ground link");
+        return NULL;
+    }
+
+    for (int i = 0; i < GROUND_LINK_MAX_LINKS; i++) {
+        GroundLink* link = &links->links[i];
+        if (link->used) continue;
+
+        memset(link, 0, sizeof(GroundLink));
+        link->used = true;
+        link->enabled = true;
+        snprintf(link->host, sizeof(link->host), "%s", host);
+        link->port = port;
+        link->component = component;
+        link->category = category;
+        link->handlers = *handlers;
+        link->fd = -1;
+        link->state = LINK_DOWN;
+        link->due_ms = sim_clock_ms();
+        // Processes and links draw different jitter
+        link->jitter_key = rng_key((uint64_t)getpid() << 16 | port);
+        wire_stream_reset(&link->stream);
+        return link;
+    }
+
+    LOG_ERROR(category, "No free ground link for %s:%u", host, port);
+    return NULL;
+}
+
+void ground_links_remove(GroundLinks* links, GroundLink* link) {
+    if (!links || !link || !link->used) return;
+
+    close_socket(link);
+    link->used = false;
+}
+
+int ground_links_fd(const GroundLinks* links) {
+    return links->epoll_fd;
+}
+
+int ground_links_next_timeout_ms(const GroundLinks* links) {
+    int64_t now = sim_clock_ms();
+    int64_t next = -1;
+
+    for (int i = 0; i < GROUND_LINK_MAX_LINKS; i++) {
+        const GroundLink* link = &links->links[i];
+        if (!link->used || !link->enabled || link->state == LINK_CONNECTED) continue;
+
+        int64_t wait = link->due_ms > now ? link->due_ms - now : 0;
+        if (next < 0 || wait < next) next = wait;
+    }
+    return (int)next;
+}
+
+bool ground_links_run(GroundLinks* links, int timeout_ms) {
+    int due = ground_links_next_timeout_ms(links);
+    if (due >= 0 && (timeout_ms < 0 || due < timeout_ms)) timeout_ms = due;
+
+    struct epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(links->epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            LOG_ERROR(LOG_CORE, "Ground links: epoll_wait failed: %s", strerror(errno));
+            return false;
+        }
+        count = 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        GroundLink* link = events[i].data.ptr;
+        if (link->state == LINK_CONNECTING) {
+            finish_connect(links, link);
+        } else if (link->state == LINK_CONNECTED) {
+            read_records(link);
+        }
+    }
+
+    int64_t now = sim_clock_ms();
+    for (int i = 0; i < GROUND_LINK_MAX_LINKS; i++) {
+        GroundLink* link = &links->links[i];
+        if (!link->used || !link->enabled || now < link->due_ms) continue;
+
+        if (link->state == LINK_DOWN) {
+            start_connect(links, link);
+        } else if (link->state == LINK_CONNECTING) {
+            connect_failed(link, "timed out");
+        }
+    }
+    return true;
+}
+
+bool ground_link_connected(const GroundLink* link) {
+    return link && link->state == LINK_CONNECTED;
+}
+
+void ground_link_set_enabled(GroundLink* link, bool enabled) {
+    if (!link || link->enabled == enabled) return;
+
+    link->enabled = enabled;
+    if (!enabled) {
+        close_socket(link);
+    } else {
+        link->failures = 0;
+        link->due_ms = sim_clock_ms();
+    }
+}
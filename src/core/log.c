@@ -4,6 +4,23 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define LOG_RING_CAPACITY 1024      // Records per process, power of two
+#define LOG_MAX_ARGS 8              // Arguments captured per record
+#define LOG_RECORD_TEXT 144         // Inline bytes for %s arguments
+#define LOG_LINE_MAX 1024           // Longest formatted line
+#define LOG_WRITE_BUFFER 16384      // Writer batches lines up to this size
+#define LOG_WRITER_IDLE_MS 20       // Writer poll interval when idle
+
+#if (LOG_RING_CAPACITY & (LOG_RING_CAPACITY - 1)) != 0
+#error "LOG_RING_CAPACITY must be a power of two"
+#endif
 
 // Log configuration
 static struct {
@@ -12,7 +29,51 @@ static struct {
     bool category_enabled[LOG_NUM_CATEGORIES];
     pthread_mutex_t mutex;
     FILE* log_file;
-} log_config;
+    int64_t realtime_offset_ns;  // CLOCK_REALTIME - CLOCK_MONOTONIC at init
+} log_config = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+_Atomic unsigned char log_enabled_levels[LOG_NUM_CATEGORIES];
+
+// One captured argument. Strings are copied into the record's text area
+// and referenced by offset, since the caller's buffer may not outlive it.
+typedef union {
+    int64_t i;
+    double d;
+    const void* p;
+    uint32_t text_offset;
+} LogArg;
+
+// Fixed-size binary record. The format string, file and function name are
+// string literals and are stored as pointers.
+typedef struct {
+    _Atomic uint64_t seq;
+    uint64_t timestamp_ns;   // CLOCK_MONOTONIC
+    const char* fmt;         // NULL when text holds a preformatted message
+    const char* file;
+    const char* func;
+    int32_t line;
+    uint8_t category;
+    uint8_t level;
+    uint8_t num_args;
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_RECORD_TEXT];
+} LogRecord;
+
+// Per-process MPSC ring of records. A slot with seq == pos is free and
+// seq == pos + 1 is committed, as in the bus rings.
+static struct {
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t dropped;
+    _Atomic uint32_t wake;       // Futex word the writer sleeps on
+    LogRecord records[LOG_RING_CAPACITY];
+} log_ring;
+
+static struct {
+    atomic_bool enabled;
+    atomic_bool running;
+    pthread_t thread;
+} log_async;
 
 // Level strings
 static const char* level_strings[] = {
@@ -35,114 +96,538 @@ static const char* category_strings[] = {
     "SAT"
 };
 
+// Recompute the table read by LOG_ENABLED. Called with the mutex held.
+static void update_enabled_levels(void) {
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
+        LogLevel level = log_config.category_levels[i] < log_config.global_level ?
+                         log_config.category_levels[i] : log_config.global_level;
+        unsigned char count = log_config.category_enabled[i] ? (unsigned char)(level + 1) : 0;
+        atomic_store_explicit(&log_enabled_levels[i], count, memory_order_relaxed);
+    }
+}
+
+static void ring_reset(void) {
+    atomic_store(&log_ring.head, 0);
+    atomic_store(&log_ring.tail, 0);
+    for (uint64_t i = 0; i < LOG_RING_CAPACITY; i++) {
+        atomic_store_explicit(&log_ring.records[i].seq, i, memory_order_relaxed);
+    }
+}
+
+static long futex(_Atomic uint32_t* addr, int op, uint32_t val,
+                  const struct timespec* timeout) {
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, NULL, 0);
+}
+
+static void wake_writer(void) {
+    atomic_fetch_add(&log_ring.wake, 1);
+    futex(&log_ring.wake, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+}
+
+// printf conversion specification, parsed from just after the '%'
+typedef struct {
+    const char* end;    // One past the conversion character
+    int stars;          // '*' width/precision arguments
+    char length;        // 0, 'H' (hh), 'h', 'l', 'q' (ll), 'j', 'z', 't', 'L'
+    char conversion;
+} FormatSpec;
+
+static void parse_spec(const char* p, FormatSpec* spec) {
+    spec->stars = 0;
+    spec->length = 0;
+
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') { spec->stars++; p++; }
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { spec->stars++; p++; }
+        while (*p >= '0' && *p <= '9') p++;
+    }
+
+    if (*p == 'h' && p[1] == 'h') { spec->length = 'H'; p += 2; }
+    else if (*p == 'l' && p[1] == 'l') { spec->length = 'q'; p += 2; }
+    else if (*p && strchr("hljztL", *p)) spec->length = *p++;
+
+    spec->conversion = *p;
+    spec->end = *p ? p + 1 : p;
+}
+
+static int64_t read_int_arg(char length, va_list* args) {
+    switch (length) {
+        case 'l': return va_arg(*args, long);
+        case 'q': return va_arg(*args, long long);
+        case 'j': return va_arg(*args, intmax_t);
+        case 'z': return (int64_t)va_arg(*args, size_t);
+        case 't': return va_arg(*args, ptrdiff_t);
+        default:  return va_arg(*args, int);
+    }
+}
+
+// Capture the arguments of fmt into the record. Returns false for formats
+// the binary encoding does not cover; the caller then preformats the text.
+static bool capture_args(LogRecord* record, const char* fmt, va_list* args) {
+    uint32_t text_used = 0;
+    int n = 0;
+
+    for (const char* p = fmt; *p; p++) {
+        if (*p != '%') continue;
+
+        FormatSpec spec;
+        parse_spec(p + 1, &spec);
+        p = spec.end - 1;
+        if (spec.conversion == '%') continue;
+
+        if (n + spec.stars + 1 > LOG_MAX_ARGS) return false;
+        for (int i = 0; i < spec.stars; i++) {
+            record->args[n++].i = va_arg(*args, int);
+        }
+
+        switch (spec.conversion) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+                if (spec.length == 'L') return false;
+                record->args[n++].i = read_int_arg(spec.length, args);
+                break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if (spec.length == 'L') return false;
+                record->args[n++].d = va_arg(*args, double);
+                break;
+
+            case 's': {
+                if (spec.length) return false;
+                const char* str = va_arg(*args, const char*);
+                if (!str) str = "(null)";
+                if (text_used >= LOG_RECORD_TEXT) return false;
+                size_t len = strnlen(str, LOG_RECORD_TEXT - 1 - text_used);
+                if (text_used + len + 1 > LOG_RECORD_TEXT) return false;
+                memcpy(record->text + text_used, str, len);
+                record->text[text_used + len] = '\0';
+                record->args[n++].text_offset = text_used;
+                text_used += (uint32_t)len + 1;
+                break;
+            }
+
+            case 'p':
+                record->args[n++].p = va_arg(*args, void*);
+                break;
+
+            default:
+                return false;  // %n, wide characters, malformed
+        }
+    }
+
+    record->num_args = (uint8_t)n;
+    return true;
+}
+
+static void ring_push(LogCategory category, LogLevel level, const char* file, int line,
+                      const char* func, const char* fmt, va_list args) {
+    uint64_t pos = atomic_load_explicit(&log_ring.tail, memory_order_relaxed);
+    LogRecord* record;
+
+    for (;;) {
+        record = &log_ring.records[pos & (LOG_RING_CAPACITY - 1)];
+        uint64_t seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&log_ring.tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&log_ring.dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&log_ring.tail, memory_order_relaxed);
+        }
+    }
+
+    record->timestamp_ns = monotonic_ns();
+    record->fmt = fmt;
+    record->file = file;
+    record->func = func;
+    record->line = line;
+    record->category = (uint8_t)category;
+    record->level = (uint8_t)level;
+
+    va_list copy;
+    va_copy(copy, args);
+    if (!capture_args(record, fmt, &copy)) {
+        record->fmt = NULL;
+        record->num_args = 0;
+        vsnprintf(record->text, sizeof(record->text), fmt, args);
+    }
+    va_end(copy);
+
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+
+    if (level <= LOG_WARN) {
+        wake_writer();
+    }
+}
+
+// Rebuild one conversion with '*' replaced by the captured values
+static const LogArg* render_spec(char* out, size_t size, const char* start, const FormatSpec* spec,
+                                 const LogRecord* record, const LogArg* arg) {
+    char spec_buf[64];
+    size_t len = 0;
+
+    for (const char* p = start; p < spec->end && len < sizeof(spec_buf) - 12; p++) {
+        if (*p == '*') {
+            len += (size_t)snprintf(spec_buf + len, sizeof(spec_buf) - len, "%d", (int)(arg++)->i);
+        } else {
+            spec_buf[len++] = *p;
+        }
+    }
+    spec_buf[len] = '\0';
+
+    switch (spec->conversion) {
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            snprintf(out, size, spec_buf, arg->d);
+            break;
+        case 's':
+            snprintf(out, size, spec_buf, record->text + arg->text_offset);
+            break;
+        case 'p':
+            snprintf(out, size, spec_buf, arg->p);
+            break;
+        default:
+            switch (spec->length) {
+                case 'l': snprintf(out, size, spec_buf, (long)arg->i); break;
+                case 'q': snprintf(out, size, spec_buf, (long long)arg->i); break;
+                case 'j': snprintf(out, size, spec_buf, (intmax_t)arg->i); break;
+                case 'z': snprintf(out, size, spec_buf, (size_t)arg->i); break;
+                case 't': snprintf(out, size, spec_buf, (ptrdiff_t)arg->i); break;
+                default:  snprintf(out, size, spec_buf, (int)arg->i); break;
+            }
+            break;
+    }
+    return arg + 1;
+}
+
+// Format the message part of a record
+static size_t render_message(char* out, size_t size, const LogRecord* record) {
+    if (!record->fmt) {
+        size_t len = (size_t)snprintf(out, size, "%s", record->text);
+        return len < size ? len : size - 1;
+    }
+
+    const LogArg* arg = record->args;
+    size_t len = 0;
+
+    for (const char* p = record->fmt; *p && len < size - 1; p++) {
+        if (*p != '%') {
+            out[len++] = *p;
+            continue;
+        }
+
+        FormatSpec spec;
+        parse_spec(p + 1, &spec);
+        if (spec.conversion == '%') {
+            out[len++] = '%';
+        } else {
+            arg = render_spec(out + len, size - len, p, &spec, record, arg);
+            len += strlen(out + len);
+        }
+        p = spec.end - 1;
+    }
+
+    out[len] = '\0';
+    return len;
+}
+
+static size_t format_timestamp(char* out, size_t size, int64_t realtime_ns) {
+    time_t seconds = (time_t)(realtime_ns / 1000000000);
+    struct tm tm_info;
+    localtime_r(&seconds, &tm_info);
+    return (size_t)snprintf(out, size, "%02d:%02d:%02d.%03ld ",
+                            tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec,
+                            (long)(realtime_ns % 1000000000) / 1000000);
+}
+
+static size_t render_record(char* out, size_t size, const LogRecord* record) {
+    size_t len = format_timestamp(out, size,
+                                  (int64_t)record->timestamp_ns + log_config.realtime_offset_ns);
+    len += (size_t)snprintf(out + len, size - len, "%-5s %-4s ",
+                            level_strings[record->level], category_strings[record->category]);
+
+    // Write file and line for debug/trace levels
+    if (record->level >= LOG_DEBUG) {
+        len += (size_t)snprintf(out + len, size - len, "[%s:%d %s] ",
+                                record->file, record->line, record->func);
+    }
+
+    // Leave room for the newline when truncating
+    if (len > size - 2) len = size - 2;
+    len += render_message(out + len, size - 1 - len, record);
+    out[len++] = '\n';
+    return len;
+}
+
+static void write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written <= 0) return;
+        buf += written;
+        len -= (size_t)written;
+    }
+}
+
+// Format every committed record, batching the output into few writes.
+// Returns the number of records written.
+static int drain_ring(int fd) {
+    static char buffer[LOG_WRITE_BUFFER];
+    size_t used = 0;
+    int count = 0;
+
+    uint64_t dropped = atomic_exchange_explicit(&log_ring.dropped, 0, memory_order_relaxed);
+    if (dropped) {
+        used = format_timestamp(buffer, sizeof(buffer),
+                                (int64_t)monotonic_ns() + log_config.realtime_offset_ns);
+        used += (size_t)snprintf(buffer + used, sizeof(buffer) - used,
+                                 "%-5s %-4s Log ring full, dropped %llu records\n",
+                                 level_strings[LOG_WARN], category_strings[LOG_CORE],
+                                 (unsigned long long)dropped);
+    }
+
+    for (;;) {
+        uint64_t pos = atomic_load_explicit(&log_ring.head, memory_order_relaxed);
+        LogRecord* record = &log_ring.records[pos & (LOG_RING_CAPACITY - 1)];
+        if (atomic_load_explicit(&record->seq, memory_order_acquire) != pos + 1) break;
+
+        if (sizeof(buffer) - used < LOG_LINE_MAX) {
+            write_all(fd, buffer, used);
+            used = 0;
+        }
+        used += render_record(buffer + used, LOG_LINE_MAX, record);
+
+        atomic_store_explicit(&record->seq, pos + LOG_RING_CAPACITY, memory_order_release);
+        atomic_store_explicit(&log_ring.head, pos + 1, memory_order_relaxed);
+        count++;
+    }
+
+    write_all(fd, buffer, used);
+    return count;
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    int fd = fileno(log_config.log_file ? log_config.log_file : stderr);
+    const struct timespec idle = { 0, LOG_WRITER_IDLE_MS * 1000000L };
+
+    while (atomic_load(&log_async.running)) {
+        uint32_t seen = atomic_load(&log_ring.wake);
+        if (drain_ring(fd) == 0) {
+            futex(&log_ring.wake, FUTEX_WAIT_PRIVATE, seen, &idle);
+        }
+    }
+
+    // Flush whatever was queued before the stop request
+    drain_ring(fd);
+    return NULL;
+}
+
+static void start_writer(void) {
+    atomic_store(&log_async.running, true);
+    if (pthread_create(&log_async.thread, NULL, writer_thread, NULL) != 0) {
+        atomic_store(&log_async.running, false);
+        atomic_store(&log_async.enabled, false);
+        fprintf(stderr, "Failed to start log writer, logging synchronously\n");
+    }
+}
+
+static void stop_writer(void) {
+    if (!atomic_exchange(&log_async.running, false)) return;
+    wake_writer();
+    pthread_join(log_async.thread, NULL);
+}
+
+static void atexit_flush(void) {
+    stop_writer();
+}
+
+// Keep the FILE buffer and the writer consistent across fork: flush before
+// forking so buffered lines are not duplicated, and give the child its own
+// empty ring and writer thread.
+static void fork_prepare(void) {
+    pthread_mutex_lock(&log_config.mutex);
+    if (log_config.log_file) fflush(log_config.log_file);
+}
+
+static void fork_parent(void) {
+    pthread_mutex_unlock(&log_config.mutex);
+}
+
+static void fork_child(void) {
+    pthread_mutex_unlock(&log_config.mutex);
+    ring_reset();
+    atomic_store(&log_ring.dropped, 0);
+    if (atomic_load(&log_async.running)) {
+        start_writer();
+    }
+}
+
+static void register_handlers(void) {
+    ring_reset();
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+    atexit(atexit_flush);
+}
+
 void log_init(void) {
-    // Initialize mutex
-    pthread_mutex_init(&log_config.mutex, NULL);
-    
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, register_handlers);
+
+    struct timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    log_config.realtime_offset_ns = (int64_t)realtime.tv_sec * 1000000000 + realtime.tv_nsec -
+                                    (int64_t)monotonic_ns();
+
     // Set default levels
+    pthread_mutex_lock(&log_config.mutex);
     log_config.global_level = LOG_INFO;
     for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
         log_config.category_levels[i] = LOG_INFO;
         log_config.category_enabled[i] = true;
     }
-    
-    // Open log file - use timestamp in filename
+
+    // Open log file - use timestamp in filename. Appending keeps lines
+    // written by forked processes whole.
     time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
     char filename[64];
-    strftime(filename, sizeof(filename), "airplane_sim_%Y%m%d_%H%M%S.log", tm_info);
-    
-    log_config.log_file = fopen(filename, "w");
+    strftime(filename, sizeof(filename), "airplane_sim_%Y%m%d_%H%M%S.log", &tm_info);
+
+    log_config.log_file = fopen(filename, "a");
     if (!log_config.log_file) {
         fprintf(stderr, "Failed to open log file %s\n", filename);
         log_config.log_file = stderr;
     }
-    
+    update_enabled_levels();
+    pthread_mutex_unlock(&log_config.mutex);
+
     LOG_INFO(LOG_CORE, "Logging system initialized");
 }
 
 void log_cleanup(void) {
+    stop_writer();
+    atomic_store(&log_async.enabled, false);
+
     pthread_mutex_lock(&log_config.mutex);
+    for (int i = 0; i < LOG_NUM_CATEGORIES; i++) {
+        atomic_store(&log_enabled_levels[i], 0);
+    }
     if (log_config.log_file && log_config.log_file != stderr) {
         fclose(log_config.log_file);
     }
+    log_config.log_file = NULL;
     pthread_mutex_unlock(&log_config.mutex);
-    pthread_mutex_destroy(&log_config.mutex);
+}
+
+void log_set_async(bool enable) {
+    pthread_mutex_lock(&log_config.mutex);
+    if (enable == atomic_load(&log_async.enabled)) {
+        pthread_mutex_unlock(&log_config.mutex);
+        return;
+    }
+
+    if (enable) {
+        // Lines already buffered by the synchronous path go out first
+        if (log_config.log_file) fflush(log_config.log_file);
+        atomic_store(&log_async.enabled, true);
+        start_writer();
+        pthread_mutex_unlock(&log_config.mutex);
+    } else {
+        atomic_store(&log_async.enabled, false);
+        pthread_mutex_unlock(&log_config.mutex);
+        stop_writer();
+    }
 }
 
 void log_set_level(LogLevel level) {
     pthread_mutex_lock(&log_config.mutex);
     log_config.global_level = level;
+    update_enabled_levels();
     pthread_mutex_unlock(&log_config.mutex);
     LOG_INFO(LOG_CORE, "Global log level set to %s", level_strings[level]);
 }
 
 void log_set_category_level(LogCategory category, LogLevel level) {
     if (category >= LOG_NUM_CATEGORIES) return;
-    
+
     pthread_mutex_lock(&log_config.mutex);
     log_config.category_levels[category] = level;
+    update_enabled_levels();
     pthread_mutex_unlock(&log_config.mutex);
-    
-    LOG_INFO(LOG_CORE, "Category %s log level set to %s", 
+
+    LOG_INFO(LOG_CORE, "Category %s log level set to %s",
              category_strings[category], level_strings[level]);
 }
 
 void log_enable_category(LogCategory category, bool enable) {
     if (category >= LOG_NUM_CATEGORIES) return;
-    
+
     pthread_mutex_lock(&log_config.mutex);
     log_config.category_enabled[category] = enable;
+    update_enabled_levels();
     pthread_mutex_unlock(&log_config.mutex);
-    
-    LOG_INFO(LOG_CORE, "Category %s %s", 
+
+    LOG_INFO(LOG_CORE, "Category %s %s",
              category_strings[category], enable ? "enabled" : "disabled");
 }
 
 void log_write(LogCategory category, LogLevel level, const char* file, int line,
                const char* func, const char* fmt, ...) {
-    if (category >= LOG_NUM_CATEGORIES) return;
-    
+    if (category >= LOG_NUM_CATEGORIES || !LOG_ENABLED(category, level)) return;
+
+    va_list args;
+    va_start(args, fmt);
+
+    if (atomic_load_explicit(&log_async.enabled, memory_order_relaxed)) {
+        ring_push(category, level, file, line, func, fmt, args);
+        va_end(args);
+        return;
+    }
+
     pthread_mutex_lock(&log_config.mutex);
-    
-    // Check if we should log this message
-    if (!log_config.category_enabled[category] ||
-        level > log_config.global_level ||
-        level > log_config.category_levels[category]) {
+    if (!log_config.log_file) {
         pthread_mutex_unlock(&log_config.mutex);
+        va_end(args);
         return;
     }
-    
+
     // Get current time
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
-    struct tm* tm_info = localtime(&ts.tv_sec);
-    
+    struct tm tm_info;
+    localtime_r(&ts.tv_sec, &tm_info);
+
     // Write timestamp and log level
     fprintf(log_config.log_file, "%02d:%02d:%02d.%03ld %-5s %-4s ",
-            tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec,
+            tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec,
             ts.tv_nsec / 1000000,
             level_strings[level],
             category_strings[category]);
-    
+
     // Write file and line for debug/trace levels
     if (level >= LOG_DEBUG) {
         fprintf(log_config.log_file, "[%s:%d %s] ",
                 file, line, func);
     }
-    
+
     // Write the actual message
-    va_list args;
-    va_start(args, fmt);
     vfprintf(log_config.log_file, fmt, args);
     va_end(args);
     fprintf(log_config.log_file, "\n");
-    
+
     // Flush buffer for important messages
     if (level <= LOG_WARN) {
         fflush(log_config.log_file);
     }
-    
+
     pthread_mutex_unlock(&log_config.mutex);
 }
 
@@ -0,0 +1,273 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Histogram buckets exported as Prometheus "le" bounds: one per power of
+// two of nanoseconds from 2^10 (~1 us) to 2^34 (~17 s)
+#define EXPORT_MIN_SHIFT 10
+#define EXPORT_MAX_SHIFT 34
+
+typedef enum {
+    LABEL_TYPE,
+    LABEL_COMPONENT
+} LabelKind;
+
+typedef struct {
+    const char* name;
+    const char* help;
+    LabelKind label;
+} MetricInfo;
+
+static const MetricInfo COUNTERS[METRIC_NUM_COUNTERS] = {
+    [METRIC_BUS_PUBLISHED] = { "airplane_sim_bus_published_total",
+                               "Messages published on the bus", LABEL_TYPE },
+    [METRIC_BUS_DELIVERED] = { "airplane_sim_bus_delivered_total",
+                               "Message copies read by subscribers", LABEL_TYPE },
+    [METRIC_BUS_DROPPED] = { "airplane_sim_bus_dropped_total",
+                             "Message copies lost before reaching a subscriber", LABEL_TYPE },
+    [METRIC_LOOP_ITERATIONS] = { "airplane_sim_loop_iterations_total",
+                                 "Component loop iterations", LABEL_COMPONENT },
+    [METRIC_LOOP_OVERRUNS] = { "airplane_sim_loop_overruns_total",
+                               "Loop iterations longer than the step period", LABEL_COMPONENT },
+    [METRIC_LINK_BYTES] = { "airplane_sim_link_received_bytes_total",
+                            "Bytes received from the component's sender", LABEL_COMPONENT },
+    [METRIC_LINK_PARSE_FAILURES] = { "airplane_sim_link_parse_failures_total",
+                                     "Malformed stream data and records from the sender",
+                                     LABEL_COMPONENT },
+    [METRIC_LINK_CONNECTS] = { "airplane_sim_link_connects_total",
+                               "Connections made to the sender", LABEL_COMPONENT },
+    [METRIC_COMPONENT_RESTARTS] = { "airplane_sim_component_restarts_total",
+                                    "Component restarts after it exited", LABEL_COMPONENT },
+    [METRIC_COMPONENT_FAILOVERS] = { "airplane_sim_component_failovers_total",
+                                     "Component exits taken over by its warm standby",
+                                     LABEL_COMPONENT }
+};
+
+static const MetricInfo GAUGES[METRIC_NUM_GAUGES] = {
+    [METRIC_COMPONENT_UP] = { "airplane_sim_component_up",
+                              "Whether the component is running", LABEL_COMPONENT },
+    [METRIC_LINK_CONNECTED] = { "airplane_sim_link_connected",
+                                "Whether the sender is connected", LABEL_COMPONENT }
+};
+
+static const MetricInfo HISTOGRAMS[METRIC_NUM_HISTOGRAMS] = {
+    [METRIC_LOOP_TIME] = { "airplane_sim_loop_duration_seconds",
+                           "Time spent in one component loop iteration", LABEL_COMPONENT }
+};
+
+MetricsRegion* metrics_region = NULL;
+static char region_name[64];
+
+static int label_count(LabelKind kind) {
+    return kind == LABEL_TYPE ? MSG_NUM_TYPES : MAX_COMPONENTS;
+}
+
+static void write_label(FILE* out, LabelKind kind, int label) {
+    if (kind == LABEL_TYPE) {
+        fprintf(out, "type=\"%s\"", message_type_name(label));
+    } else {
+        fprintf(out, "component=\"%s\"", component_name(label));
+    }
+}
+
+void metrics_region_name(char* name, size_t size, pid_t pid) {
+    snprintf(name, size, "%s.%d", METRICS_DEFAULT_NAME, (int)pid);
+}
+
+bool metrics_init(const char* name) {
+    if (metrics_region) return true;
+
+    char run_name[sizeof(region_name)];
+    if (!name) {
+        metrics_region_name(run_name, sizeof(run_name), getpid());
+        name = run_name;
+    }
+
+    // Never replace a region: it may belong to a run that is still going
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        fprintf(stderr, "Metrics: %s already exists; it belongs to another run, "
+                "or to one that did not clean up (./cleanup.sh removes those)\n", name);
+        return false;
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Metrics: shm_open %s failed: %s\n", name, strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, sizeof(MetricsRegion)) != 0) {
+        fprintf(stderr, "Metrics: ftruncate failed: %s\n", strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void* addr = mmap(NULL, sizeof(MetricsRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Metrics: mmap failed: %s\n", strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+
+    MetricsRegion* region = addr;  // Zeroed by ftruncate
+    region->version = METRICS_VERSION;
+    region->owner_pid = (int32_t)getpid();
+    region->start_time = (int64_t)time(NULL);
+    atomic_store_explicit(&region->magic, METRICS_MAGIC, memory_order_release);
+
+    snprintf(region_name, sizeof(region_name), "%s", name);
+    metrics_region = region;
+    fprintf(stderr, "Metrics: Region %s, for metrics_exporter --pid %d\n", name, (int)getpid());
+    return true;
+}
+
+void metrics_cleanup(void) {
+    if (!metrics_region) return;
+
+    bool owner = metrics_region->owner_pid == (int32_t)getpid();
+    munmap(metrics_region, sizeof(MetricsRegion));
+    metrics_region = NULL;
+    if (owner) {
+        shm_unlink(region_name);
+    }
+}
+
+const MetricsRegion* metrics_open(const char* name) {
+    if (!name) {
+        fprintf(stderr, "Metrics: metrics_open needs the region name printed by the simulator\n");
+        return NULL;
+    }
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Metrics: cannot open %s: %s\n", name, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MetricsRegion)) {
+        fprintf(stderr, "Metrics: %s is not a metrics region\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, sizeof(MetricsRegion), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Metrics: mmap failed: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    const MetricsRegion* region = addr;
+    if (atomic_load_explicit(&region->magic, memory_order_acquire) != METRICS_MAGIC ||
+        region->version != METRICS_VERSION) {
+        fprintf(stderr, "Metrics: %s is not a version %d metrics region\n", name,
+                METRICS_VERSION);
+        munmap(addr, sizeof(MetricsRegion));
+        return NULL;
+    }
+    return region;
+}
+
+void metrics_close(const MetricsRegion* region) {
+    if (region) munmap((void*)region, sizeof(MetricsRegion));
+}
+
+void metrics_loop_end(ComponentId component, uint64_t start_ns, uint32_t budget_ms) {
+    if (!metrics_region || start_ns == 0 || !VALIDATE_COMPONENT_ID(component)) return;
+
+    uint64_t now = monotonic_ns();
+    uint64_t elapsed = now > start_ns ? now - start_ns : 0;
+
+    MetricsHistogram* hist = &metrics_region->histograms[METRIC_LOOP_TIME][component];
+    latency_histogram_add(&hist->hist, elapsed);
+    atomic_fetch_add_explicit(&hist->sum_ns, elapsed, memory_order_relaxed);
+
+    metrics_count(METRIC_LOOP_ITERATIONS, component, 1);
+    if (elapsed > (uint64_t)budget_ms * 1000000ull) {
+        metrics_count(METRIC_LOOP_OVERRUNS, component, 1);
+    }
+}
+
+// Cumulative buckets at each power of two, then +Inf, _sum and _count.
+// The count is the sum of the buckets so that it matches +Inf even while
+// the histogram is being updated.
+static void write_histogram(FILE* out, const MetricInfo* info, int label,
+                            const MetricsHistogram* hist) {
+    uint64_t cumulative = 0;
+    int bucket = 0;
+    for (int shift = EXPORT_MIN_SHIFT; shift <= EXPORT_MAX_SHIFT; shift++) {
+        // 2^shift is the first value of bucket (shift - 3) << 4
+        int end = (shift - LATENCY_HIST_SUB_BITS + 1) << LATENCY_HIST_SUB_BITS;
+        for (; bucket < end; bucket++) {
+            cumulative += atomic_load_explicit(&hist->hist.buckets[bucket], memory_order_relaxed);
+        }
+        fprintf(out, "%s_bucket{", info->name);
+        write_label(out, info->label, label);
+        fprintf(out, ",le=\"%.9g\"} %llu\n", latency_histogram_bucket_limit(end - 1) / 1e9,
+                (unsigned long long)cumulative);
+    }
+    for (; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+        cumulative += atomic_load_explicit(&hist->hist.buckets[bucket], memory_order_relaxed);
+    }
+
+    fprintf(out, "%s_bucket{", info->name);
+    write_label(out, info->label, label);
+    fprintf(out, ",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+
+    fprintf(out, "%s_sum{", info->name);
+    write_label(out, info->label, label);
+    fprintf(out, "} %.9f\n", atomic_load_explicit(&hist->sum_ns, memory_order_relaxed) / 1e9);
+
+    fprintf(out, "%s_count{", info->name);
+    write_label(out, info->label, label);
+    fprintf(out, "} %llu\n", (unsigned long long)cumulative);
+}
+
+void metrics_write_prometheus(const MetricsRegion* region, FILE* out) {
+    if (!region) return;
+
+    fprintf(out, "# HELP airplane_sim_start_time_seconds Unix time the simulator started\n"
+                 "# TYPE airplane_sim_start_time_seconds gauge\n"
+                 "airplane_sim_start_time_seconds %lld\n", (long long)region->start_time);
+
+    for (int i = 0; i < METRIC_NUM_COUNTERS; i++) {
+        const MetricInfo* info = &COUNTERS[i];
+        fprintf(out, "# HELP %s %s\n# TYPE %s counter\n", info->name, info->help, info->name);
+        for (int label = 0; label < label_count(info->label); label++) {
+            fprintf(out, "%s{", info->name);
+            write_label(out, info->label, label);
+            fprintf(out, "} %llu\n", (unsigned long long)atomic_load_explicit(
+                                         &region->counters[i][label], memory_order_relaxed));
+        }
+    }
+
+    for (int i = 0; i < METRIC_NUM_GAUGES; i++) {
+        const MetricInfo* info = &GAUGES[i];
+        fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n", info->name, info->help, info->name);
+        for (int label = 0; label < label_count(info->label); label++) {
+            fprintf(out, "%s{", info->name);
+            write_label(out, info->label, label);
+            fprintf(out, "} %lld\n", (long long)atomic_load_explicit(&region->gauges[i][label],
+                                                                     memory_order_relaxed));
+        }
+    }
+
+    // Labels that never recorded anything are left out
+    for (int i = 0; i < METRIC_NUM_HISTOGRAMS; i++) {
+        const MetricInfo* info = &HISTOGRAMS[i];
+        fprintf(out, "# HELP %s %s\n# TYPE %s histogram\n", info->name, info->help, info->name);
+        for (int label = 0; label < label_count(info->label); label++) {
+            const MetricsHistogram* hist = &region->histograms[i][label];
+            if (atomic_load_explicit(&hist->hist.count, memory_order_relaxed) == 0) continue;
+            write_histogram(out, info, label, hist);
+        }
+    }
+    fflush(out);
+}
@@ -0,0 +1,275 @@
+#include "pid_batch.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Aircraft model: fraction of the remaining command taken up per second
+// of lag, before the rate limits
+#define PLANT_HEADING_TAU_S 1.0
+#define PLANT_ALTITUDE_TAU_S 3.0
+#define PLANT_SPEED_TAU_S 5.0
+#define PLANT_MAX_ACCEL_KTS 2.0  // Knots per second either way
+
+#define MIN_SETTLE_BAND 1e-9
+
+// Arrays start on a cache line and are padded to whole lines, as in
+// ins_batch.c, so any lane range that starts on a line vectorizes cleanly
+#define ARRAY_ALIGN 64
+#define LANES_PER_LINE (ARRAY_ALIGN / sizeof(double))
+#define AXIS_ARRAYS 8
+
+static size_t lane_stride(size_t count) {
+    return (count + LANES_PER_LINE - 1) / LANES_PER_LINE * LANES_PER_LINE;
+}
+
+static const double* config_gains(const AutopilotConfig* config, PIDAxis axis) {
+    switch (axis) {
+        case PID_AXIS_HEADING: return config->heading_pid;
+        case PID_AXIS_ALTITUDE: return config->altitude_pid;
+        default: return config->speed_pid;
+    }
+}
+
+PIDBatch* pid_batch_create(size_t count, const AutopilotConfig* config) {
+    if (count == 0 || !config) return NULL;
+
+    PIDBatch* batch = calloc(1, sizeof(PIDBatch));
+    if (!batch) return NULL;
+
+    size_t stride = lane_stride(count);
+    size_t bytes = (size_t)PID_NUM_AXES * AXIS_ARRAYS * stride * sizeof(double);
+    batch->storage = aligned_alloc(ARRAY_ALIGN, bytes);
+    if (!batch->storage) {
+        free(batch);
+        return NULL;
+    }
+    memset(batch->storage, 0, bytes);
+
+    double* next = batch->storage;
+    for (int a = 0; a < PID_NUM_AXES; a++) {
+        PIDAxisBatch* axis = &batch->axes[a];
+        double** arrays[AXIS_ARRAYS] = {
+            &axis->kp, &axis->ki, &axis->kd, &axis->integral, &axis->last_error,
+            &axis->value, &axis->overshoot, &axis->last_outside
+        };
+        for (int i = 0; i < AXIS_ARRAYS; i++) {
+            *arrays[i] = next;
+            next += stride;
+        }
+    }
+
+    batch->count = count;
+    batch->config = *config;
+    batch->dt = AUTOPILOT_UPDATE_INTERVAL_MS / 1000.0;
+    for (size_t lane = 0; lane < count; lane++) {
+        for (int a = 0; a < PID_NUM_AXES; a++) {
+            pid_batch_set_gains(batch, lane, (PIDAxis)a, config_gains(config, (PIDAxis)a));
+        }
+    }
+    return batch;
+}
+
+void pid_batch_destroy(PIDBatch* batch) {
+    if (!batch) return;
+    free(batch->storage);
+    free(batch);
+}
+
+void pid_batch_set_gains(PIDBatch* batch, size_t lane, PIDAxis axis, const double gains[3]) {
+    if (!batch || lane >= batch->count || axis >= PID_NUM_AXES || !gains) return;
+    batch->axes[axis].kp[lane] = gains[0];
+    batch->axes[axis].ki[lane] = gains[1];
+    batch->axes[axis].kd[lane] = gains[2];
+}
+
+// Heading difference in [-180, 180], as the autopilot normalizes it
+static inline double wrap_heading_error(double error) {
+    error = error > 180.0 ? error - 360.0 : error;
+    return error < -180.0 ? error + 360.0 : error;
+}
+
+// Heading in [0, 360) after a change of less than a full turn
+static inline double wrap_heading(double heading) {
+    heading = heading >= 360.0 ? heading - 360.0 : heading;
+    return heading < 0.0 ? heading + 360.0 : heading;
+}
+
+void pid_batch_reset(PIDBatch* batch, const FlightState* initial, double settle_fraction) {
+    if (!batch || !initial) return;
+
+    const AutopilotConfig* config = &batch->config;
+    double start[PID_NUM_AXES] = {
+        [PID_AXIS_HEADING] = initial->heading,
+        [PID_AXIS_ALTITUDE] = initial->position.altitude,
+        [PID_AXIS_SPEED] = initial->speed
+    };
+    batch->initial_error[PID_AXIS_HEADING] =
+        wrap_heading_error(config->target_heading - initial->heading);
+    batch->initial_error[PID_AXIS_ALTITUDE] = config->target_altitude - initial->position.altitude;
+    batch->initial_error[PID_AXIS_SPEED] = config->target_speed - initial->speed;
+
+    for (int a = 0; a < PID_NUM_AXES; a++) {
+        PIDAxisBatch* axis = &batch->axes[a];
+        batch->band[a] = fmax(fabs(batch->initial_error[a]) * settle_fraction, MIN_SETTLE_BAND);
+        for (size_t i = 0; i < batch->count; i++) {
+            axis->integral[i] = 0.0;
+            axis->last_error[i] = 0.0;
+            axis->value[i] = start[a];
+            axis->overshoot[i] = 0.0;
+            axis->last_outside[i] = 0.0;
+        }
+    }
+    batch->steps = 0;
+}
+
+// Past-target distance and settling band bookkeeping after a step
+static inline void track(double error, double initial_error, double band, double step,
+                         double* overshoot, double* last_outside) {
+    double past = initial_error >= 0.0 ? -error : error;
+    *overshoot = fmax(*overshoot, past);
+    *last_outside = fabs(error) > band ? step : *last_outside;
+}
+
+static void run_heading(PIDBatch* batch, size_t begin, size_t end, double step) {
+    PIDAxisBatch* axis = &batch->axes[PID_AXIS_HEADING];
+    const double* restrict kp = axis->kp;
+    const double* restrict ki = axis->ki;
+    const double* restrict kd = axis->kd;
+    double* restrict integral = axis->integral;
+    double* restrict last_error = axis->last_error;
+    double* restrict heading = axis->value;
+    double* restrict overshoot = axis->overshoot;
+    double* restrict last_outside = axis->last_outside;
+
+    const double dt = batch->dt;
+    const double target = batch->config.target_heading;
+    const double max_rate = batch->config.max_heading_rate;
+    const double response = 1.0 - exp(-dt / PLANT_HEADING_TAU_S);
+    const double initial_error = batch->initial_error[PID_AXIS_HEADING];
+    const double band = batch->band[PID_AXIS_HEADING];
+
+    for (size_t i = begin; i < end; i++) {
+        // Control law
+        double error = wrap_heading_error(target - heading[i]);
+        double output = autopilot_pid_step(kp[i], ki[i], kd[i], error, dt, &integral[i],
+                                           &last_error[i], -max_rate, max_rate);
+        double command = wrap_heading(heading[i] + output);
+
+        // Aircraft turns towards the command at no more than the rate limit
+        double turn = wrap_heading_error(command - heading[i]) * response;
+        turn = fmax(-max_rate * dt, fmin(max_rate * dt, turn));
+        heading[i] = wrap_heading(heading[i] + turn);
+
+        track(wrap_heading_error(target - heading[i]), initial_error, band, step,
+              &overshoot[i], &last_outside[i]);
+    }
+}
+
+static void run_altitude(PIDBatch* batch, size_t begin, size_t end, double step) {
+    PIDAxisBatch* axis = &batch->axes[PID_AXIS_ALTITUDE];
+    const double* restrict kp = axis->kp;
+    const double* restrict ki = axis->ki;
+    const double* restrict kd = axis->kd;
+    double* restrict integral = axis->integral;
+    double* restrict last_error = axis->last_error;
+    double* restrict altitude = axis->value;
+    double* restrict overshoot = axis->overshoot;
+    double* restrict last_outside = axis->last_outside;
+
+    const double dt = batch->dt;
+    const double target = batch->config.target_altitude;
+    const double max_climb = batch->config.max_climb_rate;
+    const double max_descent = batch->config.max_descent_rate;
+    const double response = 1.0 - exp(-dt / PLANT_ALTITUDE_TAU_S);
+    const double max_up = max_climb / 60.0 * dt;      // Feet per minute to feet per step
+    const double max_down = max_descent / 60.0 * dt;
+    const double initial_error = batch->initial_error[PID_AXIS_ALTITUDE];
+    const double band = batch->band[PID_AXIS_ALTITUDE];
+
+    for (size_t i = begin; i < end; i++) {
+        double error = target - altitude[i];
+        double output = autopilot_pid_step(kp[i], ki[i], kd[i], error, dt, &integral[i],
+                                           &last_error[i], -max_descent, max_climb);
+        double command = altitude[i] + output;
+
+        double climb = (command - altitude[i]) * response;
+        altitude[i] += fmax(-max_down, fmin(max_up, climb));
+
+        track(target - altitude[i], initial_error, band, step,
+              &overshoot[i], &last_outside[i]);
+    }
+}
+
+static void run_speed(PIDBatch* batch, size_t begin, size_t end, double step) {
+    PIDAxisBatch* axis = &batch->axes[PID_AXIS_SPEED];
+    const double* restrict kp = axis->kp;
+    const double* restrict ki = axis->ki;
+    const double* restrict kd = axis->kd;
+    double* restrict integral = axis->integral;
+    double* restrict last_error = axis->last_error;
+    double* restrict speed = axis->value;
+    double* restrict overshoot = axis->overshoot;
+    double* restrict last_outside = axis->last_outside;
+
+    const double dt = batch->dt;
+    const double target = batch->config.target_speed;
+    const double min_speed = batch->config.min_speed;
+    const double max_speed = batch->config.max_speed;
+    const double response = 1.0 - exp(-dt / PLANT_SPEED_TAU_S);
+    const double max_change = PLANT_MAX_ACCEL_KTS * dt;
+    const double initial_error = batch->initial_error[PID_AXIS_SPEED];
+    const double band = batch->band[PID_AXIS_SPEED];
+
+    for (size_t i = begin; i < end; i++) {
+        double error = target - speed[i];
+        double output = autopilot_pid_step(kp[i], ki[i], kd[i], error, dt, &integral[i],
+                                           &last_error[i], -INFINITY, INFINITY);
+        // The command itself stays within the speed limits
+        double command = fmax(min_speed, fmin(max_speed, speed[i] + output));
+
+        double change = (command - speed[i]) * response;
+        speed[i] += fmax(-max_change, fmin(max_change, change));
+
+        track(target - speed[i], initial_error, band, step,
+              &overshoot[i], &last_outside[i]);
+    }
+}
+
+void pid_batch_run(PIDBatch* batch, size_t begin, size_t end, int steps) {
+    if (!batch || begin >= end || end > batch->count) return;
+
+    // One axis at a time keeps its eight arrays for the range in cache
+    // across all the steps
+    for (int s = 1; s <= steps; s++) {
+        run_heading(batch, begin, end, (double)(batch->steps + (uint64_t)s));
+    }
+    for (int s = 1; s <= steps; s++) {
+        run_altitude(batch, begin, end, (double)(batch->steps + (uint64_t)s));
+    }
+    for (int s = 1; s <= steps; s++) {
+        run_speed(batch, begin, end, (double)(batch->steps + (uint64_t)s));
+    }
+}
+
+void pid_batch_advance(PIDBatch* batch, int steps) {
+    if (batch && steps > 0) batch->steps += (uint64_t)steps;
+}
+
+void pid_batch_get_response(const PIDBatch* batch, size_t lane, PIDAxis axis,
+                            PIDResponse* response) {
+    if (!batch || lane >= batch->count || axis >= PID_NUM_AXES || !response) return;
+
+    const PIDAxisBatch* a = &batch->axes[axis];
+    double error;
+    if (axis == PID_AXIS_HEADING) {
+        error = wrap_heading_error(batch->config.target_heading - a->value[lane]);
+    } else {
+        error = (axis == PID_AXIS_ALTITUDE ? batch->config.target_altitude
+                                           : batch->config.target_speed) - a->value[lane];
+    }
+
+    double initial = fabs(batch->initial_error[axis]);
+    response->final_error = error;
+    response->settled = a->last_outside[lane] < (double)batch->steps;
+    response->settling_s = a->last_outside[lane] * batch->dt;
+    response->overshoot_pct = initial > 0.0 ? a->overshoot[lane] / initial * 100.0 : 0.0;
+}
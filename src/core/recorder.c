@@ -0,0 +1,600 @@
+#include "recorder.h"
+#include "bus.h"
+#include "sim_clock.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define RECORDER_RING_CAPACITY 16384        // Messages in flight, power of two
+#define RECORDER_WRITER_IDLE_MS 5           // Writer poll interval when idle
+#define RECORDER_HEADER_BYTES 4096          // Header page before the index
+#define RECORDER_INDEX_CAPACITY 4096        // Index entries per segment
+#define RECORDER_MIN_SEGMENT_BYTES (1u << 20)
+#define RECORDER_DEFAULT_SEGMENT_BYTES (64ull << 20)
+#define RECORDER_DEFAULT_INDEX_INTERVAL_NS 1000000000ull
+#define RECORDER_PATH_MAX 512
+
+#if (RECORDER_RING_CAPACITY & (RECORDER_RING_CAPACITY - 1)) != 0
+#error "RECORDER_RING_CAPACITY must be a power of two"
+#endif
+
+_Static_assert(sizeof(RecorderSegmentHeader) <= RECORDER_HEADER_BYTES,
+               "Segment header must fit its page");
+_Static_assert(RECORDER_HEADER_BYTES + sizeof(RecorderIndexEntry) * RECORDER_INDEX_CAPACITY +
+               RECORDER_HEADER_BYTES + sizeof(RecorderRecord) + sizeof(Message) <=
+               RECORDER_MIN_SEGMENT_BYTES, "Smallest segment must hold a record");
+
+// Published message waiting for the writer
+typedef struct {
+    _Atomic uint64_t seq;
+    uint64_t time_ns;
+    Message message;        // Header and message_size bytes of payload
+} TapSlot;
+
+// MPSC ring shared with forked components. A slot with seq == pos is free
+// and seq == pos + 1 is committed, as in the bus rings. Publishers never
+// make a syscall except to wake the writer once the ring is half full.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t tail;
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t dropped;
+    _Atomic uint32_t wake;  // Futex word the writer sleeps on
+    TapSlot slots[RECORDER_RING_CAPACITY];
+} TapRing;
+
+// Segment being written
+typedef struct {
+    int fd;
+    uint8_t* base;
+    RecorderSegmentHeader* header;
+    RecorderIndexEntry* index;
+} WriteSegment;
+
+static struct {
+    TapRing* ring;          // Shared; NULL until recorder_start()
+    pid_t owner;            // Process running the writer
+    RecorderOptions options;
+    char prefix[RECORDER_PATH_MAX];
+    uint64_t start_clock_ns;
+    uint64_t start_wall_ns;
+
+    // Writer thread state
+    WriteSegment segment;
+    uint32_t next_segment;
+    atomic_bool running;
+    pthread_t thread;
+
+    _Atomic uint64_t recorded;
+    _Atomic uint64_t bytes;
+    _Atomic uint32_t segments;
+} recorder;
+
+static long futex(_Atomic uint32_t* addr, int op, uint32_t val,
+                  const struct timespec* timeout) {
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, NULL, 0);
+}
+
+static size_t round_up(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static size_t index_bytes(void) {
+    return round_up(sizeof(RecorderIndexEntry) * RECORDER_INDEX_CAPACITY, RECORDER_HEADER_BYTES);
+}
+
+// Bytes a message takes in the segment
+static uint32_t record_size(const Message* message) {
+    return (uint32_t)round_up(sizeof(RecorderRecord) + MESSAGE_SIZE(message->header.message_size), 8);
+}
+
+static void wake_writer(TapRing* ring) {
+    atomic_fetch_add(&ring->wake, 1);
+    futex(&ring->wake, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+// Installed as the bus tap: copy the message into the ring, or count it as
+// dropped if the writer has fallen a full ring behind
+static void recorder_tap(const Message* message) {
+    TapRing* ring = recorder.ring;
+    uint64_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    TapSlot* slot;
+
+    for (;;) {
+        slot = &ring->slots[pos & (RECORDER_RING_CAPACITY - 1)];
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->time_ns = sim_clock_ns();
+    memcpy(&slot->message, message, MESSAGE_SIZE(message->header.message_size));
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (pos - head == RECORDER_RING_CAPACITY / 2) {
+        wake_writer(ring);
+    }
+}
+
+static void segment_path(char* path, size_t size, uint32_t number) {
+    snprintf(path, size, "%s.%04u.rec", recorder.prefix, number);
+}
+
+// Create, preallocate and map the next segment file
+static bool open_segment(void) {
+    char path[RECORDER_PATH_MAX + 16];
+    uint32_t number = recorder.next_segment;
+    segment_path(path, sizeof(path), number);
+
+    size_t size = recorder.options.segment_bytes;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create recorder segment %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    // Reserve the blocks up front so appends never extend the file; fall
+    // back to a sparse file where the filesystem cannot preallocate
+    int err = posix_fallocate(fd, 0, (off_t)size);
+    if (err != 0 && ftruncate(fd, (off_t)size) != 0) {
+        fprintf(stderr, "Failed to size recorder segment %s: %s\n", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return false;
+    }
+
+    uint8_t* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map recorder segment %s: %s\n", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+
+    RecorderSegmentHeader* header = (RecorderSegmentHeader*)base;
+    memset(header, 0, RECORDER_HEADER_BYTES);
+    header->magic = RECORDER_MAGIC;
+    header->version = RECORDER_VERSION;
+    header->segment = number;
+    header->index_capacity = RECORDER_INDEX_CAPACITY;
+    header->index_interval_ns = recorder.options.index_interval_ns;
+    header->start_clock_ns = recorder.start_clock_ns;
+    header->start_wall_ns = recorder.start_wall_ns;
+    header->data_start = RECORDER_HEADER_BYTES + index_bytes();
+    atomic_store_explicit(&header->data_end, header->data_start, memory_order_release);
+
+    recorder.segment.fd = fd;
+    recorder.segment.base = base;
+    recorder.segment.header = header;
+    recorder.segment.index = (RecorderIndexEntry*)(base + RECORDER_HEADER_BYTES);
+    recorder.next_segment++;
+    atomic_fetch_add(&recorder.segments, 1);
+
+    // Keep at most max_segments files of this recording
+    uint32_t keep = recorder.options.max_segments;
+    if (keep > 0 && number >= keep) {
+        segment_path(path, sizeof(path), number - keep);
+        unlink(path);
+    }
+    return true;
+}
+
+// Mark the segment complete and trim the unused preallocation
+static void close_segment(void) {
+    WriteSegment* segment = &recorder.segment;
+    if (!segment->base) return;
+
+    RecorderSegmentHeader* header = segment->header;
+    header->dropped = atomic_load_explicit(&recorder.ring->dropped, memory_order_relaxed);
+    header->closed = true;
+
+    uint64_t used = atomic_load_explicit(&header->data_end, memory_order_relaxed);
+    munmap(segment->base, recorder.options.segment_bytes);
+    if (ftruncate(segment->fd, (off_t)used) != 0) {
+        fprintf(stderr, "Failed to trim recorder segment %u\n", header->segment);
+    }
+    close(segment->fd);
+    segment->base = NULL;
+    segment->header = NULL;
+    segment->index = NULL;
+}
+
+// Open an index entry if time_ns starts a new interval. Returns false when
+// the index is full and the segment must rotate first.
+static bool index_record(RecorderSegmentHeader* header, RecorderIndexEntry* index,
+                         uint64_t time_ns, uint64_t offset, MessageType type) {
+    RecorderIndexEntry* entry = header->index_count ? &index[header->index_count - 1] : NULL;
+    if (!entry || time_ns >= entry->time_ns + header->index_interval_ns) {
+        if (header->index_count == header->index_capacity) return false;
+
+        entry = &index[header->index_count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->time_ns = time_ns;
+        entry->first_offset = offset;
+    }
+    if (!entry->type_offset[type]) entry->type_offset[type] = offset;
+    return true;
+}
+
+// Append one message, rotating when the data or index region is full
+static bool append_record(uint64_t time_ns, const Message* message) {
+    uint32_t size = record_size(message);
+    MessageType type = message->header.type;
+
+    for (int attempt = 0; ; attempt++) {
+        if (!recorder.segment.base && !open_segment()) return false;
+
+        RecorderSegmentHeader* header = recorder.segment.header;
+        uint64_t offset = atomic_load_explicit(&header->data_end, memory_order_relaxed);
+
+        // Publishers stamp the time just after claiming their slot, so
+        // neighbours can be a little out of order; keep the file sorted
+        if (header->records && time_ns < header->last_time_ns) time_ns = header->last_time_ns;
+
+        bool fits = offset + size <= recorder.options.segment_bytes &&
+                    index_record(header, recorder.segment.index, time_ns, offset, type);
+        if (!fits) {
+            // An empty segment that cannot hold the record never will
+            if (header->records == 0 || attempt > 0) return false;
+            close_segment();
+            continue;
+        }
+
+        uint8_t* base = recorder.segment.base;
+        RecorderRecord* record = (RecorderRecord*)(base + offset);
+        record->time_ns = time_ns;
+        record->next_same_type = 0;
+        record->size = (uint32_t)MESSAGE_SIZE(message->header.message_size);
+        record->reserved = 0;
+        memcpy(record + 1, message, record->size);
+
+        // Link the type's chain and update the summary before publishing
+        // the new end to live readers
+        if (header->type_last[type]) {
+            ((RecorderRecord*)(base + header->type_last[type]))->next_same_type = offset;
+        } else {
+            header->type_first[type] = offset;
+        }
+        header->type_last[type] = offset;
+        header->type_records[type]++;
+        if (header->records++ == 0) header->first_time_ns = time_ns;
+        header->last_time_ns = time_ns;
+        atomic_store_explicit(&header->data_end, offset + size, memory_order_release);
+
+        atomic_fetch_add_explicit(&recorder.recorded, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&recorder.bytes, size, memory_order_relaxed);
+        return true;
+    }
+}
+
+// Append every committed message. Returns the number taken off the ring.
+static int drain_ring(void) {
+    TapRing* ring = recorder.ring;
+    int count = 0;
+
+    for (;;) {
+        uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        TapSlot* slot = &ring->slots[pos & (RECORDER_RING_CAPACITY - 1)];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos + 1) break;
+
+        if (!append_record(slot->time_ns, &slot->message)) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        }
+
+        atomic_store_explicit(&slot->seq, pos + RECORDER_RING_CAPACITY, memory_order_release);
+        atomic_store_explicit(&ring->head, pos + 1, memory_order_relaxed);
+        count++;
+    }
+
+    if (recorder.segment.header) {
+        recorder.segment.header->dropped =
+            atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+    return count;
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    const struct timespec idle = { 0, RECORDER_WRITER_IDLE_MS * 1000000L };
+    TapRing* ring = recorder.ring;
+
+    while (atomic_load(&recorder.running)) {
+        uint32_t seen = atomic_load(&ring->wake);
+        if (drain_ring() == 0) {
+            futex(&ring->wake, FUTEX_WAIT, seen, &idle);
+        }
+    }
+
+    // Flush whatever was published before the stop request
+    drain_ring();
+    return NULL;
+}
+
+static uint64_t wall_clock_ns(void) {
+    if (sim_clock_is_simulated()) return sim_clock_ns();
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+RecorderOptions recorder_default_options(void) {
+    RecorderOptions options = {
+        .prefix = "flight",
+        .segment_bytes = RECORDER_DEFAULT_SEGMENT_BYTES,
+        .max_segments = 0,
+        .index_interval_ns = RECORDER_DEFAULT_INDEX_INTERVAL_NS
+    };
+    return options;
+}
+
+ErrorCode recorder_start(const RecorderOptions* options) {
+    if (!options || !options->prefix || options->index_interval_ns == 0) {
+        return ERROR_INVALID_DATA;
+    }
+    if (recorder.ring) {
+        fprintf(stderr, "Recorder already running\n");
+        return ERROR_GENERAL;
+    }
+
+    if (options->segment_bytes < RECORDER_MIN_SEGMENT_BYTES) {
+        fprintf(stderr, "Recorder segments must be at least %u bytes\n",
+                RECORDER_MIN_SEGMENT_BYTES);
+        return ERROR_INVALID_DATA;
+    }
+    if (strlen(options->prefix) >= RECORDER_PATH_MAX) {
+        fprintf(stderr, "Recorder path prefix too long\n");
+        return ERROR_INVALID_DATA;
+    }
+
+    // Shared so components forked after this publish into the same ring
+    void* addr = mmap(NULL, sizeof(TapRing), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Failed to map recorder ring: %s\n", strerror(errno));
+        return ERROR_GENERAL;
+    }
+    TapRing* ring = addr;
+    for (uint64_t i = 0; i < RECORDER_RING_CAPACITY; i++) {
+        atomic_store_explicit(&ring->slots[i].seq, i, memory_order_relaxed);
+    }
+
+    recorder.ring = ring;
+    recorder.owner = getpid();
+    recorder.options = *options;
+    strcpy(recorder.prefix, options->prefix);
+    recorder.options.prefix = recorder.prefix;
+    recorder.start_clock_ns = sim_clock_ns();
+    recorder.start_wall_ns = wall_clock_ns();
+    recorder.next_segment = 0;
+    atomic_store(&recorder.recorded, 0);
+    atomic_store(&recorder.bytes, 0);
+    atomic_store(&recorder.segments, 0);
+
+    // Create the first segment now so a bad path fails here
+    if (!open_segment()) {
+        munmap(ring, sizeof(TapRing));
+        recorder.ring = NULL;
+        return ERROR_GENERAL;
+    }
+
+    atomic_store(&recorder.running, true);
+    if (pthread_create(&recorder.thread, NULL, writer_thread, NULL) != 0) {
+        fprintf(stderr, "Failed to start recorder writer\n");
+        atomic_store(&recorder.running, false);
+        close_segment();
+        munmap(ring, sizeof(TapRing));
+        recorder.ring = NULL;
+        return ERROR_GENERAL;
+    }
+
+    bus_set_tap(recorder_tap);
+    fprintf(stderr, "Recording bus traffic to %s.*.rec\n", recorder.prefix);
+    return SUCCESS;
+}
+
+void recorder_stop(void) {
+    // Forked components inherit the state and exit through the same
+    // handlers; the writer and the files belong to the owner
+    if (!recorder.ring || recorder.owner != getpid()) return;
+
+    bus_set_tap(NULL);
+    if (atomic_exchange(&recorder.running, false)) {
+        wake_writer(recorder.ring);
+        pthread_join(recorder.thread, NULL);
+    }
+    close_segment();
+
+    // Left mapped: a component thread may still be inside the tap
+    recorder_dump_stats(stderr);
+}
+
+bool recorder_active(void) {
+    return recorder.ring && atomic_load(&recorder.running);
+}
+
+void recorder_get_stats(RecorderStats* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!recorder.ring) return;
+
+    stats->recorded = atomic_load_explicit(&recorder.recorded, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&recorder.ring->dropped, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&recorder.bytes, memory_order_relaxed);
+    stats->segments = atomic_load_explicit(&recorder.segments, memory_order_relaxed);
+}
+
+void recorder_dump_stats(FILE* out) {
+    if (!recorder.ring) return;
+
+    RecorderStats stats;
+    recorder_get_stats(&stats);
+    fprintf(out, "Recorder %s: %llu messages, %llu bytes in %u segments, %llu dropped\n",
+            recorder.prefix, (unsigned long long)stats.recorded,
+            (unsigned long long)stats.bytes, stats.segments,
+            (unsigned long long)stats.dropped);
+}
+
+bool recorder_segment_open(RecorderSegment* segment, const char* path) {
+    memset(segment, 0, sizeof(*segment));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < RECORDER_HEADER_BYTES) {
+        fprintf(stderr, "%s is not a recorder segment\n", path);
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    const RecorderSegmentHeader* header = base;
+    uint64_t data_end = atomic_load_explicit(&((RecorderSegmentHeader*)base)->data_end,
+                                             memory_order_acquire);
+    if (header->magic != RECORDER_MAGIC || header->version != RECORDER_VERSION ||
+        header->index_count > header->index_capacity ||
+        header->data_start < RECORDER_HEADER_BYTES +
+                             (uint64_t)header->index_capacity * sizeof(RecorderIndexEntry) ||
+        data_end < header->data_start || data_end > (uint64_t)st.st_size) {
+        fprintf(stderr, "%s is not a recorder segment\n", path);
+        munmap(base, (size_t)st.st_size);
+        return false;
+    }
+
+    segment->base = base;
+    segment->size = (size_t)st.st_size;
+    segment->header = header;
+    segment->index = (const RecorderIndexEntry*)((const uint8_t*)base + RECORDER_HEADER_BYTES);
+    return true;
+}
+
+void recorder_segment_close(RecorderSegment* segment) {
+    if (!segment || !segment->base) return;
+    munmap((void*)segment->base, segment->size);
+    segment->base = NULL;
+}
+
+static uint64_t segment_data_end(const RecorderSegment* segment) {
+    return atomic_load_explicit(&((RecorderSegmentHeader*)segment->header)->data_end,
+                                memory_order_acquire);
+}
+
+static const RecorderRecord* record_at(const RecorderSegment* segment, uint64_t offset) {
+    if (offset < segment->header->data_start ||
+        offset + sizeof(RecorderRecord) > segment_data_end(segment)) {
+        return NULL;
+    }
+    const RecorderRecord* record = (const RecorderRecord*)(segment->base + offset);
+    if (record->size < sizeof(MessageHeader) || record->size > sizeof(Message) ||
+        offset + sizeof(RecorderRecord) + record->size > segment_data_end(segment)) {
+        return NULL;
+    }
+    return record;
+}
+
+void recorder_cursor_init(RecorderCursor* cursor, const RecorderSegment* segment, int type,
+                          uint64_t from_ns, uint64_t to_ns) {
+    cursor->segment = segment;
+    cursor->type = type;
+    cursor->offset = 0;
+    cursor->from_ns = from_ns;
+    cursor->to_ns = to_ns;
+
+    const RecorderSegmentHeader* header = segment->header;
+    if (type != RECORDER_ANY_TYPE && !VALIDATE_MESSAGE_TYPE(type)) return;
+
+    if (header->index_count == 0) {
+        // Nothing indexed yet: start from the first record
+        cursor->offset = type == RECORDER_ANY_TYPE ? header->data_start : header->type_first[type];
+        return;
+    }
+
+    // Last index entry starting at or before from_ns
+    uint32_t low = 0, high = header->index_count;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (segment->index[mid].time_ns <= from_ns) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    uint32_t entry = low > 0 ? low - 1 : 0;
+
+    // Entries without the type point nowhere; take the next one that has it
+    for (; entry < header->index_count; entry++) {
+        const RecorderIndexEntry* e = &segment->index[entry];
+        cursor->offset = type == RECORDER_ANY_TYPE ? e->first_offset : e->type_offset[type];
+        if (cursor->offset) return;
+    }
+}
+
+bool recorder_cursor_next(RecorderCursor* cursor, uint64_t* time_ns, Message* message) {
+    const RecorderSegment* segment = cursor->segment;
+
+    while (cursor->offset) {
+        const RecorderRecord* record = record_at(segment, cursor->offset);
+        if (!record) {
+            cursor->offset = 0;
+            break;
+        }
+
+        uint64_t here = cursor->offset;
+        if (cursor->type == RECORDER_ANY_TYPE) {
+            cursor->offset = here + round_up(sizeof(RecorderRecord) + record->size, 8);
+        } else {
+            cursor->offset = record->next_same_type;
+        }
+
+        if (record->time_ns > cursor->to_ns) {
+            cursor->offset = 0;
+            break;
+        }
+        if (record->time_ns < cursor->from_ns) continue;
+
+        const Message* stored = (const Message*)(record + 1);
+        if (cursor->type != RECORDER_ANY_TYPE && stored->header.type != (MessageType)cursor->type) {
+            cursor->offset = 0;
+            break;
+        }
+
+        memset(message, 0, sizeof(*message));
+        memcpy(message, stored, record->size);
+        if (time_ns) *time_ns = record->time_ns;
+        return true;
+    }
+    return false;
+}
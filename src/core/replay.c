@@ -0,0 +1,420 @@
+#include "replay.h"
+#include "sim_clock.h"
+#include "trace.h"
+#include <glob.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METERS_PER_DEGREE 111320.0
+#define METERS_PER_FOOT 0.3048
+
+// Records of one type and sender across all segments, in order. type may
+// be RECORDER_ANY_TYPE.
+typedef struct {
+    int segment;
+    RecorderCursor cursor;
+    int type;
+    ComponentId sender;
+} StreamCursor;
+
+// Recorded traffic of a receiver that is not run
+typedef struct {
+    StreamCursor cursor;
+    bool pending;           // message holds the next record
+    bool done;
+    uint64_t offset_ns;     // Of the pending record, from the start of the recording
+    Message message;
+    uint64_t startup;       // Leading records published while it started
+    uint64_t injected;
+    uint64_t rejected;      // Refused by the bus
+} InputStream;
+
+// Messages of one type and sender published by a rerun component
+typedef struct {
+    StreamCursor cursor;
+    bool opened;
+    ReplayStreamStats stats;
+} OutputStream;
+
+struct Replay {
+    Bus* bus;
+    char* prefix;
+    RecorderSegment* segments;
+    int segment_count;
+    uint64_t start_clock_ns;    // Recording's start, shared by its segments
+    uint64_t end_offset_ns;     // Last record's offset
+    bool started;
+    uint64_t origin_ns;         // Simulated time matching start_clock_ns
+    bool streams_closed;        // Missing messages counted
+    InputStream inputs[MAX_COMPONENTS];
+    OutputStream outputs[MAX_COMPONENTS][MSG_NUM_TYPES];
+};
+
+// One replay per process: the bus tap has no context
+static Replay* active_replay;
+
+bool replay_is_source(ComponentId component) {
+    return component == COMPONENT_GPS || component == COMPONENT_LANDING_RADIO ||
+           component == COMPONENT_SAT_COM;
+}
+
+// Simulated time since the replay started. Starts it on first use, which
+// is the first step of the first tick.
+static uint64_t replay_offset(Replay* replay) {
+    uint64_t now = sim_clock_ns();
+    if (!replay->started) {
+        replay->started = true;
+        replay->origin_ns = now;
+    }
+    return now - replay->origin_ns;
+}
+
+static void stream_open(Replay* replay, StreamCursor* stream, int type, ComponentId sender) {
+    stream->segment = 0;
+    stream->type = type;
+    stream->sender = sender;
+    if (replay->segment_count > 0) {
+        recorder_cursor_init(&stream->cursor, &replay->segments[0], type, 0, UINT64_MAX);
+    }
+}
+
+static bool stream_next(Replay* replay, StreamCursor* stream, uint64_t* offset_ns,
+                        Message* message) {
+    while (stream->segment < replay->segment_count) {
+        uint64_t time_ns;
+        while (recorder_cursor_next(&stream->cursor, &time_ns, message)) {
+            if (message->header.sender == stream->sender) {
+                *offset_ns = time_ns - replay->start_clock_ns;
+                return true;
+            }
+        }
+        if (++stream->segment < replay->segment_count) {
+            recorder_cursor_init(&stream->cursor, &replay->segments[stream->segment],
+                                 stream->type, 0, UINT64_MAX);
+        }
+    }
+    return false;
+}
+
+// Position carried by a message, if any
+static const Position* message_position(const Message* message) {
+    switch (message->header.type) {
+        case MSG_POSITION_UPDATE:
+            return &message->payload.position_update.position;
+        case MSG_STATE_RESPONSE:
+            return &message->payload.state_response.state.position;
+        default:
+            return NULL;
+    }
+}
+
+static double position_error(const Position* a, const Position* b) {
+    double north = (a->latitude - b->latitude) * METERS_PER_DEGREE;
+    double east = (a->longitude - b->longitude) * METERS_PER_DEGREE *
+                  cos(a->latitude * M_PI / 180.0);
+    double up = (a->altitude - b->altitude) * METERS_PER_FOOT;
+    return sqrt(north * north + east * east + up * up);
+}
+
+// Header fields the components set themselves; timestamps, send time and
+// trace ids come from the clocks
+static bool same_message(const Message* a, const Message* b) {
+    return a->header.type == b->header.type && a->header.sender == b->header.sender &&
+           a->header.receiver == b->header.receiver &&
+           a->header.message_size == b->header.message_size &&
+           memcmp(&a->payload, &b->payload, a->header.message_size) == 0;
+}
+
+static void mark_difference(ReplayStreamStats* stats, uint64_t offset_ns) {
+    if (stats->differs) return;
+    stats->differs = true;
+    stats->first_diff_ns = offset_ns;
+}
+
+// Bus tap: pair every message a rerun component publishes with the next
+// recorded one of its stream
+static void replay_tap(const Message* message) {
+    Replay* replay = active_replay;
+    ComponentId sender = message->header.sender;
+    if (!replay || replay_is_source(sender) || !VALIDATE_COMPONENT_ID(sender)) return;
+
+    OutputStream* output = &replay->outputs[sender][message->header.type];
+    if (!output->opened) {
+        stream_open(replay, &output->cursor, message->header.type, sender);
+        output->opened = true;
+    }
+
+    ReplayStreamStats* stats = &output->stats;
+    uint64_t offset = replay_offset(replay);
+    stats->replayed++;
+
+    uint64_t recorded_offset;
+    Message recorded;
+    if (!stream_next(replay, &output->cursor, &recorded_offset, &recorded)) {
+        stats->extra++;
+        mark_difference(stats, offset);
+        return;
+    }
+    stats->recorded++;
+
+    uint64_t skew = offset > recorded_offset ? offset - recorded_offset : recorded_offset - offset;
+    if (skew > stats->max_time_skew_ns) stats->max_time_skew_ns = skew;
+
+    const Position* position = message_position(message);
+    if (position && recorded.header.type == message->header.type) {
+        double error = position_error(position, message_position(&recorded));
+        if (error > stats->max_position_error) stats->max_position_error = error;
+    }
+
+    if (skew == 0 && same_message(message, &recorded)) {
+        stats->identical++;
+    } else {
+        mark_difference(stats, recorded_offset);
+    }
+}
+
+// Receivers' records ahead of the first message of a rerun component were
+// published before the first step, from their *_init()
+static void count_startup(Replay* replay) {
+    RecorderCursor cursor;
+    recorder_cursor_init(&cursor, &replay->segments[0], RECORDER_ANY_TYPE, 0, UINT64_MAX);
+
+    uint64_t time_ns;
+    Message message;
+    while (recorder_cursor_next(&cursor, &time_ns, &message) &&
+           replay_is_source(message.header.sender)) {
+        replay->inputs[message.header.sender].startup++;
+    }
+}
+
+static int compare_segments(const void* a, const void* b) {
+    uint32_t sa = ((const RecorderSegment*)a)->header->segment;
+    uint32_t sb = ((const RecorderSegment*)b)->header->segment;
+    return sa < sb ? -1 : sa > sb;
+}
+
+Replay* replay_open(Bus* bus, const char* prefix) {
+    if (!bus || !prefix) return NULL;
+    if (active_replay) {
+        fprintf(stderr, "Replay already open\n");
+        return NULL;
+    }
+
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s.*.rec", prefix);
+    glob_t found;
+    if (glob(pattern, 0, NULL, &found) != 0) {
+        fprintf(stderr, "No recorder segments match %s\n", pattern);
+        return NULL;
+    }
+
+    Replay* replay = calloc(1, sizeof(Replay));
+    if (replay) {
+        replay->segments = calloc(found.gl_pathc, sizeof(RecorderSegment));
+        replay->prefix = strdup(prefix);
+    }
+    if (!replay || !replay->segments || !replay->prefix) {
+        fprintf(stderr, "Failed to allocate replay\n");
+        globfree(&found);
+        replay_close(replay);
+        return NULL;
+    }
+    replay->bus = bus;
+
+    for (size_t i = 0; i < found.gl_pathc; i++) {
+        if (!recorder_segment_open(&replay->segments[replay->segment_count], found.gl_pathv[i])) {
+            globfree(&found);
+            replay_close(replay);
+            return NULL;
+        }
+        replay->segment_count++;
+    }
+    globfree(&found);
+    qsort(replay->segments, (size_t)replay->segment_count, sizeof(RecorderSegment),
+          compare_segments);
+
+    // Every segment must come from the same recording
+    replay->start_clock_ns = replay->segments[0].header->start_clock_ns;
+    for (int i = 0; i < replay->segment_count; i++) {
+        const RecorderSegmentHeader* header = replay->segments[i].header;
+        if (header->start_clock_ns != replay->start_clock_ns) {
+            fprintf(stderr, "Segment %u of %s belongs to another recording\n",
+                    header->segment, prefix);
+            replay_close(replay);
+            return NULL;
+        }
+        if (header->records && header->last_time_ns - replay->start_clock_ns > replay->end_offset_ns) {
+            replay->end_offset_ns = header->last_time_ns - replay->start_clock_ns;
+        }
+    }
+
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (replay_is_source(i)) {
+            stream_open(replay, &replay->inputs[i].cursor, RECORDER_ANY_TYPE, i);
+        }
+    }
+    count_startup(replay);
+
+    active_replay = replay;
+    bus_set_tap(replay_tap);
+    fprintf(stderr, "Replaying %d segments of %s (%.3f s)\n", replay->segment_count, prefix,
+            (double)replay->end_offset_ns / 1e9);
+    return replay;
+}
+
+void replay_close(Replay* replay) {
+    if (!replay) return;
+    if (active_replay == replay) {
+        bus_set_tap(NULL);
+        active_replay = NULL;
+    }
+    for (int i = 0; i < replay->segment_count; i++) {
+        recorder_segment_close(&replay->segments[i]);
+    }
+    free(replay->segments);
+    free(replay->prefix);
+    free(replay);
+}
+
+// Next recorded message of source, NULL once there are none
+static Message* input_peek(Replay* replay, InputStream* input) {
+    if (!input->pending && !input->done) {
+        input->pending = stream_next(replay, &input->cursor, &input->offset_ns, &input->message);
+        input->done = !input->pending;
+    }
+    return input->pending ? &input->message : NULL;
+}
+
+// Publish the pending message, stamped as the receiver would have now
+static void input_inject(Replay* replay, InputStream* input, ComponentId source) {
+    Message* message = &input->message;
+    message->header.timestamp = (uint32_t)sim_clock_time();
+    if (message->header.trace.id) {
+        message->header.trace = trace_begin(source);
+    }
+    if (bus_publish(replay->bus, message) == SUCCESS) {
+        input->injected++;
+    } else {
+        input->rejected++;
+    }
+    input->pending = false;
+}
+
+void replay_start_source(Replay* replay, ComponentId source) {
+    if (!replay || !replay_is_source(source)) return;
+
+    InputStream* input = &replay->inputs[source];
+    replay_offset(replay);
+    while (input->startup > 0 && input_peek(replay, input)) {
+        input_inject(replay, input, source);
+        input->startup--;
+    }
+}
+
+void replay_publish_due(Replay* replay, ComponentId source) {
+    if (!replay || !replay_is_source(source)) return;
+
+    InputStream* input = &replay->inputs[source];
+    uint64_t offset = replay_offset(replay);
+    while (input_peek(replay, input) && input->offset_ns <= offset) {
+        input_inject(replay, input, source);
+    }
+}
+
+bool replay_finished(const Replay* replay) {
+    if (!replay || !replay->started) return false;
+
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        if (replay_is_source(i) && !replay->inputs[i].done) return false;
+    }
+    return sim_clock_ns() - replay->origin_ns >= replay->end_offset_ns;
+}
+
+// Count what the rerun never published. Recorded streams no component
+// published at all are opened here.
+static void close_streams(Replay* replay) {
+    if (replay->streams_closed) return;
+    replay->streams_closed = true;
+
+    for (int sender = 0; sender < MAX_COMPONENTS; sender++) {
+        if (replay_is_source(sender)) continue;
+        for (int type = 0; type < MSG_NUM_TYPES; type++) {
+            OutputStream* output = &replay->outputs[sender][type];
+            if (!output->opened) {
+                stream_open(replay, &output->cursor, type, sender);
+                output->opened = true;
+            }
+
+            uint64_t offset;
+            Message recorded;
+            while (stream_next(replay, &output->cursor, &offset, &recorded)) {
+                output->stats.recorded++;
+                output->stats.missing++;
+                mark_difference(&output->stats, offset);
+            }
+        }
+    }
+}
+
+bool replay_get_stream_stats(Replay* replay, MessageType type, ComponentId sender,
+                             ReplayStreamStats* stats) {
+    if (!replay || !stats || !VALIDATE_MESSAGE_TYPE(type) || !VALIDATE_COMPONENT_ID(sender) ||
+        replay_is_source(sender)) {
+        return false;
+    }
+
+    *stats = replay->outputs[sender][type].stats;
+    return stats->recorded || stats->replayed;
+}
+
+bool replay_outputs_differ(Replay* replay) {
+    if (!replay) return false;
+    close_streams(replay);
+
+    for (int sender = 0; sender < MAX_COMPONENTS; sender++) {
+        for (int type = 0; type < MSG_NUM_TYPES; type++) {
+            const ReplayStreamStats* stats = &replay->outputs[sender][type].stats;
+            if (stats->differs) return true;
+        }
+    }
+    return false;
+}
+
+void replay_report(Replay* replay, FILE* out) {
+    if (!replay) return;
+    bool differ = replay_outputs_differ(replay);
+
+    fprintf(out, "Replay of %s over %.3f s\n", replay->prefix,
+            (double)replay->end_offset_ns / 1e9);
+    for (int i = 0; i < MAX_COMPONENTS; i++) {
+        const InputStream* input = &replay->inputs[i];
+        if (replay_is_source(i) && (input->injected || input->rejected)) {
+            fprintf(out, "  %-14s %10llu injected, %llu rejected by the bus\n", component_name(i),
+                    (unsigned long long)input->injected, (unsigned long long)input->rejected);
+        }
+    }
+
+    fprintf(out, "  %-32s %9s %9s %9s %8s %8s %11s %11s %10s\n", "output", "recorded",
+            "replayed", "identical", "missing", "extra", "first diff", "max pos m", "max skew");
+    for (int sender = 0; sender < MAX_COMPONENTS; sender++) {
+        for (int type = 0; type < MSG_NUM_TYPES; type++) {
+            ReplayStreamStats stats;
+            if (!replay_get_stream_stats(replay, type, sender, &stats)) continue;
+
+            char name[64];
+            snprintf(name, sizeof(name), "%s %s", component_name(sender),
+                     message_type_name(type));
+            char first[32] = "-";
+            if (stats.differs) {
+                snprintf(first, sizeof(first), "%.3f s", (double)stats.first_diff_ns / 1e9);
+            }
+            fprintf(out, "  %-32s %9llu %9llu %9llu %8llu %8llu %11s %11.3f %7.3f ms\n", name,
+                    (unsigned long long)stats.recorded, (unsigned long long)stats.replayed,
+                    (unsigned long long)stats.identical, (unsigned long long)stats.missing,
+                    (unsigned long long)stats.extra, first, stats.max_position_error,
+                    (double)stats.max_time_skew_ns / 1e6);
+        }
+    }
+    fprintf(out, "Replay %s the recording\n", differ ? "differs from" : "matches");
+}
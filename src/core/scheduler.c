@@ -0,0 +1,112 @@
+#include "scheduler.h"
+#include "sim_clock.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+    const char* name;
+    SchedulerStep step;
+    void* context;
+    uint64_t period_ns;
+    uint64_t next_ns;       // Simulated time of the next step
+} SchedulerTask;
+
+struct Scheduler {
+    SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+    int task_count;
+    double speed;
+    uint64_t sim_origin_ns;     // Simulated and real time when the speed was set
+    uint64_t real_origin_ns;
+    uint64_t steps;
+};
+
+Scheduler* scheduler_init(time_t epoch) {
+    Scheduler* scheduler = malloc(sizeof(Scheduler));
+    if (!scheduler) {
+        LOG_ERROR(LOG_CORE, "Failed to allocate scheduler");
+        return NULL;
+    }
+
+    memset(scheduler, 0, sizeof(Scheduler));
+    sim_clock_use_simulated(epoch);
+
+    LOG_INFO(LOG_CORE, "Scheduler on simulated time from %lld", (long long)epoch);
+    return scheduler;
+}
+
+void scheduler_cleanup(Scheduler* scheduler) {
+    if (!scheduler) return;
+    LOG_INFO(LOG_CORE, "Scheduler ran %llu steps", (unsigned long long)scheduler->steps);
+    free(scheduler);
+}
+
+void scheduler_set_speed(Scheduler* scheduler, double speed) {
+    if (!scheduler) return;
+
+    scheduler->speed = speed > 0.0 ? speed : 0.0;
+    scheduler->sim_origin_ns = sim_clock_ns();
+    scheduler->real_origin_ns = monotonic_ns();
+}
+
+ErrorCode scheduler_add_task(Scheduler* scheduler, const char* name, uint32_t period_ms,
+                             SchedulerStep step, void* context) {
+    if (!scheduler || !step || period_ms == 0) {
+        return ERROR_INVALID_DATA;
+    }
+    if (scheduler->task_count >= SCHEDULER_MAX_TASKS) {
+        LOG_ERROR(LOG_CORE, "Scheduler full, cannot add %s", name);
+        return ERROR_GENERAL;
+    }
+
+    SchedulerTask* task = &scheduler->tasks[scheduler->task_count++];
+    task->name = name;
+    task->step = step;
+    task->context = context;
+    task->period_ns = (uint64_t)period_ms * 1000000ull;
+    task->next_ns = sim_clock_ns();
+
+    LOG_DEBUG(LOG_CORE, "Scheduled %s every %u ms", name, period_ms);
+    return SUCCESS;
+}
+
+// Hold simulated time at or behind real time scaled by speed
+static void pace(const Scheduler* scheduler, uint64_t sim_ns) {
+    if (scheduler->speed <= 0.0) return;
+
+    uint64_t due = scheduler->real_origin_ns +
+                   (uint64_t)((double)(sim_ns - scheduler->sim_origin_ns) / scheduler->speed);
+    uint64_t now = monotonic_ns();
+    if (due > now) {
+        usleep((useconds_t)((due - now) / 1000));
+    }
+}
+
+void scheduler_run_for(Scheduler* scheduler, uint32_t duration_ms) {
+    if (!scheduler) return;
+
+    uint64_t until = sim_clock_ns() + (uint64_t)duration_ms * 1000000ull;
+    for (;;) {
+        // Earliest deadline; ties keep insertion order so runs repeat exactly
+        SchedulerTask* next = NULL;
+        for (int i = 0; i < scheduler->task_count; i++) {
+            SchedulerTask* task = &scheduler->tasks[i];
+            if (!next || task->next_ns < next->next_ns) next = task;
+        }
+        if (!next || next->next_ns > until) break;
+
+        pace(scheduler, next->next_ns);
+        sim_clock_advance_to(next->next_ns);
+        next->step(next->context);
+        next->next_ns += next->period_ns;
+        scheduler->steps++;
+    }
+
+    pace(scheduler, until);
+    sim_clock_advance_to(until);
+}
+
+uint64_t scheduler_steps(const Scheduler* scheduler) {
+    return scheduler ? scheduler->steps : 0;
+}
@@ -0,0 +1,69 @@
+#include "sensor_feed.h"
+#include "sim_clock.h"
+#include <string.h>
+
+static const uint32_t FEED_INTERVAL_MS[] = {
+    [SENSOR_FEED_GPS] = GPS_MODEL_INTERVAL_MS,
+    [SENSOR_FEED_ILS] = ILS_MODEL_INTERVAL_MS,
+    [SENSOR_FEED_GROUND_STATION] = GROUND_STATION_INTERVAL_MS
+};
+
+void sensor_feed_init(SensorFeed* feed, SensorFeedKind kind, unsigned int seed) {
+    memset(feed, 0, sizeof(*feed));
+    feed->kind = kind;
+    feed->interval_ms = FEED_INTERVAL_MS[kind];
+
+    switch (kind) {
+        case SENSOR_FEED_GPS:
+            gps_model_init(&feed->model.gps, seed);
+            break;
+        case SENSOR_FEED_ILS:
+            ils_model_init(&feed->model.ils, seed);
+            break;
+        case SENSOR_FEED_GROUND_STATION:
+            ground_station_init(&feed->model.ground, seed);
+            break;
+    }
+}
+
+// Run one sender update, as the sender's loop would once its interval passed
+static void update(SensorFeed* feed, double dt) {
+    switch (feed->kind) {
+        case SENSOR_FEED_GPS:
+            gps_model_step(&feed->model.gps, dt, &feed->pending[feed->pending_count++]);
+            break;
+        case SENSOR_FEED_ILS:
+            ils_model_step(&feed->model.ils, dt, &feed->pending[feed->pending_count++]);
+            break;
+        case SENSOR_FEED_GROUND_STATION:
+            feed->pending_count += ground_station_step(&feed->model.ground, sim_clock_time(),
+                                                       &feed->pending[feed->pending_count]);
+            break;
+    }
+}
+
+bool sensor_feed_next(SensorFeed* feed, WireMessage* record) {
+    if (feed->pending_next == feed->pending_count) {
+        feed->pending_next = feed->pending_count = 0;
+
+        int64_t now = sim_clock_ms();
+        if (!feed->started) {
+            // The sender's first record follows one interval after connecting;
+            // the ground station greets a new client with its waypoint
+            feed->started = true;
+            feed->last_ms = now;
+            if (feed->kind == SENSOR_FEED_GROUND_STATION &&
+                ground_station_waypoint(&feed->model.ground, sim_clock_time(), &feed->pending[0])) {
+                feed->pending_count = 1;
+            }
+        } else if (now - feed->last_ms >= feed->interval_ms) {
+            update(feed, (double)(now - feed->last_ms) / 1000.0);
+            feed->last_ms = now;
+        }
+
+        if (feed->pending_count == 0) return false;
+    }
+
+    *record = feed->pending[feed->pending_next++];
+    return true;
+}
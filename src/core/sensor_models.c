@@ -0,0 +1,185 @@
+#include "sensor_models.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Simulated approach to runway 28L
+#define APPROACH_START_NM 10.0
+#define APPROACH_SPEED_KTS 140.0
+#define MARKER_DISTANCE_NM 0.5
+
+#define WEATHER_UPDATE_INTERVAL_S 300  // Weather changes every 5 minutes
+#define EMERGENCY_ODDS 1000            // One update in this many carries one
+#define WAYPOINT_ETA_S 1800            // Every leg is due in 30 minutes
+
+// Flight plan flown by the ground station
+typedef struct {
+    double latitude;
+    double longitude;
+    double altitude;
+    double speed;
+    double heading;
+    bool is_final;
+} FlightPlanWaypoint;
+
+static const FlightPlanWaypoint FLIGHT_PLAN[] = {
+    {37.7749, -122.4194, 5000.0, 250.0, 90.0, false},  // San Francisco
+    {37.3688, -121.9314, 4000.0, 200.0, 120.0, false}, // San Jose
+    {37.5483, -121.9886, 3000.0, 180.0, 150.0, true}   // Fremont
+};
+#define FLIGHT_PLAN_LENGTH ((int)(sizeof(FLIGHT_PLAN) / sizeof(FLIGHT_PLAN[0])))
+
+void gps_model_init(GpsFlightPath* path, unsigned int seed) {
+    *path = (GpsFlightPath){
+        .latitude = 37.6188,    // SFO airport
+        .longitude = -122.3750,
+        .altitude = 0.0,
+        .heading = 45.0,        // Northeast heading
+        .ground_speed = 250.0,  // 250 knots
+        .climb_rate = 1500.0,   // 1500 feet per minute climb
+        .target_alt = 10000.0,  // Target altitude 10,000 feet
+        .seed = seed
+    };
+}
+
+void gps_model_step(GpsFlightPath* path, double dt, WireMessage* record) {
+    // Convert speed from knots to degrees per second
+    // At the equator, 1 degree is approximately 60 nautical miles
+    double speed_deg = path->ground_speed / (60.0 * 60.0);
+    speed_deg /= cos(path->latitude * M_PI / 180.0);     // Adjust for latitude
+
+    // Calculate position changes
+    double heading_rad = path->heading * M_PI / 180.0;
+    path->latitude += speed_deg * dt * cos(heading_rad);
+    path->longitude += speed_deg * dt * sin(heading_rad);
+
+    // Update altitude
+    if (path->altitude < path->target_alt) {
+        path->altitude += (path->climb_rate / 60.0) * dt;  // Convert from feet/min to feet/sec
+        if (path->altitude > path->target_alt) {
+            path->altitude = path->target_alt;
+        }
+    }
+
+    // Add some random variation to make it more realistic
+    path->latitude += (rand_r(&path->seed) % 100 - 50) * 0.000001;
+    path->longitude += (rand_r(&path->seed) % 100 - 50) * 0.000001;
+    path->altitude += (rand_r(&path->seed) % 10 - 5);    // +/- 5 feet variation
+
+    memset(record, 0, sizeof(*record));
+    record->type = WIRE_GPS_POSITION;
+    record->data.gps.latitude = path->latitude;
+    record->data.gps.longitude = path->longitude;
+    record->data.gps.altitude = path->altitude;
+}
+
+void ils_model_init(IlsApproach* approach, unsigned int seed) {
+    *approach = (IlsApproach){
+        .localizer = 1.5,
+        .glideslope = 0.5,
+        .distance = APPROACH_START_NM,
+        .elapsed = 0.0,
+        .seed = seed
+    };
+}
+
+// Fly the approach: close on the runway while the deviations decay with a
+// little oscillation, then start over
+void ils_model_step(IlsApproach* a, double dt, WireMessage* record) {
+    a->elapsed += dt;
+    a->distance -= APPROACH_SPEED_KTS / 3600.0 * dt;
+    if (a->distance <= 0.0) {
+        a->distance = APPROACH_START_NM;
+        a->elapsed = 0.0;
+    }
+
+    double decay = exp(-a->elapsed / 60.0);
+    a->localizer = 1.5 * decay * cos(a->elapsed / 10.0) + (rand_r(&a->seed) % 100 - 50) * 0.0005;
+    a->glideslope = 0.5 * decay * sin(a->elapsed / 15.0) + (rand_r(&a->seed) % 100 - 50) * 0.0002;
+
+    memset(record, 0, sizeof(*record));
+    record->type = WIRE_ILS_DATA;
+    record->data.ils.localizer = a->localizer;
+    record->data.ils.glideslope = a->glideslope;
+    record->data.ils.distance = a->distance;
+    record->data.ils.localizer_valid = true;
+    record->data.ils.glideslope_valid = true;
+    record->data.ils.marker_beacon = a->distance < MARKER_DISTANCE_NM;
+}
+
+void ground_station_init(GroundStation* station, unsigned int seed) {
+    *station = (GroundStation){
+        .current_waypoint = 0,
+        .wind_speed = 10.0,
+        .wind_direction = 270.0,
+        .turbulence = 2.0,
+        .temperature = 15.0,
+        .weather_updated = 0,
+        .seed = seed
+    };
+}
+
+bool ground_station_waypoint(const GroundStation* station, time_t now, WireMessage* record) {
+    if (station->current_waypoint >= FLIGHT_PLAN_LENGTH) return false;
+
+    const FlightPlanWaypoint* wp = &FLIGHT_PLAN[station->current_waypoint];
+    memset(record, 0, sizeof(*record));
+    record->type = WIRE_SAT_WAYPOINT;
+    record->data.waypoint.latitude = wp->latitude;
+    record->data.waypoint.longitude = wp->longitude;
+    record->data.waypoint.altitude = wp->altitude;
+    record->data.waypoint.speed = wp->speed;
+    record->data.waypoint.heading = wp->heading;
+    record->data.waypoint.eta = (uint32_t)(now + WAYPOINT_ETA_S);
+    record->data.waypoint.is_final = wp->is_final;
+    return true;
+}
+
+void ground_station_waypoint_reached(GroundStation* station) {
+    if (station->current_waypoint < FLIGHT_PLAN_LENGTH) {
+        station->current_waypoint++;
+    }
+}
+
+// Random walk of the weather, clamped to plausible values
+static void update_weather(GroundStation* w, time_t now) {
+    if (now - w->weather_updated < WEATHER_UPDATE_INTERVAL_S) return;
+
+    w->wind_speed += (rand_r(&w->seed) % 100 - 50) / 10.0;
+    if (w->wind_speed < 0) w->wind_speed = 0;
+    if (w->wind_speed > 50) w->wind_speed = 50;
+
+    w->wind_direction += (rand_r(&w->seed) % 40 - 20);
+    if (w->wind_direction < 0) w->wind_direction += 360;
+    if (w->wind_direction >= 360) w->wind_direction -= 360;
+
+    w->turbulence += (rand_r(&w->seed) % 100 - 50) / 50.0;
+    if (w->turbulence < 0) w->turbulence = 0;
+    if (w->turbulence > 10) w->turbulence = 10;
+
+    w->temperature += (rand_r(&w->seed) % 100 - 50) / 50.0;
+    w->weather_updated = now;
+}
+
+int ground_station_step(GroundStation* station, time_t now,
+                        WireMessage records[GROUND_STATION_MAX_RECORDS]) {
+    update_weather(station, now);
+
+    int count = 0;
+    WireMessage* weather = &records[count++];
+    memset(weather, 0, sizeof(*weather));
+    weather->type = WIRE_SAT_WEATHER;
+    weather->data.weather.wind_speed = station->wind_speed;
+    weather->data.weather.wind_direction = station->wind_direction;
+    weather->data.weather.turbulence = station->turbulence;
+    weather->data.weather.temperature = station->temperature;
+
+    if (rand_r(&station->seed) % EMERGENCY_ODDS == 0) {
+        WireMessage* emergency = &records[count++];
+        memset(emergency, 0, sizeof(*emergency));
+        emergency->type = WIRE_SAT_EMERGENCY;
+        emergency->data.emergency = (uint32_t)(rand_r(&station->seed) % 4 + 1);  // 1-4
+    }
+
+    return count;
+}
@@ -0,0 +1,31 @@
+#include "sim_clock.h"
+
+// Simulated time is per process and only driven by the single-threaded
+// scheduler, so plain variables do
+static bool simulated;
+static uint64_t simulated_ns;
+
+uint64_t sim_clock_ns(void) {
+    return simulated ? simulated_ns : monotonic_ns();
+}
+
+int64_t sim_clock_ms(void) {
+    return (int64_t)(sim_clock_ns() / 1000000ull);
+}
+
+time_t sim_clock_time(void) {
+    return simulated ? (time_t)(simulated_ns / 1000000000ull) : time(NULL);
+}
+
+void sim_clock_use_simulated(time_t epoch) {
+    simulated = true;
+    simulated_ns = (uint64_t)epoch * 1000000000ull;
+}
+
+bool sim_clock_is_simulated(void) {
+    return simulated;
+}
+
+void sim_clock_advance_to(uint64_t ns) {
+    if (ns > simulated_ns) simulated_ns = ns;
+}
@@ -0,0 +1,119 @@
+#include "standby.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// One component's last checkpoint and its shadow's wake-up word
+typedef struct {
+    _Atomic bool enabled;
+    _Atomic uint32_t promotions;  // Futex word, bumped by standby_promote()
+    // Checkpoints alternate between two buffers, so a primary that dies
+    // while writing one leaves the previous checkpoint whole in the other
+    _Atomic uint32_t count;       // Completed checkpoints; the last is in buffer count & 1
+    uint32_t sizes[2];
+    unsigned char data[2][STANDBY_CHECKPOINT_SIZE];
+} StandbySlot;
+
+// Shared with forked components; NULL until standby_init()
+static StandbySlot* slots;
+
+// Promotion count each shadow forked from this process waits to see
+// change, copied into the shadow by fork()
+static uint32_t armed[MAX_COMPONENTS];
+static bool is_armed[MAX_COMPONENTS];
+
+static long futex(_Atomic uint32_t* addr, int op, uint32_t val) {
+    // Shared futex: the controller and the shadow are different processes
+    return syscall(SYS_futex, (uint32_t*)addr, op, val, NULL, NULL, 0);
+}
+
+bool standby_init(void) {
+    if (slots) return true;
+
+    void* addr = mmap(NULL, sizeof(StandbySlot) * MAX_COMPONENTS,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return false;
+
+    slots = addr;  // Anonymous mappings start zeroed
+    return true;
+}
+
+void standby_cleanup(void) {
+    if (!slots) return;
+    munmap(slots, sizeof(StandbySlot) * MAX_COMPONENTS);
+    slots = NULL;
+}
+
+void standby_enable(ComponentId component) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component)) return;
+    atomic_store(&slots[component].enabled, true);
+}
+
+void standby_arm(ComponentId component) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component)) return;
+    armed[component] = atomic_load(&slots[component].promotions);
+    is_armed[component] = true;
+}
+
+void standby_promote(ComponentId component) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component)) return;
+    atomic_fetch_add(&slots[component].promotions, 1);
+    futex(&slots[component].promotions, FUTEX_WAKE, INT_MAX);
+}
+
+bool standby_wait_promotion(ComponentId component) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component) || !is_armed[component]) return false;
+
+    // A promotion between the fork and here has already changed the word
+    _Atomic uint32_t* word = &slots[component].promotions;
+    while (atomic_load(word) == armed[component]) {
+        if (futex(word, FUTEX_WAIT, armed[component]) < 0 &&
+            errno != EAGAIN && errno != EINTR) {
+            return false;
+        }
+    }
+    is_armed[component] = false;
+    return true;
+}
+
+void standby_checkpoint(ComponentId component, const void* state, size_t size) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component) || size > STANDBY_CHECKPOINT_SIZE) return;
+
+    StandbySlot* slot = &slots[component];
+    if (!atomic_load_explicit(&slot->enabled, memory_order_relaxed)) return;
+
+    // Single writer: only the component's current primary checkpoints
+    uint32_t count = atomic_load_explicit(&slot->count, memory_order_relaxed);
+    uint32_t buffer = (count + 1) & 1;
+    slot->sizes[buffer] = (uint32_t)size;
+    memcpy(slot->data[buffer], state, size);
+
+    atomic_store_explicit(&slot->count, count + 1, memory_order_release);
+}
+
+bool standby_restore(ComponentId component, void* state, size_t size) {
+    if (!slots || !VALIDATE_COMPONENT_ID(component) || size > STANDBY_CHECKPOINT_SIZE) {
+        return false;
+    }
+
+    StandbySlot* slot = &slots[component];
+    for (;;) {
+        uint32_t begin = atomic_load_explicit(&slot->count, memory_order_acquire);
+        if (begin == 0) return false;
+
+        uint32_t buffer = begin & 1;
+        bool match = slot->sizes[buffer] == size;
+        if (match) memcpy(state, slot->data[buffer], size);
+        atomic_thread_fence(memory_order_acquire);  // Copy completes before the recheck
+
+        // A checkpoint completed meanwhile may have started on this buffer
+        if (atomic_load_explicit(&slot->count, memory_order_relaxed) == begin) {
+            return match;
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include "trace.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Trace ids: origin component, low pid bits and a per-process sequence, so
+// ids stay unique across component restarts.
+#define TRACE_ID_PID_SHIFT 40
+#define TRACE_ID_ORIGIN_SHIFT 56
+#define TRACE_ID_SEQ_MASK ((1ull << TRACE_ID_PID_SHIFT) - 1)
+
+static const char* const POINT_NAMES[TRACE_NUM_POINTS] = {
+    [TRACE_POSITION_TO_FC] = "position -> flight controller",
+    [TRACE_STATE_TO_AUTOPILOT] = "state -> autopilot",
+    [TRACE_COMMAND_TO_FC] = "command -> flight controller",
+    [TRACE_FIX_TO_AUTOPILOT] = "fix -> autopilot (end to end)",
+    [TRACE_FIX_AGE_AT_CONTROL] = "fix age at control step",
+    [TRACE_FIX_TO_COMMAND] = "fix -> command applied (end to end)"
+};
+
+// Shared with forked components; NULL until trace_init()
+static LatencyHistogram* histograms;
+static _Atomic uint64_t next_sequence;  // Shared by threaded components
+
+static int bucket_index(uint64_t value) {
+    if (value < (1u << LATENCY_HIST_SUB_BITS)) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (msb - LATENCY_HIST_SUB_BITS)) & ((1 << LATENCY_HIST_SUB_BITS) - 1);
+    int bucket = ((msb - LATENCY_HIST_SUB_BITS + 1) << LATENCY_HIST_SUB_BITS) + sub;
+    return bucket < LATENCY_HIST_BUCKETS ? bucket : LATENCY_HIST_BUCKETS - 1;
+}
+
+static uint64_t bucket_limit(int bucket) {
+    const int sub_buckets = 1 << LATENCY_HIST_SUB_BITS;
+    if (bucket < sub_buckets) return (uint64_t)bucket;
+
+    int shift = bucket / sub_buckets - 1;
+    uint64_t sub = (uint64_t)(bucket % sub_buckets);
+    return (((uint64_t)sub_buckets + sub + 1) << shift) - 1;
+}
+
+uint64_t latency_histogram_bucket_limit(int bucket) {
+    return bucket_limit(bucket);
+}
+
+void latency_histogram_add(LatencyHistogram* hist, uint64_t ns) {
+    atomic_fetch_add_explicit(&hist->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+    while (ns > max &&
+           !atomic_compare_exchange_weak_explicit(&hist->max, &max, ns,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+void latency_histogram_merge(LatencyHistogram* into, const LatencyHistogram* from) {
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        uint64_t n = atomic_load_explicit(&from->buckets[i], memory_order_relaxed);
+        if (n) atomic_fetch_add_explicit(&into->buckets[i], n, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&into->count,
+                              atomic_load_explicit(&from->count, memory_order_relaxed),
+                              memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&from->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&into->max, memory_order_relaxed)) {
+        atomic_store_explicit(&into->max, max, memory_order_relaxed);
+    }
+}
+
+uint64_t latency_histogram_percentile(const LatencyHistogram* hist, double percentile) {
+    uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    if (count == 0) return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+        if (seen >= rank) return bucket_limit(i);
+    }
+    return bucket_limit(LATENCY_HIST_BUCKETS - 1);
+}
+
+bool trace_init(void) {
+    if (histograms) return true;
+
+    void* addr = mmap(NULL, sizeof(LatencyHistogram) * TRACE_NUM_POINTS,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return false;
+
+    histograms = addr;  // Anonymous mappings start zeroed
+    return true;
+}
+
+void trace_cleanup(void) {
+    if (!histograms) return;
+    munmap(histograms, sizeof(LatencyHistogram) * TRACE_NUM_POINTS);
+    histograms = NULL;
+}
+
+TraceContext trace_begin(ComponentId origin) {
+    uint64_t pid_bits = (uint64_t)(getpid() & 0xffff) << TRACE_ID_PID_SHIFT;
+    uint64_t sequence = (atomic_fetch_add_explicit(&next_sequence, 1, memory_order_relaxed) + 1) &
+                        TRACE_ID_SEQ_MASK;
+
+    TraceContext context = {
+        .id = ((uint64_t)origin << TRACE_ID_ORIGIN_SHIFT) | pid_bits | sequence,
+        .origin_ns = monotonic_ns()
+    };
+    return context;
+}
+
+void trace_record(TracePoint point, uint64_t since_ns) {
+    if (!histograms || since_ns == 0 || point < 0 || point >= TRACE_NUM_POINTS) return;
+
+    uint64_t now = monotonic_ns();
+    latency_histogram_add(&histograms[point], now > since_ns ? now - since_ns : 0);
+}
+
+void trace_dump(FILE* out) {
+    if (!histograms) {
+        fprintf(out, "Trace: not initialized\n");
+        return;
+    }
+
+    fprintf(out, "%-38s %10s %10s %10s %10s %10s\n",
+            "Trace point (us)", "count", "p50", "p99", "p999", "max");
+    for (int i = 0; i < TRACE_NUM_POINTS; i++) {
+        const LatencyHistogram* hist = &histograms[i];
+        fprintf(out, "%-38s %10llu %10.1f %10.1f %10.1f %10.1f\n", POINT_NAMES[i],
+                (unsigned long long)atomic_load_explicit(&hist->count, memory_order_relaxed),
+                latency_histogram_percentile(hist, 50.0) / 1e3,
+                latency_histogram_percentile(hist, 99.0) / 1e3,
+                latency_histogram_percentile(hist, 99.9) / 1e3,
+                atomic_load_explicit(&hist->max, memory_order_relaxed) / 1e3);
+    }
+    fflush(out);
+}
@@ -0,0 +1,293 @@
+#include "wire_protocol.h"
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <sys/socket.h>
+
+// Sequential field writer/reader over a payload buffer
+typedef struct {
+    uint8_t* data;
+    size_t pos;
+} WireWriter;
+
+typedef struct {
+    const uint8_t* data;
+    size_t pos;
+} WireReader;
+
+static void put_u8(WireWriter* w, uint8_t value) {
+    w->data[w->pos++] = value;
+}
+
+static void put_u32(WireWriter* w, uint32_t value) {
+    value = htobe32(value);
+    memcpy(w->data + w->pos, &value, sizeof(value));
+    w->pos += sizeof(value);
+}
+
+static void put_double(WireWriter* w, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = htobe64(bits);
+    memcpy(w->data + w->pos, &bits, sizeof(bits));
+    w->pos += sizeof(bits);
+}
+
+static uint8_t get_u8(WireReader* r) {
+    return r->data[r->pos++];
+}
+
+static uint32_t get_u32(WireReader* r) {
+    uint32_t value;
+    memcpy(&value, r->data + r->pos, sizeof(value));
+    r->pos += sizeof(value);
+    return be32toh(value);
+}
+
+static double get_double(WireReader* r) {
+    uint64_t bits;
+    memcpy(&bits, r->data + r->pos, sizeof(bits));
+    r->pos += sizeof(bits);
+    bits = be64toh(bits);
+
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Payload size of each frame type; 0 marks types without a binary form
+static const uint16_t payload_sizes[WIRE_NUM_TYPES] = {
+    [WIRE_CSV_LINE] = 0,
+    [WIRE_GPS_POSITION] = 3 * 8,
+    [WIRE_ILS_DATA] = 3 * 8 + 3,
+    [WIRE_SAT_WAYPOINT] = 5 * 8 + 4 + 1,
+    [WIRE_SAT_WEATHER] = 4 * 8,
+    [WIRE_SAT_EMERGENCY] = 4
+};
+
+static uint16_t fletcher16(const uint8_t* data, size_t len) {
+    uint16_t sum1 = 0, sum2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum1 = (uint16_t)((sum1 + data[i]) % 255);
+        sum2 = (uint16_t)((sum2 + sum1) % 255);
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+size_t wire_encode(const WireMessage* msg, uint8_t* out, size_t size) {
+    if (!msg || !out || msg->type <= WIRE_CSV_LINE || msg->type >= WIRE_NUM_TYPES) {
+        return 0;
+    }
+
+    uint16_t length = payload_sizes[msg->type];
+    if (size < (size_t)WIRE_HEADER_SIZE + length) return 0;
+
+    WireWriter w = { out + WIRE_HEADER_SIZE, 0 };
+    switch (msg->type) {
+        case WIRE_GPS_POSITION:
+            put_double(&w, msg->data.gps.latitude);
+            put_double(&w, msg->data.gps.longitude);
+            put_double(&w, msg->data.gps.altitude);
+            break;
+
+        case WIRE_ILS_DATA:
+            put_double(&w, msg->data.ils.localizer);
+            put_double(&w, msg->data.ils.glideslope);
+            put_double(&w, msg->data.ils.distance);
+            put_u8(&w, msg->data.ils.localizer_valid);
+            put_u8(&w, msg->data.ils.glideslope_valid);
+            put_u8(&w, msg->data.ils.marker_beacon);
+            break;
+
+        case WIRE_SAT_WAYPOINT:
+            put_double(&w, msg->data.waypoint.latitude);
+            put_double(&w, msg->data.waypoint.longitude);
+            put_double(&w, msg->data.waypoint.altitude);
+            put_double(&w, msg->data.waypoint.speed);
+            put_double(&w, msg->data.waypoint.heading);
+            put_u32(&w, msg->data.waypoint.eta);
+            put_u8(&w, msg->data.waypoint.is_final);
+            break;
+
+        case WIRE_SAT_WEATHER:
+            put_double(&w, msg->data.weather.wind_speed);
+            put_double(&w, msg->data.weather.wind_direction);
+            put_double(&w, msg->data.weather.turbulence);
+            put_double(&w, msg->data.weather.temperature);
+            break;
+
+        case WIRE_SAT_EMERGENCY:
+            put_u32(&w, msg->data.emergency);
+            break;
+
+        default:
+            return 0;
+    }
+
+    uint16_t checksum = fletcher16(out + WIRE_HEADER_SIZE, length);
+    out[0] = WIRE_MAGIC_0;
+    out[1] = WIRE_MAGIC_1;
+    out[2] = WIRE_VERSION;
+    out[3] = (uint8_t)msg->type;
+    out[4] = (uint8_t)(length >> 8);
+    out[5] = (uint8_t)length;
+    out[6] = (uint8_t)(checksum >> 8);
+    out[7] = (uint8_t)checksum;
+    return WIRE_HEADER_SIZE + length;
+}
+
+static void decode_payload(WireType type, const uint8_t* payload, WireMessage* msg) {
+    WireReader r = { payload, 0 };
+    msg->type = type;
+
+    switch (type) {
+        case WIRE_GPS_POSITION:
+            msg->data.gps.latitude = get_double(&r);
+            msg->data.gps.longitude = get_double(&r);
+            msg->data.gps.altitude = get_double(&r);
+            break;
+
+        case WIRE_ILS_DATA:
+            msg->data.ils.localizer = get_double(&r);
+            msg->data.ils.glideslope = get_double(&r);
+            msg->data.ils.distance = get_double(&r);
+            msg->data.ils.localizer_valid = get_u8(&r) != 0;
+            msg->data.ils.glideslope_valid = get_u8(&r) != 0;
+            msg->data.ils.marker_beacon = get_u8(&r) != 0;
+            break;
+
+        case WIRE_SAT_WAYPOINT:
+            msg->data.waypoint.latitude = get_double(&r);
+            msg->data.waypoint.longitude = get_double(&r);
+            msg->data.waypoint.altitude = get_double(&r);
+            msg->data.waypoint.speed = get_double(&r);
+            msg->data.waypoint.heading = get_double(&r);
+            msg->data.waypoint.eta = get_u32(&r);
+            msg->data.waypoint.is_final = get_u8(&r) != 0;
+            break;
+
+        case WIRE_SAT_WEATHER:
+            msg->data.weather.wind_speed = get_double(&r);
+            msg->data.weather.wind_direction = get_double(&r);
+            msg->data.weather.turbulence = get_double(&r);
+            msg->data.weather.temperature = get_double(&r);
+            break;
+
+        case WIRE_SAT_EMERGENCY:
+            msg->data.emergency = get_u32(&r);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Parsing advances start; the buffer is compacted only before receiving
+static void consume(WireStream* stream, size_t count) {
+    stream->start += count;
+    if (stream->start == stream->end) {
+        stream->start = stream->end = 0;
+    }
+}
+
+void wire_stream_reset(WireStream* stream) {
+    stream->start = stream->end = 0;
+}
+
+ssize_t wire_stream_fill(WireStream* stream, int fd) {
+    if (stream->start > 0) {
+        memmove(stream->data, stream->data + stream->start, stream->end - stream->start);
+        stream->end -= stream->start;
+        stream->start = 0;
+    }
+
+    size_t space = sizeof(stream->data) - stream->end;
+    if (space == 0) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    ssize_t bytes_read = recv(fd, stream->data + stream->end, space, MSG_DONTWAIT);
+    if (bytes_read > 0) {
+        stream->end += (size_t)bytes_read;
+    }
+    return bytes_read;
+}
+
+static WireResult next_line(WireStream* stream, WireMessage* msg) {
+    const uint8_t* data = stream->data + stream->start;
+    size_t available = stream->end - stream->start;
+    const uint8_t* newline = memchr(data, '\n', available);
+    size_t scan = newline ? (size_t)(newline - data) : available;
+
+    // CSV is plain ASCII, so a frame magic inside the line means we are
+    // resynchronising after garbage: drop everything before the frame
+    const uint8_t* magic = memchr(data, WIRE_MAGIC_0, scan);
+    if (magic) {
+        consume(stream, (size_t)(magic - data));
+        return WIRE_MALFORMED;
+    }
+
+    if (!newline) {
+        // A full buffer without a newline can never complete
+        if (available == sizeof(stream->data)) {
+            wire_stream_reset(stream);
+            return WIRE_MALFORMED;
+        }
+        return WIRE_INCOMPLETE;
+    }
+
+    size_t line_len = (size_t)(newline - data);
+    size_t copy = line_len < WIRE_MAX_LINE - 1 ? line_len : WIRE_MAX_LINE - 1;
+    if (copy > 0 && data[copy - 1] == '\r') copy--;
+
+    msg->type = WIRE_CSV_LINE;
+    memcpy(msg->data.line, data, copy);
+    msg->data.line[copy] = '\0';
+    consume(stream, line_len + 1);
+    return WIRE_OK;
+}
+
+WireResult wire_stream_next(WireStream* stream, WireMessage* msg) {
+    const uint8_t* header = stream->data + stream->start;
+    size_t available = stream->end - stream->start;
+    if (available == 0) return WIRE_INCOMPLETE;
+
+    if (header[0] != WIRE_MAGIC_0) {
+        return next_line(stream, msg);
+    }
+
+    if (available < WIRE_HEADER_SIZE) {
+        // Check what we have of the header so garbage is skipped early
+        if (available >= 2 && header[1] != WIRE_MAGIC_1) {
+            consume(stream, 1);
+            return WIRE_MALFORMED;
+        }
+        return WIRE_INCOMPLETE;
+    }
+
+    uint8_t type = header[3];
+    uint16_t length = (uint16_t)((header[4] << 8) | header[5]);
+    uint16_t checksum = (uint16_t)((header[6] << 8) | header[7]);
+
+    if (header[1] != WIRE_MAGIC_1 || header[2] != WIRE_VERSION ||
+        type == WIRE_CSV_LINE || type >= WIRE_NUM_TYPES ||
+        length != payload_sizes[type]) {
+        consume(stream, 1);  // Resynchronise on the next byte
+        return WIRE_MALFORMED;
+    }
+
+    if (available < (size_t)WIRE_HEADER_SIZE + length) {
+        return WIRE_INCOMPLETE;
+    }
+
+    const uint8_t* payload = header + WIRE_HEADER_SIZE;
+    if (fletcher16(payload, length) != checksum) {
+        consume(stream, 1);
+        return WIRE_MALFORMED;
+    }
+
+    decode_payload((WireType)type, payload, msg);
+    consume(stream, WIRE_HEADER_SIZE + length);
+    return WIRE_OK;
+}
@@ -1,102 +1,99 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
 #include <signal.h>
 #include <time.h>
-#include <errno.h>
 #include <stdbool.h>
-#include <math.h>
+#include "sensor_models.h"
+#include "sender_server.h"
+#include "wire_protocol.h"
 
 #define LANDING_RADIO_PORT 5556
-#define MAX_CLIENTS 5
 #define BIND_RETRY_ATTEMPTS 5
 #define BIND_RETRY_DELAY_MS 1000
+#define UPDATE_INTERVAL_MS ILS_MODEL_INTERVAL_MS  // 1 Hz update rate
+#define CSV_RECORD_MAX 64
 
 static volatile bool running = true;
+static bool use_csv = false;  // --csv: send text records instead of frames
+
+static IlsApproach approach;  // Shared model, see sensor_models.h
 
 void handle_signal(int sig) {
     (void)sig;  // Suppress unused parameter warning
     running = false;
 }
 
-// Initialize server socket with retry logic
-int initialize_server(void) {
-    int server_fd;
-    struct sockaddr_in address;
-    int attempt = 0;
-
-    while (attempt < BIND_RETRY_ATTEMPTS) {
-        // Create socket
-        server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (server_fd == 0) {
-            perror("Socket creation failed");
-            return -1;
-        }
-
-        // Set socket options
-        int opt = 1;
-        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, 
-                      &opt, sizeof(opt))) {
-            perror("setsockopt failed");
-            close(server_fd);
-            return -1;
-        }
-
-        // Setup address structure
-        address.sin_family = AF_INET;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_port = htons(LANDING_RADIO_PORT);
-
-        // Try to bind
-        if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-            fprintf(stderr, "Bind attempt %d failed: %s\n", 
-                    attempt + 1, strerror(errno));
-            close(server_fd);
-            
-            if (attempt < BIND_RETRY_ATTEMPTS - 1) {
-                usleep(BIND_RETRY_DELAY_MS * 1000);
-                attempt++;
-                continue;
-            }
-            return -1;
+// One ILS record per tick, encoded once and broadcast to every client
+static void send_deviations(SenderServer* server, int ticks, double dt, void* context) {
+    (void)context;
+    uint8_t buffer[SENDER_MAX_TICKS_PER_WAKE * (WIRE_MAX_FRAME + CSV_RECORD_MAX)];
+    size_t length = 0;
+
+    for (int t = 0; t < ticks; t++) {
+        WireMessage record;
+        ils_model_step(&approach, dt, &record);
+
+        // Same fields as the frame: LOC,GS,DIST,LOC_VALID,GS_VALID,MARKER
+        if (use_csv) {
+            length += (size_t)snprintf((char*)buffer + length, CSV_RECORD_MAX,
+                    "%.3f,%.3f,%.2f,%d,%d,%d\n",
+                    record.data.ils.localizer,
+                    record.data.ils.glideslope,
+                    record.data.ils.distance,
+                    record.data.ils.localizer_valid,
+                    record.data.ils.glideslope_valid,
+                    record.data.ils.marker_beacon);
+        } else {
+            length += wire_encode(&record, buffer + length, WIRE_MAX_FRAME);
         }
-
-        // Successfully bound
-        return server_fd;
     }
-
-    return -1;
+    sender_server_broadcast(server, buffer, length);
 }
 
-int main(void) {
-    int server_fd;
-    int client_sockets[MAX_CLIENTS] = {0};
+int main(int argc, char* argv[]) {
+    SenderServerOptions options = sender_server_default_options(LANDING_RADIO_PORT,
+                                                                1000.0 / UPDATE_INTERVAL_MS);
+    // The previous instance may still hold the port for a moment
+    options.reuse_port = true;
+    options.bind_attempts = BIND_RETRY_ATTEMPTS;
+    options.bind_retry_ms = BIND_RETRY_DELAY_MS;
+
+    for (int i = 1; i < argc; i++) {
+        int used = sender_server_parse_option(&options, argc, argv, i);
+        if (used > 0) {
+            i += used - 1;
+        } else if (used == 0 && strcmp(argv[i], "--csv") == 0) {
+            use_csv = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--csv] [--rate HZ] [--max-clients N] [--ready-fd FD]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
     
     // Setup signal handler
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
-    // Initialize server with retry logic
-    server_fd = initialize_server();
-    if (server_fd < 0) {
+    ils_model_init(&approach, (unsigned int)time(NULL));
+
+    SenderServerHandlers handlers = { .on_tick = send_deviations };
+    SenderServer* server = sender_server_create(&options, &handlers);
+    if (!server) {
         fprintf(stderr, "Failed to initialize server after %d attempts\n", 
                 BIND_RETRY_ATTEMPTS);
         return 1;
     }
 
-    // Listen for connections
-    if (listen(server_fd, MAX_CLIENTS) < 0) {
-        perror("Listen failed");
-        return 1;
-    }
+    printf("Landing radio sender started on port %d (%s, %g Hz)\n", LANDING_RADIO_PORT,
+           use_csv ? "csv" : "binary", options.rate_hz);
 
-    printf("Landing radio sender started on port %d\n", LANDING_RADIO_PORT);
+    sender_server_run(server, &running);
 
-    // Rest of the landing radio sender code remains the same...
-    // (ILS simulation logic)
+    sender_server_print_stats(server, stdout);
+    sender_server_destroy(server);
 
+    printf("Landing radio sender stopped\n");
     return 0;
 }
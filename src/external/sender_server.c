@@ -0,0 +1,534 @@
+#define _GNU_SOURCE  // accept4
+#include "sender_server.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define EVENT_LISTEN UINT64_MAX
+#define EVENT_TIMER (UINT64_MAX - 1)
+#define MAX_EVENTS 64
+#define MAX_RATE_HZ 1000000.0
+#define LISTEN_FDS_START 3  // First socket passed by socket activation
+
+// One connected client. Queued output is queue[head..tail); it is moved
+// back to the start of the buffer before new data would run off its end.
+typedef struct {
+    int fd;                         // -1 if the slot is free
+    uint32_t generation;            // Tells stale epoll events from a reused slot
+    uint8_t* queue;
+    size_t head;
+    size_t tail;
+    bool writable_armed;            // EPOLLOUT registered
+    uint64_t full_since_ns;         // First drop since the queue last took data, 0 if none
+} Client;
+
+struct SenderServer {
+    SenderServerOptions options;
+    SenderServerHandlers handlers;
+    int listen_fd;
+    int timer_fd;
+    int epoll_fd;
+    Client* clients;
+    int client_count;
+    SenderServerStats stats;
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t client_event(const SenderServer* server, int client) {
+    return (uint64_t)server->clients[client].generation << 32 | (uint32_t)client;
+}
+
+SenderServerOptions sender_server_default_options(uint16_t port, double rate_hz) {
+    SenderServerOptions options = {
+        .port = port,
+        .rate_hz = rate_hz,
+        .max_clients = SENDER_DEFAULT_MAX_CLIENTS,
+        .client_queue_bytes = SENDER_DEFAULT_CLIENT_QUEUE,
+        .slow_client_ms = SENDER_DEFAULT_SLOW_CLIENT_MS,
+        .reuse_port = false,
+        .bind_attempts = 1,
+        .bind_retry_ms = 1000,
+        .ready_fd = -1,
+    };
+    return options;
+}
+
+// Listening socket, retrying while the port is still held
+static int open_listener(const SenderServerOptions* options) {
+    for (int attempt = 1; ; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            perror("Socket creation failed");
+            return -1;
+        }
+
+        int opt = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+            (options->reuse_port &&
+             setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)))) {
+            perror("setsockopt failed");
+            close(fd);
+            return -1;
+        }
+
+        struct sockaddr_in address = {
+            .sin_family = AF_INET,
+            .sin_addr.s_addr = INADDR_ANY,
+            .sin_port = htons(options->port),
+        };
+        if (bind(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            if (listen(fd, options->max_clients) < 0) {
+                perror("Listen failed");
+                close(fd);
+                return -1;
+            }
+            return fd;
+        }
+
+        fprintf(stderr, "Bind attempt %d on port %u failed: %s\n", attempt,
+                options->port, strerror(errno));
+        close(fd);
+        if (attempt >= options->bind_attempts) return -1;
+        usleep(options->bind_retry_ms * 1000);
+    }
+}
+
+// A listening socket passed in by socket activation (the LISTEN_PID and
+// LISTEN_FDS variables of systemd's protocol), or -1 if there is none
+static int activated_listener(void) {
+    const char* pid = getenv("LISTEN_PID");
+    const char* fds = getenv("LISTEN_FDS");
+    if (!pid || !fds || atol(pid) != (long)getpid() || atoi(fds) < 1) return -1;
+
+    // Not for any children
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+
+    int fd = LISTEN_FDS_START;
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        perror("Activated socket unusable");
+        return -1;
+    }
+    return fd;
+}
+
+// Tell whoever started the sender that it accepts connections: a line on
+// the ready fd, and READY=1 to systemd's NOTIFY_SOCKET if that is set
+static void notify_ready(SenderServer* server) {
+    if (server->options.ready_fd >= 0) {
+        char line[32];
+        int length = snprintf(line, sizeof(line), "READY %u\n", server->options.port);
+        if (write(server->options.ready_fd, line, (size_t)length) != length) {
+            perror("Readiness notification failed");
+        }
+        close(server->options.ready_fd);
+        server->options.ready_fd = -1;
+    }
+
+    const char* path = getenv("NOTIFY_SOCKET");
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    size_t length = path ? strlen(path) : 0;
+    if (length == 0 || length >= sizeof(address.sun_path) || (path[0] != '/' && path[0] != '@')) {
+        return;
+    }
+    memcpy(address.sun_path, path, length);
+    if (path[0] == '@') address.sun_path[0] = '\0';  // Abstract namespace
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 ||
+        sendto(fd, "READY=1", 7, MSG_NOSIGNAL, (struct sockaddr*)&address,
+               (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length)) < 0) {
+        perror("NOTIFY_SOCKET notification failed");
+    }
+    if (fd >= 0) close(fd);
+}
+
+static bool arm_timer(int timer_fd, double rate_hz) {
+    uint64_t period_ns = (uint64_t)(1e9 / rate_hz);
+    if (period_ns == 0) period_ns = 1;
+    struct itimerspec spec = {
+        .it_interval = { (time_t)(period_ns / 1000000000ULL), (long)(period_ns % 1000000000ULL) },
+    };
+    spec.it_value = spec.it_interval;
+    return timerfd_settime(timer_fd, 0, &spec, NULL) == 0;
+}
+
+SenderServer* sender_server_create(const SenderServerOptions* options,
+                                   const SenderServerHandlers* handlers) {
+    if (!options || !handlers || !handlers->on_tick || options->max_clients <= 0 ||
+        options->rate_hz <= 0.0 || options->rate_hz > MAX_RATE_HZ ||
+        options->client_queue_bytes == 0) {
+        fprintf(stderr, "Invalid sender server options\n");
+        return NULL;
+    }
+
+    SenderServer* server = calloc(1, sizeof(SenderServer));
+    if (!server) return NULL;
+    server->options = *options;
+    server->handlers = *handlers;
+    server->listen_fd = server->timer_fd = server->epoll_fd = -1;
+
+    server->clients = calloc((size_t)options->max_clients, sizeof(Client));
+    if (!server->clients) {
+        free(server);
+        return NULL;
+    }
+    for (int i = 0; i < options->max_clients; i++) {
+        server->clients[i].fd = -1;
+    }
+
+    server->listen_fd = activated_listener();
+    if (server->listen_fd < 0) {
+        server->listen_fd = open_listener(options);
+    }
+    if (server->listen_fd < 0) {
+        sender_server_destroy(server);
+        return NULL;
+    }
+
+    server->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->timer_fd < 0 || server->epoll_fd < 0 ||
+        !arm_timer(server->timer_fd, options->rate_hz)) {
+        perror("Sender event loop setup failed");
+        sender_server_destroy(server);
+        return NULL;
+    }
+
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.u64 = EVENT_LISTEN };
+    struct epoll_event timer_event = { .events = EPOLLIN, .data.u64 = EVENT_TIMER };
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &listen_event) ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->timer_fd, &timer_event)) {
+        perror("epoll_ctl failed");
+        sender_server_destroy(server);
+        return NULL;
+    }
+
+    notify_ready(server);
+    return server;
+}
+
+static void close_client(SenderServer* server, int client, const char* reason) {
+    Client* c = &server->clients[client];
+    if (c->fd < 0) return;
+
+    close(c->fd);  // Also leaves the epoll set
+    free(c->queue);
+    uint32_t generation = c->generation + 1;
+    memset(c, 0, sizeof(Client));
+    c->fd = -1;
+    c->generation = generation;
+    server->client_count--;
+    printf("Client %d %s (%d connected)\n", client, reason, server->client_count);
+}
+
+void sender_server_destroy(SenderServer* server) {
+    if (!server) return;
+
+    for (int i = 0; i < server->options.max_clients; i++) {
+        if (server->clients[i].fd >= 0) {
+            close(server->clients[i].fd);
+            free(server->clients[i].queue);
+        }
+    }
+    free(server->clients);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->timer_fd >= 0) close(server->timer_fd);
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    free(server);
+}
+
+// Register for EPOLLOUT only while output is queued
+static void set_writable_interest(SenderServer* server, int client, bool armed) {
+    Client* c = &server->clients[client];
+    if (c->writable_armed == armed) return;
+
+    struct epoll_event event = {
+        .events = EPOLLIN | (armed ? EPOLLOUT : 0),
+        .data.u64 = client_event(server, client),
+    };
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &event) == 0) {
+        c->writable_armed = armed;
+    }
+}
+
+// Bytes the socket took, 0 if it would block, -1 if the client is gone
+static ssize_t write_client(SenderServer* server, int client, const struct iovec* parts,
+                            int count) {
+    struct msghdr message = { .msg_iov = (struct iovec*)parts, .msg_iovlen = (size_t)count };
+    ssize_t written = sendmsg(server->clients[client].fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+        close_client(server, client, "disconnected");
+        return -1;
+    }
+    server->stats.bytes_sent += (uint64_t)written;
+    return written;
+}
+
+// Write what is queued and then data, queueing whatever the socket did not
+// take. The whole of data is dropped if it does not fit the queue.
+static bool send_to_client(SenderServer* server, int client, const uint8_t* data, size_t length) {
+    Client* c = &server->clients[client];
+    size_t capacity = server->options.client_queue_bytes;
+    size_t queued = c->tail - c->head;
+
+    if (length > capacity - queued) {
+        server->stats.bytes_dropped += length;
+        if (c->full_since_ns == 0) c->full_since_ns = monotonic_ns();
+        return false;
+    }
+    c->full_since_ns = 0;
+
+    if (!c->queue) {
+        c->queue = malloc(capacity);
+        if (!c->queue) {
+            close_client(server, client, "dropped (out of memory)");
+            return false;
+        }
+    }
+
+    struct iovec parts[2];
+    int count = 0;
+    if (queued > 0) {
+        parts[count++] = (struct iovec){ c->queue + c->head, queued };
+    }
+    parts[count++] = (struct iovec){ (void*)data, length };
+
+    ssize_t written = write_client(server, client, parts, count);
+    if (written < 0) return false;
+
+    size_t sent = (size_t)written;
+    if (sent < queued) {
+        c->head += sent;
+        sent = 0;
+    } else {
+        c->head = c->tail = 0;
+        sent -= queued;
+    }
+
+    size_t rest = length - sent;
+    if (rest > 0) {
+        if (c->tail + rest > capacity) {
+            memmove(c->queue, c->queue + c->head, c->tail - c->head);
+            c->tail -= c->head;
+            c->head = 0;
+        }
+        memcpy(c->queue + c->tail, data + sent, rest);
+        c->tail += rest;
+    }
+    set_writable_interest(server, client, c->tail > c->head);
+    return true;
+}
+
+void sender_server_broadcast(SenderServer* server, const void* data, size_t length) {
+    if (length == 0) return;
+    server->stats.batches++;
+
+    for (int i = 0; i < server->options.max_clients; i++) {
+        if (server->clients[i].fd >= 0) {
+            send_to_client(server, i, data, length);
+        }
+    }
+}
+
+bool sender_server_send(SenderServer* server, int client, const void* data, size_t length) {
+    if (client < 0 || client >= server->options.max_clients ||
+        server->clients[client].fd < 0) {
+        return false;
+    }
+    return length == 0 || send_to_client(server, client, data, length);
+}
+
+static void flush_client(SenderServer* server, int client) {
+    Client* c = &server->clients[client];
+    if (c->tail > c->head) {
+        struct iovec part = { c->queue + c->head, c->tail - c->head };
+        ssize_t written = write_client(server, client, &part, 1);
+        if (written < 0) return;
+        c->head += (size_t)written;
+    }
+    if (c->head == c->tail) {
+        c->head = c->tail = 0;
+        set_writable_interest(server, client, false);
+    }
+}
+
+static void accept_clients(SenderServer* server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("Accept failed");
+            return;
+        }
+
+        int slot = -1;
+        for (int i = 0; i < server->options.max_clients; i++) {
+            if (server->clients[i].fd < 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            server->stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        // Records are small and latency matters more than packet count
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        server->clients[slot].fd = fd;
+        struct epoll_event event = { .events = EPOLLIN, .data.u64 = client_event(server, slot) };
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            perror("epoll_ctl failed");
+            close(fd);
+            server->clients[slot].fd = -1;
+            continue;
+        }
+
+        server->client_count++;
+        server->stats.connections++;
+        printf("Client %d connected (%d connected)\n", slot, server->client_count);
+        if (server->handlers.on_connect) {
+            server->handlers.on_connect(server, slot, server->handlers.context);
+        }
+    }
+}
+
+static void receive_from_client(SenderServer* server, int client) {
+    char buffer[SENDER_RECEIVE_BUFFER];
+    ssize_t bytes_read = recv(server->clients[client].fd, buffer, sizeof(buffer) - 1,
+                              MSG_DONTWAIT);
+    if (bytes_read > 0) {
+        buffer[bytes_read] = '\0';
+        if (server->handlers.on_receive) {
+            server->handlers.on_receive(server, client, buffer, (size_t)bytes_read,
+                                        server->handlers.context);
+        }
+    } else if (bytes_read == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        close_client(server, client, "disconnected");
+    }
+}
+
+// Hand the elapsed ticks to the sender, then drop clients whose queue has
+// been full for too long
+static void run_ticks(SenderServer* server) {
+    uint64_t expirations = 0;
+    if (read(server->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations) ||
+        expirations == 0) {
+        return;
+    }
+
+    int ticks = expirations > SENDER_MAX_TICKS_PER_WAKE ? SENDER_MAX_TICKS_PER_WAKE :
+                (int)expirations;
+    server->stats.ticks_skipped += expirations - (uint64_t)ticks;
+    server->handlers.on_tick(server, ticks, 1.0 / server->options.rate_hz,
+                             server->handlers.context);
+
+    uint64_t now = monotonic_ns();
+    uint64_t limit_ns = (uint64_t)server->options.slow_client_ms * 1000000ULL;
+    for (int i = 0; i < server->options.max_clients; i++) {
+        Client* c = &server->clients[i];
+        if (c->fd >= 0 && c->full_since_ns && now - c->full_since_ns > limit_ns) {
+            server->stats.slow_disconnects++;
+            close_client(server, i, "dropped (not reading)");
+        }
+    }
+}
+
+void sender_server_run(SenderServer* server, volatile bool* running) {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (*running) {
+        int count = epoll_wait(server->epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            return;
+        }
+
+        for (int e = 0; e < count; e++) {
+            uint64_t tag = events[e].data.u64;
+            if (tag == EVENT_LISTEN) {
+                accept_clients(server);
+                continue;
+            }
+            if (tag == EVENT_TIMER) {
+                run_ticks(server);
+                continue;
+            }
+
+            int client = (int)(uint32_t)tag;
+            if ((uint32_t)(tag >> 32) != server->clients[client].generation) continue;
+
+            uint32_t ready = events[e].events;
+            if (ready & EPOLLOUT) flush_client(server, client);
+            if (server->clients[client].fd >= 0 && (ready & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                receive_from_client(server, client);
+            }
+        }
+    }
+}
+
+int sender_server_client_count(const SenderServer* server) {
+    return server->client_count;
+}
+
+void sender_server_get_stats(const SenderServer* server, SenderServerStats* stats) {
+    *stats = server->stats;
+}
+
+void sender_server_print_stats(const SenderServer* server, FILE* out) {
+    const SenderServerStats* s = &server->stats;
+    fprintf(out, "Clients: %llu accepted, %llu rejected, %llu dropped as slow, %d connected\n",
+            (unsigned long long)s->connections, (unsigned long long)s->rejected,
+            (unsigned long long)s->slow_disconnects, server->client_count);
+    fprintf(out, "Output: %llu batches, %llu bytes sent, %llu bytes dropped, %llu ticks skipped\n",
+            (unsigned long long)s->batches, (unsigned long long)s->bytes_sent,
+            (unsigned long long)s->bytes_dropped, (unsigned long long)s->ticks_skipped);
+}
+
+int sender_server_parse_option(SenderServerOptions* options, int argc, char* argv[], int i) {
+    bool rate = strcmp(argv[i], "--rate") == 0;
+    bool clients = strcmp(argv[i], "--max-clients") == 0;
+    if (!rate && !clients && strcmp(argv[i], "--ready-fd") != 0) return 0;
+    if (i + 1 >= argc) return -1;
+
+    char* end;
+    if (rate) {
+        double hz = strtod(argv[i + 1], &end);
+        if (*end != '\0' || hz <= 0.0 || hz > MAX_RATE_HZ) return -1;
+        options->rate_hz = hz;
+    } else {
+        long value = strtol(argv[i + 1], &end, 10);
+        if (*end != '\0' || value < 0 || value > 65536 || (clients && value == 0)) return -1;
+        if (clients) {
+            options->max_clients = (int)value;
+        } else {
+            options->ready_fd = (int)value;
+        }
+    }
+    return 2;
+}
@@ -1,16 +1,32 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <stdbool.h>
 #include "bus.h"
+#include "component.h"
 #include "flight_controller.h"
+#include "log.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "replay.h"
 #include "common.h"
+#include "sim_clock.h"
+#include "trace.h"
+
+// Upper bound on how long the main loop sleeps waiting for messages
+#define MAIN_LOOP_TIMEOUT_MS 100
+// How long startup waits for every component to report ready (as long as
+// the INS waits for its first GPS fix)
+#define READY_TIMEOUT_MS 10000
 
 static volatile bool running = true;
+static volatile sig_atomic_t dump_traces = false;
 static FlightController* controller = NULL;
 static Bus* bus = NULL;
+static Replay* replay = NULL;
 
 // Forward declaration
 static void cleanup(void);
@@ -21,33 +37,49 @@ static void handle_signal(int sig) {
     running = false;
 }
 
+// SIGUSR1 prints the latency histograms, loop jitter, bus and recorder
+// counters from the main loop
+static void handle_dump_signal(int sig) {
+    (void)sig;
+    dump_traces = true;
+}
+
 // Cleanup handler that will be called on exit
 static void cleanup(void) {
     fprintf(stderr, "Performing cleanup...\n");
     
     if (controller) {
-        flight_controller_cleanup(controller);
+        flight_controller_cleanup(controller);  // Releases the bus too
         controller = NULL;
+        bus = NULL;
     }
     
     if (bus) {
         bus_cleanup(bus);
         bus = NULL;
     }
+
+    replay_close(replay);
+    replay = NULL;
+
+    recorder_stop();  // After the components, so their last messages are kept
+    metrics_cleanup();
+    log_cleanup();  // Drains the async ring
     
     fprintf(stderr, "Cleanup complete\n");
 }
 
-// Print simulation status
-static void print_status(const FlightController* fc) {
+// Print simulation status from the shared snapshot, once a second of real
+// time unless forced
+static void print_status(Bus* bus, bool force) {
     static time_t last_print = 0;
     time_t now = time(NULL);
 
-    if (now - last_print >= 1) {  // Update every second
-        const ExtendedFlightState* state = flight_controller_get_state(fc);
-        if (state) {
+    if (force || now - last_print >= 1) {  // Update every second
+        FlightStateSample sample;
+        if (flight_state_read_snapshot(bus_state_snapshot(bus), &sample)) {
             char buffer[1024];
-            flight_state_to_string(state, buffer, sizeof(buffer));
+            flight_state_to_string(&sample.state, buffer, sizeof(buffer));
             printf("\033[2J\033[H");  // Clear screen and move cursor to top
             printf("%s\n", buffer);
         }
@@ -55,45 +87,184 @@ static void print_status(const FlightController* fc) {
     }
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
+    // --threads runs every component as a thread of this process over an
+    // in-memory bus, for single-box regression and soak runs. --scheduler
+    // steps them all from this thread on simulated time, flat out unless
+    // paced with --speed. --duration stops after that many seconds of
+    // (simulated) time. --realtime pins and prioritizes components as the
+    // given schedule file says (see config/realtime.json). --record writes
+    // all bus traffic to PREFIX.NNNN.rec segments (see recorder_dump).
+    // --replay runs the scheduler on such a recording's sensor traffic in
+    // place of the receivers, then compares the outputs and exits non-zero
+    // if they differ. --standby keeps a warm standby process behind the
+    // INS and the autopilot that takes over within a step if they die.
+    // --log writes component logs to airplane_sim_<time>.log; --async-log
+    // does the same through a per-process ring and writer thread, so
+    // component loops never block on the file.
+    FlightControllerOptions options = flight_controller_default_options();
+    RecorderOptions record_options = recorder_default_options();
+    bool record = false;
+    const char* replay_prefix = NULL;
+    FlightControllerExecMode exec_mode = FC_EXEC_PROCESSES;
+    double speed = 0.0;
+    double duration_s = 0.0;
+    bool log_file = false;
+    bool async_log = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0) {
+            exec_mode = FC_EXEC_THREADS;
+        } else if (strcmp(argv[i], "--scheduler") == 0) {
+            exec_mode = FC_EXEC_SCHEDULER;
+        } else if (strcmp(argv[i], "--standby") == 0) {
+            options.standby[COMPONENT_INS] = true;
+            options.standby[COMPONENT_AUTOPILOT] = true;
+        } else if (strcmp(argv[i], "--log") == 0) {
+            log_file = true;
+        } else if (strcmp(argv[i], "--async-log") == 0) {
+            log_file = true;
+            async_log = true;
+        } else if (strcmp(argv[i], "--realtime") == 0 && i + 1 < argc) {
+            if (flight_controller_load_schedules(&options, argv[++i]) != SUCCESS) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_options.prefix = argv[++i];
+            record = true;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_prefix = argv[++i];
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration_s = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--threads | --scheduler [--speed X]] [--duration SECONDS] "
+                    "[--realtime SCHEDULE.json] [--standby] [--log | --async-log] "
+                    "[--record PREFIX | --replay PREFIX]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (replay_prefix && exec_mode == FC_EXEC_THREADS) {
+        fprintf(stderr, "--replay runs on the scheduler, not --threads\n");
+        return 1;
+    }
+    if (replay_prefix && record) {
+        fprintf(stderr, "--replay compares with a recording and cannot record itself\n");
+        return 1;
+    }
+    if (replay_prefix) {
+        exec_mode = FC_EXEC_SCHEDULER;
+    }
+    if (options.standby[COMPONENT_INS] && exec_mode != FC_EXEC_PROCESSES) {
+        fprintf(stderr, "--standby needs component processes\n");
+        return 1;
+    }
+
     // Setup signal handlers
     struct sigaction sa = {0};
     sa.sa_handler = handle_signal;
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = handle_dump_signal;
+    sigaction(SIGUSR1, &sa, NULL);
     
     // Register cleanup handler
     atexit(cleanup);
 
     fprintf(stderr, "Starting aircraft simulation...\n");
 
+    // Before anything forks, so every component logs the same way
+    if (log_file) {
+        log_init();
+        log_set_async(async_log);
+    }
+
     // Initialize message bus
-    bus = bus_init();
+    BusOptions bus_options = bus_default_options();
+    if (exec_mode != FC_EXEC_PROCESSES) {
+        bus_options.backend = BUS_BACKEND_MEMORY;
+    }
+    bus = bus_init_with_options(&bus_options);
     if (!bus) {
         fprintf(stderr, "Failed to initialize message bus\n");
         return 1;
     }
 
+    // Latency tables and metrics must exist before components are forked
+    if (!trace_init()) {
+        fprintf(stderr, "Failed to initialize latency tracing\n");
+    }
+    if (!component_timing_init()) {
+        fprintf(stderr, "Failed to initialize loop timing\n");
+    }
+    if (!metrics_init(NULL)) {
+        fprintf(stderr, "Failed to initialize metrics\n");
+    }
+
+    if (replay_prefix && !(replay = replay_open(bus, replay_prefix))) {
+        return 1;
+    }
+
     // Initialize flight controller
-    controller = flight_controller_init(bus);
+    options.mode = exec_mode;
+    options.replay = replay;
+    controller = flight_controller_init_with_options(bus, &options);
     if (!controller) {
         fprintf(stderr, "Failed to initialize flight controller\n");
         return 1;
     }
+    flight_controller_set_sim_speed(controller, speed);
+
+    // The recorder taps the bus in every component, so it starts before
+    // they are forked, and after the scheduler has switched the clock
+    if (record && recorder_start(&record_options) != SUCCESS) {
+        return 1;
+    }
 
-    // Start flight controller (this will fork component processes)
+    // Start flight controller (this will fork component processes or
+    // start component threads)
     if (flight_controller_start(controller) != SUCCESS) {
         fprintf(stderr, "Failed to start flight controller\n");
         return 1;
     }
 
+    // Declare the system up once every component says it is ready. The
+    // wait counts towards --duration; replays run as recorded, without it.
+    int64_t stop_ms = duration_s > 0.0 ? sim_clock_ms() + (int64_t)(duration_s * 1000.0) : 0;
+    if (!replay) {
+        int64_t wait_start_ms = monotonic_ms();
+        if (flight_controller_wait_ready(controller, READY_TIMEOUT_MS, &running) == SUCCESS) {
+            fprintf(stderr, "All systems ready after %lld ms\n",
+                    (long long)(monotonic_ms() - wait_start_ms));
+        } else if (running) {
+            fprintf(stderr, "Not every component is ready; running anyway\n");
+        }
+    }
+
     fprintf(stderr, "All systems initialized. Running simulation...\n");
 
     // Main loop
-    while (running) {
-        flight_controller_process_messages(controller);
-        print_status(controller);
-        usleep(10000);  // 10ms sleep
+    while (running && (stop_ms == 0 || sim_clock_ms() < stop_ms) && !replay_finished(replay)) {
+        flight_controller_wait_messages(controller, MAIN_LOOP_TIMEOUT_MS);
+        print_status(bus, false);
+        if (dump_traces) {
+            dump_traces = false;
+            trace_dump(stderr);
+            component_timing_dump(stderr);
+            bus_dump_stats(bus, stderr);
+            recorder_dump_stats(stderr);
+        }
+    }
+
+    if (running) {
+        print_status(bus, true);  // State at the end of --duration
+    }
+
+    if (replay) {
+        replay_report(replay, stderr);
+        if (replay_outputs_differ(replay)) {
+            return 2;
+        }
     }
 
     fprintf(stderr, "Simulation shutdown complete\n");
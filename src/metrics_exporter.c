@@ -0,0 +1,179 @@
+// Metrics exporter: print or serve the simulator's metrics in the
+// Prometheus text format.
+//
+// Maps the metrics region read-only, so it never touches the simulator's
+// hot path; each dump or scrape opens it again, so a restarted simulator
+// is picked up without restarting the exporter.
+//
+// Usage: metrics_exporter [options]
+//   --pid PID         read the region of the simulator running as PID
+//   --name NAME       shared memory region, as printed by the simulator
+//   --http PORT       serve GET /metrics on PORT instead of printing once
+
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define REQUEST_BUFFER 2048
+#define LISTEN_BACKLOG 16
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+static bool write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+static void respond(int fd, const char* status, const char* content_type,
+                    const char* body, size_t length) {
+    char header[256];
+    int header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+                                 "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                                 status, content_type, length);
+    if (write_all(fd, header, (size_t)header_length)) {
+        write_all(fd, body, length);
+    }
+}
+
+// One request per connection: GET /metrics gets the current region
+static void serve_client(int fd, const char* name) {
+    char request[REQUEST_BUFFER];
+    size_t length = 0;
+    while (length < sizeof(request) - 1) {
+        ssize_t bytes = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        length += (size_t)bytes;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[length] = '\0';
+
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        const char* body = "Not found; try /metrics\n";
+        respond(fd, "404 Not Found", "text/plain", body, strlen(body));
+        return;
+    }
+
+    const MetricsRegion* region = metrics_open(name);
+    if (!region) {
+        const char* body = "Simulator metrics region not available\n";
+        respond(fd, "503 Service Unavailable", "text/plain", body, strlen(body));
+        return;
+    }
+
+    char* body = NULL;
+    size_t body_length = 0;
+    FILE* out = open_memstream(&body, &body_length);
+    if (out) {
+        metrics_write_prometheus(region, out);
+        fclose(out);
+        respond(fd, "200 OK", "text/plain; version=0.0.4", body, body_length);
+        free(body);
+    }
+    metrics_close(region);
+}
+
+static int serve(const char* name, uint16_t port) {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = INADDR_ANY,
+        .sin_port = htons(port)
+    };
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, LISTEN_BACKLOG) < 0) {
+        fprintf(stderr, "Cannot listen on port %u: %s\n", port, strerror(errno));
+        close(listen_fd);
+        return 1;
+    }
+
+    fprintf(stderr, "Serving %s on http://0.0.0.0:%u/metrics\n", name, port);
+    while (running) {
+        int client = accept(listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno != EINTR) perror("accept");
+            continue;
+        }
+        struct timeval timeout = { .tv_sec = 2, .tv_usec = 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        serve_client(client, name);
+        close(client);
+    }
+
+    close(listen_fd);
+    return 0;
+}
+
+static int usage(const char* prog) {
+    fprintf(stderr, "Usage: %s --pid PID | --name NAME [--http PORT]\n", prog);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    char pid_name[64];
+    const char* name = NULL;
+    int port = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--pid") == 0 && i + 1 < argc) {
+            int pid = atoi(argv[++i]);
+            if (pid <= 0) {
+                fprintf(stderr, "Invalid pid %s\n", argv[i]);
+                return 1;
+            }
+            metrics_region_name(pid_name, sizeof(pid_name), pid);
+            name = pid_name;
+        } else if (strcmp(argv[i], "--http") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+            if (port <= 0 || port > 65535) {
+                fprintf(stderr, "Invalid port %s\n", argv[i]);
+                return 1;
+            }
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (!name) return usage(argv[0]);
+
+    if (port) {
+        // Without SA_RESTART, so accept() returns on a signal
+        struct sigaction sa = {0};
+        sa.sa_handler = handle_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        return serve(name, (uint16_t)port);
+    }
+
+    const MetricsRegion* region = metrics_open(name);
+    if (!region) return 1;
+    metrics_write_prometheus(region, stdout);
+    metrics_close(region);
+    return 0;
+}
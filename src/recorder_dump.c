@@ -0,0 +1,141 @@
+// Recorder dump: print the bus traffic captured by airplane_sim --record.
+//
+// Reads segment files in the order given, through each segment's index,
+// so a time slice or a single message type is found without scanning the
+// rest of the file. Times are seconds since the recording started.
+//
+// Usage: recorder_dump [options] FILE.rec...
+//   --type T          only this message type (name or number)
+//   --from S          skip records before S seconds
+//   --to S            stop after S seconds
+//   --summary         per-segment counts instead of records
+
+#include "recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int type;
+    double from_s;
+    double to_s;            // Negative for no limit
+    bool summary;
+} DumpConfig;
+
+static int parse_type(const char* text) {
+    for (int i = 0; i < MSG_NUM_TYPES; i++) {
+        if (strcmp(text, message_type_name(i)) == 0) return i;
+    }
+    char* end;
+    long number = strtol(text, &end, 10);
+    if (*end == '\0' && VALIDATE_MESSAGE_TYPE(number)) return (int)number;
+    return -2;
+}
+
+static void print_payload(const Message* message) {
+    switch (message->header.type) {
+        case MSG_POSITION_UPDATE: {
+            const Position* p = &message->payload.position_update.position;
+            printf(" %.6f, %.6f, %.1f ft", p->latitude, p->longitude, p->altitude);
+            break;
+        }
+        case MSG_STATE_RESPONSE: {
+            const FlightState* s = &message->payload.state_response.state;
+            printf(" %.6f, %.6f, %.1f ft, hdg %.1f, %.1f kt", s->position.latitude,
+                   s->position.longitude, s->position.altitude, s->heading, s->speed);
+            break;
+        }
+        case MSG_AUTOPILOT_COMMAND: {
+            const AutopilotCommandMsg* c = &message->payload.autopilot_command;
+            printf(" hdg %.1f, %.1f kt, %.1f ft", c->target_heading, c->target_speed,
+                   c->target_altitude);
+            break;
+        }
+        case MSG_SYSTEM_STATUS:
+            printf(" %s", message->payload.system_status.component_active ? "active" : "inactive");
+            break;
+        default:
+            break;
+    }
+}
+
+static void print_summary(const char* path, const RecorderSegment* segment) {
+    const RecorderSegmentHeader* header = segment->header;
+    double span = (double)(header->last_time_ns - header->first_time_ns) / 1e9;
+
+    printf("%s: segment %u%s, %llu records over %.3f s from %.3f s, %u index entries, "
+           "%llu dropped\n", path, header->segment, header->closed ? "" : " (open)",
+           (unsigned long long)header->records, header->records ? span : 0.0,
+           (double)(header->first_time_ns - header->start_clock_ns) / 1e9,
+           header->index_count, (unsigned long long)header->dropped);
+    for (int type = 0; type < MSG_NUM_TYPES; type++) {
+        if (header->type_records[type]) {
+            printf("  %-16s %10llu\n", message_type_name(type),
+                   (unsigned long long)header->type_records[type]);
+        }
+    }
+}
+
+static void print_records(const RecorderSegment* segment, const DumpConfig* config) {
+    const RecorderSegmentHeader* header = segment->header;
+    uint64_t from_ns = header->start_clock_ns + (uint64_t)(config->from_s * 1e9);
+    uint64_t to_ns = config->to_s < 0.0 ? UINT64_MAX :
+                     header->start_clock_ns + (uint64_t)(config->to_s * 1e9);
+
+    RecorderCursor cursor;
+    recorder_cursor_init(&cursor, segment, config->type, from_ns, to_ns);
+
+    uint64_t time_ns;
+    Message message;
+    while (recorder_cursor_next(&cursor, &time_ns, &message)) {
+        printf("%12.6f %-16s %d -> %d", (double)(time_ns - header->start_clock_ns) / 1e9,
+               message_type_name(message.header.type), message.header.sender,
+               message.header.receiver);
+        print_payload(&message);
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    DumpConfig config = { .type = RECORDER_ANY_TYPE, .from_s = 0.0, .to_s = -1.0 };
+
+    int i = 1;
+    for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+            config.type = parse_type(argv[++i]);
+            if (config.type < RECORDER_ANY_TYPE) {
+                fprintf(stderr, "Unknown message type %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            config.from_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            config.to_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--summary") == 0) {
+            config.summary = true;
+        } else {
+            break;
+        }
+    }
+    if (i >= argc || config.from_s < 0.0) {
+        fprintf(stderr, "Usage: %s [--type T] [--from S] [--to S] [--summary] FILE.rec...\n",
+                argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (; i < argc; i++) {
+        RecorderSegment segment;
+        if (!recorder_segment_open(&segment, argv[i])) {
+            status = 1;
+            continue;
+        }
+        if (config.summary) {
+            print_summary(argv[i], &segment);
+        } else {
+            print_records(&segment, &config);
+        }
+        recorder_segment_close(&segment);
+    }
+    return status;
+}
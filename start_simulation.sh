@@ -23,22 +23,31 @@ if [ ! -f config/autopilot_config.json ]; then
 EOL
 fi
 
-# Start external components
+# Start external components together. Each writes a READY line to fd 3
+# once it accepts connections; fd 3 is a FIFO held open for reading and
+# writing here, so it never blocks or reports end of file.
 echo "Starting external components..."
-./build/external/gps_sender &
-sleep 0.5
-./build/external/landing_radio_sender &
-sleep 0.5
-./build/external/sat_com_sender &
-sleep 0.5
+SENDERS="gps_sender landing_radio_sender sat_com_sender"
+READY_FIFO=$(mktemp -u /tmp/airplane_sim_ready.XXXXXX)
+mkfifo "$READY_FIFO"
+exec 3<>"$READY_FIFO"
+rm -f "$READY_FIFO"
+for sender in $SENDERS; do
+    ./build/external/$sender --ready-fd 3 &
+done
 
-# Wait for components to initialize
 echo "Waiting for external components to initialize..."
-sleep 1
+for sender in $SENDERS; do
+    if ! read -r -t 10 -u 3 _; then
+        echo "External components not ready after 10 s, starting anyway" >&2
+        break
+    fi
+done
+exec 3<&-
 
 # Start main simulation
 echo "Starting main simulation..."
-./build/airplane_sim
+./build/airplane_sim "$@"
 
 # When main simulation exits, kill external components
 echo "Stopping external components..."